@@ -0,0 +1,8 @@
+# define source directory
+SRC		+= $(CHIPSET_PATH)
+
+# define include directory
+INCLUDE	+= $(CHIPSET_PATH)
+
+# define lib directory
+LIB		+=
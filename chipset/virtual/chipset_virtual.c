@@ -0,0 +1,20 @@
+#include <errno.h>
+
+#include "chipset_virtual.h"
+
+// public API
+/* The virtual controller needs no vendor setup */
+const struct bt_hci_chipset_driver *bt_hci_chipset_impl_local_instance(void)
+{
+    return NULL;
+}
+
+const bt_usb_interface_t *bt_chipset_get_usb_interface(void)
+{
+    return NULL;
+}
+
+const bt_uart_interface_t *bt_chipset_get_uart_interface(void)
+{
+    return NULL;
+}
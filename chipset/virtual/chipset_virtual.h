@@ -0,0 +1,16 @@
+#ifndef _CHIPSET_VIRTUAL_H_
+#define _CHIPSET_VIRTUAL_H_
+
+#include "chipset_interface.h"
+#include "platform_interface.h"
+#include "virtual_controller.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //_CHIPSET_VIRTUAL_H_
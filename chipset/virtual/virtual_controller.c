@@ -0,0 +1,1775 @@
+/* virtual_controller.c - Simulated LE controller for hardware-free testing */
+
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <errno.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "base/types.h"
+#include "base/byteorder.h"
+#include "base/util.h"
+
+#include <bluetooth/addr.h>
+#include <bluetooth/hci.h>
+
+#include "virtual_controller.h"
+
+#define H4_NONE 0x00
+#define H4_CMD  0x01
+#define H4_ACL  0x02
+#define H4_EVT  0x04
+
+/* Frame types on the simulated air */
+#define AIR_ADV  0x01
+#define AIR_DATA 0x02
+
+/* Advertising channel PDU types, numbered as on a real link */
+#define PDU_ADV_IND         0x00
+#define PDU_ADV_DIRECT_IND  0x01
+#define PDU_ADV_NONCONN_IND 0x02
+#define PDU_SCAN_REQ        0x03
+#define PDU_SCAN_RSP        0x04
+#define PDU_CONNECT_IND     0x05
+#define PDU_ADV_SCAN_IND    0x06
+
+/* Data channel LLIDs */
+#define LLID_CONT  0x01
+#define LLID_START 0x02
+#define LLID_CTRL  0x03
+
+/* Control PDU opcodes, a subset with simplified layouts */
+#define LL_CONN_UPDATE_IND 0x00
+#define LL_TERMINATE_IND   0x02
+#define LL_FEATURE_REQ     0x08
+#define LL_FEATURE_RSP     0x09
+#define LL_VERSION_IND     0x0c
+
+/* Peripheral-initiated Features Exchange */
+#define VCTRL_LE_FEATURES BIT(3)
+
+#define VCTRL_CTRL_LEN        12
+#define VCTRL_CTRL_QUEUE      4
+#define VCTRL_FAL_SIZE        8
+#define VCTRL_DUP_SIZE        16
+#define VCTRL_INSTANT_OFFSET  6U
+#define VCTRL_IDLE_US         10000U
+#define VCTRL_ADV_DELAY_US    10000U
+#define VCTRL_HD_DIRECT_US    3750U
+#define VCTRL_HD_TIMEOUT_US   1280000U
+#define VCTRL_MANUFACTURER    0xffff
+#define VCTRL_LE_EVT_MASK_DEF 0x1f
+
+#define H4_BUF_SIZE MAX(sizeof(struct bt_hci_cmd_hdr) + UINT8_MAX,                                 \
+                        sizeof(struct bt_hci_acl_hdr) + BT_VCTRL_ACL_LEN_MAX)
+
+struct air_adv
+{
+    uint8_t type;
+    uint8_t pdu;
+    /* Sender: AdvA, ScanA or InitA */
+    bt_addr_le_t a0;
+    /* Target: TargetA, AdvA or none */
+    bt_addr_le_t a1;
+    uint8_t len;
+    uint8_t data[31];
+} __packed;
+
+struct air_conn_ind
+{
+    uint32_t aa;
+    uint16_t interval;
+    uint16_t latency;
+    uint16_t timeout;
+} __packed;
+
+struct air_data
+{
+    uint8_t type;
+    uint32_t aa;
+    uint16_t event;
+    uint8_t llid;
+    uint8_t md;
+    uint8_t len;
+    uint8_t data[0];
+} __packed;
+
+struct ll_conn_update_ind
+{
+    uint8_t opcode;
+    uint16_t interval;
+    uint16_t latency;
+    uint16_t timeout;
+    uint16_t instant;
+} __packed;
+
+struct ll_version_ind
+{
+    uint8_t opcode;
+    uint8_t version;
+    uint16_t company;
+    uint16_t subversion;
+} __packed;
+
+struct vctrl_buf
+{
+    uint8_t llid;
+    uint8_t len;
+    uint8_t data[BT_VCTRL_ACL_LEN_MAX];
+};
+
+struct vctrl_ctrl
+{
+    uint8_t len;
+    uint8_t data[VCTRL_CTRL_LEN];
+};
+
+struct vctrl_conn
+{
+    bool used;
+    bool terminated;
+    uint8_t role;
+    bt_addr_le_t peer;
+    uint32_t aa;
+    uint16_t interval;
+    uint16_t latency;
+    uint16_t timeout;
+    uint16_t event;
+    uint32_t next_event;
+    uint32_t last_rx;
+
+    /* Host ACL waiting for a connection event, indexes into the pool */
+    uint8_t tx_queue[BT_VCTRL_ACL_COUNT_MAX];
+    uint8_t tx_head;
+    uint8_t tx_count;
+    /* Sent since the last Number Of Completed Packets */
+    uint16_t completed;
+
+    struct vctrl_ctrl ctrl[VCTRL_CTRL_QUEUE];
+    uint8_t ctrl_head;
+    uint8_t ctrl_count;
+
+    bool update_pending;
+    uint16_t instant;
+    uint16_t new_interval;
+    uint16_t new_latency;
+    uint16_t new_timeout;
+
+    bool feat_req;
+    bool version_req;
+    bool version_sent;
+    bool version_known;
+    struct ll_version_ind peer_version;
+};
+
+struct vctrl_dup
+{
+    bt_addr_le_t addr;
+    uint8_t evt_type;
+};
+
+static struct
+{
+    struct bt_vctrl_config cfg;
+    const struct bt_vctrl_io *io;
+    uint32_t rand;
+
+    bt_addr_le_t public_addr;
+    bt_addr_le_t random_addr;
+    uint64_t le_event_mask;
+
+    struct
+    {
+        uint8_t type;
+        uint32_t len;
+        uint32_t need;
+        bool hdr_done;
+        uint8_t buf[H4_BUF_SIZE];
+    } h4;
+
+    struct
+    {
+        bool enabled;
+        struct bt_hci_cp_le_set_adv_param param;
+        uint8_t data_len;
+        uint8_t data[31];
+        uint8_t rsp_len;
+        uint8_t rsp[31];
+        uint32_t next;
+        uint32_t deadline;
+    } adv;
+
+    struct
+    {
+        bool enabled;
+        struct bt_hci_cp_le_set_scan_param param;
+        uint8_t filter_dup;
+        struct vctrl_dup dup[VCTRL_DUP_SIZE];
+        uint8_t dup_count;
+        bool req_pending;
+        bt_addr_le_t req_addr;
+    } scan;
+
+    struct
+    {
+        bool enabled;
+        struct bt_hci_cp_le_create_conn param;
+    } init;
+
+    bt_addr_le_t fal[VCTRL_FAL_SIZE];
+    uint8_t fal_count;
+
+    struct vctrl_buf bufs[BT_VCTRL_ACL_COUNT_MAX];
+    uint8_t free_bufs[BT_VCTRL_ACL_COUNT_MAX];
+    uint8_t free_count;
+
+    struct vctrl_conn conns[BT_VCTRL_CONN_MAX];
+} vc;
+
+static bool time_due(uint32_t now, uint32_t at)
+{
+    return (int32_t)(now - at) >= 0;
+}
+
+static uint32_t time_earliest(uint32_t now, uint32_t a, uint32_t b)
+{
+    return (a - now) < (b - now) ? a : b;
+}
+
+static uint32_t vctrl_rand(void)
+{
+    vc.rand ^= vc.rand << 13;
+    vc.rand ^= vc.rand >> 17;
+    vc.rand ^= vc.rand << 5;
+
+    return vc.rand;
+}
+
+static const bt_addr_le_t *own_addr(uint8_t own_addr_type)
+{
+    /* No controller based privacy, resolvable types fall back to the identity */
+    return (own_addr_type & BT_ADDR_LE_RANDOM) ? &vc.random_addr : &vc.public_addr;
+}
+
+static bool fal_contains(const bt_addr_le_t *addr)
+{
+    uint8_t i;
+
+    for (i = 0U; i < vc.fal_count; i++)
+    {
+        if (!bt_addr_le_cmp(&vc.fal[i], addr))
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/* Host interface */
+
+static void evt_send(uint8_t evt, const void *data, uint8_t len)
+{
+    uint8_t buf[1 + sizeof(struct bt_hci_evt_hdr) + UINT8_MAX];
+    struct bt_hci_evt_hdr *hdr = (void *)&buf[1];
+
+    buf[0] = H4_EVT;
+    hdr->evt = evt;
+    hdr->len = len;
+    (void)memcpy(&buf[1 + sizeof(*hdr)], data, len);
+
+    vc.io->h4_write(buf, 1 + sizeof(*hdr) + len);
+}
+
+static void le_meta_send(uint8_t subevent, const void *data, uint8_t len)
+{
+    uint8_t buf[UINT8_MAX];
+
+    if (!(vc.le_event_mask & BIT64(subevent - 1U)))
+    {
+        return;
+    }
+
+    buf[0] = subevent;
+    (void)memcpy(&buf[1], data, len);
+
+    evt_send(BT_HCI_EVT_LE_META_EVENT, buf, 1 + len);
+}
+
+static void cmd_complete(uint16_t opcode, const void *rp, uint8_t len)
+{
+    uint8_t buf[UINT8_MAX];
+    struct bt_hci_evt_cmd_complete *cc = (void *)buf;
+
+    cc->ncmd = 1U;
+    cc->opcode = sys_cpu_to_le16(opcode);
+    (void)memcpy(&buf[sizeof(*cc)], rp, len);
+
+    evt_send(BT_HCI_EVT_CMD_COMPLETE, buf, sizeof(*cc) + len);
+}
+
+static void cmd_complete_status(uint16_t opcode, uint8_t status)
+{
+    cmd_complete(opcode, &status, sizeof(status));
+}
+
+static void cmd_status(uint16_t opcode, uint8_t status)
+{
+    struct bt_hci_evt_cmd_status cs;
+
+    cs.status = status;
+    cs.ncmd = 1U;
+    cs.opcode = sys_cpu_to_le16(opcode);
+
+    evt_send(BT_HCI_EVT_CMD_STATUS, &cs, sizeof(cs));
+}
+
+static void acl_to_host(struct vctrl_conn *conn, uint8_t llid, const uint8_t *data, uint8_t len)
+{
+    uint8_t buf[1 + sizeof(struct bt_hci_acl_hdr) + BT_VCTRL_ACL_LEN_MAX];
+    struct bt_hci_acl_hdr *hdr = (void *)&buf[1];
+    uint8_t pb = llid == LLID_START ? BT_ACL_START : BT_ACL_CONT;
+
+    buf[0] = H4_ACL;
+    hdr->handle = sys_cpu_to_le16(bt_acl_handle_pack(conn - vc.conns, pb));
+    hdr->len = sys_cpu_to_le16(len);
+    (void)memcpy(&buf[1 + sizeof(*hdr)], data, len);
+
+    vc.io->h4_write(buf, 1 + sizeof(*hdr) + len);
+}
+
+/* Report every packet sent over the air since the last call */
+static void nocp_flush(void)
+{
+    uint8_t buf[1 + BT_VCTRL_CONN_MAX * sizeof(struct bt_hci_handle_count)];
+    struct bt_hci_evt_num_completed_packets *ev = (void *)buf;
+    struct vctrl_conn *conn;
+    uint8_t i;
+
+    ev->num_handles = 0U;
+
+    for (i = 0U; i < BT_VCTRL_CONN_MAX; i++)
+    {
+        conn = &vc.conns[i];
+        if (!conn->used || !conn->completed)
+        {
+            continue;
+        }
+
+        ev->h[ev->num_handles].handle = sys_cpu_to_le16(i);
+        ev->h[ev->num_handles].count = sys_cpu_to_le16(conn->completed);
+        ev->num_handles++;
+        conn->completed = 0U;
+    }
+
+    if (ev->num_handles)
+    {
+        evt_send(BT_HCI_EVT_NUM_COMPLETED_PACKETS, buf,
+                 1 + ev->num_handles * sizeof(struct bt_hci_handle_count));
+    }
+}
+
+static void conn_complete_send(uint8_t status, struct vctrl_conn *conn)
+{
+    struct bt_hci_evt_le_conn_complete evt;
+
+    (void)memset(&evt, 0, sizeof(evt));
+    evt.status = status;
+
+    if (conn)
+    {
+        evt.handle = sys_cpu_to_le16(conn - vc.conns);
+        evt.role = conn->role;
+        bt_addr_le_copy(&evt.peer_addr, &conn->peer);
+        evt.interval = sys_cpu_to_le16(conn->interval);
+        evt.latency = sys_cpu_to_le16(conn->latency);
+        evt.supv_timeout = sys_cpu_to_le16(conn->timeout);
+    }
+
+    le_meta_send(BT_HCI_EVT_LE_CONN_COMPLETE, &evt, sizeof(evt));
+}
+
+/* Connections */
+
+static struct vctrl_conn *conn_get(uint16_t handle)
+{
+    if (handle >= BT_VCTRL_CONN_MAX || !vc.conns[handle].used)
+    {
+        return NULL;
+    }
+
+    return &vc.conns[handle];
+}
+
+static struct vctrl_conn *conn_alloc(uint8_t role, const bt_addr_le_t *peer, uint32_t now)
+{
+    struct vctrl_conn *conn;
+    uint8_t i;
+
+    for (i = 0U; i < BT_VCTRL_CONN_MAX; i++)
+    {
+        conn = &vc.conns[i];
+        if (conn->used)
+        {
+            continue;
+        }
+
+        (void)memset(conn, 0, sizeof(*conn));
+        conn->used = true;
+        conn->role = role;
+        bt_addr_le_copy(&conn->peer, peer);
+        conn->last_rx = now;
+
+        return conn;
+    }
+
+    return NULL;
+}
+
+static void conn_disconnected(struct vctrl_conn *conn, uint8_t reason)
+{
+    struct bt_hci_evt_disconn_complete evt;
+
+    /* The host must see the completions before the handle goes away */
+    nocp_flush();
+
+    while (conn->tx_count)
+    {
+        vc.free_bufs[vc.free_count++] = conn->tx_queue[conn->tx_head];
+        conn->tx_head = (conn->tx_head + 1U) % BT_VCTRL_ACL_COUNT_MAX;
+        conn->tx_count--;
+    }
+
+    conn->used = false;
+
+    evt.status = BT_HCI_ERR_SUCCESS;
+    evt.handle = sys_cpu_to_le16(conn - vc.conns);
+    evt.reason = reason;
+
+    evt_send(BT_HCI_EVT_DISCONN_COMPLETE, &evt, sizeof(evt));
+}
+
+static int ctrl_queue(struct vctrl_conn *conn, const void *data, uint8_t len)
+{
+    struct vctrl_ctrl *ctrl;
+
+    if (conn->ctrl_count >= VCTRL_CTRL_QUEUE)
+    {
+        return -ENOMEM;
+    }
+
+    ctrl = &conn->ctrl[(conn->ctrl_head + conn->ctrl_count) % VCTRL_CTRL_QUEUE];
+    ctrl->len = len;
+    (void)memcpy(ctrl->data, data, len);
+    conn->ctrl_count++;
+
+    return 0;
+}
+
+static void ctrl_version_queue(struct vctrl_conn *conn)
+{
+    struct ll_version_ind ind = {
+            .opcode = LL_VERSION_IND,
+            .version = BT_HCI_VERSION_5_0,
+            .company = VCTRL_MANUFACTURER,
+            .subversion = 0U,
+    };
+
+    if (!ctrl_queue(conn, &ind, sizeof(ind)))
+    {
+        conn->version_sent = true;
+    }
+}
+
+static void ctrl_features_queue(struct vctrl_conn *conn, uint8_t opcode)
+{
+    uint8_t pdu[9];
+
+    (void)memset(pdu, 0, sizeof(pdu));
+    pdu[0] = opcode;
+    pdu[1] = VCTRL_LE_FEATURES;
+
+    (void)ctrl_queue(conn, pdu, sizeof(pdu));
+}
+
+static void remote_version_send(struct vctrl_conn *conn)
+{
+    struct bt_hci_evt_remote_version_info evt;
+
+    evt.status = BT_HCI_ERR_SUCCESS;
+    evt.handle = sys_cpu_to_le16(conn - vc.conns);
+    evt.version = conn->peer_version.version;
+    evt.manufacturer = sys_cpu_to_le16(conn->peer_version.company);
+    evt.subversion = sys_cpu_to_le16(conn->peer_version.subversion);
+
+    evt_send(BT_HCI_EVT_REMOTE_VERSION_INFO, &evt, sizeof(evt));
+    conn->version_req = false;
+}
+
+static void conn_update_apply(struct vctrl_conn *conn)
+{
+    struct bt_hci_evt_le_conn_update_complete evt;
+
+    conn->update_pending = false;
+    conn->interval = conn->new_interval;
+    conn->latency = conn->new_latency;
+    conn->timeout = conn->new_timeout;
+
+    evt.status = BT_HCI_ERR_SUCCESS;
+    evt.handle = sys_cpu_to_le16(conn - vc.conns);
+    evt.interval = sys_cpu_to_le16(conn->interval);
+    evt.latency = sys_cpu_to_le16(conn->latency);
+    evt.supv_timeout = sys_cpu_to_le16(conn->timeout);
+
+    le_meta_send(BT_HCI_EVT_LE_CONN_UPDATE_COMPLETE, &evt, sizeof(evt));
+}
+
+static void pdu_send(struct vctrl_conn *conn, uint8_t llid, const uint8_t *data, uint8_t len,
+                     bool md)
+{
+    uint8_t buf[sizeof(struct air_data) + BT_VCTRL_ACL_LEN_MAX];
+    struct air_data *pdu = (void *)buf;
+
+    pdu->type = AIR_DATA;
+    pdu->aa = conn->aa;
+    pdu->event = conn->event;
+    pdu->llid = llid;
+    pdu->md = md;
+    pdu->len = len;
+    if (len)
+    {
+        (void)memcpy(pdu->data, data, len);
+    }
+
+    vc.io->air_send(buf, sizeof(*pdu) + len);
+}
+
+/* One side of a connection event: control PDUs first, then up to
+ * pdus_per_event data PDUs, or an empty PDU when there is nothing to send.
+ */
+static void conn_tx_event(struct vctrl_conn *conn)
+{
+    uint8_t data = MIN(conn->tx_count, vc.cfg.pdus_per_event);
+    uint8_t left = conn->ctrl_count + data;
+    struct vctrl_ctrl *ctrl;
+    struct vctrl_buf *buf;
+    uint8_t idx;
+
+    if (!left)
+    {
+        pdu_send(conn, LLID_CONT, NULL, 0U, false);
+        return;
+    }
+
+    while (conn->ctrl_count)
+    {
+        ctrl = &conn->ctrl[conn->ctrl_head];
+        conn->ctrl_head = (conn->ctrl_head + 1U) % VCTRL_CTRL_QUEUE;
+        conn->ctrl_count--;
+
+        pdu_send(conn, LLID_CTRL, ctrl->data, ctrl->len, --left > 0U);
+
+        if (ctrl->data[0] == LL_TERMINATE_IND)
+        {
+            conn->terminated = true;
+            return;
+        }
+    }
+
+    while (data--)
+    {
+        idx = conn->tx_queue[conn->tx_head];
+        buf = &vc.bufs[idx];
+        conn->tx_head = (conn->tx_head + 1U) % BT_VCTRL_ACL_COUNT_MAX;
+        conn->tx_count--;
+
+        pdu_send(conn, buf->llid, buf->data, buf->len, --left > 0U);
+
+        vc.free_bufs[vc.free_count++] = idx;
+        conn->completed++;
+    }
+}
+
+static void conn_central_event(struct vctrl_conn *conn, uint32_t now)
+{
+    uint32_t interval_us;
+
+    if (conn->update_pending && conn->event == conn->instant)
+    {
+        conn_update_apply(conn);
+    }
+
+    conn_tx_event(conn);
+
+    if (conn->terminated)
+    {
+        conn_disconnected(conn, BT_HCI_ERR_LOCALHOST_TERM_CONN);
+        return;
+    }
+
+    interval_us = conn->interval * 1250U;
+    conn->event++;
+    conn->next_event += interval_us;
+
+    /* Skip the anchors missed while the process was not scheduled */
+    if (time_due(now, conn->next_event))
+    {
+        conn->next_event = now + interval_us;
+    }
+}
+
+static void ctrl_rx(struct vctrl_conn *conn, const uint8_t *data, uint8_t len)
+{
+    struct bt_hci_evt_le_remote_feat_complete feat;
+    const struct ll_conn_update_ind *upd;
+
+    if (!len)
+    {
+        return;
+    }
+
+    switch (data[0])
+    {
+    case LL_CONN_UPDATE_IND:
+        if (conn->role != BT_HCI_ROLE_PERIPHERAL || len < sizeof(*upd))
+        {
+            break;
+        }
+
+        upd = (const void *)data;
+        conn->update_pending = true;
+        conn->new_interval = upd->interval;
+        conn->new_latency = upd->latency;
+        conn->new_timeout = upd->timeout;
+        conn->instant = upd->instant;
+        break;
+    case LL_TERMINATE_IND:
+        conn->terminated = true;
+        conn_disconnected(conn, len > 1U ? data[1] : BT_HCI_ERR_REMOTE_USER_TERM_CONN);
+        break;
+    case LL_FEATURE_REQ:
+        ctrl_features_queue(conn, LL_FEATURE_RSP);
+        break;
+    case LL_FEATURE_RSP:
+        if (!conn->feat_req || len < 1U + sizeof(feat.features))
+        {
+            break;
+        }
+
+        conn->feat_req = false;
+        feat.status = BT_HCI_ERR_SUCCESS;
+        feat.handle = sys_cpu_to_le16(conn - vc.conns);
+        (void)memcpy(feat.features, &data[1], sizeof(feat.features));
+        le_meta_send(BT_HCI_EVT_LE_REMOTE_FEAT_COMPLETE, &feat, sizeof(feat));
+        break;
+    case LL_VERSION_IND:
+        if (len < sizeof(conn->peer_version))
+        {
+            break;
+        }
+
+        (void)memcpy(&conn->peer_version, data, sizeof(conn->peer_version));
+        conn->version_known = true;
+
+        if (!conn->version_sent)
+        {
+            ctrl_version_queue(conn);
+        }
+
+        if (conn->version_req)
+        {
+            remote_version_send(conn);
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+static void data_rx(const struct air_data *pdu, uint16_t len, uint32_t now)
+{
+    struct vctrl_conn *conn = NULL;
+    uint8_t i;
+
+    if (len < sizeof(*pdu) || len < sizeof(*pdu) + pdu->len)
+    {
+        return;
+    }
+
+    for (i = 0U; i < BT_VCTRL_CONN_MAX; i++)
+    {
+        if (vc.conns[i].used && vc.conns[i].aa == pdu->aa)
+        {
+            conn = &vc.conns[i];
+            break;
+        }
+    }
+
+    if (!conn)
+    {
+        return;
+    }
+
+    conn->last_rx = now;
+
+    if (conn->role == BT_HCI_ROLE_PERIPHERAL)
+    {
+        conn->event = pdu->event;
+
+        if (conn->update_pending && (int16_t)(conn->event - conn->instant) >= 0)
+        {
+            conn_update_apply(conn);
+        }
+    }
+
+    if (pdu->llid == LLID_CTRL)
+    {
+        ctrl_rx(conn, pdu->data, pdu->len);
+        if (conn->terminated)
+        {
+            return;
+        }
+    }
+    else if (pdu->len)
+    {
+        acl_to_host(conn, pdu->llid, pdu->data, pdu->len);
+    }
+
+    /* The peripheral answers once the central has nothing more to send */
+    if (conn->role == BT_HCI_ROLE_PERIPHERAL && !pdu->md)
+    {
+        conn_tx_event(conn);
+
+        if (conn->terminated)
+        {
+            conn_disconnected(conn, BT_HCI_ERR_LOCALHOST_TERM_CONN);
+        }
+    }
+}
+
+/* Advertising, scanning and initiating */
+
+static void adv_pdu_send(uint8_t pdu_type, const bt_addr_le_t *a0, const bt_addr_le_t *a1,
+                         const void *data, uint8_t len)
+{
+    struct air_adv pdu;
+
+    (void)memset(&pdu, 0, sizeof(pdu));
+    pdu.type = AIR_ADV;
+    pdu.pdu = pdu_type;
+    bt_addr_le_copy(&pdu.a0, a0);
+    if (a1)
+    {
+        bt_addr_le_copy(&pdu.a1, a1);
+    }
+    pdu.len = len;
+    if (len)
+    {
+        (void)memcpy(pdu.data, data, len);
+    }
+
+    vc.io->air_send((const uint8_t *)&pdu, offsetof(struct air_adv, data) + len);
+}
+
+static bool adv_high_duty(void)
+{
+    return vc.adv.param.type == BT_HCI_ADV_DIRECT_IND;
+}
+
+static bool adv_connectable(void)
+{
+    return vc.adv.param.type == BT_HCI_ADV_IND || vc.adv.param.type == BT_HCI_ADV_DIRECT_IND ||
+           vc.adv.param.type == BT_HCI_ADV_DIRECT_IND_LOW_DUTY;
+}
+
+static bool adv_scannable(void)
+{
+    return vc.adv.param.type == BT_HCI_ADV_IND || vc.adv.param.type == BT_HCI_ADV_SCAN_IND;
+}
+
+static void adv_event(uint32_t now)
+{
+    const bt_addr_le_t *addr = own_addr(vc.adv.param.own_addr_type);
+    uint32_t interval_us;
+
+    switch (vc.adv.param.type)
+    {
+    case BT_HCI_ADV_IND:
+        adv_pdu_send(PDU_ADV_IND, addr, NULL, vc.adv.data, vc.adv.data_len);
+        break;
+    case BT_HCI_ADV_DIRECT_IND:
+    case BT_HCI_ADV_DIRECT_IND_LOW_DUTY:
+        adv_pdu_send(PDU_ADV_DIRECT_IND, addr, &vc.adv.param.direct_addr, NULL, 0U);
+        break;
+    case BT_HCI_ADV_SCAN_IND:
+        adv_pdu_send(PDU_ADV_SCAN_IND, addr, NULL, vc.adv.data, vc.adv.data_len);
+        break;
+    default:
+        adv_pdu_send(PDU_ADV_NONCONN_IND, addr, NULL, vc.adv.data, vc.adv.data_len);
+        break;
+    }
+
+    if (adv_high_duty())
+    {
+        interval_us = VCTRL_HD_DIRECT_US;
+    }
+    else
+    {
+        interval_us = sys_le16_to_cpu(vc.adv.param.min_interval) * 625U +
+                      vctrl_rand() % VCTRL_ADV_DELAY_US;
+    }
+
+    vc.adv.next = now + interval_us;
+}
+
+static bool adv_filter(const bt_addr_le_t *addr, uint8_t policy)
+{
+    if (!(vc.adv.param.filter_policy & policy))
+    {
+        return true;
+    }
+
+    return fal_contains(addr);
+}
+
+static void adv_scan_req_rx(const struct air_adv *pdu)
+{
+    if (!vc.adv.enabled || !adv_scannable() ||
+        bt_addr_le_cmp(&pdu->a1, own_addr(vc.adv.param.own_addr_type)) ||
+        !adv_filter(&pdu->a0, BT_LE_ADV_FP_FILTER_SCAN_REQ))
+    {
+        return;
+    }
+
+    adv_pdu_send(PDU_SCAN_RSP, own_addr(vc.adv.param.own_addr_type), NULL, vc.adv.rsp,
+                 vc.adv.rsp_len);
+}
+
+static void adv_connect_ind_rx(const struct air_adv *pdu, uint32_t now)
+{
+    const struct air_conn_ind *ind = (const void *)pdu->data;
+    struct vctrl_conn *conn;
+
+    if (!vc.adv.enabled || !adv_connectable() || pdu->len < sizeof(*ind) ||
+        bt_addr_le_cmp(&pdu->a1, own_addr(vc.adv.param.own_addr_type)))
+    {
+        return;
+    }
+
+    if (vc.adv.param.type == BT_HCI_ADV_IND)
+    {
+        if (!adv_filter(&pdu->a0, BT_LE_ADV_FP_FILTER_CONN_IND))
+        {
+            return;
+        }
+    }
+    else if (bt_addr_le_cmp(&pdu->a0, &vc.adv.param.direct_addr))
+    {
+        return;
+    }
+
+    conn = conn_alloc(BT_HCI_ROLE_PERIPHERAL, &pdu->a0, now);
+    if (!conn)
+    {
+        return;
+    }
+
+    vc.adv.enabled = false;
+
+    conn->aa = ind->aa;
+    conn->interval = ind->interval;
+    conn->latency = ind->latency;
+    conn->timeout = ind->timeout;
+
+    conn_complete_send(BT_HCI_ERR_SUCCESS, conn);
+}
+
+static bool init_accepts(const bt_addr_le_t *addr)
+{
+    if (vc.init.param.filter_policy)
+    {
+        return fal_contains(addr);
+    }
+
+    return !bt_addr_le_cmp(addr, &vc.init.param.peer_addr);
+}
+
+static void init_connect(const struct air_adv *adv, uint32_t now)
+{
+    const struct bt_hci_cp_le_create_conn *cp = &vc.init.param;
+    struct air_conn_ind ind;
+    struct vctrl_conn *conn;
+
+    conn = conn_alloc(BT_HCI_ROLE_CENTRAL, &adv->a0, now);
+    if (!conn)
+    {
+        return;
+    }
+
+    vc.init.enabled = false;
+
+    conn->aa = vctrl_rand();
+    conn->interval = sys_le16_to_cpu(cp->conn_interval_max);
+    conn->latency = sys_le16_to_cpu(cp->conn_latency);
+    conn->timeout = sys_le16_to_cpu(cp->supervision_timeout);
+    conn->next_event = now + conn->interval * 1250U;
+
+    ind.aa = conn->aa;
+    ind.interval = conn->interval;
+    ind.latency = conn->latency;
+    ind.timeout = conn->timeout;
+
+    adv_pdu_send(PDU_CONNECT_IND, own_addr(cp->own_addr_type), &adv->a0, &ind, sizeof(ind));
+
+    conn_complete_send(BT_HCI_ERR_SUCCESS, conn);
+}
+
+static bool scan_duplicate(const bt_addr_le_t *addr, uint8_t evt_type)
+{
+    struct vctrl_dup *dup;
+    uint8_t i;
+
+    if (vc.scan.filter_dup != BT_HCI_LE_SCAN_FILTER_DUP_ENABLE)
+    {
+        return false;
+    }
+
+    for (i = 0U; i < vc.scan.dup_count; i++)
+    {
+        dup = &vc.scan.dup[i];
+        if (dup->evt_type == evt_type && !bt_addr_le_cmp(&dup->addr, addr))
+        {
+            return true;
+        }
+    }
+
+    /* Once the table is full new advertisers are always reported */
+    if (vc.scan.dup_count < VCTRL_DUP_SIZE)
+    {
+        dup = &vc.scan.dup[vc.scan.dup_count++];
+        bt_addr_le_copy(&dup->addr, addr);
+        dup->evt_type = evt_type;
+    }
+
+    return false;
+}
+
+static void scan_report(const struct air_adv *pdu, uint8_t evt_type)
+{
+    uint8_t buf[1 + sizeof(struct bt_hci_evt_le_advertising_info) + 31 + 1];
+    struct bt_hci_evt_le_advertising_info *info = (void *)&buf[1];
+    uint8_t len = MIN(pdu->len, sizeof(pdu->data));
+
+    buf[0] = 1U;
+    info->evt_type = evt_type;
+    bt_addr_le_copy(&info->addr, &pdu->a0);
+    info->length = len;
+    (void)memcpy(info->data, pdu->data, len);
+    info->data[len] = (uint8_t)vc.cfg.rssi;
+
+    le_meta_send(BT_HCI_EVT_LE_ADVERTISING_REPORT, buf, 1 + sizeof(*info) + len + 1);
+}
+
+static void scan_adv_rx(const struct air_adv *pdu, uint8_t evt_type)
+{
+    const bt_addr_le_t *addr = own_addr(vc.scan.param.addr_type);
+
+    if (pdu->pdu == PDU_ADV_DIRECT_IND && bt_addr_le_cmp(&pdu->a1, addr))
+    {
+        return;
+    }
+
+    if (vc.scan.param.filter_policy == BT_HCI_LE_SCAN_FP_BASIC_FILTER && !fal_contains(&pdu->a0))
+    {
+        return;
+    }
+
+    if (scan_duplicate(&pdu->a0, evt_type))
+    {
+        return;
+    }
+
+    scan_report(pdu, evt_type);
+
+    if (vc.scan.param.scan_type == BT_HCI_LE_SCAN_ACTIVE &&
+        (pdu->pdu == PDU_ADV_IND || pdu->pdu == PDU_ADV_SCAN_IND))
+    {
+        vc.scan.req_pending = true;
+        bt_addr_le_copy(&vc.scan.req_addr, &pdu->a0);
+        adv_pdu_send(PDU_SCAN_REQ, addr, &pdu->a0, NULL, 0U);
+    }
+}
+
+static void scan_rsp_rx(const struct air_adv *pdu)
+{
+    if (!vc.scan.enabled || !vc.scan.req_pending || bt_addr_le_cmp(&pdu->a0, &vc.scan.req_addr))
+    {
+        return;
+    }
+
+    vc.scan.req_pending = false;
+
+    if (!scan_duplicate(&pdu->a0, BT_HCI_ADV_SCAN_RSP))
+    {
+        scan_report(pdu, BT_HCI_ADV_SCAN_RSP);
+    }
+}
+
+static void adv_rx(const struct air_adv *pdu, uint16_t len, uint32_t now)
+{
+    uint8_t evt_type;
+
+    if (len < offsetof(struct air_adv, data) || len < offsetof(struct air_adv, data) + pdu->len ||
+        pdu->len > sizeof(pdu->data))
+    {
+        return;
+    }
+
+    switch (pdu->pdu)
+    {
+    case PDU_ADV_IND:
+        evt_type = BT_HCI_ADV_IND;
+        break;
+    case PDU_ADV_DIRECT_IND:
+        evt_type = BT_HCI_ADV_DIRECT_IND;
+        break;
+    case PDU_ADV_SCAN_IND:
+        evt_type = BT_HCI_ADV_SCAN_IND;
+        break;
+    case PDU_ADV_NONCONN_IND:
+        evt_type = BT_HCI_ADV_NONCONN_IND;
+        break;
+    case PDU_SCAN_REQ:
+        adv_scan_req_rx(pdu);
+        return;
+    case PDU_SCAN_RSP:
+        scan_rsp_rx(pdu);
+        return;
+    case PDU_CONNECT_IND:
+        adv_connect_ind_rx(pdu, now);
+        return;
+    default:
+        return;
+    }
+
+    if (vc.init.enabled && init_accepts(&pdu->a0) &&
+        (pdu->pdu == PDU_ADV_IND ||
+         (pdu->pdu == PDU_ADV_DIRECT_IND &&
+          !bt_addr_le_cmp(&pdu->a1, own_addr(vc.init.param.own_addr_type)))))
+    {
+        init_connect(pdu, now);
+        return;
+    }
+
+    if (vc.scan.enabled)
+    {
+        scan_adv_rx(pdu, evt_type);
+    }
+}
+
+/* HCI commands */
+
+static void cmd_reset(void)
+{
+    uint8_t i;
+
+    (void)memset(&vc.adv, 0, sizeof(vc.adv));
+    (void)memset(&vc.scan, 0, sizeof(vc.scan));
+    (void)memset(&vc.init, 0, sizeof(vc.init));
+    (void)memset(vc.conns, 0, sizeof(vc.conns));
+    (void)memset(&vc.random_addr, 0, sizeof(vc.random_addr));
+    vc.random_addr.type = BT_ADDR_LE_RANDOM;
+    vc.fal_count = 0U;
+    vc.le_event_mask = VCTRL_LE_EVT_MASK_DEF;
+
+    vc.adv.param.min_interval = sys_cpu_to_le16(BT_LE_ADV_INTERVAL_DEFAULT);
+    vc.adv.param.channel_map = BT_LE_ADV_CHAN_MAP_ALL;
+
+    for (i = 0U; i < vc.cfg.acl_count; i++)
+    {
+        vc.free_bufs[i] = i;
+    }
+    vc.free_count = vc.cfg.acl_count;
+}
+
+static void cmd_read_supported_commands(uint16_t opcode)
+{
+    struct bt_hci_rp_read_supported_commands rp;
+
+    (void)memset(&rp, 0, sizeof(rp));
+    rp.status = BT_HCI_ERR_SUCCESS;
+    /* Disconnect, Read Remote Version Information */
+    rp.commands[0] = BIT(5);
+    rp.commands[2] = BIT(7);
+    /* Set Event Mask, Reset */
+    rp.commands[5] = BIT(6) | BIT(7);
+    /* Read Local Version Information, Read Local Supported Features */
+    rp.commands[14] = BIT(3) | BIT(5);
+    /* Read BD_ADDR */
+    rp.commands[15] = BIT(1);
+    /* LE Set Event Mask through LE Set Advertising Data */
+    rp.commands[25] = BIT(0) | BIT(1) | BIT(2) | BIT(4) | BIT(5) | BIT(6) | BIT(7);
+    /* LE Set Scan Response Data through LE Clear Filter Accept List */
+    rp.commands[26] = 0xff;
+    /* Filter Accept List, Connection Update, Read Remote Features, Rand */
+    rp.commands[27] = BIT(0) | BIT(1) | BIT(2) | BIT(5) | BIT(7);
+    /* LE Read Supported States */
+    rp.commands[28] = BIT(3);
+
+    cmd_complete(opcode, &rp, sizeof(rp));
+}
+
+static void cmd_read_local_version(uint16_t opcode)
+{
+    struct bt_hci_rp_read_local_version_info rp;
+
+    rp.status = BT_HCI_ERR_SUCCESS;
+    rp.hci_version = BT_HCI_VERSION_5_0;
+    rp.hci_revision = 0U;
+    rp.lmp_version = BT_HCI_VERSION_5_0;
+    rp.manufacturer = sys_cpu_to_le16(VCTRL_MANUFACTURER);
+    rp.lmp_subversion = 0U;
+
+    cmd_complete(opcode, &rp, sizeof(rp));
+}
+
+static void cmd_read_local_features(uint16_t opcode)
+{
+    struct bt_hci_rp_read_local_features rp;
+
+    (void)memset(&rp, 0, sizeof(rp));
+    rp.status = BT_HCI_ERR_SUCCESS;
+    /* BR/EDR Not Supported, LE Supported (Controller) */
+    rp.features[4] = BIT(5) | BIT(6);
+
+    cmd_complete(opcode, &rp, sizeof(rp));
+}
+
+static void cmd_le_read_local_features(uint16_t opcode)
+{
+    struct bt_hci_rp_le_read_local_features rp;
+
+    (void)memset(&rp, 0, sizeof(rp));
+    rp.status = BT_HCI_ERR_SUCCESS;
+    rp.features[0] = VCTRL_LE_FEATURES;
+
+    cmd_complete(opcode, &rp, sizeof(rp));
+}
+
+static void cmd_le_read_buffer_size(uint16_t opcode)
+{
+    struct bt_hci_rp_le_read_buffer_size rp;
+
+    rp.status = BT_HCI_ERR_SUCCESS;
+    rp.le_max_len = sys_cpu_to_le16(vc.cfg.acl_len);
+    rp.le_max_num = vc.cfg.acl_count;
+
+    cmd_complete(opcode, &rp, sizeof(rp));
+}
+
+static void cmd_read_bd_addr(uint16_t opcode)
+{
+    struct bt_hci_rp_read_bd_addr rp;
+
+    rp.status = BT_HCI_ERR_SUCCESS;
+    bt_addr_copy(&rp.bdaddr, &vc.public_addr.a);
+
+    cmd_complete(opcode, &rp, sizeof(rp));
+}
+
+static void cmd_le_rand(uint16_t opcode)
+{
+    struct bt_hci_rp_le_rand rp;
+    uint32_t val;
+
+    rp.status = BT_HCI_ERR_SUCCESS;
+    val = vctrl_rand();
+    (void)memcpy(&rp.rand[0], &val, sizeof(val));
+    val = vctrl_rand();
+    (void)memcpy(&rp.rand[4], &val, sizeof(val));
+
+    cmd_complete(opcode, &rp, sizeof(rp));
+}
+
+static void cmd_le_read_supp_states(uint16_t opcode)
+{
+    struct bt_hci_rp_le_read_supp_states rp;
+
+    (void)memset(&rp, 0, sizeof(rp));
+    rp.status = BT_HCI_ERR_SUCCESS;
+    sys_put_le64(0x3ffffffffffULL, rp.le_states);
+
+    cmd_complete(opcode, &rp, sizeof(rp));
+}
+
+static void cmd_le_read_fal_size(uint16_t opcode)
+{
+    uint8_t rp[2] = {BT_HCI_ERR_SUCCESS, VCTRL_FAL_SIZE};
+
+    cmd_complete(opcode, rp, sizeof(rp));
+}
+
+static uint8_t cmd_le_fal_add(const struct bt_hci_cp_le_add_dev_to_fal *cp)
+{
+    if (fal_contains(&cp->addr))
+    {
+        return BT_HCI_ERR_SUCCESS;
+    }
+
+    if (vc.fal_count >= VCTRL_FAL_SIZE)
+    {
+        return BT_HCI_ERR_MEM_CAPACITY_EXCEEDED;
+    }
+
+    bt_addr_le_copy(&vc.fal[vc.fal_count++], &cp->addr);
+
+    return BT_HCI_ERR_SUCCESS;
+}
+
+static uint8_t cmd_le_fal_remove(const struct bt_hci_cp_le_rem_dev_from_fal *cp)
+{
+    uint8_t i;
+
+    for (i = 0U; i < vc.fal_count; i++)
+    {
+        if (!bt_addr_le_cmp(&vc.fal[i], &cp->addr))
+        {
+            bt_addr_le_copy(&vc.fal[i], &vc.fal[--vc.fal_count]);
+            break;
+        }
+    }
+
+    return BT_HCI_ERR_SUCCESS;
+}
+
+static uint8_t cmd_le_set_adv_enable(const struct bt_hci_cp_le_set_adv_enable *cp, uint32_t now)
+{
+    if (!cp->enable)
+    {
+        vc.adv.enabled = false;
+        return BT_HCI_ERR_SUCCESS;
+    }
+
+    if (vc.adv.enabled)
+    {
+        return BT_HCI_ERR_SUCCESS;
+    }
+
+    vc.adv.enabled = true;
+    vc.adv.next = now;
+    vc.adv.deadline = now + VCTRL_HD_TIMEOUT_US;
+
+    return BT_HCI_ERR_SUCCESS;
+}
+
+static uint8_t cmd_le_set_scan_enable(const struct bt_hci_cp_le_set_scan_enable *cp)
+{
+    if (cp->enable && !vc.scan.enabled)
+    {
+        vc.scan.dup_count = 0U;
+        vc.scan.req_pending = false;
+    }
+
+    vc.scan.enabled = cp->enable;
+    vc.scan.filter_dup = cp->filter_dup;
+
+    return BT_HCI_ERR_SUCCESS;
+}
+
+static void cmd_le_create_conn_cancel(uint16_t opcode)
+{
+    if (!vc.init.enabled)
+    {
+        cmd_complete_status(opcode, BT_HCI_ERR_CMD_DISALLOWED);
+        return;
+    }
+
+    vc.init.enabled = false;
+
+    cmd_complete_status(opcode, BT_HCI_ERR_SUCCESS);
+    conn_complete_send(BT_HCI_ERR_UNKNOWN_CONN_ID, NULL);
+}
+
+static uint8_t cmd_le_conn_update(const struct hci_cp_le_conn_update *cp)
+{
+    struct ll_conn_update_ind ind;
+    struct vctrl_conn *conn;
+
+    conn = conn_get(sys_le16_to_cpu(cp->handle));
+    if (!conn)
+    {
+        return BT_HCI_ERR_UNKNOWN_CONN_ID;
+    }
+
+    /* No Connection Parameters Request procedure, only the central updates */
+    if (conn->role != BT_HCI_ROLE_CENTRAL || conn->update_pending)
+    {
+        return BT_HCI_ERR_CMD_DISALLOWED;
+    }
+
+    ind.opcode = LL_CONN_UPDATE_IND;
+    ind.interval = sys_le16_to_cpu(cp->conn_interval_max);
+    ind.latency = sys_le16_to_cpu(cp->conn_latency);
+    ind.timeout = sys_le16_to_cpu(cp->supervision_timeout);
+    ind.instant = conn->event + VCTRL_INSTANT_OFFSET;
+
+    if (ctrl_queue(conn, &ind, sizeof(ind)))
+    {
+        return BT_HCI_ERR_MEM_CAPACITY_EXCEEDED;
+    }
+
+    conn->update_pending = true;
+    conn->new_interval = ind.interval;
+    conn->new_latency = ind.latency;
+    conn->new_timeout = ind.timeout;
+    conn->instant = ind.instant;
+
+    return BT_HCI_ERR_SUCCESS;
+}
+
+static void cmd_le_read_remote_features(uint16_t opcode,
+                                        const struct bt_hci_cp_le_read_remote_features *cp)
+{
+    struct vctrl_conn *conn = conn_get(sys_le16_to_cpu(cp->handle));
+
+    if (!conn)
+    {
+        cmd_status(opcode, BT_HCI_ERR_UNKNOWN_CONN_ID);
+        return;
+    }
+
+    if (conn->feat_req || conn->ctrl_count >= VCTRL_CTRL_QUEUE)
+    {
+        cmd_status(opcode, BT_HCI_ERR_CMD_DISALLOWED);
+        return;
+    }
+
+    cmd_status(opcode, BT_HCI_ERR_SUCCESS);
+
+    conn->feat_req = true;
+    ctrl_features_queue(conn, LL_FEATURE_REQ);
+}
+
+static void cmd_read_remote_version(uint16_t opcode,
+                                    const struct bt_hci_cp_read_remote_version_info *cp)
+{
+    struct vctrl_conn *conn = conn_get(sys_le16_to_cpu(cp->handle));
+
+    if (!conn)
+    {
+        cmd_status(opcode, BT_HCI_ERR_UNKNOWN_CONN_ID);
+        return;
+    }
+
+    cmd_status(opcode, BT_HCI_ERR_SUCCESS);
+
+    conn->version_req = true;
+
+    if (conn->version_known)
+    {
+        remote_version_send(conn);
+    }
+    else if (!conn->version_sent)
+    {
+        ctrl_version_queue(conn);
+    }
+}
+
+static void cmd_disconnect(uint16_t opcode, const struct bt_hci_cp_disconnect *cp)
+{
+    struct vctrl_conn *conn = conn_get(sys_le16_to_cpu(cp->handle));
+    uint8_t pdu[2] = {LL_TERMINATE_IND, cp->reason};
+
+    if (!conn)
+    {
+        cmd_status(opcode, BT_HCI_ERR_UNKNOWN_CONN_ID);
+        return;
+    }
+
+    if (ctrl_queue(conn, pdu, sizeof(pdu)))
+    {
+        cmd_status(opcode, BT_HCI_ERR_CMD_DISALLOWED);
+        return;
+    }
+
+    cmd_status(opcode, BT_HCI_ERR_SUCCESS);
+}
+
+static void cmd_handle(uint16_t opcode, const uint8_t *param, uint32_t now)
+{
+    switch (opcode)
+    {
+    case BT_HCI_OP_RESET:
+        cmd_reset();
+        cmd_complete_status(opcode, BT_HCI_ERR_SUCCESS);
+        break;
+    case BT_HCI_OP_SET_EVENT_MASK:
+    case BT_HCI_OP_SET_EVENT_MASK_PAGE_2:
+    case BT_HCI_OP_SET_CTL_TO_HOST_FLOW:
+    case BT_HCI_OP_HOST_BUFFER_SIZE:
+        cmd_complete_status(opcode, BT_HCI_ERR_SUCCESS);
+        break;
+    case BT_HCI_OP_READ_LOCAL_VERSION_INFO:
+        cmd_read_local_version(opcode);
+        break;
+    case BT_HCI_OP_READ_SUPPORTED_COMMANDS:
+        cmd_read_supported_commands(opcode);
+        break;
+    case BT_HCI_OP_READ_LOCAL_FEATURES:
+        cmd_read_local_features(opcode);
+        break;
+    case BT_HCI_OP_READ_BD_ADDR:
+        cmd_read_bd_addr(opcode);
+        break;
+    case BT_HCI_OP_DISCONNECT:
+        cmd_disconnect(opcode, (const void *)param);
+        break;
+    case BT_HCI_OP_READ_REMOTE_VERSION_INFO:
+        cmd_read_remote_version(opcode, (const void *)param);
+        break;
+    case BT_HCI_OP_LE_SET_EVENT_MASK:
+        vc.le_event_mask = sys_get_le64(((const struct bt_hci_cp_le_set_event_mask *)param)->events);
+        cmd_complete_status(opcode, BT_HCI_ERR_SUCCESS);
+        break;
+    case BT_HCI_OP_LE_READ_BUFFER_SIZE:
+        cmd_le_read_buffer_size(opcode);
+        break;
+    case BT_HCI_OP_LE_READ_LOCAL_FEATURES:
+        cmd_le_read_local_features(opcode);
+        break;
+    case BT_HCI_OP_LE_SET_RANDOM_ADDRESS:
+        bt_addr_copy(&vc.random_addr.a, (const void *)param);
+        cmd_complete_status(opcode, BT_HCI_ERR_SUCCESS);
+        break;
+    case BT_HCI_OP_LE_SET_ADV_PARAM:
+        if (vc.adv.enabled)
+        {
+            cmd_complete_status(opcode, BT_HCI_ERR_CMD_DISALLOWED);
+            break;
+        }
+
+        (void)memcpy(&vc.adv.param, param, sizeof(vc.adv.param));
+        cmd_complete_status(opcode, BT_HCI_ERR_SUCCESS);
+        break;
+    case BT_HCI_OP_LE_READ_ADV_CHAN_TX_POWER:
+    {
+        uint8_t rp[2] = {BT_HCI_ERR_SUCCESS, 0U};
+
+        cmd_complete(opcode, rp, sizeof(rp));
+        break;
+    }
+    case BT_HCI_OP_LE_SET_ADV_DATA:
+        vc.adv.data_len = MIN(param[0], sizeof(vc.adv.data));
+        (void)memcpy(vc.adv.data, &param[1], vc.adv.data_len);
+        cmd_complete_status(opcode, BT_HCI_ERR_SUCCESS);
+        break;
+    case BT_HCI_OP_LE_SET_SCAN_RSP_DATA:
+        vc.adv.rsp_len = MIN(param[0], sizeof(vc.adv.rsp));
+        (void)memcpy(vc.adv.rsp, &param[1], vc.adv.rsp_len);
+        cmd_complete_status(opcode, BT_HCI_ERR_SUCCESS);
+        break;
+    case BT_HCI_OP_LE_SET_ADV_ENABLE:
+        cmd_complete_status(opcode, cmd_le_set_adv_enable((const void *)param, now));
+        break;
+    case BT_HCI_OP_LE_SET_SCAN_PARAM:
+        if (vc.scan.enabled)
+        {
+            cmd_complete_status(opcode, BT_HCI_ERR_CMD_DISALLOWED);
+            break;
+        }
+
+        (void)memcpy(&vc.scan.param, param, sizeof(vc.scan.param));
+        cmd_complete_status(opcode, BT_HCI_ERR_SUCCESS);
+        break;
+    case BT_HCI_OP_LE_SET_SCAN_ENABLE:
+        cmd_complete_status(opcode, cmd_le_set_scan_enable((const void *)param));
+        break;
+    case BT_HCI_OP_LE_CREATE_CONN:
+        if (vc.init.enabled)
+        {
+            cmd_status(opcode, BT_HCI_ERR_CMD_DISALLOWED);
+            break;
+        }
+
+        (void)memcpy(&vc.init.param, param, sizeof(vc.init.param));
+        vc.init.enabled = true;
+        cmd_status(opcode, BT_HCI_ERR_SUCCESS);
+        break;
+    case BT_HCI_OP_LE_CREATE_CONN_CANCEL:
+        cmd_le_create_conn_cancel(opcode);
+        break;
+    case BT_HCI_OP_LE_READ_FAL_SIZE:
+        cmd_le_read_fal_size(opcode);
+        break;
+    case BT_HCI_OP_LE_CLEAR_FAL:
+        vc.fal_count = 0U;
+        cmd_complete_status(opcode, BT_HCI_ERR_SUCCESS);
+        break;
+    case BT_HCI_OP_LE_ADD_DEV_TO_FAL:
+        cmd_complete_status(opcode, cmd_le_fal_add((const void *)param));
+        break;
+    case BT_HCI_OP_LE_REM_DEV_FROM_FAL:
+        cmd_complete_status(opcode, cmd_le_fal_remove((const void *)param));
+        break;
+    case BT_HCI_OP_LE_CONN_UPDATE:
+        cmd_status(opcode, cmd_le_conn_update((const void *)param));
+        break;
+    case BT_HCI_OP_LE_READ_REMOTE_FEATURES:
+        cmd_le_read_remote_features(opcode, (const void *)param);
+        break;
+    case BT_HCI_OP_LE_RAND:
+        cmd_le_rand(opcode);
+        break;
+    case BT_HCI_OP_LE_READ_SUPP_STATES:
+        cmd_le_read_supp_states(opcode);
+        break;
+    default:
+        cmd_complete_status(opcode, BT_HCI_ERR_UNKNOWN_CMD);
+        break;
+    }
+}
+
+static void acl_handle(const uint8_t *data)
+{
+    const struct bt_hci_acl_hdr *hdr = (const void *)data;
+    uint16_t handle = sys_le16_to_cpu(hdr->handle);
+    uint16_t len = sys_le16_to_cpu(hdr->len);
+    struct bt_hci_evt_data_buf_overflow evt;
+    struct vctrl_conn *conn;
+    struct vctrl_buf *buf;
+    uint8_t pb;
+    uint8_t idx;
+
+    conn = conn_get(bt_acl_handle(handle));
+    if (!conn || conn->terminated)
+    {
+        return;
+    }
+
+    /* Still complete the packet so the host credits stay in step */
+    if (len > vc.cfg.acl_len || !vc.free_count)
+    {
+        evt.link_type = BT_OVERFLOW_LINK_ACL;
+        evt_send(BT_HCI_EVT_DATA_BUF_OVERFLOW, &evt, sizeof(evt));
+        conn->completed++;
+        return;
+    }
+
+    pb = bt_acl_flags_pb(bt_acl_flags(handle));
+
+    idx = vc.free_bufs[--vc.free_count];
+    buf = &vc.bufs[idx];
+    buf->llid = pb == BT_ACL_CONT ? LLID_CONT : LLID_START;
+    buf->len = len;
+    (void)memcpy(buf->data, &data[sizeof(*hdr)], len);
+
+    conn->tx_queue[(conn->tx_head + conn->tx_count) % BT_VCTRL_ACL_COUNT_MAX] = idx;
+    conn->tx_count++;
+}
+
+static void h4_packet(uint32_t now)
+{
+    const struct bt_hci_cmd_hdr *hdr = (const void *)vc.h4.buf;
+
+    if (vc.h4.type == H4_ACL)
+    {
+        acl_handle(vc.h4.buf);
+        return;
+    }
+
+    /* Short parameters read as zero */
+    (void)memset(&vc.h4.buf[vc.h4.len], 0, sizeof(vc.h4.buf) - vc.h4.len);
+
+    cmd_handle(sys_le16_to_cpu(hdr->opcode), &vc.h4.buf[sizeof(*hdr)], now);
+}
+
+// public API
+int bt_vctrl_init(const struct bt_vctrl_config *config, const struct bt_vctrl_io *io)
+{
+    if (!config || !io || !io->h4_write || !io->air_send || !io->now_us)
+    {
+        return -EINVAL;
+    }
+
+    if (config->index >= BT_VCTRL_NODES_MAX || config->acl_len < 27U ||
+        config->acl_len > BT_VCTRL_ACL_LEN_MAX || !config->acl_count ||
+        config->acl_count > BT_VCTRL_ACL_COUNT_MAX || !config->pdus_per_event)
+    {
+        return -EINVAL;
+    }
+
+    (void)memset(&vc, 0, sizeof(vc));
+    vc.cfg = *config;
+    vc.io = io;
+    vc.rand = (io->now_us() << 8) ^ (config->index + 1U) ^ 0x9e3779b9U;
+
+    vc.public_addr.type = BT_ADDR_LE_PUBLIC;
+    vc.public_addr.a.val[0] = config->index + 1U;
+    vc.public_addr.a.val[3] = 0xde;
+    vc.public_addr.a.val[4] = 0xc0;
+
+    cmd_reset();
+
+    return 0;
+}
+
+void bt_vctrl_h4_input(const uint8_t *buf, uint16_t len)
+{
+    uint32_t now = vc.io->now_us();
+    uint32_t copy;
+
+    while (len)
+    {
+        if (vc.h4.type == H4_NONE)
+        {
+            vc.h4.type = *buf++;
+            len--;
+            vc.h4.len = 0U;
+            vc.h4.hdr_done = false;
+
+            if (vc.h4.type == H4_CMD)
+            {
+                vc.h4.need = sizeof(struct bt_hci_cmd_hdr);
+            }
+            else if (vc.h4.type == H4_ACL)
+            {
+                vc.h4.need = sizeof(struct bt_hci_acl_hdr);
+            }
+            else
+            {
+                /* Nothing else comes from a host, resync on the next byte */
+                vc.h4.type = H4_NONE;
+            }
+            continue;
+        }
+
+        copy = MIN(len, vc.h4.need - vc.h4.len);
+        if (vc.h4.len < sizeof(vc.h4.buf))
+        {
+            (void)memcpy(&vc.h4.buf[vc.h4.len], buf,
+                         MIN(copy, sizeof(vc.h4.buf) - vc.h4.len));
+        }
+        vc.h4.len += copy;
+        buf += copy;
+        len -= copy;
+
+        if (vc.h4.len < vc.h4.need)
+        {
+            continue;
+        }
+
+        if (!vc.h4.hdr_done)
+        {
+            vc.h4.hdr_done = true;
+
+            if (vc.h4.type == H4_CMD)
+            {
+                vc.h4.need += ((struct bt_hci_cmd_hdr *)vc.h4.buf)->param_len;
+            }
+            else
+            {
+                vc.h4.need += sys_le16_to_cpu(((struct bt_hci_acl_hdr *)vc.h4.buf)->len);
+            }
+
+            if (vc.h4.len < vc.h4.need)
+            {
+                continue;
+            }
+        }
+
+        /* Oversized ACL is cut short here, its header still fails the length check */
+        vc.h4.len = MIN(vc.h4.len, sizeof(vc.h4.buf));
+        h4_packet(now);
+        vc.h4.type = H4_NONE;
+    }
+
+    nocp_flush();
+}
+
+void bt_vctrl_air_input(const uint8_t *buf, uint16_t len)
+{
+    uint32_t now = vc.io->now_us();
+
+    if (!len)
+    {
+        return;
+    }
+
+    if (buf[0] == AIR_ADV)
+    {
+        adv_rx((const void *)buf, len, now);
+    }
+    else if (buf[0] == AIR_DATA)
+    {
+        data_rx((const void *)buf, len, now);
+    }
+
+    nocp_flush();
+}
+
+uint32_t bt_vctrl_process(void)
+{
+    uint32_t now = vc.io->now_us();
+    uint32_t next = now + VCTRL_IDLE_US;
+    struct vctrl_conn *conn;
+    uint32_t supervision;
+    uint8_t i;
+
+    if (vc.adv.enabled && adv_high_duty() && time_due(now, vc.adv.deadline))
+    {
+        vc.adv.enabled = false;
+        conn_complete_send(BT_HCI_ERR_ADV_TIMEOUT, NULL);
+    }
+
+    if (vc.adv.enabled)
+    {
+        if (time_due(now, vc.adv.next))
+        {
+            adv_event(now);
+        }
+
+        next = time_earliest(now, next, vc.adv.next);
+    }
+
+    for (i = 0U; i < BT_VCTRL_CONN_MAX; i++)
+    {
+        conn = &vc.conns[i];
+        if (!conn->used)
+        {
+            continue;
+        }
+
+        supervision = conn->last_rx + conn->timeout * 10000U;
+        if (time_due(now, supervision))
+        {
+            conn_disconnected(conn, BT_HCI_ERR_CONN_TIMEOUT);
+            continue;
+        }
+
+        next = time_earliest(now, next, supervision);
+
+        if (conn->role != BT_HCI_ROLE_CENTRAL)
+        {
+            continue;
+        }
+
+        if (time_due(now, conn->next_event))
+        {
+            conn_central_event(conn, now);
+            if (!conn->used)
+            {
+                continue;
+            }
+        }
+
+        next = time_earliest(now, next, conn->next_event);
+    }
+
+    nocp_flush();
+
+    now = vc.io->now_us();
+
+    return time_due(now, next) ? 0U : next - now;
+}
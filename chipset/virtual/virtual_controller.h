@@ -0,0 +1,94 @@
+/* virtual_controller.h - Simulated LE controller for hardware-free testing */
+
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef _CHIPSET_VIRTUAL_CONTROLLER_H_
+#define _CHIPSET_VIRTUAL_CONTROLLER_H_
+
+#include "base/types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Most nodes that can share one simulated air */
+#define BT_VCTRL_NODES_MAX 8
+/** Most simultaneous connections per node */
+#define BT_VCTRL_CONN_MAX  4
+/** Largest ACL payload the controller can be configured to accept */
+#define BT_VCTRL_ACL_LEN_MAX 251
+/** Largest ACL buffer pool the controller can be configured with */
+#define BT_VCTRL_ACL_COUNT_MAX 32
+
+/** Largest frame exchanged over the simulated air */
+#define BT_VCTRL_AIR_MTU 320
+
+struct bt_vctrl_config
+{
+    /** Node index, also selects the public address */
+    uint8_t index;
+    /** ACL payload size reported by LE Read Buffer Size */
+    uint16_t acl_len;
+    /** ACL buffer count reported by LE Read Buffer Size */
+    uint8_t acl_count;
+    /** Data PDUs the central sends per connection event */
+    uint8_t pdus_per_event;
+    /** RSSI reported in advertising reports */
+    int8_t rssi;
+};
+
+#define BT_VCTRL_CONFIG_DEFAULT(_index)                                                            \
+    {                                                                                              \
+        .index = (_index), .acl_len = 27U, .acl_count = 8U, .pdus_per_event = 4U, .rssi = -50,     \
+    }
+
+struct bt_vctrl_io
+{
+    /** Write H4 framed bytes towards the host */
+    void (*h4_write)(const uint8_t *buf, uint16_t len);
+    /** Broadcast one frame to every other node on the air */
+    void (*air_send)(const uint8_t *buf, uint16_t len);
+    /** Free running microsecond clock */
+    uint32_t (*now_us)(void);
+};
+
+/**
+ * @brief Initialize the virtual controller.
+ *
+ * The controller is not thread safe, all the calls below must come from
+ * the same context.
+ *
+ * @param config Buffer sizes and timing model.
+ * @param io     Transport callbacks.
+ *
+ * @return 0 on success or negative error number on failure.
+ */
+int bt_vctrl_init(const struct bt_vctrl_config *config, const struct bt_vctrl_io *io);
+
+/**
+ * @brief Feed H4 bytes written by the host.
+ *
+ * Bytes may arrive in arbitrary fragments, packets are reassembled and
+ * handled once complete.
+ */
+void bt_vctrl_h4_input(const uint8_t *buf, uint16_t len);
+
+/**
+ * @brief Feed one frame received from the air.
+ */
+void bt_vctrl_air_input(const uint8_t *buf, uint16_t len);
+
+/**
+ * @brief Run advertising, scanning and connection events that are due.
+ *
+ * @return Microseconds until the controller next needs to run.
+ */
+uint32_t bt_vctrl_process(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _CHIPSET_VIRTUAL_CONTROLLER_H_ */
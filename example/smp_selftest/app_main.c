@@ -0,0 +1,18 @@
+#include <logging/bt_log_impl.h>
+
+/* The SMP self tests run from bt_enable(), their result is the init result */
+void bt_ready(int err)
+{
+    if (err)
+    {
+        printk("SMP self tests failed (err %d)\n", err);
+        return;
+    }
+
+    printk("SMP self tests passed\n");
+}
+
+void app_polling_work(void)
+{
+    return;
+}
@@ -0,0 +1,8 @@
+# define source directory
+SRC		+= $(APP_PATH)
+
+# define include directory
+INCLUDE	+= $(APP_PATH)
+
+# define lib directory
+LIB		+=
\ No newline at end of file
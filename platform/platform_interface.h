@@ -3,6 +3,7 @@
 #define _PLATFORM_INTERFACE_H_
 
 #include "common/bt_storage_kv.h"
+#include "common/bt_capture.h"
 #include "logging/bt_log_impl.h"
 #include "drivers/hci_driver.h"
 
@@ -13,6 +14,7 @@ extern "C" {
 const bt_log_impl_t *bt_log_impl_local_instance(void);
 const struct bt_hci_chipset_driver *bt_hci_chipset_impl_local_instance(void);
 const struct bt_storage_kv_impl *bt_storage_kv_impl_local_instance(void);
+const struct bt_capture_impl *bt_capture_impl_local_instance(void);
 void bt_timer_impl_local_init(void);
 
 typedef void (*bt_hci_driver_reset_callback_t)(void);
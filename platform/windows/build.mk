@@ -9,6 +9,9 @@ INCLUDE	+= $(PLATFORM_PATH)
 #   their path using -Lpath, something like:
 LFLAGS += -lusb0
 
+# BCryptGenRandom() for CONFIG_BT_RAND_OS_ENTROPY
+LFLAGS += -lbcrypt
+
 # Windows have diff cpu arch, ia64, amd64, x86
 CPU_ARCH ?= x86
 # define lib directory
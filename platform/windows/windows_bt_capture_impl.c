@@ -0,0 +1,123 @@
+#include <stdio.h>
+
+#include <pthread.h>
+#include <windows.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include "windows_bt_capture_impl.h"
+
+#if defined(CONFIG_BT_CAPTURE)
+
+#define CAPTURE_FILE_PATH_MAX_LENGTH (0x400)
+
+/* Written from a thread of its own, the HCI path only fills the ring */
+#define CAPTURE_FLUSH_INTERVAL_MS (100)
+
+/**
+ * number of seconds from 1 Jan. 1601 00:00 to 1 Jan 1970 00:00 UTC
+ */
+#define EPOCH_DIFF 11644473600LL
+
+#if defined(CONFIG_BT_CAPTURE_FORMAT_PCAP)
+#define CAPTURE_FILE_EXT "pcap"
+#else
+#define CAPTURE_FILE_EXT "btsnoop"
+#endif
+
+static FILE *capture_file;
+static pthread_t capture_thread;
+
+static void get_capture_file_name(char *file_path, uint8_t index)
+{
+    char exe_path[CAPTURE_FILE_PATH_MAX_LENGTH];
+    GetModuleFileName(NULL, exe_path, CAPTURE_FILE_PATH_MAX_LENGTH);
+    *strrchr(exe_path, '\\') = 0;
+
+    sprintf(file_path, "%s\\log\\capture_%u." CAPTURE_FILE_EXT, exe_path, index);
+}
+
+static void *capture_flush_thread(void *arg)
+{
+    while (1)
+    {
+        bt_capture_flush();
+
+        if (capture_file)
+        {
+            fflush(capture_file);
+        }
+
+        Sleep(CAPTURE_FLUSH_INTERVAL_MS);
+    }
+
+    return NULL;
+}
+
+static void capture_init(void)
+{
+    char exe_path[CAPTURE_FILE_PATH_MAX_LENGTH];
+    char log_path[CAPTURE_FILE_PATH_MAX_LENGTH];
+    GetModuleFileName(NULL, exe_path, CAPTURE_FILE_PATH_MAX_LENGTH);
+    *strrchr(exe_path, '\\') = 0;
+
+    sprintf(log_path, "%s\\log", exe_path);
+    mkdir(log_path);
+
+    pthread_create(&capture_thread, NULL, capture_flush_thread, NULL);
+}
+
+static int capture_open(uint8_t index)
+{
+    char file_name[CAPTURE_FILE_PATH_MAX_LENGTH];
+    get_capture_file_name(file_name, index);
+
+    capture_file = fopen(file_name, "wb");
+    if (capture_file == NULL)
+    {
+        return -1;
+    }
+
+    return 0;
+}
+
+static int capture_write(const uint8_t *data, uint16_t len)
+{
+    if (len && fwrite(data, len, 1, capture_file) != 1)
+    {
+        return -1;
+    }
+
+    return 0;
+}
+
+static void capture_close(void)
+{
+    fclose(capture_file);
+    capture_file = NULL;
+}
+
+static uint64_t capture_wall_clock_us(void)
+{
+    FILETIME file_time;
+    ULARGE_INTEGER now_time;
+    GetSystemTimeAsFileTime(&file_time);
+    now_time.LowPart = file_time.dwLowDateTime;
+    now_time.HighPart = file_time.dwHighDateTime;
+
+    return now_time.QuadPart / 10 - EPOCH_DIFF * 1000000LLU;
+}
+
+static const struct bt_capture_impl capture_impl = {
+        capture_init,
+        capture_open,
+        capture_write,
+        capture_close,
+        capture_wall_clock_us,
+};
+
+const struct bt_capture_impl *bt_capture_impl_local_instance(void)
+{
+    return &capture_impl;
+}
+#endif /* CONFIG_BT_CAPTURE */
@@ -0,0 +1,14 @@
+#ifndef _WINDOWS_BT_CAPTURE_IMPL_H_
+#define _WINDOWS_BT_CAPTURE_IMPL_H_
+
+#include "platform_interface.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //_WINDOWS_BT_CAPTURE_IMPL_H_
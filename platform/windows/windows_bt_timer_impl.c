@@ -1,5 +1,6 @@
 #include "base\byteorder.h"
 #include "common\timer.h"
+#include "common\bt_profile.h"
 #include "host\hci_core.h"
 
 #include <stdio.h>
@@ -28,6 +29,20 @@ uint32_t timer_get_delay_time_ms(void)
     return time_ms;
 }
 
+#if defined(CONFIG_BT_PROFILE)
+static LARGE_INTEGER profile_freq;
+
+static uint32_t profile_now_us(void)
+{
+    LARGE_INTEGER counter;
+    QueryPerformanceCounter(&counter);
+
+    /* Split up, the counter times 10^6 overflows after some days */
+    return (uint32_t)(counter.QuadPart / profile_freq.QuadPart * 1000000 +
+                      counter.QuadPart % profile_freq.QuadPart * 1000000 / profile_freq.QuadPart);
+}
+#endif
+
 pthread_t timer_thread;
 static int timer_process_loop(void *args)
 {
@@ -58,6 +73,11 @@ void bt_timer_impl_local_init(void)
     last_time.LowPart = file_time.dwLowDateTime;
     last_time.HighPart = file_time.dwHighDateTime;
 
+#if defined(CONFIG_BT_PROFILE)
+    QueryPerformanceFrequency(&profile_freq);
+    bt_profile_clock_register(profile_now_us);
+#endif
+
     pthread_create(&timer_thread, NULL, (void *)timer_process_loop, NULL);
 
     sys_clock_announce(0);
@@ -175,7 +175,7 @@ static int rx_evt_process_loop(void *args)
 #endif
         )
         {
-            printk("rx_evt_process_loop(), reserve buff not enough.\n");
+            /* The host frees buffers as it polls, no need to log each wait */
             Sleep(10);
             continue;
         }
@@ -203,28 +203,24 @@ static int rx_evt_process_loop(void *args)
 #if defined(CONFIG_BT_MONITOR_SLEEP)
             bt_sleep_wakeup_work_start();
 #endif
-            if (bt_check_rx_evt_need_drop(tmp))
-            {
-                printk("rx_evt_process_loop(), no reserve buff, drop adv.\n");
-            }
-            else
+            /* Advertising reports are shed under buffer pressure */
+            if (!bt_check_rx_evt_need_drop(tmp))
             {
                 struct net_buf *buf;
                 buf = bt_buf_get_controller_tx_evt();
 
+                /* Not discardable, wait for the host to free a buffer */
+                while (!buf && is_enable)
+                {
+                    Sleep(10);
+                    buf = bt_buf_get_controller_tx_evt();
+                }
+
                 if (buf)
                 {
                     net_buf_add_mem(buf, tmp, ret);
                     push_rx_queue(buf);
                 }
-                else
-                {
-                    while (1)
-                    {
-                        printk("rx_evt_process_loop(), no reserve buff\n");
-                        Sleep(1000);
-                    }
-                }
             }
 #if defined(CONFIG_BT_MONITOR_SLEEP)
             bt_sleep_wakeup_work_end();
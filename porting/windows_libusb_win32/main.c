@@ -20,6 +20,23 @@
 extern void bt_ready(int err);
 extern void app_polling_work(void);
 
+static volatile bool app_exit;
+
+/* Ctrl+C leaves the polling loop so that bt_disable() can write out
+ * pending bonds before the process ends.
+ */
+static BOOL WINAPI console_ctrl_handler(DWORD type)
+{
+    if (type != CTRL_C_EVENT && type != CTRL_BREAK_EVENT)
+    {
+        return FALSE;
+    }
+
+    app_exit = true;
+
+    return TRUE;
+}
+
 int open_hci_driver(int argc, const char *argv[])
 {
     bt_usb_interface_t *p_interface = NULL;
@@ -71,6 +88,9 @@ int main(int argc, const char *argv[])
     }
     bt_hci_chipset_driver_register(bt_hci_chipset_impl_local_instance());
     bt_storage_kv_register(bt_storage_kv_impl_local_instance());
+#if defined(CONFIG_BT_CAPTURE)
+    bt_capture_register(bt_capture_impl_local_instance());
+#endif
     bt_timer_impl_local_init();
 
     /* Initialize the Bluetooth Subsystem */
@@ -80,7 +100,9 @@ int main(int argc, const char *argv[])
     bt_init_monitor_sleep();
 #endif
 
-    while (1)
+    SetConsoleCtrlHandler(console_ctrl_handler, TRUE);
+
+    while (!app_exit)
     {
 #if defined(CONFIG_BT_MONITOR_SLEEP)
         if (!bt_check_is_in_sleep())
@@ -102,5 +124,7 @@ int main(int argc, const char *argv[])
         libusb_main_loop();
     }
 
+    (void)bt_disable();
+
     return (err);
 }
\ No newline at end of file
@@ -0,0 +1,17 @@
+# define source directory
+SRC		+= $(PORT_PATH)
+
+# define include directory
+INCLUDE	+= $(PORT_PATH)
+
+# define lib directory
+LIB		+=
+
+# loopback sockets stand in for the UART and the air, 1ms timer resolution
+LFLAGS	+= -lws2_32 -lwinmm
+
+PLATFORM_ROOT_PATH := platform
+INCLUDE	+= $(PLATFORM_ROOT_PATH)
+
+PLATFORM_PATH := $(PLATFORM_ROOT_PATH)/windows
+include $(PLATFORM_PATH)/build.mk
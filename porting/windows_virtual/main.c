@@ -0,0 +1,110 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <windows.h>
+
+#include "windows_driver_virtual.h"
+
+#include "chipset_interface.h"
+#include "platform_interface.h"
+
+#include "base/types.h"
+#include "utils/spool.h"
+#include <logging/bt_log_impl.h>
+#include <drivers/hci_driver.h>
+#include "host/hci_core.h"
+
+#include <bluetooth/bluetooth.h>
+#include <bluetooth/hci.h>
+
+extern void bt_ready(int err);
+extern void app_polling_work(void);
+
+static volatile bool app_exit;
+
+/* Ctrl+C leaves the polling loop so that bt_disable() can write out
+ * pending bonds before the process ends.
+ */
+static BOOL WINAPI console_ctrl_handler(DWORD type)
+{
+    if (type != CTRL_C_EVENT && type != CTRL_BREAK_EVENT)
+    {
+        return FALSE;
+    }
+
+    app_exit = true;
+
+    return TRUE;
+}
+
+/* main.exe <node index> [acl_len] [acl_count] [pdus_per_event] */
+int open_hci_driver(int argc, const char *argv[])
+{
+    struct bt_vctrl_config config = BT_VCTRL_CONFIG_DEFAULT(0);
+
+    if (argc < 2 || argc > 5)
+    {
+        printk("Error, must input node index.");
+        return -1;
+    }
+
+    config.index = strtol(argv[1], NULL, 0);
+    if (argc > 2)
+    {
+        config.acl_len = strtol(argv[2], NULL, 0);
+    }
+    if (argc > 3)
+    {
+        config.acl_count = strtol(argv[3], NULL, 0);
+    }
+    if (argc > 4)
+    {
+        config.pdus_per_event = strtol(argv[4], NULL, 0);
+    }
+
+    if (bt_hci_init_virtual_device(&config) < 0)
+    {
+        printk("Error, virtual controller open failed.");
+        return -1;
+    }
+
+    return 0;
+}
+
+int main(int argc, const char *argv[])
+{
+    int err = 0;
+
+    bt_log_impl_register(bt_log_impl_local_instance());
+
+    if (open_hci_driver(argc, argv) < 0)
+    {
+        return -1;
+    }
+    bt_hci_chipset_driver_register(bt_hci_chipset_impl_local_instance());
+    bt_storage_kv_register(bt_storage_kv_impl_local_instance());
+#if defined(CONFIG_BT_CAPTURE)
+    bt_capture_register(bt_capture_impl_local_instance());
+#endif
+    bt_timer_impl_local_init();
+
+    /* Initialize the Bluetooth Subsystem */
+    err = bt_enable(bt_ready);
+
+    SetConsoleCtrlHandler(console_ctrl_handler, TRUE);
+
+    while (!app_exit)
+    {
+        bt_polling_work();
+
+        app_polling_work();
+
+        extern void bt_hci_h4_polling(void);
+        bt_hci_h4_polling();
+    }
+
+    (void)bt_disable();
+
+    return (err);
+}
@@ -0,0 +1,284 @@
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#include <windows.h>
+#include <mmsystem.h>
+
+#include "windows_driver_virtual.h"
+#include "drivers/hci_driver.h"
+#include "drivers/hci_h4.h"
+
+#include "logging/bt_log_impl.h"
+
+/* Windows has no socketpair() or pty, a connected loopback TCP pair carries
+ * H4 between the host and the controller thread, and UDP datagrams between
+ * the nodes on 127.0.0.1 act as the air.
+ */
+
+#ifndef SIO_UDP_CONNRESET
+#define SIO_UDP_CONNRESET _WSAIOW(IOC_VENDOR, 12)
+#endif
+
+static SOCKET host_sock = INVALID_SOCKET;
+static SOCKET ctrl_sock = INVALID_SOCKET;
+static SOCKET air_sock = INVALID_SOCKET;
+static uint8_t node_index;
+static LARGE_INTEGER clock_freq;
+static pthread_t ctrl_thread;
+
+static uint32_t virtual_now_us(void)
+{
+    LARGE_INTEGER now;
+
+    QueryPerformanceCounter(&now);
+
+    return (uint32_t)(now.QuadPart / clock_freq.QuadPart * 1000000 +
+                      now.QuadPart % clock_freq.QuadPart * 1000000 / clock_freq.QuadPart);
+}
+
+static void virtual_h4_write(const uint8_t *buf, uint16_t len)
+{
+    int ret;
+
+    while (len)
+    {
+        ret = send(ctrl_sock, (const char *)buf, len, 0);
+        if (ret == SOCKET_ERROR)
+        {
+            printk("virtual h4 write failed %d\n", WSAGetLastError());
+            return;
+        }
+
+        buf += ret;
+        len -= ret;
+    }
+}
+
+static void virtual_air_send(const uint8_t *buf, uint16_t len)
+{
+    struct sockaddr_in addr;
+    uint8_t i;
+
+    (void)memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    for (i = 0U; i < BT_VCTRL_NODES_MAX; i++)
+    {
+        if (i == node_index)
+        {
+            continue;
+        }
+
+        addr.sin_port = htons(VIRTUAL_AIR_PORT_BASE + i);
+        (void)sendto(air_sock, (const char *)buf, len, 0, (struct sockaddr *)&addr, sizeof(addr));
+    }
+}
+
+static const struct bt_vctrl_io vctrl_io = {
+        .h4_write = virtual_h4_write,
+        .air_send = virtual_air_send,
+        .now_us = virtual_now_us,
+};
+
+static void *virtual_controller_thread(void *arg)
+{
+    uint8_t buf[1024];
+    struct timeval tv;
+    uint32_t wait_us;
+    fd_set rfds;
+    int len;
+
+    while (1)
+    {
+        wait_us = bt_vctrl_process();
+
+        FD_ZERO(&rfds);
+        FD_SET(ctrl_sock, &rfds);
+        FD_SET(air_sock, &rfds);
+        tv.tv_sec = wait_us / 1000000U;
+        tv.tv_usec = wait_us % 1000000U;
+
+        if (select(0, &rfds, NULL, NULL, &tv) == SOCKET_ERROR)
+        {
+            printk("virtual controller select failed %d\n", WSAGetLastError());
+            break;
+        }
+
+        if (FD_ISSET(ctrl_sock, &rfds))
+        {
+            len = recv(ctrl_sock, (char *)buf, sizeof(buf), 0);
+            if (len <= 0)
+            {
+                break;
+            }
+
+            bt_vctrl_h4_input(buf, len);
+        }
+
+        if (FD_ISSET(air_sock, &rfds))
+        {
+            len = recvfrom(air_sock, (char *)buf, sizeof(buf), 0, NULL, NULL);
+            if (len > 0)
+            {
+                bt_vctrl_air_input(buf, len);
+            }
+        }
+    }
+
+    return NULL;
+}
+
+/* Loopback stand-in for socketpair() */
+static int virtual_socket_pair(SOCKET *a, SOCKET *b)
+{
+    struct sockaddr_in addr;
+    int addr_len = sizeof(addr);
+    SOCKET listener;
+    BOOL nodelay = TRUE;
+
+    listener = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (listener == INVALID_SOCKET)
+    {
+        return -1;
+    }
+
+    (void)memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = 0;
+
+    if (bind(listener, (struct sockaddr *)&addr, sizeof(addr)) == SOCKET_ERROR ||
+        getsockname(listener, (struct sockaddr *)&addr, &addr_len) == SOCKET_ERROR ||
+        listen(listener, 1) == SOCKET_ERROR)
+    {
+        closesocket(listener);
+        return -1;
+    }
+
+    *a = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (*a == INVALID_SOCKET || connect(*a, (struct sockaddr *)&addr, sizeof(addr)) == SOCKET_ERROR)
+    {
+        closesocket(listener);
+        return -1;
+    }
+
+    *b = accept(listener, NULL, NULL);
+    closesocket(listener);
+    if (*b == INVALID_SOCKET)
+    {
+        return -1;
+    }
+
+    (void)setsockopt(*a, IPPROTO_TCP, TCP_NODELAY, (const char *)&nodelay, sizeof(nodelay));
+    (void)setsockopt(*b, IPPROTO_TCP, TCP_NODELAY, (const char *)&nodelay, sizeof(nodelay));
+
+    return 0;
+}
+
+static int virtual_air_open(uint8_t index)
+{
+    struct sockaddr_in addr;
+    BOOL report = FALSE;
+    DWORD bytes;
+
+    air_sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (air_sock == INVALID_SOCKET)
+    {
+        return -1;
+    }
+
+    /* Absent nodes must not turn into errors on the next recvfrom() */
+    (void)WSAIoctl(air_sock, SIO_UDP_CONNRESET, &report, sizeof(report), NULL, 0, &bytes, NULL,
+                   NULL);
+
+    (void)memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(VIRTUAL_AIR_PORT_BASE + index);
+
+    if (bind(air_sock, (struct sockaddr *)&addr, sizeof(addr)) == SOCKET_ERROR)
+    {
+        printk("virtual air port %d busy\n", VIRTUAL_AIR_PORT_BASE + index);
+        return -1;
+    }
+
+    return 0;
+}
+
+static int hci_driver_h4_open(void)
+{
+    return 0;
+}
+
+static int hci_driver_h4_send(uint8_t *buf, uint16_t len)
+{
+    int ret = send(host_sock, (const char *)buf, len, 0);
+
+    if (ret == SOCKET_ERROR && WSAGetLastError() == WSAEWOULDBLOCK)
+    {
+        return 0;
+    }
+
+    return ret;
+}
+
+static int hci_driver_h4_recv(uint8_t *buf, uint16_t len)
+{
+    int ret = recv(host_sock, (char *)buf, len, 0);
+
+    if (ret == SOCKET_ERROR && WSAGetLastError() == WSAEWOULDBLOCK)
+    {
+        return 0;
+    }
+
+    return ret;
+}
+
+static const struct bt_hci_h4_driver h4_drv = {
+        .open = hci_driver_h4_open,
+        .send = hci_driver_h4_send,
+        .recv = hci_driver_h4_recv,
+};
+
+int bt_hci_init_virtual_device(const struct bt_vctrl_config *config)
+{
+    u_long nonblock = 1;
+    WSADATA wsa;
+
+    printk("virtual controller node %d, acl %d x %d, %d pdus per event\n", config->index,
+           config->acl_count, config->acl_len, config->pdus_per_event);
+
+    if (WSAStartup(MAKEWORD(2, 2), &wsa))
+    {
+        return -1;
+    }
+
+    QueryPerformanceFrequency(&clock_freq);
+    /* Connection intervals go down to 7.5ms, the default tick is too coarse */
+    timeBeginPeriod(1);
+
+    node_index = config->index;
+
+    if (bt_vctrl_init(config, &vctrl_io) < 0)
+    {
+        printk("virtual controller config invalid\n");
+        return -1;
+    }
+
+    if (virtual_socket_pair(&host_sock, &ctrl_sock) < 0 || virtual_air_open(config->index) < 0)
+    {
+        return -1;
+    }
+
+    /* The host polls, it must never block on an empty transport */
+    ioctlsocket(host_sock, FIONBIO, &nonblock);
+
+    pthread_create(&ctrl_thread, NULL, virtual_controller_thread, NULL);
+
+    hci_h4_init(&h4_drv);
+
+    return (0);
+}
@@ -0,0 +1,19 @@
+#ifndef _WINDOWS_DRIVER_VIRTUAL_H_
+#define _WINDOWS_DRIVER_VIRTUAL_H_
+
+#include "virtual_controller.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Every node binds this port plus its index for the simulated air */
+#define VIRTUAL_AIR_PORT_BASE 47800
+
+int bt_hci_init_virtual_device(const struct bt_vctrl_config *config);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //_WINDOWS_DRIVER_VIRTUAL_H_
@@ -31,13 +31,24 @@ def compile_code(params):
 
 
 port_sets = ['windows_libusb_win32', 
-             'windows_serial', ]
+             'windows_serial', 
+             'windows_virtual', ]
 
 chipset_sets = ['ats2851', 
                 'common', 
                 'csr8510', 
                 'csr8910', 
-                'pts_dongle',]
+                'pts_dongle', 
+                'virtual',]
+
+# Ports and chipsets that only build with each other
+exclusive_pairs = {'windows_virtual': 'virtual', }
+
+def is_valid_pair(port, chipset):
+    if port in exclusive_pairs:
+        return exclusive_pairs[port] == chipset
+
+    return chipset not in exclusive_pairs.values()
 
 def parse_args():
     parser = argparse.ArgumentParser()
@@ -71,12 +82,16 @@ if __name__ == '__main__':
         for app in app_sets:
             for port in port_sets:
                 for chipset in chipset_sets:
-                    total_work_cnt += 1
+                    if is_valid_pair(port, chipset):
+                        total_work_cnt += 1
 
         current_work_cnt = 0
         for app in app_sets:
             for port in port_sets:
                 for chipset in chipset_sets:
+                    if not is_valid_pair(port, chipset):
+                        continue
+
                     current_work_cnt += 1
                     print("=================================================================================")
                     print("Total Work Cnt: %d, Current Cnt: %d, Process: %.2f%%" 
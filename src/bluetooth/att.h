@@ -94,6 +94,55 @@ size_t bt_eatt_count(struct bt_conn *conn);
 
 #endif /* CONFIG_BT_EATT */
 
+#if defined(CONFIG_BT_ATT_BEARER_STATS)
+/** @brief ATT bearer statistics
+ *
+ *  Times are in milliseconds. The occupancy of a bearer is
+ *  @ref busy_time / @ref up_time.
+ */
+struct bt_att_bearer_stats
+{
+    /** L2CAP CID of the bearer. */
+    uint16_t cid;
+    /** True for an Enhanced ATT bearer. */
+    bool enhanced;
+    /** PDUs queued on the bearer, including one being sent and an outstanding request. */
+    uint16_t backlog;
+    /** Requests sent. */
+    uint32_t req_count;
+    /** Requests completed, with a response or an error. */
+    uint32_t rsp_count;
+    /** Other PDUs sent: commands, notifications, responses, confirmations. */
+    uint32_t pdu_count;
+    /** Sum of request latencies, from bt_att queueing to completion. */
+    uint32_t latency_total;
+    /** Largest request latency. */
+    uint32_t latency_max;
+    /** Time the bearer had a request outstanding, including one still pending. */
+    uint32_t busy_time;
+    /** Time since the bearer connected or statistics were reset. */
+    uint32_t up_time;
+};
+
+/** @brief Get statistics of the ATT bearers of a connection
+ *
+ *  @param conn Connection object.
+ *  @param stats Array filled with one entry per bearer.
+ *  @param count In: number of entries in @p stats, out: entries filled.
+ *
+ *  @return 0 in case of success or negative value in case of error.
+ *  @retval -ENOTCONN if @p conn has no ATT bearer.
+ */
+int bt_att_bearer_stats_get(struct bt_conn *conn, struct bt_att_bearer_stats *stats,
+                            size_t *count);
+
+/** @brief Reset statistics of the ATT bearers of a connection
+ *
+ *  @param conn Connection object.
+ */
+void bt_att_bearer_stats_reset(struct bt_conn *conn);
+#endif /* CONFIG_BT_ATT_BEARER_STATS */
+
 #ifdef __cplusplus
 }
 #endif
@@ -171,7 +171,11 @@ int bt_enable(bt_ready_cb_t cb);
  *
  * Close and release HCI resources. Result is architecture dependent.
  *
- * @return Zero on success or (negative) error code otherwise.
+ * Data pending in the storage write-back cache is written out first, call
+ * this before the application exits. No HCI driver can be closed yet.
+ *
+ * @return Zero on success or (negative) error code otherwise, -ENOTSUP
+ *         once pending storage writes are done.
  */
 int bt_disable(void);
 
@@ -899,6 +903,105 @@ int bt_le_adv_update_data(const struct bt_data *ad, size_t ad_len, const struct
  */
 int bt_le_adv_stop(void);
 
+#if defined(CONFIG_BT_ADV_SCHED)
+/** Logical advertiser for the advertising scheduler */
+struct bt_le_adv_sched_param
+{
+    /** Advertising parameters while on air, peer must be NULL */
+    struct bt_le_adv_param param;
+    /** Advertising and scan response data, kept by the caller */
+    const struct bt_data *ad;
+    size_t ad_len;
+    const struct bt_data *sd;
+    size_t sd_len;
+    /** Wanted time between the starts of two turns in milliseconds */
+    uint32_t period_ms;
+    /** Time on air per turn in milliseconds, 0 for the default */
+    uint16_t dwell_ms;
+    /** Among advertisers due at the same time the highest goes first */
+    uint8_t priority;
+};
+
+/** Advertising scheduler statistics of one logical advertiser */
+struct bt_le_adv_sched_stats
+{
+    /** Turns on air */
+    uint32_t airings;
+    /** Average and longest time between the starts of two turns */
+    uint32_t interval_avg_ms;
+    uint32_t interval_max_ms;
+    /** Total time on air and its share of the time since added */
+    uint32_t on_air_ms;
+    uint16_t duty_permille;
+    /** Turns started with new data only, and with a stop and start of
+     *  advertising
+     */
+    uint32_t data_switches;
+    uint32_t restarts;
+};
+
+/**
+ * @brief Add a logical advertiser to the advertising scheduler.
+ *
+ * @param param Advertiser description.
+ *
+ * @return Advertiser id on success or (negative) error code otherwise.
+ */
+int bt_le_adv_sched_add(const struct bt_le_adv_sched_param *param);
+
+/**
+ * @brief Replace the data of a logical advertiser.
+ *
+ * Sent right away if the advertiser is on air, otherwise on its next turn.
+ *
+ * @param id     Advertiser id from @ref bt_le_adv_sched_add.
+ * @param ad     Data to be used in advertisement packets.
+ * @param ad_len Number of elements in ad
+ * @param sd     Data to be used in scan response packets.
+ * @param sd_len Number of elements in sd
+ *
+ * @return Zero on success or (negative) error code otherwise.
+ */
+int bt_le_adv_sched_update_data(uint8_t id, const struct bt_data *ad, size_t ad_len,
+                                const struct bt_data *sd, size_t sd_len);
+
+/**
+ * @brief Remove a logical advertiser from the advertising scheduler.
+ *
+ * @param id Advertiser id from @ref bt_le_adv_sched_add.
+ *
+ * @return Zero on success or (negative) error code otherwise.
+ */
+int bt_le_adv_sched_remove(uint8_t id);
+
+/**
+ * @brief Start rotating the logical advertisers.
+ *
+ * The scheduler owns the legacy advertising set until stopped, do not use
+ * @ref bt_le_adv_start meanwhile.
+ *
+ * @return Zero on success or (negative) error code otherwise.
+ */
+int bt_le_adv_sched_start(void);
+
+/**
+ * @brief Stop rotating and stop advertising.
+ *
+ * @return Zero on success or (negative) error code otherwise.
+ */
+int bt_le_adv_sched_stop(void);
+
+/**
+ * @brief Get the effective interval and duty cycle of an advertiser.
+ *
+ * @param id    Advertiser id from @ref bt_le_adv_sched_add.
+ * @param stats Filled with the statistics.
+ *
+ * @return Zero on success or (negative) error code otherwise.
+ */
+int bt_le_adv_sched_stats_get(uint8_t id, struct bt_le_adv_sched_stats *stats);
+#endif /* CONFIG_BT_ADV_SCHED */
+
 /**
  * @brief Create advertising set.
  *
@@ -1005,6 +1108,39 @@ int bt_le_ext_adv_stop(struct bt_le_ext_adv *adv);
 int bt_le_ext_adv_set_data(struct bt_le_ext_adv *adv, const struct bt_data *ad, size_t ad_len,
                            const struct bt_data *sd, size_t sd_len);
 
+/**
+ * @brief Have scanners report unchanged advertising data again.
+ *
+ * Gives the advertising data a new Advertising Data ID without sending the
+ * data again, so scanners that filter duplicates report it once more.
+ * Only for extended advertising PDUs while advertising.
+ *
+ * @param adv Advertising set object.
+ *
+ * @return Zero on success or (negative) error code otherwise.
+ */
+int bt_le_ext_adv_update_did(struct bt_le_ext_adv *adv);
+
+#if defined(CONFIG_BT_ADV_DATA_CACHE)
+/** Advertising data command counters */
+struct bt_le_adv_data_stats
+{
+    /** Set advertising or scan response data commands sent */
+    uint32_t sent;
+    /** Commands not sent because the controller had the data */
+    uint32_t skipped;
+    /** Data ID updates sent by @ref bt_le_ext_adv_update_did */
+    uint32_t did_updates;
+};
+
+/**
+ * @brief Get the advertising data command counters.
+ *
+ * @param stats Filled with the counters since boot.
+ */
+void bt_le_adv_data_stats_get(struct bt_le_adv_data_stats *stats);
+#endif /* CONFIG_BT_ADV_DATA_CACHE */
+
 /**
  * @brief Update advertising parameters.
  *
@@ -1657,6 +1793,27 @@ enum
      * @note Requires @ref BT_LE_SCAN_OPT_CODED.
      */
     BT_LE_SCAN_OPT_NO_1M = BIT(3),
+
+    /**
+     * @brief Filter duplicates in the host.
+     *
+     * Reports of a device are delivered again when their data changed,
+     * see @ref bt_le_scan_dedup_param.
+     *
+     * @note Requires CONFIG_BT_SCAN_DEDUP. Controllers hide data changes
+     *       with @ref BT_LE_SCAN_OPT_FILTER_DUPLICATE, leave it out.
+     */
+    BT_LE_SCAN_OPT_HOST_FILTER_DUPLICATE = BIT(4),
+};
+
+/** Host duplicate filter settings of a scan */
+struct bt_le_scan_dedup_param
+{
+    /** Deliver again when the RSSI moved this many dBm, 0 to ignore RSSI */
+    uint8_t rssi_delta;
+
+    /** Deliver again after this many milliseconds, 0 to never */
+    uint32_t refresh_ms;
 };
 
 enum
@@ -1710,6 +1867,17 @@ struct bt_le_scan_param
      * Set zero to use same as LE 1M PHY scan window.
      */
     uint16_t window_coded;
+
+#if defined(CONFIG_BT_SCAN_DEDUP)
+    /**
+     * @brief Host duplicate filter settings
+     *
+     * Used with @ref BT_LE_SCAN_OPT_HOST_FILTER_DUPLICATE, NULL for the
+     * CONFIG_BT_SCAN_DEDUP_RSSI_DELTA and CONFIG_BT_SCAN_DEDUP_REFRESH
+     * defaults.
+     */
+    const struct bt_le_scan_dedup_param *dedup;
+#endif /* CONFIG_BT_SCAN_DEDUP */
 };
 
 /** LE advertisement packet information */
@@ -1903,6 +2071,234 @@ void bt_le_scan_cb_register(struct bt_le_scan_cb *cb);
  */
 void bt_le_scan_cb_unregister(struct bt_le_scan_cb *cb);
 
+#if defined(CONFIG_BT_SCAN_BATCH)
+/** Advertising report as delivered to batch listeners */
+struct bt_le_scan_report
+{
+    /** Advertiser address as received, not resolved to an identity */
+    const bt_addr_le_t *addr;
+    /** Strength of advertiser signal. */
+    int8_t rssi;
+    /** Transmit power of the advertiser. */
+    int8_t tx_power;
+    /** Advertising packet type. */
+    uint8_t adv_type;
+    /** Advertising packet properties. */
+    uint16_t adv_props;
+    /** Advertising Set Identifier. */
+    uint8_t sid;
+    /** Primary advertising channel PHY. */
+    uint8_t primary_phy;
+    /** Secondary advertising channel PHY. */
+    uint8_t secondary_phy;
+    /** Periodic advertising interval, 0 if no periodic advertising. */
+    uint16_t interval;
+    /** Advertising data */
+    const uint8_t *data;
+    /** Length of the advertising data */
+    uint16_t data_len;
+};
+
+/** Listener for batches of advertising reports. */
+struct bt_le_scan_batch_cb
+{
+    /**
+     * @brief Advertising reports received callback.
+     *
+     * Called once per HCI event with the reports that passed the scan
+     * filters. Addresses and data point into the event and are only
+     * valid during the callback.
+     *
+     * @param reports Array of reports.
+     * @param count   Number of reports.
+     */
+    void (*recv)(const struct bt_le_scan_report *reports, size_t count);
+
+    sys_snode_t node;
+};
+
+/**
+ * @brief Register scanner packet batch callbacks.
+ *
+ * Batch listeners do not need address resolution, when no other
+ * listener is registered reports are not resolved.
+ *
+ * @param cb Callback struct. Must point to memory that remains valid.
+ */
+void bt_le_scan_batch_cb_register(struct bt_le_scan_batch_cb *cb);
+
+/**
+ * @brief Unregister scanner packet batch callbacks.
+ *
+ * @param cb Callback struct. Must point to memory that remains valid.
+ */
+void bt_le_scan_batch_cb_unregister(struct bt_le_scan_batch_cb *cb);
+#endif /* CONFIG_BT_SCAN_BATCH */
+
+#if defined(CONFIG_BT_EXT_SCAN_REASSEMBLY)
+/** Extended advertising report reassembly counters */
+struct bt_le_scan_reassembly_stats
+{
+    /** Chains of several reports delivered */
+    uint32_t completed;
+    /** Reports delivered without reassembly */
+    uint32_t direct;
+    /** Chains dropped to make room for a new advertiser */
+    uint32_t evicted;
+    /** Chains dropped, truncated by the controller or too long */
+    uint32_t truncated;
+    /** Chains whose next report did not come in time */
+    uint32_t timed_out;
+    /** Dropped chains no longer followed for want of room, the rest of
+     *  them may be delivered as new chains
+     */
+    uint32_t lost;
+};
+
+/**
+ * @brief Get the extended advertising report reassembly counters.
+ *
+ * @param stats Filled with the counters since boot.
+ */
+void bt_le_scan_reassembly_stats_get(struct bt_le_scan_reassembly_stats *stats);
+#endif /* CONFIG_BT_EXT_SCAN_REASSEMBLY */
+
+#if defined(CONFIG_BT_SCAN_FILTER)
+/** Conditions of a scan filter, all the given ones must hold */
+enum
+{
+    /** Advertiser address, or the most significant bytes of it */
+    BT_LE_SCAN_FILTER_ADDR = BIT(0),
+    /** RSSI at least the given one */
+    BT_LE_SCAN_FILTER_RSSI = BIT(1),
+    /** AD structure of the given type present */
+    BT_LE_SCAN_FILTER_AD_TYPE = BIT(2),
+    /** Manufacturer specific data of the given company */
+    BT_LE_SCAN_FILTER_COMPANY_ID = BIT(3),
+    /** 16-bit UUID in a service UUID list or service data */
+    BT_LE_SCAN_FILTER_UUID16 = BIT(4),
+    /** 128-bit UUID in a service UUID list or service data */
+    BT_LE_SCAN_FILTER_UUID128 = BIT(5),
+    /** Bytes at an offset, e.g. a name prefix */
+    BT_LE_SCAN_FILTER_PATTERN = BIT(6),
+};
+
+/** Advertising report filter */
+struct bt_le_scan_filter
+{
+    /** Bit field of BT_LE_SCAN_FILTER_* conditions */
+    uint8_t conditions;
+
+    /** Address as received over the air, not the resolved identity */
+    bt_addr_le_t addr;
+    /** Most significant address bytes compared, 0 for all of them */
+    uint8_t addr_prefix_len;
+
+    /** Lowest RSSI in dBm */
+    int8_t rssi_min;
+
+    /** AD type that has to be present */
+    uint8_t ad_type;
+
+    /** Bluetooth SIG company identifier */
+    uint16_t company_id;
+
+    /** 16-bit service UUID */
+    uint16_t uuid16;
+
+    /** 128-bit service UUID in little-endian format */
+    uint8_t uuid128[16];
+
+    /** Byte pattern */
+    struct
+    {
+        /** AD type the offset is counted in, 0 for the raw report data */
+        uint8_t ad_type;
+        /** Offset in the AD data or in the report */
+        uint8_t offset;
+        /** Length of data and mask */
+        uint8_t len;
+        /** Bytes to match */
+        const uint8_t *data;
+        /** Bits of data compared, NULL to compare all of them */
+        const uint8_t *mask;
+    } pattern;
+};
+
+/** Counters of one scan filter */
+struct bt_le_scan_filter_stats
+{
+    /** Reports this filter accepted */
+    uint32_t matched;
+    /** Reports this filter was evaluated on and did not accept */
+    uint32_t rejected;
+};
+
+/**
+ * @brief Set the advertising report filters.
+ *
+ * A report is delivered to the scan callbacks if any of the filters
+ * accepts it. Filters are evaluated in order and the first one that
+ * accepts the report ends the evaluation. The filters are copied, the
+ * pattern data does not need to stay valid. Setting the filters clears
+ * the counters.
+ *
+ * Reports of devices with a pending connection are still checked for it
+ * when dropped.
+ *
+ * @param filters Array of filters.
+ * @param count   Number of filters, 0 to deliver all reports again.
+ *
+ * @return Zero on success or (negative) error code otherwise.
+ * @return -ENOMEM if count is larger than CONFIG_BT_SCAN_FILTER_MAX.
+ */
+int bt_le_scan_filter_set(const struct bt_le_scan_filter *filters, size_t count);
+
+/**
+ * @brief Get the counters of one filter.
+ *
+ * @param index Index of the filter in the set.
+ * @param stats Filled with the counters.
+ *
+ * @return Zero on success or (negative) error code otherwise.
+ */
+int bt_le_scan_filter_stats_get(size_t index, struct bt_le_scan_filter_stats *stats);
+
+/**
+ * @brief Get the number of reports delivered and dropped by the filters.
+ *
+ * @param passed  Reports at least one filter accepted.
+ * @param dropped Reports no filter accepted.
+ */
+void bt_le_scan_filter_totals_get(uint32_t *passed, uint32_t *dropped);
+#endif /* CONFIG_BT_SCAN_FILTER */
+
+#if defined(CONFIG_BT_SCAN_DEDUP)
+/** Host duplicate filter counters */
+struct bt_le_scan_dedup_stats
+{
+    /** Reports of devices not in the table */
+    uint32_t new_device;
+    /** Reports delivered because their data changed */
+    uint32_t changed;
+    /** Reports delivered because the RSSI moved */
+    uint32_t rssi;
+    /** Reports delivered because the refresh interval passed */
+    uint32_t refresh;
+    /** Reports suppressed as duplicates */
+    uint32_t suppressed;
+    /** Devices dropped from the table to make room */
+    uint32_t evicted;
+};
+
+/**
+ * @brief Get the host duplicate filter counters.
+ *
+ * @param stats Filled with the counters since boot.
+ */
+void bt_le_scan_dedup_stats_get(struct bt_le_scan_dedup_stats *stats);
+#endif /* CONFIG_BT_SCAN_DEDUP */
+
 /**
  * @brief Add device (LE) to filter accept list.
  *
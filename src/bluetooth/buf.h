@@ -153,6 +153,27 @@ struct net_buf *bt_buf_get_cmd_complete(k_timeout_t timeout);
  */
 struct net_buf *bt_buf_get_evt(uint8_t evt, bool discardable, k_timeout_t timeout);
 
+#if defined(CONFIG_BT_BUF_EVT_ADMISSION)
+/** Event admission counters */
+struct bt_buf_evt_stats
+{
+    /** Discardable events taken in */
+    uint32_t admitted;
+    /** Discardable events left out while sampling */
+    uint32_t sampled_out;
+    /** Discardable events dropped to keep the reserve */
+    uint32_t shed;
+    /** Events that are not discardable and found no buffer */
+    uint32_t alloc_failed;
+};
+
+/** @brief Get the event admission counters.
+ *
+ *  @param stats Filled with the counters since boot.
+ */
+void bt_buf_evt_stats_get(struct bt_buf_evt_stats *stats);
+#endif /* CONFIG_BT_BUF_EVT_ADMISSION */
+
 /** Set the buffer type
  *
  *  @param buf   Bluetooth buffer
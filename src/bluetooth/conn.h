@@ -441,6 +441,75 @@ int bt_conn_get_info(const struct bt_conn *conn, struct bt_conn_info *info);
  */
 int bt_conn_get_remote_info(struct bt_conn *conn, struct bt_conn_remote_info *remote_info);
 
+#if defined(CONFIG_BT_CONN_STATS)
+/** @brief Connection performance counters
+ *
+ *  Counted since the connection was established or the counters were
+ *  reset. Times are in milliseconds.
+ */
+struct bt_conn_stats
+{
+    /** Time the counters cover. */
+    uint32_t duration;
+    /** L2CAP PDUs queued for sending and their bytes. */
+    uint32_t tx_pdus;
+    uint32_t tx_bytes;
+    /** Complete L2CAP PDUs received and their bytes. */
+    uint32_t rx_pdus;
+    uint32_t rx_bytes;
+    /** ACL packets handed to the controller, fragments included. */
+    uint32_t tx_acl;
+    /** Fragments created for PDUs larger than the controller buffers. */
+    uint32_t tx_frags;
+    /** ACL packets received from the controller. */
+    uint32_t rx_acl;
+    /** ACL packets reported completed by the controller. */
+    uint32_t tx_completed;
+    /** Most ACL packets of the connection in the controller at once. */
+    uint16_t tx_in_flight_max;
+    /** ACL packets sent while the controller buffers were all in use. */
+    uint32_t tx_credit_stalls;
+    /** ACL packets the driver failed to take. */
+    uint32_t tx_errors;
+    /** PDUs timed in the transmit queue, with the sum and largest wait. */
+    uint32_t tx_queue_waits;
+    uint32_t tx_queue_wait_total;
+    uint32_t tx_queue_wait_max;
+    /** ATT requests sent, and the ones answered or timed out. */
+    uint32_t att_req;
+    uint32_t att_rsp;
+    uint32_t att_timeouts;
+    /** Sum and largest time from sending a request to its response. */
+    uint32_t att_rtt_total;
+    uint32_t att_rtt_max;
+    /** Notifications and indications sent. */
+    uint32_t att_notify;
+    /** Notifications and indications not sent for lack of a buffer. */
+    uint32_t att_notify_drops;
+    /** L2CAP CoC segments sent. */
+    uint32_t coc_tx_segs;
+    /** Times a CoC ran out of credits to send with. */
+    uint32_t coc_tx_credit_stalls;
+    /** Credits given to peers on CoCs. */
+    uint32_t coc_rx_credits;
+};
+
+/** @brief Get connection performance counters.
+ *
+ *  @param conn Connection object.
+ *  @param stats Filled with the counters.
+ *
+ *  @return Zero on success or (negative) error code on failure.
+ */
+int bt_conn_get_stats(const struct bt_conn *conn, struct bt_conn_stats *stats);
+
+/** @brief Reset connection performance counters.
+ *
+ *  @param conn Connection object.
+ */
+void bt_conn_reset_stats(struct bt_conn *conn);
+#endif /* CONFIG_BT_CONN_STATS */
+
 /** @brief Get connection transmit power level.
  *
  *  @param conn           Connection object.
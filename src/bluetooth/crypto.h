@@ -67,6 +67,19 @@ int bt_encrypt_le(const uint8_t key[16], const uint8_t plaintext[16], uint8_t en
  */
 int bt_encrypt_be(const uint8_t key[16], const uint8_t plaintext[16], uint8_t enc_data[16]);
 
+/** @brief AES encrypt big-endian data into a little-endian result.
+ *
+ *  Same as bt_encrypt_be() but the encrypted block is returned LS byte
+ *  first.
+ *
+ *  @param key 128 bit MS byte first key for the encryption of the plaintext
+ *  @param plaintext 128 bit MS byte first plaintext data block to be encrypted
+ *  @param enc_data 128 bit LS byte first encrypted data block
+ *
+ *  @return Zero on success or error code otherwise.
+ */
+int bt_encrypt_sk(const uint8_t key[16], const uint8_t plaintext[16], uint8_t enc_data[16]);
+
 /** @brief Decrypt big-endian data with AES-CCM.
  *
  *  Decrypts and authorizes @c enc_data with AES-CCM, as described in
@@ -710,8 +710,10 @@ struct bt_gatt_ccc_cfg
 /** Internal representation of CCC value */
 struct _bt_gatt_ccc
 {
+#if !defined(CONFIG_BT_GATT_CCC_SPARSE)
     /** Configuration for each connection */
     struct bt_gatt_ccc_cfg cfg[BT_GATT_CCC_MAX];
+#endif /* !CONFIG_BT_GATT_CCC_SPARSE */
 
     /** Highest value of all connected peer's subscriptions */
     uint16_t value;
@@ -795,10 +797,17 @@ ssize_t bt_gatt_attr_write_ccc(struct bt_conn *conn, const struct bt_gatt_attr *
  *  @param _write Configuration write callback.
  *  @param _match Configuration match callback.
  */
+#if defined(CONFIG_BT_GATT_CCC_SPARSE)
+#define BT_GATT_CCC_INITIALIZER(_changed, _write, _match)                                          \
+    {                                                                                              \
+        .cfg_changed = _changed, .cfg_write = _write, .cfg_match = _match,                         \
+    }
+#else
 #define BT_GATT_CCC_INITIALIZER(_changed, _write, _match)                                          \
     {                                                                                              \
         .cfg = {}, .cfg_changed = _changed, .cfg_write = _write, .cfg_match = _match,              \
     }
+#endif /* CONFIG_BT_GATT_CCC_SPARSE */
 
 /** @def BT_GATT_CCC_MANAGED
  *  @brief Managed Client Characteristic Configuration Declaration Macro.
@@ -1412,6 +1421,10 @@ struct bt_gatt_discover_params
  *  the BT RX thread. @p params must remain valid until start of callback where
  *  iter `attr` is `NULL` or callback will return `BT_GATT_ITER_STOP`.
  *
+ *  Several procedures can be run at once with distinct @p params, e.g. one
+ *  characteristic discovery per service handle range. With Enhanced ATT
+ *  bearers and @kconfig{CONFIG_BT_EATT_SCHED} they proceed concurrently.
+ *
  *  This function will block while the ATT request queue is full, except when
  *  called from the BT RX thread, as this would cause a deadlock.
  *
@@ -0,0 +1,539 @@
+/* aes_backend.c - Selectable AES-128 block cipher backends */
+
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <errno.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "aes_backend.h"
+
+#include "base/sys_clock.h"
+#include "base/util.h"
+
+#define BT_DBG_ENABLED  IS_ENABLED(CONFIG_BT_DEBUG_HCI_CORE)
+#define LOG_MODULE_NAME bt_aes
+#include "logging/bt_log.h"
+
+#if defined(CONFIG_BT_AES_NI)
+#if !defined(__GNUC__) || !(defined(__x86_64__) || defined(__i386__))
+#error "CONFIG_BT_AES_NI needs GCC or Clang targeting x86"
+#endif
+#include <cpuid.h>
+#include <wmmintrin.h>
+#endif /* CONFIG_BT_AES_NI */
+
+#if defined(CONFIG_BT_AES_ARMV8)
+#if !defined(__ARM_FEATURE_AES) && !defined(__ARM_FEATURE_CRYPTO)
+#error "CONFIG_BT_AES_ARMV8 needs a compiler targeting the ARMv8 Cryptography Extensions"
+#endif
+#include <arm_neon.h>
+#endif /* CONFIG_BT_AES_ARMV8 */
+
+/* Backends registered at runtime, e.g. by the chipset layer */
+#define AES_BACKEND_EXT_MAX 2
+
+/* FIPS-197 Appendix C.1 */
+static const uint8_t kat_key[16] = {0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07,
+                                    0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f};
+static const uint8_t kat_pt[16] = {0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77,
+                                   0x88, 0x99, 0xaa, 0xbb, 0xcc, 0xdd, 0xee, 0xff};
+static const uint8_t kat_ct[16] = {0x69, 0xc4, 0xe0, 0xd8, 0x6a, 0x7b, 0x04, 0x30,
+                                   0xd8, 0xcd, 0xb7, 0x80, 0x70, 0xb4, 0xc5, 0x5a};
+
+/* Byte oriented tiny-AES from aes_soft.c, also used to expand the key for
+ * the instruction set backends which share its round key layout.
+ */
+static void soft_expand(struct bt_aes_sched *sched, const uint8_t key[16])
+{
+    AES_init_ctx(&sched->rk.ctx, key);
+}
+
+static void soft_encrypt(const struct bt_aes_sched *sched, const uint8_t in[16], uint8_t out[16])
+{
+    memmove(out, in, AES_BLOCKLEN);
+    AES_ECB_encrypt(&sched->rk.ctx, out);
+}
+
+static const struct bt_aes_backend soft_backend = {
+        .name = "soft",
+        .expand = soft_expand,
+        .encrypt = soft_encrypt,
+};
+
+#if defined(CONFIG_BT_AES_TTABLE)
+/* Combined SubBytes and MixColumns for row 0, {02, 01, 01, 03} * S[x].
+ * The tables for the other rows are rotations of it and the S-box is
+ * byte 2, so a single 1 KiB table is needed.
+ */
+static const uint32_t te0[256] = {
+    0xc66363a5U, 0xf87c7c84U, 0xee777799U, 0xf67b7b8dU, 0xfff2f20dU, 0xd66b6bbdU,
+    0xde6f6fb1U, 0x91c5c554U, 0x60303050U, 0x02010103U, 0xce6767a9U, 0x562b2b7dU,
+    0xe7fefe19U, 0xb5d7d762U, 0x4dababe6U, 0xec76769aU, 0x8fcaca45U, 0x1f82829dU,
+    0x89c9c940U, 0xfa7d7d87U, 0xeffafa15U, 0xb25959ebU, 0x8e4747c9U, 0xfbf0f00bU,
+    0x41adadecU, 0xb3d4d467U, 0x5fa2a2fdU, 0x45afafeaU, 0x239c9cbfU, 0x53a4a4f7U,
+    0xe4727296U, 0x9bc0c05bU, 0x75b7b7c2U, 0xe1fdfd1cU, 0x3d9393aeU, 0x4c26266aU,
+    0x6c36365aU, 0x7e3f3f41U, 0xf5f7f702U, 0x83cccc4fU, 0x6834345cU, 0x51a5a5f4U,
+    0xd1e5e534U, 0xf9f1f108U, 0xe2717193U, 0xabd8d873U, 0x62313153U, 0x2a15153fU,
+    0x0804040cU, 0x95c7c752U, 0x46232365U, 0x9dc3c35eU, 0x30181828U, 0x379696a1U,
+    0x0a05050fU, 0x2f9a9ab5U, 0x0e070709U, 0x24121236U, 0x1b80809bU, 0xdfe2e23dU,
+    0xcdebeb26U, 0x4e272769U, 0x7fb2b2cdU, 0xea75759fU, 0x1209091bU, 0x1d83839eU,
+    0x582c2c74U, 0x341a1a2eU, 0x361b1b2dU, 0xdc6e6eb2U, 0xb45a5aeeU, 0x5ba0a0fbU,
+    0xa45252f6U, 0x763b3b4dU, 0xb7d6d661U, 0x7db3b3ceU, 0x5229297bU, 0xdde3e33eU,
+    0x5e2f2f71U, 0x13848497U, 0xa65353f5U, 0xb9d1d168U, 0x00000000U, 0xc1eded2cU,
+    0x40202060U, 0xe3fcfc1fU, 0x79b1b1c8U, 0xb65b5bedU, 0xd46a6abeU, 0x8dcbcb46U,
+    0x67bebed9U, 0x7239394bU, 0x944a4adeU, 0x984c4cd4U, 0xb05858e8U, 0x85cfcf4aU,
+    0xbbd0d06bU, 0xc5efef2aU, 0x4faaaae5U, 0xedfbfb16U, 0x864343c5U, 0x9a4d4dd7U,
+    0x66333355U, 0x11858594U, 0x8a4545cfU, 0xe9f9f910U, 0x04020206U, 0xfe7f7f81U,
+    0xa05050f0U, 0x783c3c44U, 0x259f9fbaU, 0x4ba8a8e3U, 0xa25151f3U, 0x5da3a3feU,
+    0x804040c0U, 0x058f8f8aU, 0x3f9292adU, 0x219d9dbcU, 0x70383848U, 0xf1f5f504U,
+    0x63bcbcdfU, 0x77b6b6c1U, 0xafdada75U, 0x42212163U, 0x20101030U, 0xe5ffff1aU,
+    0xfdf3f30eU, 0xbfd2d26dU, 0x81cdcd4cU, 0x180c0c14U, 0x26131335U, 0xc3ecec2fU,
+    0xbe5f5fe1U, 0x359797a2U, 0x884444ccU, 0x2e171739U, 0x93c4c457U, 0x55a7a7f2U,
+    0xfc7e7e82U, 0x7a3d3d47U, 0xc86464acU, 0xba5d5de7U, 0x3219192bU, 0xe6737395U,
+    0xc06060a0U, 0x19818198U, 0x9e4f4fd1U, 0xa3dcdc7fU, 0x44222266U, 0x542a2a7eU,
+    0x3b9090abU, 0x0b888883U, 0x8c4646caU, 0xc7eeee29U, 0x6bb8b8d3U, 0x2814143cU,
+    0xa7dede79U, 0xbc5e5ee2U, 0x160b0b1dU, 0xaddbdb76U, 0xdbe0e03bU, 0x64323256U,
+    0x743a3a4eU, 0x140a0a1eU, 0x924949dbU, 0x0c06060aU, 0x4824246cU, 0xb85c5ce4U,
+    0x9fc2c25dU, 0xbdd3d36eU, 0x43acacefU, 0xc46262a6U, 0x399191a8U, 0x319595a4U,
+    0xd3e4e437U, 0xf279798bU, 0xd5e7e732U, 0x8bc8c843U, 0x6e373759U, 0xda6d6db7U,
+    0x018d8d8cU, 0xb1d5d564U, 0x9c4e4ed2U, 0x49a9a9e0U, 0xd86c6cb4U, 0xac5656faU,
+    0xf3f4f407U, 0xcfeaea25U, 0xca6565afU, 0xf47a7a8eU, 0x47aeaee9U, 0x10080818U,
+    0x6fbabad5U, 0xf0787888U, 0x4a25256fU, 0x5c2e2e72U, 0x381c1c24U, 0x57a6a6f1U,
+    0x73b4b4c7U, 0x97c6c651U, 0xcbe8e823U, 0xa1dddd7cU, 0xe874749cU, 0x3e1f1f21U,
+    0x964b4bddU, 0x61bdbddcU, 0x0d8b8b86U, 0x0f8a8a85U, 0xe0707090U, 0x7c3e3e42U,
+    0x71b5b5c4U, 0xcc6666aaU, 0x904848d8U, 0x06030305U, 0xf7f6f601U, 0x1c0e0e12U,
+    0xc26161a3U, 0x6a35355fU, 0xae5757f9U, 0x69b9b9d0U, 0x17868691U, 0x99c1c158U,
+    0x3a1d1d27U, 0x279e9eb9U, 0xd9e1e138U, 0xebf8f813U, 0x2b9898b3U, 0x22111133U,
+    0xd26969bbU, 0xa9d9d970U, 0x078e8e89U, 0x339494a7U, 0x2d9b9bb6U, 0x3c1e1e22U,
+    0x15878792U, 0xc9e9e920U, 0x87cece49U, 0xaa5555ffU, 0x50282878U, 0xa5dfdf7aU,
+    0x038c8c8fU, 0x59a1a1f8U, 0x09898980U, 0x1a0d0d17U, 0x65bfbfdaU, 0xd7e6e631U,
+    0x844242c6U, 0xd06868b8U, 0x824141c3U, 0x299999b0U, 0x5a2d2d77U, 0x1e0f0f11U,
+    0x7bb0b0cbU, 0xa85454fcU, 0x6dbbbbd6U, 0x2c16163aU,
+};
+
+static const uint8_t rcon[10] = {0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80, 0x1b, 0x36};
+
+#define ROR32(v, s) (((v) >> (s)) | ((v) << (32 - (s))))
+#define TE0(x)      te0[(x)&0xff]
+#define TE1(x)      ROR32(te0[(x)&0xff], 8)
+#define TE2(x)      ROR32(te0[(x)&0xff], 16)
+#define TE3(x)      ROR32(te0[(x)&0xff], 24)
+#define SBOX(x)     ((te0[(x)&0xff] >> 16) & 0xff)
+
+static uint32_t get_be32(const uint8_t *p)
+{
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+static void put_be32(uint32_t v, uint8_t *p)
+{
+    p[0] = v >> 24;
+    p[1] = v >> 16;
+    p[2] = v >> 8;
+    p[3] = v;
+}
+
+static void ttable_expand(struct bt_aes_sched *sched, const uint8_t key[16])
+{
+    uint32_t *rk = sched->rk.words;
+    uint32_t t;
+    uint8_t i;
+
+    for (i = 0U; i < 4U; i++)
+    {
+        rk[i] = get_be32(&key[i * 4U]);
+    }
+
+    for (i = 4U; i < 44U; i++)
+    {
+        t = rk[i - 1];
+
+        if (!(i % 4U))
+        {
+            t = (SBOX(t >> 16) << 24) | (SBOX(t >> 8) << 16) | (SBOX(t) << 8) | SBOX(t >> 24);
+            t ^= (uint32_t)rcon[i / 4U - 1U] << 24;
+        }
+
+        rk[i] = rk[i - 4] ^ t;
+    }
+}
+
+static void ttable_encrypt(const struct bt_aes_sched *sched, const uint8_t in[16],
+                           uint8_t out[16])
+{
+    const uint32_t *rk = sched->rk.words;
+    uint32_t s0, s1, s2, s3;
+    uint32_t t0, t1, t2, t3;
+    uint8_t r;
+
+    s0 = get_be32(&in[0]) ^ rk[0];
+    s1 = get_be32(&in[4]) ^ rk[1];
+    s2 = get_be32(&in[8]) ^ rk[2];
+    s3 = get_be32(&in[12]) ^ rk[3];
+
+    for (r = 1U; r < 10U; r++)
+    {
+        rk += 4;
+
+        t0 = TE0(s0 >> 24) ^ TE1(s1 >> 16) ^ TE2(s2 >> 8) ^ TE3(s3) ^ rk[0];
+        t1 = TE0(s1 >> 24) ^ TE1(s2 >> 16) ^ TE2(s3 >> 8) ^ TE3(s0) ^ rk[1];
+        t2 = TE0(s2 >> 24) ^ TE1(s3 >> 16) ^ TE2(s0 >> 8) ^ TE3(s1) ^ rk[2];
+        t3 = TE0(s3 >> 24) ^ TE1(s0 >> 16) ^ TE2(s1 >> 8) ^ TE3(s2) ^ rk[3];
+
+        s0 = t0;
+        s1 = t1;
+        s2 = t2;
+        s3 = t3;
+    }
+
+    rk += 4;
+
+    t0 = (SBOX(s0 >> 24) << 24) | (SBOX(s1 >> 16) << 16) | (SBOX(s2 >> 8) << 8) | SBOX(s3);
+    t1 = (SBOX(s1 >> 24) << 24) | (SBOX(s2 >> 16) << 16) | (SBOX(s3 >> 8) << 8) | SBOX(s0);
+    t2 = (SBOX(s2 >> 24) << 24) | (SBOX(s3 >> 16) << 16) | (SBOX(s0 >> 8) << 8) | SBOX(s1);
+    t3 = (SBOX(s3 >> 24) << 24) | (SBOX(s0 >> 16) << 16) | (SBOX(s1 >> 8) << 8) | SBOX(s2);
+
+    put_be32(t0 ^ rk[0], &out[0]);
+    put_be32(t1 ^ rk[1], &out[4]);
+    put_be32(t2 ^ rk[2], &out[8]);
+    put_be32(t3 ^ rk[3], &out[12]);
+}
+
+static const struct bt_aes_backend ttable_backend = {
+        .name = "ttable",
+        .expand = ttable_expand,
+        .encrypt = ttable_encrypt,
+};
+#endif /* CONFIG_BT_AES_TTABLE */
+
+#if defined(CONFIG_BT_AES_NI)
+static bool aesni_probe(void)
+{
+    unsigned int eax, ebx, ecx, edx;
+
+    if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+    {
+        return false;
+    }
+
+    return (ecx & bit_AES) != 0;
+}
+
+__attribute__((target("aes,sse2"))) static void
+aesni_encrypt(const struct bt_aes_sched *sched, const uint8_t in[16], uint8_t out[16])
+{
+    const __m128i *rk = (const __m128i *)sched->rk.bytes;
+    __m128i s;
+    uint8_t r;
+
+    s = _mm_xor_si128(_mm_loadu_si128((const __m128i *)in), _mm_loadu_si128(&rk[0]));
+
+    for (r = 1U; r < 10U; r++)
+    {
+        s = _mm_aesenc_si128(s, _mm_loadu_si128(&rk[r]));
+    }
+
+    s = _mm_aesenclast_si128(s, _mm_loadu_si128(&rk[10]));
+
+    _mm_storeu_si128((__m128i *)out, s);
+}
+
+static const struct bt_aes_backend aesni_backend = {
+        .name = "aesni",
+        .probe = aesni_probe,
+        .expand = soft_expand,
+        .encrypt = aesni_encrypt,
+};
+#endif /* CONFIG_BT_AES_NI */
+
+#if defined(CONFIG_BT_AES_ARMV8)
+static void armv8_encrypt(const struct bt_aes_sched *sched, const uint8_t in[16], uint8_t out[16])
+{
+    const uint8_t *rk = sched->rk.bytes;
+    uint8x16_t s;
+    uint8_t r;
+
+    s = vld1q_u8(in);
+
+    /* AESE does AddRoundKey, SubBytes and ShiftRows, AESMC MixColumns */
+    for (r = 0U; r < 9U; r++)
+    {
+        s = vaesmcq_u8(vaeseq_u8(s, vld1q_u8(&rk[r * 16U])));
+    }
+
+    s = vaeseq_u8(s, vld1q_u8(&rk[9 * 16U]));
+    s = veorq_u8(s, vld1q_u8(&rk[10 * 16U]));
+
+    vst1q_u8(out, s);
+}
+
+static const struct bt_aes_backend armv8_backend = {
+        .name = "armv8",
+        .expand = soft_expand,
+        .encrypt = armv8_encrypt,
+};
+#endif /* CONFIG_BT_AES_ARMV8 */
+
+/* Built-in backends, fastest first */
+static const struct bt_aes_backend *const builtin_backends[] = {
+#if defined(CONFIG_BT_AES_NI)
+        &aesni_backend,
+#endif
+#if defined(CONFIG_BT_AES_ARMV8)
+        &armv8_backend,
+#endif
+#if defined(CONFIG_BT_AES_TTABLE)
+        &ttable_backend,
+#endif
+        &soft_backend,
+};
+
+static const struct bt_aes_backend *ext_backends[AES_BACKEND_EXT_MAX];
+static const struct bt_aes_backend *current;
+
+#if defined(CONFIG_BT_AES_KEY_CACHE)
+struct aes_key_entry
+{
+    uint8_t key[16];
+    uint32_t used;
+    struct bt_aes_sched sched;
+};
+
+static struct aes_key_entry key_cache[CONFIG_BT_AES_KEY_CACHE_SIZE];
+static uint32_t key_cache_clock;
+#endif /* CONFIG_BT_AES_KEY_CACHE */
+
+static bool backend_usable(const struct bt_aes_backend *backend)
+{
+    struct bt_aes_sched sched;
+    uint8_t out[16];
+    bool ok;
+
+    if (backend->probe && !backend->probe())
+    {
+        return false;
+    }
+
+    sched.backend = backend;
+    backend->expand(&sched, kat_key);
+    backend->encrypt(&sched, kat_pt, out);
+
+    ok = !memcmp(out, kat_ct, sizeof(out));
+    if (!ok)
+    {
+        BT_ERR("AES backend %s failed known answer test", backend->name);
+    }
+
+    memset(&sched, 0, sizeof(sched));
+
+    return ok;
+}
+
+/* Walk registered backends first, then the built-in ones */
+static const struct bt_aes_backend *backend_at(uint8_t index)
+{
+    uint8_t ext = 0U;
+    uint8_t i;
+
+    for (i = 0U; i < AES_BACKEND_EXT_MAX; i++)
+    {
+        if (ext_backends[i])
+        {
+            if (ext++ == index)
+            {
+                return ext_backends[i];
+            }
+        }
+    }
+
+    index -= ext;
+    if (index < ARRAY_SIZE(builtin_backends))
+    {
+        return builtin_backends[index];
+    }
+
+    return NULL;
+}
+
+static const struct bt_aes_backend *backend_current(void)
+{
+    if (!current)
+    {
+        (void)bt_aes_backend_select(NULL);
+    }
+
+    return current;
+}
+
+int bt_aes_backend_register(const struct bt_aes_backend *backend)
+{
+    uint8_t i;
+
+    if (!backend || !backend->expand || !backend->encrypt)
+    {
+        return -EINVAL;
+    }
+
+    if (!backend_usable(backend))
+    {
+        return -EIO;
+    }
+
+    for (i = 0U; i < AES_BACKEND_EXT_MAX; i++)
+    {
+        if (!ext_backends[i])
+        {
+            ext_backends[i] = backend;
+
+            /* Pick it up on next use */
+            current = NULL;
+            bt_aes_key_cache_clear();
+            return 0;
+        }
+    }
+
+    return -ENOMEM;
+}
+
+int bt_aes_backend_select(const char *name)
+{
+    const struct bt_aes_backend *backend;
+    uint8_t i;
+
+    for (i = 0U; (backend = backend_at(i)) != NULL; i++)
+    {
+        if (name && strcmp(backend->name, name))
+        {
+            continue;
+        }
+
+        if (!backend_usable(backend))
+        {
+            continue;
+        }
+
+        if (current != backend)
+        {
+            BT_DBG("AES backend %s", backend->name);
+            current = backend;
+            bt_aes_key_cache_clear();
+        }
+
+        return 0;
+    }
+
+    if (!current)
+    {
+        /* The soft backend is always there */
+        current = &soft_backend;
+    }
+
+    return -ENOENT;
+}
+
+const struct bt_aes_backend *bt_aes_backend_get(void)
+{
+    return backend_current();
+}
+
+void bt_aes_expand(struct bt_aes_sched *sched, const uint8_t key[16])
+{
+    sched->backend = backend_current();
+    sched->backend->expand(sched, key);
+}
+
+void bt_aes_encrypt(const struct bt_aes_sched *sched, const uint8_t in[16], uint8_t out[16])
+{
+    sched->backend->encrypt(sched, in, out);
+}
+
+const struct bt_aes_sched *bt_aes_sched_get(const uint8_t key[16], struct bt_aes_sched *tmp)
+{
+#if defined(CONFIG_BT_AES_KEY_CACHE)
+    const struct bt_aes_backend *backend = backend_current();
+    struct aes_key_entry *entry = NULL;
+    uint8_t i;
+
+    for (i = 0U; i < CONFIG_BT_AES_KEY_CACHE_SIZE; i++)
+    {
+        if (key_cache[i].sched.backend == backend && !memcmp(key_cache[i].key, key, 16))
+        {
+            key_cache[i].used = ++key_cache_clock;
+            return &key_cache[i].sched;
+        }
+
+        /* Unused entries have a zero stamp and are taken first */
+        if (!entry || key_cache[i].used < entry->used)
+        {
+            entry = &key_cache[i];
+        }
+    }
+
+    memcpy(entry->key, key, 16);
+    entry->used = ++key_cache_clock;
+    bt_aes_expand(&entry->sched, key);
+
+    return &entry->sched;
+#else
+    bt_aes_expand(tmp, key);
+
+    return tmp;
+#endif /* CONFIG_BT_AES_KEY_CACHE */
+}
+
+void bt_aes_key_cache_clear(void)
+{
+#if defined(CONFIG_BT_AES_KEY_CACHE)
+    memset(key_cache, 0, sizeof(key_cache));
+    key_cache_clock = 0U;
+#endif /* CONFIG_BT_AES_KEY_CACHE */
+}
+
+#if defined(CONFIG_BT_AES_BENCHMARK)
+#define AES_BENCH_BLOCKS 4096U
+
+void bt_aes_backend_benchmark(void)
+{
+    const struct bt_aes_backend *backend;
+    struct bt_aes_sched sched;
+    uint8_t block[16];
+    uint32_t start;
+    uint32_t elapsed;
+    uint32_t n;
+    uint8_t i;
+
+    for (i = 0U; (backend = backend_at(i)) != NULL; i++)
+    {
+        if (!backend_usable(backend))
+        {
+            continue;
+        }
+
+        sched.backend = backend;
+        memcpy(block, kat_pt, sizeof(block));
+
+        start = sys_clock_tick_get();
+        for (n = 0U; n < AES_BENCH_BLOCKS; n++)
+        {
+            backend->expand(&sched, kat_key);
+        }
+        elapsed = MAX(k_ticks_to_us_floor32(sys_clock_tick_get() - start), 1U);
+
+        BT_INFO("%s: %u key expansions/s", backend->name,
+                (uint32_t)(AES_BENCH_BLOCKS * 1000000ULL / elapsed));
+
+        start = sys_clock_tick_get();
+        for (n = 0U; n < AES_BENCH_BLOCKS; n++)
+        {
+            backend->encrypt(&sched, block, block);
+        }
+        elapsed = MAX(k_ticks_to_us_floor32(sys_clock_tick_get() - start), 1U);
+
+        BT_INFO("%s: %u blocks/s", backend->name,
+                (uint32_t)(AES_BENCH_BLOCKS * 1000000ULL / elapsed));
+    }
+}
+#endif /* CONFIG_BT_AES_BENCHMARK */
@@ -0,0 +1,111 @@
+/* aes_backend.h - Selectable AES-128 block cipher backends */
+
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef _ZEPHYR_POLLING_COMMON_AES_BACKEND_H_
+#define _ZEPHYR_POLLING_COMMON_AES_BACKEND_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "bt_config.h"
+
+#include "aes_soft.h"
+
+struct bt_aes_backend;
+
+/* Expanded key, the layout is owned by the backend that expanded it. All
+ * keys and blocks are in AES (MS byte first) order.
+ */
+struct bt_aes_sched
+{
+    const struct bt_aes_backend *backend;
+    union
+    {
+        uint32_t words[4 * 11];
+        uint8_t bytes[16 * 11];
+        struct AES_ctx ctx;
+    } rk;
+};
+
+struct bt_aes_backend
+{
+    const char *name;
+
+    /** @brief Check the backend can run on this device.
+     *
+     *  Optional, the backend is always usable when not set.
+     *
+     *  @return true if usable.
+     */
+    bool (*probe)(void);
+
+    /** @brief Expand a 128-bit key into @p sched.
+     *
+     *  Hardware backends may keep the raw key or a key slot reference here.
+     */
+    void (*expand)(struct bt_aes_sched *sched, const uint8_t key[16]);
+
+    /** @brief Encrypt one block, @p in and @p out may overlap. */
+    void (*encrypt)(const struct bt_aes_sched *sched, const uint8_t in[16], uint8_t out[16]);
+};
+
+/** @brief Register an additional backend, e.g. an MCU AES peripheral.
+ *
+ *  Registered backends are preferred over the built-in ones. The backend is
+ *  checked against a known answer before it is used.
+ *
+ *  @param backend Backend, must stay valid.
+ *
+ *  @return 0 on success, -ENOMEM if no slot is left, -EIO if the known answer
+ *  test failed.
+ */
+int bt_aes_backend_register(const struct bt_aes_backend *backend);
+
+/** @brief Select a backend by name.
+ *
+ *  @param name Backend name, NULL selects the best usable backend.
+ *
+ *  @return 0 on success, -ENOENT if no usable backend has that name.
+ */
+int bt_aes_backend_select(const char *name);
+
+/** @brief Get the backend in use. */
+const struct bt_aes_backend *bt_aes_backend_get(void);
+
+/** @brief Expand a key with the current backend.
+ *
+ *  Callers holding a key for a long time (e.g. while resolving against an
+ *  IRK list) can keep the schedule and skip the expansion on every block.
+ */
+void bt_aes_expand(struct bt_aes_sched *sched, const uint8_t key[16]);
+
+/** @brief Encrypt one block with an expanded key. */
+void bt_aes_encrypt(const struct bt_aes_sched *sched, const uint8_t in[16], uint8_t out[16]);
+
+/** @brief Get the expanded key for @p key.
+ *
+ *  With CONFIG_BT_AES_KEY_CACHE the schedules of recently used keys are
+ *  kept, otherwise @p tmp is expanded and returned. Only meant for long
+ *  lived keys such as IRKs, short lived secrets must be expanded with
+ *  bt_aes_expand() instead. The caller clears @p tmp after use.
+ *
+ *  @param key 128-bit key.
+ *  @param tmp Storage used when the key is not cached.
+ *
+ *  @return Expanded key.
+ */
+const struct bt_aes_sched *bt_aes_sched_get(const uint8_t key[16], struct bt_aes_sched *tmp);
+
+/** @brief Drop all cached key schedules. */
+void bt_aes_key_cache_clear(void);
+
+#if defined(CONFIG_BT_AES_BENCHMARK)
+/** @brief Measure and log the throughput of every usable backend. */
+void bt_aes_backend_benchmark(void);
+#endif /* CONFIG_BT_AES_BENCHMARK */
+
+#endif /* _ZEPHYR_POLLING_COMMON_AES_BACKEND_H_ */
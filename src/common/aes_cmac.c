@@ -0,0 +1,266 @@
+/* aes_cmac.c - AES-CMAC (RFC 4493) on top of the software AES */
+
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <errno.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "aes_cmac.h"
+
+/* Number of long lived keys whose schedule and subkeys are kept. Signing
+ * reuses the CSRK, the GATT database hash and the DRBG conditioning reuse
+ * the zero key, so two entries cover the common cases. Other keys, the SMP
+ * pairing secrets among them, are never cached.
+ */
+#define AES_CMAC_KEY_CACHE_SIZE 2
+
+/* Constant Rb for 128-bit block ciphers, RFC 4493 2.3 */
+#define AES_CMAC_RB 0x87
+
+struct aes_cmac_key
+{
+    bool valid;
+    uint8_t key[AES_KEYLEN];
+    struct bt_aes_sched sched;
+    uint8_t k1[AES_BLOCKLEN];
+    uint8_t k2[AES_BLOCKLEN];
+};
+
+static struct aes_cmac_key key_cache[AES_CMAC_KEY_CACHE_SIZE];
+
+static void block_xor(uint8_t *dst, const uint8_t *src)
+{
+    uint8_t i;
+
+    for (i = 0U; i < AES_BLOCKLEN; i++)
+    {
+        dst[i] ^= src[i];
+    }
+}
+
+/* Multiply by x in GF(2^128), RFC 4493 2.3 */
+static void gf_double(uint8_t *out, const uint8_t *in)
+{
+    uint8_t carry = in[0] & 0x80;
+    uint8_t i;
+
+    for (i = 0U; i < AES_BLOCKLEN - 1; i++)
+    {
+        out[i] = (uint8_t)(in[i] << 1) | (in[i + 1] >> 7);
+    }
+
+    out[AES_BLOCKLEN - 1] = (uint8_t)(in[AES_BLOCKLEN - 1] << 1);
+
+    if (carry)
+    {
+        out[AES_BLOCKLEN - 1] ^= AES_CMAC_RB;
+    }
+}
+
+static void subkeys_gen(const struct bt_aes_sched *sched, uint8_t *k1, uint8_t *k2)
+{
+    uint8_t l[AES_BLOCKLEN] = {0};
+
+    bt_aes_encrypt(sched, l, l);
+    gf_double(k1, l);
+    gf_double(k2, k1);
+
+    memset(l, 0, sizeof(l));
+}
+
+static const struct aes_cmac_key *key_lookup(const uint8_t *key)
+{
+    struct aes_cmac_key *entry;
+    struct aes_cmac_key tmp;
+    uint8_t i;
+
+    for (i = 0U; i < AES_CMAC_KEY_CACHE_SIZE; i++)
+    {
+        entry = &key_cache[i];
+
+        if (!entry->valid || entry->sched.backend != bt_aes_backend_get() ||
+            memcmp(entry->key, key, AES_KEYLEN))
+        {
+            continue;
+        }
+
+        /* Keep most recently used first */
+        if (i)
+        {
+            tmp = *entry;
+            memmove(&key_cache[1], &key_cache[0], i * sizeof(key_cache[0]));
+            key_cache[0] = tmp;
+            memset(&tmp, 0, sizeof(tmp));
+        }
+
+        return &key_cache[0];
+    }
+
+    /* Evict the least recently used entry */
+    memmove(&key_cache[1], &key_cache[0], (AES_CMAC_KEY_CACHE_SIZE - 1) * sizeof(key_cache[0]));
+
+    entry = &key_cache[0];
+    entry->valid = true;
+    memcpy(entry->key, key, AES_KEYLEN);
+    bt_aes_expand(&entry->sched, key);
+    subkeys_gen(&entry->sched, entry->k1, entry->k2);
+
+    return entry;
+}
+
+int bt_aes_cmac_setup(struct bt_aes_cmac_ctx *ctx, const uint8_t key[16])
+{
+    if (!ctx || !key)
+    {
+        return -EINVAL;
+    }
+
+    bt_aes_expand(&ctx->sched, key);
+    subkeys_gen(&ctx->sched, ctx->k1, ctx->k2);
+    memset(ctx->iv, 0, sizeof(ctx->iv));
+    ctx->leftover_len = 0U;
+
+    return 0;
+}
+
+int bt_aes_cmac_setup_cached(struct bt_aes_cmac_ctx *ctx, const uint8_t key[16])
+{
+    const struct aes_cmac_key *entry;
+
+    if (!ctx || !key)
+    {
+        return -EINVAL;
+    }
+
+    entry = key_lookup(key);
+
+    memcpy(&ctx->sched, &entry->sched, sizeof(ctx->sched));
+    memcpy(ctx->k1, entry->k1, sizeof(ctx->k1));
+    memcpy(ctx->k2, entry->k2, sizeof(ctx->k2));
+    memset(ctx->iv, 0, sizeof(ctx->iv));
+    ctx->leftover_len = 0U;
+
+    return 0;
+}
+
+int bt_aes_cmac_update(struct bt_aes_cmac_ctx *ctx, const uint8_t *data, size_t len)
+{
+    size_t n;
+
+    if (!ctx || (!data && len))
+    {
+        return -EINVAL;
+    }
+
+    if (!len)
+    {
+        return 0;
+    }
+
+    if (ctx->leftover_len)
+    {
+        n = AES_BLOCKLEN - ctx->leftover_len;
+        if (n > len)
+        {
+            n = len;
+        }
+
+        memcpy(&ctx->leftover[ctx->leftover_len], data, n);
+        ctx->leftover_len += n;
+        data += n;
+        len -= n;
+
+        /* A full block is only processed once more data follows, the
+         * last block gets the subkey applied in final.
+         */
+        if (!len)
+        {
+            return 0;
+        }
+
+        block_xor(ctx->iv, ctx->leftover);
+        bt_aes_encrypt(&ctx->sched, ctx->iv, ctx->iv);
+        ctx->leftover_len = 0U;
+    }
+
+    while (len > AES_BLOCKLEN)
+    {
+        block_xor(ctx->iv, data);
+        bt_aes_encrypt(&ctx->sched, ctx->iv, ctx->iv);
+        data += AES_BLOCKLEN;
+        len -= AES_BLOCKLEN;
+    }
+
+    memcpy(ctx->leftover, data, len);
+    ctx->leftover_len = len;
+
+    return 0;
+}
+
+int bt_aes_cmac_final(struct bt_aes_cmac_ctx *ctx, uint8_t out[16])
+{
+    if (!ctx || !out)
+    {
+        return -EINVAL;
+    }
+
+    if (ctx->leftover_len == AES_BLOCKLEN)
+    {
+        block_xor(ctx->leftover, ctx->k1);
+    }
+    else
+    {
+        ctx->leftover[ctx->leftover_len] = 0x80;
+        memset(&ctx->leftover[ctx->leftover_len + 1], 0,
+               AES_BLOCKLEN - ctx->leftover_len - 1);
+        block_xor(ctx->leftover, ctx->k2);
+    }
+
+    block_xor(ctx->iv, ctx->leftover);
+    bt_aes_encrypt(&ctx->sched, ctx->iv, ctx->iv);
+    memcpy(out, ctx->iv, AES_BLOCKLEN);
+
+    memset(ctx, 0, sizeof(*ctx));
+
+    return 0;
+}
+
+static int aes_cmac(const uint8_t key[16], bool cached, const uint8_t *in, size_t len,
+                    uint8_t out[16])
+{
+    struct bt_aes_cmac_ctx ctx;
+    int err;
+
+    err = cached ? bt_aes_cmac_setup_cached(&ctx, key) : bt_aes_cmac_setup(&ctx, key);
+    if (err)
+    {
+        return err;
+    }
+
+    err = bt_aes_cmac_update(&ctx, in, len);
+    if (err)
+    {
+        memset(&ctx, 0, sizeof(ctx));
+        return err;
+    }
+
+    return bt_aes_cmac_final(&ctx, out);
+}
+
+int bt_aes_cmac(const uint8_t key[16], const uint8_t *in, size_t len, uint8_t out[16])
+{
+    return aes_cmac(key, false, in, len, out);
+}
+
+int bt_aes_cmac_cached(const uint8_t key[16], const uint8_t *in, size_t len, uint8_t out[16])
+{
+    return aes_cmac(key, true, in, len, out);
+}
+
+void bt_aes_cmac_cache_clear(void)
+{
+    memset(key_cache, 0, sizeof(key_cache));
+}
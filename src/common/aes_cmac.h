@@ -0,0 +1,105 @@
+/* aes_cmac.h - AES-CMAC (RFC 4493) on top of the software AES */
+
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef _ZEPHYR_POLLING_COMMON_AES_CMAC_H_
+#define _ZEPHYR_POLLING_COMMON_AES_CMAC_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "aes_backend.h"
+
+/* All keys, messages and MACs are in AES (big endian) byte order, as with
+ * the TinyCrypt API this replaces.
+ */
+struct bt_aes_cmac_ctx
+{
+    struct bt_aes_sched sched;
+    /* Subkeys derived from the key */
+    uint8_t k1[AES_BLOCKLEN];
+    uint8_t k2[AES_BLOCKLEN];
+    /* Running CBC-MAC value */
+    uint8_t iv[AES_BLOCKLEN];
+    /* Last (possibly complete) block, kept back until final */
+    uint8_t leftover[AES_BLOCKLEN];
+    uint8_t leftover_len;
+};
+
+/** @brief Prepare a context for a new MAC.
+ *
+ *  The key is expanded into the context only, nothing is kept once the
+ *  context is wiped.
+ *
+ *  @param ctx CMAC context.
+ *  @param key 128-bit key.
+ *
+ *  @return 0 on success or negative error value on failure.
+ */
+int bt_aes_cmac_setup(struct bt_aes_cmac_ctx *ctx, const uint8_t key[16]);
+
+/** @brief Prepare a context for a new MAC with a long lived key.
+ *
+ *  The expanded key and the K1/K2 subkeys of recently used keys are cached,
+ *  so repeated MACs with the same key skip the key schedule and the subkey
+ *  encryption. Only for keys that stay in RAM anyway, such as a CSRK or the
+ *  zero key of the database hash, never for pairing secrets.
+ *
+ *  @param ctx CMAC context.
+ *  @param key 128-bit key.
+ *
+ *  @return 0 on success or negative error value on failure.
+ */
+int bt_aes_cmac_setup_cached(struct bt_aes_cmac_ctx *ctx, const uint8_t key[16]);
+
+/** @brief Feed message data, may be called any number of times.
+ *
+ *  @param ctx  CMAC context.
+ *  @param data Message data.
+ *  @param len  Length of the data.
+ *
+ *  @return 0 on success or negative error value on failure.
+ */
+int bt_aes_cmac_update(struct bt_aes_cmac_ctx *ctx, const uint8_t *data, size_t len);
+
+/** @brief Produce the MAC and wipe the context.
+ *
+ *  @param ctx CMAC context.
+ *  @param out 128-bit MAC.
+ *
+ *  @return 0 on success or negative error value on failure.
+ */
+int bt_aes_cmac_final(struct bt_aes_cmac_ctx *ctx, uint8_t out[16]);
+
+/** @brief One-shot AES-CMAC.
+ *
+ *  @param key 128-bit key.
+ *  @param in  Message.
+ *  @param len Length of the message.
+ *  @param out 128-bit MAC.
+ *
+ *  @return 0 on success or negative error value on failure.
+ */
+int bt_aes_cmac(const uint8_t key[16], const uint8_t *in, size_t len, uint8_t out[16]);
+
+/** @brief One-shot AES-CMAC with a long lived key, see bt_aes_cmac_setup_cached().
+ *
+ *  @param key 128-bit key.
+ *  @param in  Message.
+ *  @param len Length of the message.
+ *  @param out 128-bit MAC.
+ *
+ *  @return 0 on success or negative error value on failure.
+ */
+int bt_aes_cmac_cached(const uint8_t key[16], const uint8_t *in, size_t len, uint8_t out[16]);
+
+/** @brief Drop all cached key schedules and subkeys.
+ *
+ *  Used once a cached key is no longer valid, e.g. the CSRK of a removed
+ *  bond.
+ */
+void bt_aes_cmac_cache_clear(void);
+
+#endif /* _ZEPHYR_POLLING_COMMON_AES_CMAC_H_ */
@@ -239,8 +239,63 @@ uint8_t bt_buf_reserve_size_controller_tx_acl(void)
     return bt_buf_reserve_size(BT_BUF_ACL_IN);
 }
 
+#if defined(CONFIG_BT_BUF_EVT_ADMISSION)
+BUILD_ASSERT(CONFIG_BT_BUF_EVT_RESERVED < CONFIG_BT_BUF_EVT_RX_COUNT,
+             "No event buffer left for advertising reports");
+
+static struct bt_buf_evt_stats evt_stats;
+static uint8_t evt_sample;
+
+bool bt_buf_evt_admit(bool discardable)
+{
+    uint8_t free = spool_size(&evt_pool);
+
+    if (!discardable)
+    {
+        return true;
+    }
+
+    if (free <= CONFIG_BT_BUF_EVT_RESERVED)
+    {
+        evt_stats.shed++;
+        return false;
+    }
+
+    if (free < CONFIG_BT_BUF_EVT_SHED_LEVEL && evt_sample++ % CONFIG_BT_BUF_EVT_SAMPLE)
+    {
+        evt_stats.sampled_out++;
+        return false;
+    }
+
+    evt_stats.admitted++;
+
+    return true;
+}
+
+void bt_buf_evt_stats_get(struct bt_buf_evt_stats *stats)
+{
+    *stats = evt_stats;
+}
+
+/* Advertising reports, by the event code and subevent code of an event */
+static bool evt_discardable(const uint8_t *packet)
+{
+    if (packet[0] != BT_HCI_EVT_LE_META_EVENT)
+    {
+        return false;
+    }
+
+    return packet[2] == BT_HCI_EVT_LE_ADVERTISING_REPORT ||
+           packet[2] == BT_HCI_EVT_LE_EXT_ADVERTISING_REPORT ||
+           packet[2] == BT_HCI_EVT_LE_DIRECT_ADV_REPORT;
+}
+#endif /* CONFIG_BT_BUF_EVT_ADMISSION */
+
 uint8_t bt_check_rx_evt_need_drop(uint8_t *packet)
 {
+#if defined(CONFIG_BT_BUF_EVT_ADMISSION)
+    return !bt_buf_evt_admit(evt_discardable(packet));
+#else
     if (bt_buf_reserve_size(BT_BUF_EVT) < 3)
     {
         if (packet[0] == BT_HCI_EVT_LE_META_EVENT && packet[2] == BT_HCI_EVT_LE_ADVERTISING_REPORT)
@@ -250,6 +305,31 @@ uint8_t bt_check_rx_evt_need_drop(uint8_t *packet)
     }
 
     return 0;
+#endif /* CONFIG_BT_BUF_EVT_ADMISSION */
+}
+
+static struct net_buf *evt_alloc(bool discardable)
+{
+#if defined(CONFIG_BT_BUF_EVT_ADMISSION)
+    struct net_buf *buf;
+
+    /* The reserve is not for discardable events */
+    if (discardable && spool_size(&evt_pool) <= CONFIG_BT_BUF_EVT_RESERVED)
+    {
+        evt_stats.shed++;
+        return NULL;
+    }
+
+    buf = bt_buf_get_controller_tx_evt();
+    if (!buf && !discardable)
+    {
+        evt_stats.alloc_failed++;
+    }
+
+    return buf;
+#else
+    return bt_buf_get_controller_tx_evt();
+#endif /* CONFIG_BT_BUF_EVT_ADMISSION */
 }
 
 struct net_buf *bt_buf_get_evt(uint8_t evt, bool discardable, k_timeout_t timeout)
@@ -273,9 +353,9 @@ struct net_buf *bt_buf_get_evt(uint8_t evt, bool discardable, k_timeout_t timeou
 #endif /* CONFIG_BT_CONN */
     case BT_HCI_EVT_CMD_COMPLETE:
     case BT_HCI_EVT_CMD_STATUS:
-        return bt_buf_get_controller_tx_evt();
+        return evt_alloc(false);
     default:
-        return bt_buf_get_controller_tx_evt();
+        return evt_alloc(discardable);
     }
 }
 
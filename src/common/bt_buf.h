@@ -42,6 +42,18 @@ uint8_t bt_buf_reserve_size_controller_tx_acl(void);
 
 uint8_t bt_check_rx_evt_need_drop(uint8_t *packet);
 
+#if defined(CONFIG_BT_BUF_EVT_ADMISSION)
+/* Whether an event is to be received, decided from the free event buffers
+ * before one is allocated.
+ */
+bool bt_buf_evt_admit(bool discardable);
+#else
+static inline bool bt_buf_evt_admit(bool discardable)
+{
+    return true;
+}
+#endif /* CONFIG_BT_BUF_EVT_ADMISSION */
+
 void bt_buf_pool_init(void);
 uint8_t bt_buf_check_allow_sleep(void);
 
@@ -0,0 +1,353 @@
+/* bt_capture.c - HCI traffic capture to btsnoop or pcap files */
+
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <string.h>
+
+#include "bt_config.h"
+
+#include "base/types.h"
+#include "base/common.h"
+#include "base/byteorder.h"
+#include "base/sys_clock.h"
+
+#include "bt_capture.h"
+
+#define BT_DBG_ENABLED  IS_ENABLED(CONFIG_BT_DEBUG_HCI_CORE)
+#define LOG_MODULE_NAME bt_capture
+#include "logging/bt_log.h"
+
+#if defined(CONFIG_BT_CAPTURE)
+
+#define CAPTURE_RECORDS   CONFIG_BT_CAPTURE_RECORDS
+#define CAPTURE_MASK      (CAPTURE_RECORDS - 1U)
+#define CAPTURE_SNAPLEN   CONFIG_BT_CAPTURE_SNAPLEN
+#define CAPTURE_FILE_SIZE (CONFIG_BT_CAPTURE_FILE_SIZE * 1024UL)
+
+BUILD_ASSERT((CAPTURE_RECORDS & CAPTURE_MASK) == 0U, "BT_CAPTURE_RECORDS not a power of two");
+
+#if defined(CONFIG_BT_CAPTURE_FORMAT_PCAP)
+/* LINKTYPE_BLUETOOTH_HCI_H4_WITH_PHDR, a direction word before the H4 type */
+#define PCAP_LINKTYPE      201U
+#define PCAP_PHDR_SIZE     4U
+#define CAPTURE_FILE_HDR   24U
+#define CAPTURE_RECORD_HDR (16U + PCAP_PHDR_SIZE + 1U)
+#else
+#define BTSNOOP_DATALINK_H4 1002U
+/* Microseconds from year 0 to 1970 */
+#define BTSNOOP_EPOCH_DELTA 0x00dcddb30f2f8000ULL
+#define CAPTURE_FILE_HDR    16U
+#define CAPTURE_RECORD_HDR  (24U + 1U)
+#endif /* CONFIG_BT_CAPTURE_FORMAT_PCAP */
+
+#define H4_CMD 0x01
+#define H4_EVT 0x04
+
+/* One packet, payload cut at the snap length */
+struct capture_rec
+{
+    uint32_t ticks;
+    uint16_t len;
+    uint8_t type;
+    uint8_t in;
+    uint8_t data[CAPTURE_SNAPLEN];
+};
+
+/* The HCI path records at head, the flushing context writes from tail.
+ * In trigger mode the ring is a history that overwrites itself and is
+ * only read out, with recording paused, once triggered. Both sides may
+ * run on different threads: head, tail and triggered are published with
+ * release stores and read with acquire loads, so a record, or the
+ * trigger time, is complete before the index that hands it over.
+ */
+static struct
+{
+    const struct bt_capture_impl *impl;
+    uint32_t head;
+    uint32_t tail;
+    uint32_t triggered;
+    uint32_t trigger_ticks;
+
+    /* Flushing context only */
+    bool file_open;
+    uint8_t file_index;
+    uint32_t file_bytes;
+    uint32_t last_ticks;
+    uint32_t wraps;
+    uint64_t base_us;
+
+    struct bt_capture_stats stats;
+    struct capture_rec recs[CAPTURE_RECORDS];
+} capture;
+
+void bt_capture_packet(uint8_t packet_type, uint8_t in, const uint8_t *data, uint16_t len)
+{
+    uint32_t head = __atomic_load_n(&capture.head, __ATOMIC_RELAXED);
+    struct capture_rec *rec;
+    bool full;
+
+    if (!capture.impl)
+    {
+        return;
+    }
+
+    if (IS_ENABLED(CONFIG_BT_CAPTURE_TRIGGER))
+    {
+        full = __atomic_load_n(&capture.triggered, __ATOMIC_ACQUIRE);
+    }
+    else
+    {
+        full = head - __atomic_load_n(&capture.tail, __ATOMIC_ACQUIRE) >= CAPTURE_RECORDS;
+    }
+
+    if (full)
+    {
+        capture.stats.dropped++;
+        return;
+    }
+
+    rec = &capture.recs[head & CAPTURE_MASK];
+    rec->ticks = sys_clock_tick_get();
+    rec->len = len;
+    rec->type = packet_type;
+    rec->in = in;
+    (void)memcpy(rec->data, data, MIN(len, CAPTURE_SNAPLEN));
+
+    if (len > CAPTURE_SNAPLEN)
+    {
+        capture.stats.snapped++;
+    }
+
+    capture.stats.recorded++;
+
+    __atomic_store_n(&capture.head, head + 1U, __ATOMIC_RELEASE);
+}
+
+static bool capture_write(const uint8_t *data, uint16_t len)
+{
+    if (capture.impl->write(data, len) < 0)
+    {
+        capture.stats.errors++;
+        return false;
+    }
+
+    capture.file_bytes += len;
+    capture.stats.bytes += len;
+
+    return true;
+}
+
+static void capture_close(void)
+{
+    if (capture.file_open)
+    {
+        capture.impl->close();
+        capture.file_open = false;
+    }
+}
+
+static bool capture_open(void)
+{
+    uint8_t hdr[CAPTURE_FILE_HDR];
+
+    capture_close();
+
+    if (capture.impl->open(capture.file_index) < 0)
+    {
+        capture.stats.errors++;
+        return false;
+    }
+
+    capture.file_open = true;
+    capture.file_bytes = 0U;
+    capture.file_index = (capture.file_index + 1U) % CONFIG_BT_CAPTURE_FILE_COUNT;
+    capture.stats.files++;
+
+#if defined(CONFIG_BT_CAPTURE_FORMAT_PCAP)
+    sys_put_le32(0xa1b2c3d4, &hdr[0]);
+    sys_put_le16(2U, &hdr[4]);
+    sys_put_le16(4U, &hdr[6]);
+    sys_put_le32(0U, &hdr[8]);
+    sys_put_le32(0U, &hdr[12]);
+    sys_put_le32(CAPTURE_SNAPLEN + PCAP_PHDR_SIZE + 1U, &hdr[16]);
+    sys_put_le32(PCAP_LINKTYPE, &hdr[20]);
+#else
+    (void)memcpy(&hdr[0], "btsnoop", 8U);
+    sys_put_be32(1U, &hdr[8]);
+    sys_put_be32(BTSNOOP_DATALINK_H4, &hdr[12]);
+#endif /* CONFIG_BT_CAPTURE_FORMAT_PCAP */
+
+    return capture_write(hdr, sizeof(hdr));
+}
+
+/* Timestamp since 1970, or since the start without a wall clock */
+static uint64_t capture_time_us(const struct capture_rec *rec)
+{
+    if (rec->ticks < capture.last_ticks)
+    {
+        capture.wraps++;
+    }
+
+    capture.last_ticks = rec->ticks;
+
+    return capture.base_us + k_ticks_to_us_floor64(((uint64_t)capture.wraps << 32) | rec->ticks);
+}
+
+static void capture_record(const struct capture_rec *rec, uint64_t ts_us)
+{
+    uint16_t incl = MIN(rec->len, CAPTURE_SNAPLEN);
+    uint8_t hdr[CAPTURE_RECORD_HDR];
+
+    if (!capture.file_open ||
+        (!IS_ENABLED(CONFIG_BT_CAPTURE_TRIGGER) &&
+         capture.file_bytes + sizeof(hdr) + incl > CAPTURE_FILE_SIZE))
+    {
+        if (!capture_open())
+        {
+            return;
+        }
+    }
+
+#if defined(CONFIG_BT_CAPTURE_FORMAT_PCAP)
+    sys_put_le32((uint32_t)(ts_us / USEC_PER_SEC), &hdr[0]);
+    sys_put_le32((uint32_t)(ts_us % USEC_PER_SEC), &hdr[4]);
+    sys_put_le32(incl + PCAP_PHDR_SIZE + 1U, &hdr[8]);
+    sys_put_le32(rec->len + PCAP_PHDR_SIZE + 1U, &hdr[12]);
+    sys_put_be32(rec->in ? 1U : 0U, &hdr[16]);
+#else
+    sys_put_be32(rec->len + 1U, &hdr[0]);
+    sys_put_be32(incl + 1U, &hdr[4]);
+    sys_put_be32((rec->in ? BIT(0) : 0U) |
+                         ((rec->type == H4_CMD || rec->type == H4_EVT) ? BIT(1) : 0U),
+                 &hdr[8]);
+    sys_put_be32(capture.stats.dropped, &hdr[12]);
+    sys_put_be64(BTSNOOP_EPOCH_DELTA + ts_us, &hdr[16]);
+#endif /* CONFIG_BT_CAPTURE_FORMAT_PCAP */
+
+    hdr[sizeof(hdr) - 1U] = rec->type;
+
+    if (capture_write(hdr, sizeof(hdr)) && capture_write(rec->data, incl))
+    {
+        capture.stats.written++;
+    }
+}
+
+#if defined(CONFIG_BT_CAPTURE_TRIGGER)
+void bt_capture_trigger(void)
+{
+    if (!capture.impl || __atomic_load_n(&capture.triggered, __ATOMIC_ACQUIRE))
+    {
+        return;
+    }
+
+    /* Published by the store of triggered below */
+    capture.trigger_ticks = sys_clock_tick_get();
+    __atomic_store_n(&capture.triggered, 1U, __ATOMIC_RELEASE);
+}
+
+uint32_t bt_capture_flush(void)
+{
+    const struct capture_rec *rec;
+    uint32_t written = capture.stats.written;
+    uint32_t head;
+    uint32_t tail;
+    uint64_t ts_us;
+
+    if (!capture.impl || !__atomic_load_n(&capture.triggered, __ATOMIC_ACQUIRE))
+    {
+        return 0U;
+    }
+
+    /* Read after triggered, recording has paused at this head */
+    head = __atomic_load_n(&capture.head, __ATOMIC_ACQUIRE);
+    tail = __atomic_load_n(&capture.tail, __ATOMIC_RELAXED);
+
+    /* Leave out the oldest record, the HCI path may have started to
+     * overwrite it right before recording paused.
+     */
+    if (head - tail >= CAPTURE_RECORDS)
+    {
+        tail = head - (CAPTURE_RECORDS - 1U);
+    }
+
+    if (capture_open())
+    {
+        for (; tail != head; tail++)
+        {
+            rec = &capture.recs[tail & CAPTURE_MASK];
+            ts_us = capture_time_us(rec);
+
+            if (k_ticks_to_ms_floor32(capture.trigger_ticks - rec->ticks) <=
+                CONFIG_BT_CAPTURE_TRIGGER_WINDOW)
+            {
+                capture_record(rec, ts_us);
+            }
+        }
+
+        capture_close();
+    }
+
+    capture.stats.triggers++;
+
+    __atomic_store_n(&capture.tail, head, __ATOMIC_RELEASE);
+    __atomic_store_n(&capture.triggered, 0U, __ATOMIC_RELEASE);
+
+    return capture.stats.written - written;
+}
+#else
+void bt_capture_trigger(void)
+{
+}
+
+uint32_t bt_capture_flush(void)
+{
+    uint32_t head = __atomic_load_n(&capture.head, __ATOMIC_ACQUIRE);
+    uint32_t tail = __atomic_load_n(&capture.tail, __ATOMIC_RELAXED);
+    const struct capture_rec *rec;
+    uint32_t written = capture.stats.written;
+
+    if (!capture.impl)
+    {
+        return 0U;
+    }
+
+    for (; tail != head; tail++)
+    {
+        rec = &capture.recs[tail & CAPTURE_MASK];
+        capture_record(rec, capture_time_us(rec));
+
+        /* Hand the record back right away */
+        __atomic_store_n(&capture.tail, tail + 1U, __ATOMIC_RELEASE);
+    }
+
+    return capture.stats.written - written;
+}
+#endif /* CONFIG_BT_CAPTURE_TRIGGER */
+
+void bt_capture_stats_get(struct bt_capture_stats *stats)
+{
+    *stats = capture.stats;
+}
+
+void bt_capture_register(const struct bt_capture_impl *impl)
+{
+    uint32_t ticks = sys_clock_tick_get();
+
+    capture.last_ticks = ticks;
+    capture.base_us = 0U;
+
+    if (impl->wall_clock_us)
+    {
+        capture.base_us = impl->wall_clock_us() - k_ticks_to_us_floor64(ticks);
+    }
+
+    capture.impl = impl;
+
+    if (impl->init)
+    {
+        impl->init();
+    }
+}
+#endif /* CONFIG_BT_CAPTURE */
@@ -0,0 +1,77 @@
+#ifndef _ZEPHYR_POLLING_COMMON_BT_CAPTURE_H_
+#define _ZEPHYR_POLLING_COMMON_BT_CAPTURE_H_
+
+#include "bt_config.h"
+
+#include "base/types.h"
+
+/* Where the capture files go. The core writes the btsnoop or pcap headers,
+ * the backend only stores bytes.
+ */
+struct bt_capture_impl
+{
+    /* Called from bt_capture_register(), e.g. to start a thread that
+     * calls bt_capture_flush(). Optional.
+     */
+    void (*init)(void);
+
+    /* Start file number index, truncating it */
+    int (*open)(uint8_t index);
+
+    int (*write)(const uint8_t *data, uint16_t len);
+
+    void (*close)(void);
+
+    /* Microseconds since 1 Jan 1970 for the timestamps. Optional,
+     * without it they count from the capture start.
+     */
+    uint64_t (*wall_clock_us)(void);
+};
+
+struct bt_capture_stats
+{
+    /* Packets recorded into the ring */
+    uint32_t recorded;
+    /* Packets dropped because the ring was full or being dumped */
+    uint32_t dropped;
+    /* Packets that had payload cut at the snap length */
+    uint32_t snapped;
+    /* Packets and bytes written to the backend */
+    uint32_t written;
+    uint32_t bytes;
+    /* Files started, and failed backend calls */
+    uint32_t files;
+    uint32_t errors;
+    /* Trigger dumps done */
+    uint32_t triggers;
+};
+
+#if defined(CONFIG_BT_CAPTURE)
+void bt_capture_register(const struct bt_capture_impl *impl);
+
+/* Record one H4 packet, data is the packet without the H4 type */
+void bt_capture_packet(uint8_t packet_type, uint8_t in, const uint8_t *data, uint16_t len);
+
+/* Write what was recorded to the backend. Only one context may flush, it
+ * can be another thread than the one recording. Returns packets written.
+ */
+uint32_t bt_capture_flush(void);
+
+/* With BT_CAPTURE_TRIGGER, have the next flush write the last
+ * BT_CAPTURE_TRIGGER_WINDOW milliseconds of traffic to a new file.
+ */
+void bt_capture_trigger(void);
+
+void bt_capture_stats_get(struct bt_capture_stats *stats);
+#else
+static inline void bt_capture_packet(uint8_t packet_type, uint8_t in, const uint8_t *data,
+                                     uint16_t len)
+{
+}
+
+static inline void bt_capture_trigger(void)
+{
+}
+#endif /* CONFIG_BT_CAPTURE */
+
+#endif /* _ZEPHYR_POLLING_COMMON_BT_CAPTURE_H_ */
@@ -0,0 +1,318 @@
+/* bt_profile.c - Polling loop latency profiler */
+
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <errno.h>
+#include <string.h>
+
+#include "bt_config.h"
+
+#include "base/types.h"
+#include "base/common.h"
+#include "base/sys_clock.h"
+
+#include "bt_profile.h"
+
+#define BT_DBG_ENABLED  IS_ENABLED(CONFIG_BT_DEBUG_HCI_CORE)
+#define LOG_MODULE_NAME bt_profile
+#include "logging/bt_log.h"
+
+#if defined(CONFIG_BT_PROFILE)
+
+/* Log-linear buckets: exact below 4 us, then four per power of two up to
+ * 2^24 us, longer runs go to the last one.
+ */
+#define HIST_SUB          4U
+#define HIST_EXP_MAX      23U
+#define HIST_BUCKETS      (HIST_SUB + (HIST_EXP_MAX - 1U) * HIST_SUB)
+#define PROFILE_OFFENDERS CONFIG_BT_PROFILE_OFFENDERS
+
+struct profile_site
+{
+    uint32_t count;
+    uint32_t max_us;
+    uint64_t total_us;
+    const void *max_fn;
+    uint32_t hist[HIST_BUCKETS];
+};
+
+struct profile_offender
+{
+    const void *fn;
+    uint8_t site;
+    uint32_t count;
+    uint32_t max_us;
+    uint64_t total_us;
+};
+
+static const char *const site_names[BT_PROFILE_SITES] = {
+        [BT_PROFILE_LOOP] = "loop",
+        [BT_PROFILE_HCI_STATE] = "hci state",
+        [BT_PROFILE_HCI_TX] = "hci tx",
+        [BT_PROFILE_HCI_RX] = "hci rx",
+        [BT_PROFILE_HOST_WORK] = "host work",
+        [BT_PROFILE_TIMEOUT] = "timeouts",
+        [BT_PROFILE_LOG_DRAIN] = "log drain",
+        [BT_PROFILE_HCI_EVT] = "hci event",
+        [BT_PROFILE_HCI_CMD_COMPLETE] = "cmd complete",
+        [BT_PROFILE_ATT] = "att",
+        [BT_PROFILE_TIMEOUT_CB] = "timeout cb",
+};
+
+static struct
+{
+    uint32_t (*now_us)(void);
+    bool loop_started;
+    uint32_t loop_start;
+    struct profile_site sites[BT_PROFILE_SITES];
+    struct profile_offender offenders[PROFILE_OFFENDERS];
+} profile;
+
+static uint8_t hist_bucket(uint32_t us)
+{
+    uint32_t exp;
+
+    if (us < HIST_SUB)
+    {
+        return us;
+    }
+
+    exp = 31U - __builtin_clz(us);
+    if (exp > HIST_EXP_MAX)
+    {
+        return HIST_BUCKETS - 1U;
+    }
+
+    return HIST_SUB + (exp - 2U) * HIST_SUB + ((us >> (exp - 2U)) & (HIST_SUB - 1U));
+}
+
+static uint32_t hist_floor(uint8_t bucket)
+{
+    uint8_t exp;
+
+    if (bucket < HIST_SUB)
+    {
+        return bucket;
+    }
+
+    exp = (bucket - HIST_SUB) / HIST_SUB + 2U;
+
+    return (HIST_SUB + (bucket - HIST_SUB) % HIST_SUB) << (exp - 2U);
+}
+
+void bt_profile_clock_register(uint32_t (*now_us)(void))
+{
+    profile.now_us = now_us;
+}
+
+uint32_t bt_profile_now(void)
+{
+    if (profile.now_us)
+    {
+        return profile.now_us();
+    }
+
+    return k_ticks_to_us_floor32(sys_clock_tick_get());
+}
+
+/* Keep the functions with the longest single runs */
+static void offender_record(enum bt_profile_site site, const void *fn, uint32_t us)
+{
+    struct profile_offender *least = NULL;
+    struct profile_offender *entry;
+    uint8_t i;
+
+    for (i = 0U; i < PROFILE_OFFENDERS; i++)
+    {
+        entry = &profile.offenders[i];
+
+        if (entry->fn == fn && entry->site == site)
+        {
+            entry->count++;
+            entry->total_us += us;
+            entry->max_us = MAX(entry->max_us, us);
+            return;
+        }
+
+        if (!least || entry->max_us < least->max_us)
+        {
+            least = entry;
+        }
+    }
+
+    if (least->fn && least->max_us >= us)
+    {
+        return;
+    }
+
+    least->fn = fn;
+    least->site = site;
+    least->count = 1U;
+    least->total_us = us;
+    least->max_us = us;
+}
+
+static void site_record(enum bt_profile_site site, const void *fn, uint32_t us)
+{
+    struct profile_site *s = &profile.sites[site];
+
+    s->count++;
+    s->total_us += us;
+    s->hist[hist_bucket(us)]++;
+
+    if (us >= s->max_us)
+    {
+        s->max_us = us;
+        s->max_fn = fn;
+    }
+}
+
+void bt_profile_record(enum bt_profile_site site, const void *fn, uint32_t start)
+{
+    uint32_t us = bt_profile_now() - start;
+
+    site_record(site, fn, us);
+
+    if (fn)
+    {
+        offender_record(site, fn, us);
+    }
+}
+
+void bt_profile_loop(void)
+{
+    uint32_t now = bt_profile_now();
+
+    if (profile.loop_started)
+    {
+        site_record(BT_PROFILE_LOOP, NULL, now - profile.loop_start);
+    }
+
+    profile.loop_started = true;
+    profile.loop_start = now;
+}
+
+static uint32_t hist_percentile(const struct profile_site *s, uint32_t permille)
+{
+    uint64_t want = ((uint64_t)s->count * permille + 999U) / 1000U;
+    uint64_t seen = 0U;
+    uint8_t i;
+
+    for (i = 0U; i < HIST_BUCKETS; i++)
+    {
+        seen += s->hist[i];
+        if (seen >= want)
+        {
+            return hist_floor(i);
+        }
+    }
+
+    return s->max_us;
+}
+
+int bt_profile_summary_get(enum bt_profile_site site, struct bt_profile_summary *summary)
+{
+    const struct profile_site *s;
+
+    if (site >= BT_PROFILE_SITES || !summary)
+    {
+        return -EINVAL;
+    }
+
+    s = &profile.sites[site];
+
+    summary->count = s->count;
+    summary->avg_us = s->count ? (uint32_t)(s->total_us / s->count) : 0U;
+    summary->p50_us = s->count ? hist_percentile(s, 500U) : 0U;
+    summary->p90_us = s->count ? hist_percentile(s, 900U) : 0U;
+    summary->p99_us = s->count ? hist_percentile(s, 990U) : 0U;
+    summary->max_us = s->max_us;
+    summary->max_fn = s->max_fn;
+
+    return 0;
+}
+
+size_t bt_profile_offenders_get(struct bt_profile_offender *offenders, size_t max)
+{
+    const struct profile_offender *entry;
+    size_t count = 0U;
+    size_t i, j;
+
+    for (i = 0U; i < PROFILE_OFFENDERS; i++)
+    {
+        entry = &profile.offenders[i];
+        if (!entry->fn)
+        {
+            continue;
+        }
+
+        /* Insertion sort, longest run first */
+        for (j = count; j > 0U && offenders[j - 1U].max_us < entry->max_us; j--)
+        {
+            if (j < max)
+            {
+                offenders[j] = offenders[j - 1U];
+            }
+        }
+
+        if (j < max)
+        {
+            offenders[j].fn = entry->fn;
+            offenders[j].site = entry->site;
+            offenders[j].count = entry->count;
+            offenders[j].avg_us = (uint32_t)(entry->total_us / entry->count);
+            offenders[j].max_us = entry->max_us;
+            count += count < max ? 1U : 0U;
+        }
+    }
+
+    return count;
+}
+
+void bt_profile_dump(void)
+{
+    struct bt_profile_offender offenders[PROFILE_OFFENDERS];
+    const struct profile_site *loop = &profile.sites[BT_PROFILE_LOOP];
+    struct bt_profile_summary summary;
+    size_t count;
+    uint8_t i;
+
+    for (i = 0U; i < BT_PROFILE_SITES; i++)
+    {
+        (void)bt_profile_summary_get(i, &summary);
+        if (!summary.count)
+        {
+            continue;
+        }
+
+        BT_INFO("%s: n %u avg %u p50 %u p90 %u p99 %u max %u us (%p)", site_names[i],
+                summary.count, summary.avg_us, summary.p50_us, summary.p90_us, summary.p99_us,
+                summary.max_us, summary.max_fn);
+    }
+
+    for (i = 0U; i < HIST_BUCKETS; i++)
+    {
+        if (loop->hist[i])
+        {
+            BT_INFO("loop >= %u us: %u", hist_floor(i), loop->hist[i]);
+        }
+    }
+
+    count = bt_profile_offenders_get(offenders, ARRAY_SIZE(offenders));
+    for (i = 0U; i < count; i++)
+    {
+        BT_INFO("stall %p in %s: n %u avg %u max %u us", offenders[i].fn,
+                site_names[offenders[i].site], offenders[i].count, offenders[i].avg_us,
+                offenders[i].max_us);
+    }
+}
+
+void bt_profile_reset(void)
+{
+    (void)memset(profile.sites, 0, sizeof(profile.sites));
+    (void)memset(profile.offenders, 0, sizeof(profile.offenders));
+    profile.loop_started = false;
+}
+#endif /* CONFIG_BT_PROFILE */
@@ -0,0 +1,97 @@
+#ifndef _ZEPHYR_POLLING_COMMON_BT_PROFILE_H_
+#define _ZEPHYR_POLLING_COMMON_BT_PROFILE_H_
+
+#include <stddef.h>
+
+#include "bt_config.h"
+
+#include "base/types.h"
+
+/* What is timed. The stages are the steps of bt_polling_work(), the
+ * handlers run inside them.
+ */
+enum bt_profile_site
+{
+    /* Start to start of bt_polling_work(), with the application and the
+     * driver polling done in between.
+     */
+    BT_PROFILE_LOOP,
+    BT_PROFILE_HCI_STATE,
+    BT_PROFILE_HCI_TX,
+    BT_PROFILE_HCI_RX,
+    /* ECC, DRBG, key precomputation and resolving list batching */
+    BT_PROFILE_HOST_WORK,
+    BT_PROFILE_TIMEOUT,
+    BT_PROFILE_LOG_DRAIN,
+    BT_PROFILE_HCI_EVT,
+    BT_PROFILE_HCI_CMD_COMPLETE,
+    BT_PROFILE_ATT,
+    /* Work items and timers expiring */
+    BT_PROFILE_TIMEOUT_CB,
+
+    BT_PROFILE_SITES,
+};
+
+struct bt_profile_summary
+{
+    uint32_t count;
+    uint32_t avg_us;
+    /* Lower bound of the histogram bucket the percentile falls in */
+    uint32_t p50_us;
+    uint32_t p90_us;
+    uint32_t p99_us;
+    uint32_t max_us;
+    /* Function that took max_us */
+    const void *max_fn;
+};
+
+/* A function that ran long, the ones with the longest single run are kept */
+struct bt_profile_offender
+{
+    const void *fn;
+    uint8_t site;
+    uint32_t count;
+    uint32_t avg_us;
+    uint32_t max_us;
+};
+
+#if defined(CONFIG_BT_PROFILE)
+/* Microsecond clock, wrapping at 32 bits. Without one the profiler uses
+ * the system tick.
+ */
+void bt_profile_clock_register(uint32_t (*now_us)(void));
+
+uint32_t bt_profile_now(void);
+void bt_profile_loop(void);
+void bt_profile_record(enum bt_profile_site site, const void *fn, uint32_t start);
+
+#define BT_PROFILE_CALL(_site, _fn, _call)                                                         \
+    do                                                                                             \
+    {                                                                                              \
+        uint32_t _profile_start = bt_profile_now();                                                \
+        _call;                                                                                     \
+        bt_profile_record(_site, (const void *)(_fn), _profile_start);                             \
+    } while (false)
+
+int bt_profile_summary_get(enum bt_profile_site site, struct bt_profile_summary *summary);
+
+/* Fills offenders, longest run first, returns how many */
+size_t bt_profile_offenders_get(struct bt_profile_offender *offenders, size_t max);
+
+/* Log the loop time distribution, every site and the offenders */
+void bt_profile_dump(void);
+
+void bt_profile_reset(void);
+#else
+#define BT_PROFILE_CALL(_site, _fn, _call)                                                         \
+    do                                                                                             \
+    {                                                                                              \
+        _call;                                                                                     \
+    } while (false)
+
+static inline void bt_profile_loop(void)
+{
+}
+#endif /* CONFIG_BT_PROFILE */
+
+#endif /* _ZEPHYR_POLLING_COMMON_BT_PROFILE_H_ */
@@ -16,12 +16,220 @@
 
 #include "bt_storage_kv.h"
 
+#if defined(CONFIG_BT_STORAGE_KV_CACHE)
+#include "common/work.h"
+#endif /* CONFIG_BT_STORAGE_KV_CACHE */
+
 #define BT_DBG_ENABLED  IS_ENABLED(CONFIG_BT_DEBUG_bt_storage_kv)
 #define LOG_MODULE_NAME bt_storage_kv
 #include "logging/bt_log.h"
 
 static const struct bt_storage_kv_impl *kv_obj;
 
+#if defined(CONFIG_BT_STORAGE_KV_CACHE)
+/* Write-back cache in front of the backend. Writes and deletes land in RAM
+ * and reach the backend in the order of the last write to each key, either
+ * when the flush timer expires, when the host is idle or on
+ * bt_storage_kv_sync(). Rewriting a pending key replaces its value and moves
+ * it behind the other pending keys, so the backend is only consistent once
+ * a flush has completed.
+ */
+enum
+{
+    KV_ENTRY_VALID = BIT(0),
+    KV_ENTRY_DIRTY = BIT(1),
+    KV_ENTRY_DELETED = BIT(2),
+};
+
+struct kv_entry
+{
+    uint16_t key;
+    uint16_t len;
+    uint8_t flags;
+    /* Order of the last write, dirty entries are flushed oldest first */
+    uint32_t seq;
+    uint8_t data[CONFIG_BT_STORAGE_KV_CACHE_DATA_MAX];
+};
+
+static struct kv_entry kv_entries[CONFIG_BT_STORAGE_KV_CACHE_ENTRIES];
+static uint32_t kv_seq;
+static uint8_t kv_dirty_cnt;
+static struct k_work_delayable kv_flush_work;
+static struct bt_storage_kv_stats kv_stats;
+
+static struct kv_entry *kv_entry_find(uint16_t key)
+{
+    for (int i = 0; i < ARRAY_SIZE(kv_entries); i++)
+    {
+        if ((kv_entries[i].flags & KV_ENTRY_VALID) && kv_entries[i].key == key)
+        {
+            return &kv_entries[i];
+        }
+    }
+
+    return NULL;
+}
+
+static struct kv_entry *kv_dirty_oldest(void)
+{
+    struct kv_entry *oldest = NULL;
+
+    for (int i = 0; i < ARRAY_SIZE(kv_entries); i++)
+    {
+        struct kv_entry *entry = &kv_entries[i];
+
+        if ((entry->flags & KV_ENTRY_DIRTY) && (!oldest || entry->seq < oldest->seq))
+        {
+            oldest = entry;
+        }
+    }
+
+    return oldest;
+}
+
+static void kv_entry_flush(struct kv_entry *entry)
+{
+    if (entry->flags & KV_ENTRY_DELETED)
+    {
+        (*kv_obj->delete)(entry->key, NULL, 0);
+        kv_stats.backend_delete++;
+    }
+    else
+    {
+        (*kv_obj->set)(entry->key, entry->data, entry->len);
+        kv_stats.backend_set++;
+    }
+
+    entry->flags &= ~KV_ENTRY_DIRTY;
+    kv_dirty_cnt--;
+}
+
+static void kv_flush_all(void)
+{
+    struct kv_entry *entry;
+
+    if (!kv_dirty_cnt)
+    {
+        return;
+    }
+
+    BT_DBG("flushing %u entries", kv_dirty_cnt);
+
+    k_work_cancel_delayable(&kv_flush_work);
+
+    while ((entry = kv_dirty_oldest()) != NULL)
+    {
+        kv_entry_flush(entry);
+    }
+
+    kv_stats.flush_count++;
+}
+
+static void kv_flush_handler(struct k_work *work)
+{
+    kv_flush_all();
+}
+
+static void kv_entry_drop(struct kv_entry *entry)
+{
+    if (entry->flags & KV_ENTRY_DIRTY)
+    {
+        kv_dirty_cnt--;
+    }
+
+    entry->flags = 0U;
+}
+
+static struct kv_entry *kv_entry_alloc(void)
+{
+    struct kv_entry *victim = NULL;
+
+    for (int i = 0; i < ARRAY_SIZE(kv_entries); i++)
+    {
+        struct kv_entry *entry = &kv_entries[i];
+
+        if (!(entry->flags & KV_ENTRY_VALID))
+        {
+            return entry;
+        }
+
+        /* Least recently written clean entry */
+        if (!(entry->flags & KV_ENTRY_DIRTY) && (!victim || entry->seq < victim->seq))
+        {
+            victim = entry;
+        }
+    }
+
+    if (!victim)
+    {
+        /* All entries pending, write them out to make room */
+        kv_flush_all();
+        return kv_entry_alloc();
+    }
+
+    kv_entry_drop(victim);
+
+    return victim;
+}
+
+static void kv_entry_update(uint16_t key, const uint8_t *data, uint16_t len, bool deleted)
+{
+    struct kv_entry *entry = kv_entry_find(key);
+    bool was_dirty = entry && (entry->flags & KV_ENTRY_DIRTY);
+
+    if (was_dirty)
+    {
+        /* Previous value never reached the backend */
+        kv_stats.merged++;
+    }
+
+    if (!entry)
+    {
+        entry = kv_entry_alloc();
+    }
+
+    entry->key = key;
+    entry->len = deleted ? 0U : len;
+    entry->flags = KV_ENTRY_VALID | KV_ENTRY_DIRTY | (deleted ? KV_ENTRY_DELETED : 0U);
+    entry->seq = ++kv_seq;
+    if (!deleted)
+    {
+        memcpy(entry->data, data, len);
+    }
+
+    if (was_dirty)
+    {
+        return;
+    }
+
+    /* The timer runs from the first pending write so that a steady
+     * stream of writes still reaches the backend in bounded time.
+     */
+    if (!kv_dirty_cnt++)
+    {
+        k_work_schedule(&kv_flush_work, K_MSEC(CONFIG_BT_STORAGE_KV_CACHE_FLUSH_MS));
+    }
+}
+
+void bt_storage_kv_sync(void)
+{
+    kv_flush_all();
+}
+
+uint8_t bt_storage_kv_check_allow_sleep(void)
+{
+    /* Host is idle, good time to write out pending data */
+    kv_flush_all();
+
+    return 1;
+}
+
+void bt_storage_kv_stats_get(struct bt_storage_kv_stats *stats)
+{
+    *stats = kv_stats;
+}
+#endif /* CONFIG_BT_STORAGE_KV_CACHE */
+
 void bt_storage_kv_init_list(struct bt_storage_kv_header *list, uint16_t list_cnt)
 {
     (*kv_obj->init_list)(list, list_cnt);
@@ -29,20 +237,82 @@ void bt_storage_kv_init_list(struct bt_storage_kv_header *list, uint16_t list_cn
 
 int bt_storage_kv_get(uint16_t key, uint8_t *data, uint16_t *len)
 {
+#if defined(CONFIG_BT_STORAGE_KV_CACHE)
+    struct kv_entry *entry = kv_entry_find(key);
+
+    if (entry)
+    {
+        if (entry->flags & KV_ENTRY_DELETED)
+        {
+            return -ENOENT;
+        }
+
+        if (data)
+        {
+            *len = MIN(*len, entry->len);
+            memcpy(data, entry->data, *len);
+        }
+        else
+        {
+            *len = entry->len;
+        }
+
+        return 0;
+    }
+#endif /* CONFIG_BT_STORAGE_KV_CACHE */
+
     return (*kv_obj->get)(key, data, len);
 }
 
 void bt_storage_kv_set(uint16_t key, uint8_t *data, uint16_t len)
 {
+#if defined(CONFIG_BT_STORAGE_KV_CACHE)
+    struct kv_entry *entry;
+
+    kv_stats.set_count++;
+
+    if (len <= CONFIG_BT_STORAGE_KV_CACHE_DATA_MAX)
+    {
+        kv_entry_update(key, data, len, false);
+        return;
+    }
+
+    /* Too large to cache: keep ordering with pending writes and write
+     * through, dropping any older cached value.
+     */
+    entry = kv_entry_find(key);
+    if (entry)
+    {
+        if (entry->flags & KV_ENTRY_DIRTY)
+        {
+            kv_stats.merged++;
+        }
+
+        kv_entry_drop(entry);
+    }
+
+    kv_flush_all();
+    kv_stats.backend_set++;
+#endif /* CONFIG_BT_STORAGE_KV_CACHE */
+
     (*kv_obj->set)(key, data, len);
 }
 
 void bt_storage_kv_delete(uint16_t key, uint8_t *data, uint16_t len)
 {
+#if defined(CONFIG_BT_STORAGE_KV_CACHE)
+    kv_stats.delete_count++;
+    kv_entry_update(key, NULL, 0U, true);
+#else
     (*kv_obj->delete)(key, data, len);
+#endif /* CONFIG_BT_STORAGE_KV_CACHE */
 }
 
 void bt_storage_kv_register(const struct bt_storage_kv_impl *impl)
 {
     kv_obj = impl;
+
+#if defined(CONFIG_BT_STORAGE_KV_CACHE)
+    k_work_init_delayable(&kv_flush_work, kv_flush_handler);
+#endif /* CONFIG_BT_STORAGE_KV_CACHE */
 }
@@ -16,9 +16,15 @@ enum bt_storage_kv_keys
 
     KEY_INDEX_LE_KEY_INFO_LIST = 0x0100,
     KEY_INDEX_LE_KEY_INFO_ITEM_BASE = 0x0110,
+
+    KEY_INDEX_LE_GATT_CACHE_ITEM_BASE = 0x0200,
+
+    KEY_INDEX_LE_KEY_RECORD_BASE = 0x0400,
 };
 
-#define KEY_INDEX_LE_KEY_INFO_ITEM(__x) (KEY_INDEX_LE_KEY_INFO_ITEM_BASE + (__x))
+#define KEY_INDEX_LE_KEY_INFO_ITEM(__x)   (KEY_INDEX_LE_KEY_INFO_ITEM_BASE + (__x))
+#define KEY_INDEX_LE_GATT_CACHE_ITEM(__x) (KEY_INDEX_LE_GATT_CACHE_ITEM_BASE + (__x))
+#define KEY_INDEX_LE_KEY_RECORD(__x)      (KEY_INDEX_LE_KEY_RECORD_BASE + (__x))
 
 struct bt_storage_kv_header
 {
@@ -43,6 +49,29 @@ void bt_storage_kv_set(uint16_t key, uint8_t *data, uint16_t len);
 void bt_storage_kv_delete(uint16_t key, uint8_t *data, uint16_t len);
 void bt_storage_kv_register(const struct bt_storage_kv_impl *impl);
 
+#if defined(CONFIG_BT_STORAGE_KV_CACHE)
+struct bt_storage_kv_stats
+{
+    /* Calls to bt_storage_kv_set() and bt_storage_kv_delete() */
+    uint32_t set_count;
+    uint32_t delete_count;
+    /* Operations that reached the backend */
+    uint32_t backend_set;
+    uint32_t backend_delete;
+    /* Pending writes replaced before reaching the backend */
+    uint32_t merged;
+    /* Flushes of pending writes */
+    uint32_t flush_count;
+};
+
+/* Write all pending data to the backend */
+void bt_storage_kv_sync(void);
+/* Flush pending data while the host is idle, always allows sleep */
+uint8_t bt_storage_kv_check_allow_sleep(void);
+/* Backend writes avoided: set_count + delete_count - backend_set - backend_delete */
+void bt_storage_kv_stats_get(struct bt_storage_kv_stats *stats);
+#endif /* CONFIG_BT_STORAGE_KV_CACHE */
+
 /**
  * Function used to read the data from the settings storage in
  * h_set handler implementations.
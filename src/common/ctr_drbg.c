@@ -0,0 +1,182 @@
+/* ctr_drbg.c - CTR_DRBG (NIST SP 800-90A) with AES-128 on the AES backend */
+
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <errno.h>
+#include <string.h>
+
+#include "ctr_drbg.h"
+
+static void block_inc(uint8_t v[AES_BLOCKLEN])
+{
+    int i;
+
+    for (i = AES_BLOCKLEN - 1; i >= 0; i--)
+    {
+        if (++v[i])
+        {
+            break;
+        }
+    }
+}
+
+static const struct bt_aes_sched *drbg_sched(struct bt_ctr_drbg *ctx)
+{
+    if (ctx->sched.backend != bt_aes_backend_get())
+    {
+        bt_aes_expand(&ctx->sched, ctx->key);
+    }
+
+    return &ctx->sched;
+}
+
+/* CTR_DRBG_Update, SP 800-90A 10.2.1.2 */
+static void drbg_update(struct bt_ctr_drbg *ctx, const uint8_t *data)
+{
+    const struct bt_aes_sched *sched = drbg_sched(ctx);
+    uint8_t temp[BT_CTR_DRBG_SEED_LEN];
+    uint8_t i;
+
+    block_inc(ctx->v);
+    bt_aes_encrypt(sched, ctx->v, temp);
+    block_inc(ctx->v);
+    bt_aes_encrypt(sched, ctx->v, temp + AES_BLOCKLEN);
+
+    if (data)
+    {
+        for (i = 0U; i < BT_CTR_DRBG_SEED_LEN; i++)
+        {
+            temp[i] ^= data[i];
+        }
+    }
+
+    memcpy(ctx->key, temp, AES_KEYLEN);
+    memcpy(ctx->v, temp + AES_KEYLEN, AES_BLOCKLEN);
+    bt_aes_expand(&ctx->sched, ctx->key);
+
+    memset(temp, 0, sizeof(temp));
+}
+
+int bt_ctr_drbg_instantiate(struct bt_ctr_drbg *ctx, const uint8_t *entropy, const uint8_t *pers,
+                            size_t pers_len)
+{
+    uint8_t seed[BT_CTR_DRBG_SEED_LEN];
+    size_t i;
+
+    if (!ctx || !entropy || pers_len > BT_CTR_DRBG_SEED_LEN || (pers_len && !pers))
+    {
+        return -EINVAL;
+    }
+
+    memcpy(seed, entropy, sizeof(seed));
+    for (i = 0; i < pers_len; i++)
+    {
+        seed[i] ^= pers[i];
+    }
+
+    memset(ctx, 0, sizeof(*ctx));
+    bt_aes_expand(&ctx->sched, ctx->key);
+    drbg_update(ctx, seed);
+    ctx->reseed_counter = 1U;
+    ctx->seeded = true;
+
+    memset(seed, 0, sizeof(seed));
+
+    return 0;
+}
+
+int bt_ctr_drbg_reseed(struct bt_ctr_drbg *ctx, const uint8_t *entropy)
+{
+    if (!ctx || !ctx->seeded || !entropy)
+    {
+        return -EINVAL;
+    }
+
+    drbg_update(ctx, entropy);
+    ctx->reseed_counter = 1U;
+
+    return 0;
+}
+
+int bt_ctr_drbg_generate(struct bt_ctr_drbg *ctx, uint8_t *out, size_t len)
+{
+    const struct bt_aes_sched *sched;
+    uint8_t block[AES_BLOCKLEN];
+    size_t n;
+
+    if (!ctx || !ctx->seeded || (!out && len) || len > BT_CTR_DRBG_MAX_REQUEST)
+    {
+        return -EINVAL;
+    }
+
+    sched = drbg_sched(ctx);
+
+    while (len)
+    {
+        block_inc(ctx->v);
+        bt_aes_encrypt(sched, ctx->v, block);
+
+        n = len < AES_BLOCKLEN ? len : AES_BLOCKLEN;
+        memcpy(out, block, n);
+        out += n;
+        len -= n;
+    }
+
+    /* Backtracking resistance */
+    drbg_update(ctx, NULL);
+    ctx->reseed_counter++;
+
+    memset(block, 0, sizeof(block));
+
+    return 0;
+}
+
+void bt_ctr_drbg_uninstantiate(struct bt_ctr_drbg *ctx)
+{
+    memset(ctx, 0, sizeof(*ctx));
+}
+
+int bt_ctr_drbg_self_test(void)
+{
+    /* Checked against an independent implementation on OpenSSL AES-128 */
+    static const uint8_t entropy[BT_CTR_DRBG_SEED_LEN] = {
+            0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0a,
+            0x0b, 0x0c, 0x0d, 0x0e, 0x0f, 0x10, 0x11, 0x12, 0x13, 0x14, 0x15,
+            0x16, 0x17, 0x18, 0x19, 0x1a, 0x1b, 0x1c, 0x1d, 0x1e, 0x1f};
+    static const uint8_t reseed[BT_CTR_DRBG_SEED_LEN] = {
+            0x80, 0x81, 0x82, 0x83, 0x84, 0x85, 0x86, 0x87, 0x88, 0x89, 0x8a,
+            0x8b, 0x8c, 0x8d, 0x8e, 0x8f, 0x90, 0x91, 0x92, 0x93, 0x94, 0x95,
+            0x96, 0x97, 0x98, 0x99, 0x9a, 0x9b, 0x9c, 0x9d, 0x9e, 0x9f};
+    static const uint8_t expected[32] = {
+            0x4a, 0x8d, 0x87, 0xf4, 0xde, 0x07, 0x68, 0xbc, 0x96, 0xeb, 0x19,
+            0x55, 0xc4, 0xed, 0x61, 0xf6, 0xe3, 0x0e, 0x28, 0x99, 0x58, 0x7a,
+            0x5d, 0xd7, 0x98, 0x5e, 0x28, 0x48, 0x63, 0x2b, 0x69, 0x26};
+    struct bt_ctr_drbg ctx;
+    uint8_t out[32];
+    int err;
+
+    err = bt_ctr_drbg_instantiate(&ctx, entropy, NULL, 0);
+    if (!err)
+    {
+        err = bt_ctr_drbg_generate(&ctx, out, sizeof(out));
+    }
+    if (!err)
+    {
+        err = bt_ctr_drbg_reseed(&ctx, reseed);
+    }
+    if (!err)
+    {
+        err = bt_ctr_drbg_generate(&ctx, out, sizeof(out));
+    }
+
+    bt_ctr_drbg_uninstantiate(&ctx);
+
+    if (err || memcmp(out, expected, sizeof(out)))
+    {
+        return -EIO;
+    }
+
+    return 0;
+}
@@ -0,0 +1,76 @@
+/* ctr_drbg.h - CTR_DRBG (NIST SP 800-90A) with AES-128 on the AES backend */
+
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef _ZEPHYR_POLLING_COMMON_CTR_DRBG_H_
+#define _ZEPHYR_POLLING_COMMON_CTR_DRBG_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "aes_backend.h"
+
+/* Key plus block length, the amount of entropy taken on (re)seed since no
+ * derivation function is used.
+ */
+#define BT_CTR_DRBG_SEED_LEN 32
+
+/* Largest request, SP 800-90A Table 3 allows 2^19 bits for AES */
+#define BT_CTR_DRBG_MAX_REQUEST 65536
+
+struct bt_ctr_drbg
+{
+    /* Key, kept to expand again if the AES backend changes */
+    uint8_t key[AES_KEYLEN];
+    struct bt_aes_sched sched;
+    uint8_t v[AES_BLOCKLEN];
+    /* Generate requests since the last (re)seed */
+    uint32_t reseed_counter;
+    bool seeded;
+};
+
+/** @brief Instantiate from full entropy input.
+ *
+ *  @param ctx     DRBG state.
+ *  @param entropy BT_CTR_DRBG_SEED_LEN bytes of entropy.
+ *  @param pers    Optional personalization string, up to
+ *                 BT_CTR_DRBG_SEED_LEN bytes.
+ *  @param pers_len Length of @p pers.
+ *
+ *  @return 0 on success or negative error value on failure.
+ */
+int bt_ctr_drbg_instantiate(struct bt_ctr_drbg *ctx, const uint8_t *entropy, const uint8_t *pers,
+                            size_t pers_len);
+
+/** @brief Mix in fresh entropy and reset the reseed counter.
+ *
+ *  @param ctx     DRBG state.
+ *  @param entropy BT_CTR_DRBG_SEED_LEN bytes of entropy.
+ *
+ *  @return 0 on success or negative error value on failure.
+ */
+int bt_ctr_drbg_reseed(struct bt_ctr_drbg *ctx, const uint8_t *entropy);
+
+/** @brief Generate random bytes.
+ *
+ *  @param ctx DRBG state.
+ *  @param out Output buffer.
+ *  @param len Number of bytes, at most BT_CTR_DRBG_MAX_REQUEST.
+ *
+ *  @return 0 on success, -EINVAL if not instantiated or too long.
+ */
+int bt_ctr_drbg_generate(struct bt_ctr_drbg *ctx, uint8_t *out, size_t len);
+
+/** @brief Wipe the state. */
+void bt_ctr_drbg_uninstantiate(struct bt_ctr_drbg *ctx);
+
+/** @brief Known answer test of instantiate, reseed and generate.
+ *
+ *  @return 0 on success, -EIO on mismatch.
+ */
+int bt_ctr_drbg_self_test(void);
+
+#endif /* _ZEPHYR_POLLING_COMMON_CTR_DRBG_H_ */
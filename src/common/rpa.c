@@ -16,12 +16,16 @@
 
 #include "bt_config.h"
 
+#include "base/byteorder.h"
+
 #define BT_DBG_ENABLED  IS_ENABLED(CONFIG_BT_DEBUG_RPA)
 #define LOG_MODULE_NAME bt_rpa
 #include "logging/bt_log.h"
 
 #include <bluetooth/crypto.h>
 
+#include "aes_backend.h"
+
 #if defined(CONFIG_BT_CTLR) && defined(CONFIG_BT_HOST_CRYPTO)
 #include "../controller/hal/ecb.h"
 #include "../controller/util/util.h"
@@ -42,7 +46,27 @@ static int internal_rand(void *buf, size_t len)
 static int internal_encrypt_le(const uint8_t key[16], const uint8_t plaintext[16],
                                uint8_t enc_data[16])
 {
-    return bt_encrypt_le(key, plaintext, enc_data);
+    const struct bt_aes_sched *sched;
+    struct bt_aes_sched tmp;
+    uint8_t key_be[16];
+    uint8_t block[16];
+
+    /* Only IRKs get here, they are long lived and may stay in the key cache
+     * unlike the SMP keys going through bt_encrypt_le().
+     */
+    sys_memcpy_swap(key_be, key, 16);
+    sys_memcpy_swap(block, plaintext, 16);
+
+    sched = bt_aes_sched_get(key_be, &tmp);
+    bt_aes_encrypt(sched, block, block);
+
+    sys_memcpy_swap(enc_data, block, 16);
+
+    (void)memset(&tmp, 0, sizeof(tmp));
+    (void)memset(key_be, 0, sizeof(key_be));
+    (void)memset(block, 0, sizeof(block));
+
+    return 0;
 }
 
 __unused
@@ -91,6 +115,42 @@ bool bt_rpa_irk_matches(const uint8_t irk[16], const bt_addr_t *addr)
 
     return !memcmp(addr->val, hash, 3);
 }
+
+int bt_rpa_resolve(const struct bt_aes_sched *const irks[], size_t count, const bt_addr_t *addr)
+{
+    uint8_t r[16];
+    uint8_t res[16];
+    size_t i;
+
+    BT_DBG("bdaddr %s count %u", bt_addr_str(addr), (unsigned int)count);
+
+    /* r' = padding || r, in AES byte order */
+    (void)memset(r, 0, 13);
+    sys_memcpy_swap(&r[13], addr->val + 3, 3);
+
+    for (i = 0; i < count; i++)
+    {
+        if (!irks[i])
+        {
+            continue;
+        }
+
+        bt_aes_encrypt(irks[i], r, res);
+
+        /* ah() keeps the least significant 24 bits, i.e. the last three
+         * bytes in AES byte order.
+         */
+        if (res[15] == addr->val[0] && res[14] == addr->val[1] && res[13] == addr->val[2])
+        {
+            (void)memset(res, 0, sizeof(res));
+            return (int)i;
+        }
+    }
+
+    (void)memset(res, 0, sizeof(res));
+
+    return -ENOENT;
+}
 #endif
 
 #if defined(CONFIG_BT_PRIVACY) || defined(CONFIG_BT_CTLR_PRIVACY)
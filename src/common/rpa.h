@@ -16,7 +16,23 @@
 
 #include <bluetooth/addr.h>
 
+struct bt_aes_sched;
+
 bool bt_rpa_irk_matches(const uint8_t irk[16], const bt_addr_t *addr);
+
+/** @brief Resolve an RPA against a list of IRKs.
+ *
+ *  The plaintext is prepared once and every IRK costs a single AES block,
+ *  the IRKs are given as schedules expanded from the IRK in AES (big
+ *  endian) byte order.
+ *
+ *  @param irks  Expanded IRKs, NULL entries are skipped.
+ *  @param count Number of entries in @p irks.
+ *  @param addr  Resolvable Private Address.
+ *
+ *  @return Index of the first matching IRK or -ENOENT.
+ */
+int bt_rpa_resolve(const struct bt_aes_sched *const irks[], size_t count, const bt_addr_t *addr);
 int bt_rpa_create(const uint8_t irk[16], bt_addr_t *rpa);
 
 #endif /* _ZEPHYR_POLLING_COMMON_RPA_H_ */
\ No newline at end of file
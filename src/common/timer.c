@@ -7,6 +7,7 @@
 #include "base/util.h"
 
 #include "timer.h"
+#include "bt_profile.h"
 #include "utils/slist.h"
 
 #define BT_DBG_ENABLED  IS_ENABLED(CONFIG_BT_DEBUG_TIMER)
@@ -36,7 +37,7 @@ void z_timer_expiration_handler(struct _timeout *t)
     /* invoke timer expiry function */
     if (timer->expiry_fn != NULL)
     {
-        timer->expiry_fn(timer);
+        BT_PROFILE_CALL(BT_PROFILE_TIMEOUT_CB, timer->expiry_fn, timer->expiry_fn(timer));
     }
 }
 
@@ -4,6 +4,7 @@
  * SPDX-License-Identifier: Apache-2.0
  */
 #include "work.h"
+#include "bt_profile.h"
 
 /**
  * @brief Handle expiration of a kernel timer object.
@@ -17,6 +18,6 @@ void z_work_expiration_handler(struct _timeout *t)
     /* invoke timer expiry function */
     if (work->handler != NULL)
     {
-        work->handler(work);
+        BT_PROFILE_CALL(BT_PROFILE_TIMEOUT_CB, work->handler, work->handler(work));
     }
 }
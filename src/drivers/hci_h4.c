@@ -14,6 +14,7 @@
 
 #include "base/byteorder.h"
 #include "base/util.h"
+#include "common/bt_buf.h"
 #include "common/timeout.h"
 #include <bluetooth/bluetooth.h>
 #include <bluetooth/hci.h>
@@ -142,6 +143,15 @@ static inline void get_iso_hdr(void)
     }
 }
 
+static void reset_rx(void)
+{
+    rx.type = H4_NONE;
+    rx.remaining = 0U;
+    rx.have_hdr = false;
+    rx.hdr_len = 0U;
+    rx.discardable = false;
+}
+
 static inline void get_evt_hdr(void)
 {
     struct bt_hci_evt_hdr *hdr = &rx.evt;
@@ -168,7 +178,9 @@ static inline void get_evt_hdr(void)
     if (!rx.remaining)
     {
         if (rx.evt.evt == BT_HCI_EVT_LE_META_EVENT &&
-            (rx.hdr[sizeof(*hdr)] == BT_HCI_EVT_LE_ADVERTISING_REPORT))
+            (rx.hdr[sizeof(*hdr)] == BT_HCI_EVT_LE_ADVERTISING_REPORT ||
+             rx.hdr[sizeof(*hdr)] == BT_HCI_EVT_LE_EXT_ADVERTISING_REPORT ||
+             rx.hdr[sizeof(*hdr)] == BT_HCI_EVT_LE_DIRECT_ADV_REPORT))
         {
             BT_DBG("Marking adv report as discardable");
             rx.discardable = true;
@@ -176,6 +188,15 @@ static inline void get_evt_hdr(void)
 
         rx.remaining = hdr->len - (rx.hdr_len - sizeof(*hdr));
         BT_DBG("Got event header. Payload %u bytes", hdr->len);
+
+        /* Shed before any buffer is touched, the payload is skipped */
+        if (!bt_buf_evt_admit(rx.discardable))
+        {
+            rx.discard = rx.remaining;
+            reset_rx();
+            return;
+        }
+
         rx.have_hdr = true;
     }
 }
@@ -185,15 +206,6 @@ static inline void copy_hdr(struct net_buf *buf)
     net_buf_add_mem(buf, rx.hdr, rx.hdr_len);
 }
 
-static void reset_rx(void)
-{
-    rx.type = H4_NONE;
-    rx.remaining = 0U;
-    rx.have_hdr = false;
-    rx.hdr_len = 0U;
-    rx.discardable = false;
-}
-
 static struct net_buf *get_rx(void)
 {
     BT_DBG("type 0x%02x, evt 0x%02x", rx.type, rx.evt.evt);
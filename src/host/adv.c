@@ -364,7 +364,7 @@ int bt_le_adv_set_enable_legacy(struct bt_le_ext_adv *adv, bool enable)
         return err;
     }
 
-    atomic_set_bit(adv->flags, BT_ADV_ENABLED);
+    atomic_set_bit_to(adv->flags, BT_ADV_ENABLED, enable);
 
     return 0;
 }
@@ -567,7 +567,159 @@ static int set_data_add_complete(uint8_t *set_data, uint8_t set_data_len_max,
     return 0;
 }
 
-static int hci_set_ad(uint16_t hci_op, const struct bt_ad *ad, size_t ad_len)
+#if defined(CONFIG_BT_ADV_DATA_CACHE)
+static struct bt_le_adv_data_stats adv_data_stats;
+
+static struct bt_adv_data_cache *adv_data_cache(struct bt_le_ext_adv *adv, uint16_t hci_op)
+{
+    if (hci_op == BT_HCI_OP_LE_SET_SCAN_RSP_DATA || hci_op == BT_HCI_OP_LE_SET_EXT_SCAN_RSP_DATA)
+    {
+        return &adv->sd_cache;
+    }
+
+    return &adv->ad_cache;
+}
+
+/* True if the controller already holds this data, otherwise remember it
+ * as the data about to be sent.
+ */
+static bool adv_data_cache_check(struct bt_le_ext_adv *adv, uint16_t hci_op, const uint8_t *data,
+                                 size_t len)
+{
+    struct bt_adv_data_cache *cache = adv_data_cache(adv, hci_op);
+
+    if (cache->valid && cache->len == len && !memcmp(cache->data, data, len))
+    {
+        adv_data_stats.skipped++;
+        return true;
+    }
+
+    cache->valid = len <= sizeof(cache->data);
+    if (cache->valid)
+    {
+        cache->len = len;
+        memcpy(cache->data, data, len);
+    }
+
+    return false;
+}
+
+/* Compare data sent in fragments, it is not flattened in one buffer */
+static bool adv_data_cache_check_stream(struct bt_le_ext_adv *adv, uint16_t hci_op,
+                                        const struct bt_ad *ad, size_t ad_len, size_t len)
+{
+    struct bt_adv_data_cache *cache = adv_data_cache(adv, hci_op);
+    struct ad_stream stream;
+    uint8_t chunk[32];
+    uint16_t offset = 0U;
+    uint8_t read_len;
+
+    if (!cache->valid || cache->len != len || ad_stream_new(&stream, ad, ad_len))
+    {
+        return false;
+    }
+
+    while (!ad_stream_is_empty(&stream))
+    {
+        read_len = ad_stream_read(&stream, chunk, sizeof(chunk));
+        if (memcmp(&cache->data[offset], chunk, read_len))
+        {
+            return false;
+        }
+
+        offset += read_len;
+    }
+
+    adv_data_stats.skipped += ceiling_fraction(len, BT_HCI_LE_EXT_ADV_FRAG_MAX_LEN);
+
+    return true;
+}
+
+/* Remember data once all of its fragments were sent */
+static void adv_data_cache_store_stream(struct bt_le_ext_adv *adv, uint16_t hci_op,
+                                        const struct bt_ad *ad, size_t ad_len, size_t len)
+{
+    struct bt_adv_data_cache *cache = adv_data_cache(adv, hci_op);
+    struct ad_stream stream;
+
+    cache->valid = false;
+
+    if (len > sizeof(cache->data) || ad_stream_new(&stream, ad, ad_len))
+    {
+        return;
+    }
+
+    cache->len = 0U;
+    while (!ad_stream_is_empty(&stream))
+    {
+        cache->len += ad_stream_read(&stream, &cache->data[cache->len],
+                                     MIN(len - cache->len, UINT8_MAX));
+    }
+
+    cache->valid = true;
+}
+
+static void adv_data_cache_invalidate(struct bt_le_ext_adv *adv, uint16_t hci_op)
+{
+    adv_data_cache(adv, hci_op)->valid = false;
+}
+
+static void adv_data_cache_clear(struct bt_le_ext_adv *adv, void *data)
+{
+    adv->ad_cache.valid = false;
+    adv->sd_cache.valid = false;
+}
+
+void bt_le_adv_data_cmd_complete(struct net_buf *buf)
+{
+    struct bt_hci_evt_cc_status *rp = (void *)buf->data;
+
+    if (!rp->status)
+    {
+        return;
+    }
+
+    /* The failed set is not known from the response, forget all */
+    BT_WARN("Advertising data rejected (0x%02x)", rp->status);
+    bt_le_ext_adv_foreach(adv_data_cache_clear, NULL);
+}
+
+void bt_le_adv_data_stats_get(struct bt_le_adv_data_stats *stats)
+{
+    *stats = adv_data_stats;
+}
+#else
+static inline bool adv_data_cache_check(struct bt_le_ext_adv *adv, uint16_t hci_op,
+                                        const uint8_t *data, size_t len)
+{
+    return false;
+}
+
+static inline bool adv_data_cache_check_stream(struct bt_le_ext_adv *adv, uint16_t hci_op,
+                                               const struct bt_ad *ad, size_t ad_len, size_t len)
+{
+    return false;
+}
+
+static inline void adv_data_cache_store_stream(struct bt_le_ext_adv *adv, uint16_t hci_op,
+                                               const struct bt_ad *ad, size_t ad_len, size_t len)
+{
+}
+
+static inline void adv_data_cache_invalidate(struct bt_le_ext_adv *adv, uint16_t hci_op)
+{
+}
+#endif /* CONFIG_BT_ADV_DATA_CACHE */
+
+static void adv_data_sent(void)
+{
+#if defined(CONFIG_BT_ADV_DATA_CACHE)
+    adv_data_stats.sent++;
+#endif /* CONFIG_BT_ADV_DATA_CACHE */
+}
+
+static int hci_set_ad(struct bt_le_ext_adv *adv, uint16_t hci_op, const struct bt_ad *ad,
+                      size_t ad_len)
 {
     struct bt_hci_cp_le_set_adv_data *set_data;
     struct net_buf *buf;
@@ -590,7 +742,21 @@ static int hci_set_ad(uint16_t hci_op, const struct bt_ad *ad, size_t ad_len)
         return err;
     }
 
-    return bt_hci_cmd_send(hci_op, buf);
+    if (adv_data_cache_check(adv, hci_op, set_data->data, set_data->len))
+    {
+        net_buf_unref(buf);
+        return 0;
+    }
+
+    adv_data_sent();
+
+    err = bt_hci_cmd_send(hci_op, buf);
+    if (err)
+    {
+        adv_data_cache_invalidate(adv, hci_op);
+    }
+
+    return err;
 }
 
 static int hci_set_adv_ext_complete(struct bt_le_ext_adv *adv, uint16_t hci_op,
@@ -626,11 +792,25 @@ static int hci_set_adv_ext_complete(struct bt_le_ext_adv *adv, uint16_t hci_op,
         return err;
     }
 
+    if (adv_data_cache_check(adv, hci_op, set_data->data, set_data->len))
+    {
+        net_buf_unref(buf);
+        return 0;
+    }
+
     set_data->handle = adv->handle;
     set_data->op = BT_HCI_LE_EXT_ADV_OP_COMPLETE_DATA;
     set_data->frag_pref = BT_HCI_LE_EXT_ADV_FRAG_DISABLED;
 
-    return bt_hci_cmd_send_sync(hci_op, buf, NULL);
+    adv_data_sent();
+
+    err = bt_hci_cmd_send_sync(hci_op, buf, NULL);
+    if (err)
+    {
+        adv_data_cache_invalidate(adv, hci_op);
+    }
+
+    return err;
 }
 
 static int hci_set_adv_ext_fragmented(struct bt_le_ext_adv *adv, uint16_t hci_op,
@@ -639,6 +819,7 @@ static int hci_set_adv_ext_fragmented(struct bt_le_ext_adv *adv, uint16_t hci_op
     int err;
     struct ad_stream stream;
     bool is_first_iteration = true;
+    size_t total_len;
 
     err = ad_stream_new(&stream, ad, ad_len);
     if (err)
@@ -646,6 +827,10 @@ static int hci_set_adv_ext_fragmented(struct bt_le_ext_adv *adv, uint16_t hci_op
         return err;
     }
 
+    /* Unknown until the last fragment went out */
+    total_len = stream.remaining_size;
+    adv_data_cache_invalidate(adv, hci_op);
+
     while (!ad_stream_is_empty(&stream))
     {
         struct bt_hci_cp_le_set_ext_adv_data *set_data;
@@ -683,6 +868,8 @@ static int hci_set_adv_ext_fragmented(struct bt_le_ext_adv *adv, uint16_t hci_op
             set_data->op = BT_HCI_LE_EXT_ADV_OP_INTERM_FRAG;
         }
 
+        adv_data_sent();
+
         err = bt_hci_cmd_send_sync(hci_op, buf, NULL);
         if (err)
         {
@@ -692,6 +879,8 @@ static int hci_set_adv_ext_fragmented(struct bt_le_ext_adv *adv, uint16_t hci_op
         is_first_iteration = false;
     }
 
+    adv_data_cache_store_stream(adv, hci_op, ad, ad_len, total_len);
+
     return 0;
 }
 
@@ -708,6 +897,15 @@ static int hci_set_ad_ext(struct bt_le_ext_adv *adv, uint16_t hci_op, const stru
         }
     }
 
+    /* Fragments cannot be replaced one by one, the first fragment
+     * discards what the controller had. So either all are sent or none.
+     */
+    if ((total_len_bytes > BT_HCI_LE_EXT_ADV_FRAG_MAX_LEN) &&
+        adv_data_cache_check_stream(adv, hci_op, ad, ad_len, total_len_bytes))
+    {
+        return 0;
+    }
+
     if ((total_len_bytes > BT_HCI_LE_EXT_ADV_FRAG_MAX_LEN) &&
         atomic_test_bit(adv->flags, BT_ADV_ENABLED))
     {
@@ -739,7 +937,7 @@ static int set_ad(struct bt_le_ext_adv *adv, const struct bt_ad *ad, size_t ad_l
         return hci_set_ad_ext(adv, BT_HCI_OP_LE_SET_EXT_ADV_DATA, ad, ad_len);
     }
 
-    return hci_set_ad(BT_HCI_OP_LE_SET_ADV_DATA, ad, ad_len);
+    return hci_set_ad(adv, BT_HCI_OP_LE_SET_ADV_DATA, ad, ad_len);
 }
 
 static int set_sd(struct bt_le_ext_adv *adv, const struct bt_ad *sd, size_t sd_len)
@@ -749,7 +947,7 @@ static int set_sd(struct bt_le_ext_adv *adv, const struct bt_ad *sd, size_t sd_l
         return hci_set_ad_ext(adv, BT_HCI_OP_LE_SET_EXT_SCAN_RSP_DATA, sd, sd_len);
     }
 
-    return hci_set_ad(BT_HCI_OP_LE_SET_SCAN_RSP_DATA, sd, sd_len);
+    return hci_set_ad(adv, BT_HCI_OP_LE_SET_SCAN_RSP_DATA, sd, sd_len);
 }
 
 #if defined(CONFIG_BT_PER_ADV)
@@ -1842,6 +2040,43 @@ int bt_le_ext_adv_set_data(struct bt_le_ext_adv *adv, const struct bt_data *ad,
     return le_adv_update(adv, ad, ad_len, sd, sd_len, ext_adv, scannable, get_adv_name_type(adv));
 }
 
+int bt_le_ext_adv_update_did(struct bt_le_ext_adv *adv)
+{
+    struct bt_hci_cp_le_set_ext_adv_data *set_data;
+    struct net_buf *buf;
+
+    if (!IS_ENABLED(CONFIG_BT_EXT_ADV) || !BT_DEV_FEAT_LE_EXT_ADV(bt_dev.le.features) ||
+        !atomic_test_bit(adv->flags, BT_ADV_EXT_ADV))
+    {
+        return -ENOTSUP;
+    }
+
+    /* Only allowed while advertising */
+    if (!atomic_test_bit(adv->flags, BT_ADV_ENABLED))
+    {
+        return -EAGAIN;
+    }
+
+    buf = bt_hci_cmd_create(BT_HCI_OP_LE_SET_EXT_ADV_DATA, sizeof(*set_data));
+    if (!buf)
+    {
+        return -ENOBUFS;
+    }
+
+    set_data = net_buf_add(buf, sizeof(*set_data));
+    (void)memset(set_data, 0, sizeof(*set_data));
+
+    set_data->handle = adv->handle;
+    set_data->op = BT_HCI_LE_EXT_ADV_OP_UNCHANGED_DATA;
+    set_data->frag_pref = BT_HCI_LE_EXT_ADV_FRAG_DISABLED;
+
+#if defined(CONFIG_BT_ADV_DATA_CACHE)
+    adv_data_stats.did_updates++;
+#endif /* CONFIG_BT_ADV_DATA_CACHE */
+
+    return bt_hci_cmd_send_sync(BT_HCI_OP_LE_SET_EXT_ADV_DATA, buf, NULL);
+}
+
 int bt_le_ext_adv_delete(struct bt_le_ext_adv *adv)
 {
     struct bt_hci_cp_le_remove_adv_set *cp;
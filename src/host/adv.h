@@ -24,4 +24,8 @@ int bt_le_adv_set_enable_ext(struct bt_le_ext_adv *adv, bool enable,
 int bt_le_adv_set_enable_legacy(struct bt_le_ext_adv *adv, bool enable);
 int bt_le_lim_adv_cancel_timeout(struct bt_le_ext_adv *adv);
 
+#if defined(CONFIG_BT_ADV_DATA_CACHE)
+void bt_le_adv_data_cmd_complete(struct net_buf *buf);
+#endif /* CONFIG_BT_ADV_DATA_CACHE */
+
 #endif /* _ZEPHYR_POLLING_HOST_ADV_H_ */
\ No newline at end of file
@@ -0,0 +1,384 @@
+/* adv_sched.c - Time multiplexed advertising of several payloads */
+
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <errno.h>
+#include <string.h>
+
+#include "bt_config.h"
+
+#include "base/types.h"
+#include "base/common.h"
+#include "base/sys_clock.h"
+
+#include <bluetooth/bluetooth.h>
+
+#include "common/work.h"
+
+#define BT_DBG_ENABLED  IS_ENABLED(CONFIG_BT_DEBUG_HCI_CORE)
+#define LOG_MODULE_NAME bt_adv_sched
+#include "logging/bt_log.h"
+
+#if defined(CONFIG_BT_ADV_SCHED)
+
+#define SCHED_MAX CONFIG_BT_ADV_SCHED_MAX
+
+/* One logical advertiser. The controller has a single legacy advertising
+ * set, advertisers take turns on it for their dwell time whenever their
+ * period is due, the most important and then the most late first.
+ */
+struct sched_adv
+{
+    bool used;
+    struct bt_le_adv_param param;
+    const struct bt_data *ad;
+    size_t ad_len;
+    const struct bt_data *sd;
+    size_t sd_len;
+    uint32_t period_ms;
+    uint16_t dwell_ms;
+    uint8_t priority;
+
+    /* Next time it wants to be on air */
+    uint32_t due;
+    uint32_t added;
+    uint32_t last_start;
+    uint32_t airings;
+    uint32_t interval_sum;
+    uint32_t interval_max;
+    uint32_t on_air;
+    /* How it was put on air, see sched_air() */
+    uint32_t data_switches;
+    uint32_t restarts;
+};
+
+static struct
+{
+    bool running;
+    struct sched_adv *cur;
+    /* When cur went on air, and when it may be replaced */
+    uint32_t since;
+    uint32_t until;
+    struct sched_adv advs[SCHED_MAX];
+    struct k_work_delayable work;
+} sched;
+
+static uint32_t sched_now(void)
+{
+    return k_ticks_to_ms_floor32(sys_clock_tick_get());
+}
+
+/* Only the fields the controller sees, the structure has padding */
+static bool sched_param_equal(const struct bt_le_adv_param *a, const struct bt_le_adv_param *b)
+{
+    return a->id == b->id && a->sid == b->sid && a->options == b->options &&
+           a->interval_min == b->interval_min && a->interval_max == b->interval_max;
+}
+
+static void sched_off_air(uint32_t now)
+{
+    if (sched.cur)
+    {
+        sched.cur->on_air += now - sched.since;
+    }
+}
+
+/* Put the next advertiser on the set. With the same parameters only new
+ * data is sent, the controller switches at its next advertising event.
+ * Otherwise stop, parameters, data and start are queued back to back.
+ */
+static int sched_air(struct sched_adv *next, uint32_t now)
+{
+    int err = -EINVAL;
+
+    if (sched.cur && sched_param_equal(&sched.cur->param, &next->param))
+    {
+        err = bt_le_adv_update_data(next->ad, next->ad_len, next->sd, next->sd_len);
+        if (!err)
+        {
+            next->data_switches++;
+        }
+    }
+
+    if (err)
+    {
+        if (sched.cur)
+        {
+            (void)bt_le_adv_stop();
+        }
+
+        err = bt_le_adv_start(&next->param, next->ad, next->ad_len, next->sd, next->sd_len);
+        if (err)
+        {
+            BT_WARN("Advertiser %u not started (err %d)", (uint8_t)(next - sched.advs), err);
+            sched.cur = NULL;
+            /* Retry after a dwell time instead of spinning */
+            next->due = now + next->dwell_ms;
+            return err;
+        }
+
+        next->restarts++;
+    }
+
+    if (next->airings)
+    {
+        next->interval_sum += now - next->last_start;
+        next->interval_max = MAX(next->interval_max, now - next->last_start);
+    }
+
+    next->airings++;
+    next->last_start = now;
+    next->due = now + next->period_ms;
+
+    sched.cur = next;
+    sched.since = now;
+    sched.until = now + next->dwell_ms;
+
+    return 0;
+}
+
+/* Due advertiser with the highest priority, the latest one among equals */
+static struct sched_adv *sched_pick(uint32_t now)
+{
+    struct sched_adv *best = NULL;
+    struct sched_adv *adv;
+    uint8_t i;
+
+    for (i = 0U; i < SCHED_MAX; i++)
+    {
+        adv = &sched.advs[i];
+
+        if (!adv->used || (int32_t)(now - adv->due) < 0)
+        {
+            continue;
+        }
+
+        if (!best || adv->priority > best->priority ||
+            (adv->priority == best->priority && (int32_t)(best->due - adv->due) > 0))
+        {
+            best = adv;
+        }
+    }
+
+    return best;
+}
+
+static uint32_t sched_next_due(uint32_t now)
+{
+    uint32_t next = UINT32_MAX;
+    uint8_t i;
+
+    for (i = 0U; i < SCHED_MAX; i++)
+    {
+        if (sched.advs[i].used)
+        {
+            next = MIN(next, MAX((int32_t)(sched.advs[i].due - now), 0));
+        }
+    }
+
+    return next;
+}
+
+static void sched_run(struct k_work *work)
+{
+    struct sched_adv *next;
+    uint32_t now = sched_now();
+    uint32_t delay;
+
+    if (!sched.running)
+    {
+        return;
+    }
+
+    if (sched.cur && !sched.cur->used)
+    {
+        /* Removed while on air */
+        sched.cur = NULL;
+        (void)bt_le_adv_stop();
+    }
+
+    if (!sched.cur || (int32_t)(now - sched.until) >= 0)
+    {
+        next = sched_pick(now);
+        if (next && next != sched.cur)
+        {
+            sched_off_air(now);
+            (void)sched_air(next, now);
+        }
+        else if (next)
+        {
+            /* Alone and due again, keeps the set as it is */
+            next->due = now + next->period_ms;
+            sched.until = now + next->dwell_ms;
+        }
+    }
+
+    /* Stay on air past the dwell time until someone else is due */
+    delay = sched.cur ? MAX((int32_t)(sched.until - now), 0) : 0;
+    delay = MAX(delay, sched_next_due(now));
+    if (delay == UINT32_MAX)
+    {
+        return;
+    }
+
+    k_work_reschedule(&sched.work, K_MSEC(MAX(delay, 1U)));
+}
+
+int bt_le_adv_sched_add(const struct bt_le_adv_sched_param *param)
+{
+    struct sched_adv *adv = NULL;
+    uint8_t i;
+
+    if (!param || param->param.peer || !param->period_ms)
+    {
+        return -EINVAL;
+    }
+
+    for (i = 0U; i < SCHED_MAX; i++)
+    {
+        if (!sched.advs[i].used)
+        {
+            adv = &sched.advs[i];
+            break;
+        }
+    }
+
+    if (!adv)
+    {
+        return -ENOMEM;
+    }
+
+    (void)memset(adv, 0, sizeof(*adv));
+    adv->used = true;
+    adv->param = param->param;
+    adv->ad = param->ad;
+    adv->ad_len = param->ad_len;
+    adv->sd = param->sd;
+    adv->sd_len = param->sd_len;
+    adv->period_ms = param->period_ms;
+    adv->dwell_ms = param->dwell_ms ? param->dwell_ms : CONFIG_BT_ADV_SCHED_DWELL_MS;
+    adv->priority = param->priority;
+    adv->added = sched_now();
+    adv->due = adv->added;
+
+    if (sched.running)
+    {
+        k_work_reschedule(&sched.work, K_NO_WAIT);
+    }
+
+    return i;
+}
+
+int bt_le_adv_sched_update_data(uint8_t id, const struct bt_data *ad, size_t ad_len,
+                                const struct bt_data *sd, size_t sd_len)
+{
+    struct sched_adv *adv;
+
+    if (id >= SCHED_MAX || !sched.advs[id].used)
+    {
+        return -EINVAL;
+    }
+
+    adv = &sched.advs[id];
+    adv->ad = ad;
+    adv->ad_len = ad_len;
+    adv->sd = sd;
+    adv->sd_len = sd_len;
+
+    if (sched.cur == adv)
+    {
+        return bt_le_adv_update_data(ad, ad_len, sd, sd_len);
+    }
+
+    return 0;
+}
+
+int bt_le_adv_sched_remove(uint8_t id)
+{
+    struct sched_adv *adv;
+
+    if (id >= SCHED_MAX || !sched.advs[id].used)
+    {
+        return -EINVAL;
+    }
+
+    adv = &sched.advs[id];
+    adv->used = false;
+
+    if (sched.cur == adv)
+    {
+        /* Hand the set over right away */
+        sched.until = sched_now();
+        if (sched.running)
+        {
+            k_work_reschedule(&sched.work, K_NO_WAIT);
+        }
+    }
+
+    return 0;
+}
+
+int bt_le_adv_sched_start(void)
+{
+    if (sched.running)
+    {
+        return -EALREADY;
+    }
+
+    sched.running = true;
+    sched.cur = NULL;
+    k_work_init_delayable(&sched.work, sched_run);
+    k_work_reschedule(&sched.work, K_NO_WAIT);
+
+    return 0;
+}
+
+int bt_le_adv_sched_stop(void)
+{
+    if (!sched.running)
+    {
+        return -EALREADY;
+    }
+
+    sched.running = false;
+    k_work_cancel_delayable(&sched.work);
+
+    if (sched.cur)
+    {
+        sched_off_air(sched_now());
+        sched.cur = NULL;
+        return bt_le_adv_stop();
+    }
+
+    return 0;
+}
+
+int bt_le_adv_sched_stats_get(uint8_t id, struct bt_le_adv_sched_stats *stats)
+{
+    const struct sched_adv *adv;
+    uint32_t now = sched_now();
+    uint32_t on_air;
+    uint32_t age;
+
+    if (id >= SCHED_MAX || !sched.advs[id].used || !stats)
+    {
+        return -EINVAL;
+    }
+
+    adv = &sched.advs[id];
+    on_air = adv->on_air + (sched.cur == adv ? now - sched.since : 0);
+    age = now - adv->added;
+
+    stats->airings = adv->airings;
+    stats->interval_avg_ms = adv->airings > 1 ? adv->interval_sum / (adv->airings - 1) : 0;
+    stats->interval_max_ms = adv->interval_max;
+    stats->on_air_ms = on_air;
+    stats->duty_permille = age ? (uint16_t)((uint64_t)on_air * 1000U / age) : 0;
+    stats->data_switches = adv->data_switches;
+    stats->restarts = adv->restarts;
+
+    return 0;
+}
+#endif /* CONFIG_BT_ADV_SCHED */
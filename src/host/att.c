@@ -33,6 +33,7 @@
 #include "gatt_internal.h"
 
 #include "utils/mem_slab.h"
+#include "common/bt_profile.h"
 
 #if defined(CONFIG_BT_CONN)
 #define ATT_CHAN(_ch)  CONTAINER_OF(_ch, struct bt_att_chan, chan.chan)
@@ -98,6 +99,13 @@ struct bt_att_chan
     struct k_fifo tx_queue;
     struct k_work_delayable timeout_work;
     sys_snode_t node;
+#if defined(CONFIG_BT_ATT_BEARER_STATS)
+    struct bt_att_bearer_stats stats;
+    uint32_t connected_at;
+#endif /* CONFIG_BT_ATT_BEARER_STATS */
+#if defined(CONFIG_BT_ATT_BEARER_STATS) || defined(CONFIG_BT_CONN_STATS)
+    uint32_t req_sent_at;
+#endif /* CONFIG_BT_ATT_BEARER_STATS || CONFIG_BT_CONN_STATS */
 };
 
 /* ATT connection specific data */
@@ -196,6 +204,89 @@ void att_sent(struct bt_conn *conn, void *user_data)
     }
 }
 
+#if defined(CONFIG_BT_ATT_BEARER_STATS)
+static void att_chan_stats_sent(struct bt_att_chan *chan, uint8_t op)
+{
+    if (att_op_get_type(op) == ATT_REQUEST)
+    {
+        chan->stats.req_count++;
+        chan->req_sent_at = sys_clock_tick_get();
+    }
+    else
+    {
+        chan->stats.pdu_count++;
+    }
+}
+
+/* The bearer stays busy until a response, a timeout or a disconnect ends the
+ * request, even one cancelled meanwhile.
+ */
+static void att_chan_stats_busy(struct bt_att_chan *chan)
+{
+    chan->stats.busy_time += sys_clock_tick_get() - chan->req_sent_at;
+}
+
+static void att_chan_stats_rsp(struct bt_att_chan *chan, struct bt_att_req *req)
+{
+    uint32_t latency = sys_clock_tick_get() - req->queued_at;
+
+    chan->stats.rsp_count++;
+    chan->stats.latency_total += latency;
+    chan->stats.latency_max = MAX(chan->stats.latency_max, latency);
+}
+#else
+static inline void att_chan_stats_sent(struct bt_att_chan *chan, uint8_t op)
+{
+}
+
+static inline void att_chan_stats_busy(struct bt_att_chan *chan)
+{
+}
+
+static inline void att_chan_stats_rsp(struct bt_att_chan *chan, struct bt_att_req *req)
+{
+}
+#endif /* CONFIG_BT_ATT_BEARER_STATS */
+
+#if defined(CONFIG_BT_CONN_STATS)
+static void att_conn_stats_sent(struct bt_att_chan *chan, uint8_t op)
+{
+    struct bt_conn *conn = chan->att->conn;
+
+    switch (att_op_get_type(op))
+    {
+    case ATT_REQUEST:
+        conn->stats.att_req++;
+        chan->req_sent_at = sys_clock_tick_get();
+        break;
+    case ATT_NOTIFICATION:
+    case ATT_INDICATION:
+        conn->stats.att_notify++;
+        break;
+    default:
+        break;
+    }
+}
+
+static void att_conn_stats_rsp(struct bt_att_chan *chan)
+{
+    struct bt_conn *conn = chan->att->conn;
+    uint32_t rtt = k_ticks_to_ms_floor32(sys_clock_tick_get() - chan->req_sent_at);
+
+    conn->stats.att_rsp++;
+    conn->stats.att_rtt_total += rtt;
+    conn->stats.att_rtt_max = MAX(conn->stats.att_rtt_max, rtt);
+}
+#else
+static inline void att_conn_stats_sent(struct bt_att_chan *chan, uint8_t op)
+{
+}
+
+static inline void att_conn_stats_rsp(struct bt_att_chan *chan)
+{
+}
+#endif /* CONFIG_BT_CONN_STATS */
+
 /* In case of success the ownership of the buffer is transferred to the stack
  * which takes care of releasing it when it completes transmitting to the
  * controller.
@@ -209,8 +300,10 @@ static int chan_send(struct bt_att_chan *chan, struct net_buf *buf)
     struct net_buf_simple_state state;
     int err;
     struct bt_att_tx_meta_data *data = bt_att_tx_meta_data(buf);
+    uint8_t op;
 
     hdr = (void *)buf->data;
+    op = hdr->code;
 
     BT_DBG("code 0x%02x", hdr->code);
 
@@ -261,6 +354,9 @@ static int chan_send(struct bt_att_chan *chan, struct net_buf *buf)
             return err;
         }
 
+        att_chan_stats_sent(chan, op);
+        att_conn_stats_sent(chan, op);
+
         return 0;
     }
 
@@ -287,9 +383,13 @@ static int chan_send(struct bt_att_chan *chan, struct net_buf *buf)
     {
         /* In case of an error has occurred restore the buffer state */
         net_buf_simple_restore(&buf->b, &state);
+        return err;
     }
 
-    return err;
+    att_chan_stats_sent(chan, op);
+    att_conn_stats_sent(chan, op);
+
+    return 0;
 }
 
 static int process_queue(struct bt_att_chan *chan, struct k_fifo *queue)
@@ -612,9 +712,70 @@ static int bt_att_chan_send(struct bt_att_chan *chan, struct net_buf *buf)
     return chan_send(chan, buf);
 }
 
+#if defined(CONFIG_BT_EATT_SCHED) || defined(CONFIG_BT_ATT_BEARER_STATS)
+/* Number of PDUs a bearer still has to get through */
+static size_t att_chan_backlog(struct bt_att_chan *chan)
+{
+    size_t backlog = k_fifo_size(&chan->tx_queue);
+
+    if (chan->req)
+    {
+        backlog++;
+    }
+
+    if (atomic_test_bit(chan->flags, ATT_PENDING_SENT))
+    {
+        backlog++;
+    }
+
+    return backlog;
+}
+#endif /* CONFIG_BT_EATT_SCHED || CONFIG_BT_ATT_BEARER_STATS */
+
+#if defined(CONFIG_BT_EATT_SCHED)
+/* Pick the least loaded bearer not tried yet, ignoring bearers with an
+ * outstanding request if idle is set.
+ */
+static struct bt_att_chan *att_chan_select(struct bt_att *att, uint32_t *tried, bool idle)
+{
+    struct bt_att_chan *chan, *best = NULL;
+    size_t best_backlog = SIZE_MAX;
+    uint8_t i = 0U, best_i = 0U;
+
+    SYS_SLIST_FOR_EACH_CONTAINER (&att->chans, chan, node)
+    {
+        if (!(*tried & BIT(i)) && (!idle || !chan->req))
+        {
+            size_t backlog = att_chan_backlog(chan);
+
+            if (backlog < best_backlog)
+            {
+                best = chan;
+                best_backlog = backlog;
+                best_i = i;
+            }
+        }
+
+        i++;
+    }
+
+    if (best)
+    {
+        *tried |= BIT(best_i);
+    }
+
+    return best;
+}
+#endif /* CONFIG_BT_EATT_SCHED */
+
 static void att_send_process(struct bt_att *att)
 {
+#if defined(CONFIG_BT_EATT_SCHED)
+    struct bt_att_chan *chan;
+    uint32_t tried = 0U;
+#else
     struct bt_att_chan *chan, *tmp;
+#endif /* CONFIG_BT_EATT_SCHED */
     struct net_buf *buf;
     int err = -ENOENT;
 
@@ -624,6 +785,17 @@ static void att_send_process(struct bt_att *att)
         return;
     }
 
+#if defined(CONFIG_BT_EATT_SCHED)
+    /* Spread PDUs over the bearers by backlog */
+    while ((chan = att_chan_select(att, &tried, false)) != NULL)
+    {
+        err = bt_att_chan_send(chan, buf);
+        if (err >= 0)
+        {
+            break;
+        }
+    }
+#else
     SYS_SLIST_FOR_EACH_CONTAINER_SAFE (&att->chans, chan, tmp, node)
     {
         err = bt_att_chan_send(chan, buf);
@@ -632,6 +804,7 @@ static void att_send_process(struct bt_att *att)
             break;
         }
     }
+#endif /* CONFIG_BT_EATT_SCHED */
 
     if (err < 0)
     {
@@ -757,6 +930,38 @@ static int bt_att_chan_req_send(struct bt_att_chan *chan, struct bt_att_req *req
     return chan_req_send(chan, req);
 }
 
+#if defined(CONFIG_BT_EATT_SCHED)
+static void att_req_send_process(struct bt_att *att)
+{
+    struct bt_att_chan *chan;
+    sys_snode_t *node;
+    uint32_t tried;
+
+    /* Hand out queued requests to idle bearers, least loaded first, until
+     * either runs out.
+     */
+    while ((node = sys_slist_get(&att->reqs)) != NULL)
+    {
+        BT_DBG("req %p", ATT_REQ(node));
+
+        tried = 0U;
+        while ((chan = att_chan_select(att, &tried, true)) != NULL)
+        {
+            if (bt_att_chan_req_send(chan, ATT_REQ(node)) >= 0)
+            {
+                break;
+            }
+        }
+
+        if (!chan)
+        {
+            /* Prepend back to the list as it could not be sent */
+            sys_slist_prepend(&att->reqs, node);
+            return;
+        }
+    }
+}
+#else
 static void att_req_send_process(struct bt_att *att)
 {
     sys_snode_t *node;
@@ -786,6 +991,7 @@ static void att_req_send_process(struct bt_att *att)
     /* Prepend back to the list as it could not be sent */
     sys_slist_prepend(&att->reqs, node);
 }
+#endif /* CONFIG_BT_EATT_SCHED */
 
 static uint8_t att_handle_rsp(struct bt_att_chan *chan, void *pdu, uint16_t len, uint8_t err)
 {
@@ -803,6 +1009,8 @@ static uint8_t att_handle_rsp(struct bt_att_chan *chan, void *pdu, uint16_t len,
         goto process;
     }
 
+    att_chan_stats_busy(chan);
+
     /* Check if request has been cancelled */
     if (chan->req == &cancel)
     {
@@ -810,6 +1018,9 @@ static uint8_t att_handle_rsp(struct bt_att_chan *chan, void *pdu, uint16_t len,
         goto process;
     }
 
+    att_chan_stats_rsp(chan, chan->req);
+    att_conn_stats_rsp(chan);
+
     /* Reset func so it can be reused by the callback */
     func = chan->req->func;
     chan->req->func = NULL;
@@ -2799,7 +3010,7 @@ static int bt_att_recv(struct bt_l2cap_chan *chan, struct net_buf *buf)
     }
     else
     {
-        err = handler->func(att_chan, buf);
+        BT_PROFILE_CALL(BT_PROFILE_ATT, handler->func, err = handler->func(att_chan, buf));
     }
 
     if (handler->type == ATT_REQUEST && err)
@@ -2839,6 +3050,7 @@ struct net_buf *bt_att_create_pdu(struct bt_conn *conn, uint8_t op, size_t len)
 {
     struct bt_att *att;
     struct bt_att_chan *chan, *tmp;
+    struct net_buf *buf;
 
     att = att_get(conn);
     if (!att)
@@ -2853,7 +3065,16 @@ struct net_buf *bt_att_create_pdu(struct bt_conn *conn, uint8_t op, size_t len)
             continue;
         }
 
-        return bt_att_chan_create_pdu(chan, op, len);
+        buf = bt_att_chan_create_pdu(chan, op, len);
+#if defined(CONFIG_BT_CONN_STATS)
+        if (!buf && (att_op_get_type(op) == ATT_NOTIFICATION ||
+                     att_op_get_type(op) == ATT_INDICATION))
+        {
+            conn->stats.att_notify_drops++;
+        }
+#endif /* CONFIG_BT_CONN_STATS */
+
+        return buf;
     }
 
     BT_WARN("No ATT channel for MTU %zu", len + sizeof(op));
@@ -2940,6 +3161,8 @@ static void att_timeout(struct k_work *work)
 
     BT_ERR("ATT Timeout");
 
+    BT_CONN_STATS_INC(chan->att->conn, att_timeouts);
+
     /* BLUETOOTH SPECIFICATION Version 4.2 [Vol 3, Part F] page 480:
      *
      * A transaction not completed within 30 seconds shall time out. Such a
@@ -2997,6 +3220,10 @@ static void bt_att_connected(struct bt_l2cap_chan *chan)
 
     k_work_init_delayable(&att_chan->timeout_work, att_timeout);
 
+#if defined(CONFIG_BT_ATT_BEARER_STATS)
+    att_chan->connected_at = sys_clock_tick_get();
+#endif /* CONFIG_BT_ATT_BEARER_STATS */
+
     bt_gatt_connected(le_chan->chan.conn);
 }
 
@@ -3733,6 +3960,70 @@ uint16_t bt_att_get_mtu(struct bt_conn *conn)
     return mtu;
 }
 
+#if defined(CONFIG_BT_ATT_BEARER_STATS)
+int bt_att_bearer_stats_get(struct bt_conn *conn, struct bt_att_bearer_stats *stats,
+                            size_t *count)
+{
+    struct bt_att_chan *chan;
+    struct bt_att *att;
+    uint32_t now;
+    size_t i = 0;
+
+    __ASSERT_NO_MSG(stats && count);
+
+    att = att_get(conn);
+    if (!att)
+    {
+        return -ENOTCONN;
+    }
+
+    now = sys_clock_tick_get();
+
+    SYS_SLIST_FOR_EACH_CONTAINER (&att->chans, chan, node)
+    {
+        if (i == *count)
+        {
+            break;
+        }
+
+        /* Times are accumulated in ticks and reported in ms */
+        stats[i] = chan->stats;
+        stats[i].cid = chan->chan.tx.cid;
+        stats[i].enhanced = atomic_test_bit(chan->flags, ATT_ENHANCED);
+        stats[i].backlog = att_chan_backlog(chan);
+        stats[i].latency_total = k_ticks_to_ms_floor32(chan->stats.latency_total);
+        stats[i].latency_max = k_ticks_to_ms_floor32(chan->stats.latency_max);
+        /* A request still outstanding has not been accounted for yet */
+        stats[i].busy_time = k_ticks_to_ms_floor32(
+                chan->stats.busy_time + (chan->req ? now - chan->req_sent_at : 0U));
+        stats[i].up_time = k_ticks_to_ms_floor32(now - chan->connected_at);
+        i++;
+    }
+
+    *count = i;
+
+    return 0;
+}
+
+void bt_att_bearer_stats_reset(struct bt_conn *conn)
+{
+    struct bt_att_chan *chan;
+    struct bt_att *att;
+
+    att = att_get(conn);
+    if (!att)
+    {
+        return;
+    }
+
+    SYS_SLIST_FOR_EACH_CONTAINER (&att->chans, chan, node)
+    {
+        (void)memset(&chan->stats, 0, sizeof(chan->stats));
+        chan->connected_at = sys_clock_tick_get();
+    }
+}
+#endif /* CONFIG_BT_ATT_BEARER_STATS */
+
 static void att_chan_mtu_updated(struct bt_att_chan *updated_chan)
 {
     struct bt_att *att = updated_chan->att;
@@ -3835,6 +4126,10 @@ int bt_att_req_send(struct bt_conn *conn, struct bt_att_req *req)
         return -ENOTCONN;
     }
 
+#if defined(CONFIG_BT_ATT_BEARER_STATS)
+    req->queued_at = sys_clock_tick_get();
+#endif /* CONFIG_BT_ATT_BEARER_STATS */
+
     sys_slist_append(&att->reqs, &req->node);
     att_req_send_process(att);
 
@@ -320,6 +320,9 @@ struct bt_att_req
     uint8_t att_op;
     size_t len;
 #endif /* CONFIG_BT_SMP */
+#if defined(CONFIG_BT_ATT_BEARER_STATS)
+    uint32_t queued_at;
+#endif /* CONFIG_BT_ATT_BEARER_STATS */
     void *user_data;
 };
 
@@ -155,6 +155,112 @@ struct k_sem *bt_conn_get_pkts(struct bt_conn *conn)
 #endif /* CONFIG_BT_CONN */
 }
 
+#if defined(CONFIG_BT_CONN_STATS)
+/* ACL packets of all connections in the controller. The host does not wait
+ * for controller buffers, so this is what tells sending into a full
+ * controller apart.
+ */
+static uint16_t tx_in_flight_total;
+
+static void conn_stats_reset(struct bt_conn *conn)
+{
+    (void)memset(&conn->stats, 0, sizeof(conn->stats));
+    conn->stats_since = sys_clock_tick_get();
+}
+
+static void conn_stats_queued(struct bt_conn *conn, struct net_buf *buf)
+{
+    conn->stats.tx_pdus++;
+    conn->stats.tx_bytes += buf->len;
+    conn->tx_queued_at[conn->tx_queue_in++ % CONFIG_BT_CONN_STATS_TX_QUEUE] = sys_clock_tick_get();
+}
+
+static void conn_stats_dequeued(struct bt_conn *conn)
+{
+    uint32_t seq = conn->tx_queue_out++;
+    uint32_t wait;
+
+    /* The entry was overwritten if too many were queued behind it */
+    if (conn->tx_queue_in - seq > CONFIG_BT_CONN_STATS_TX_QUEUE)
+    {
+        return;
+    }
+
+    wait = k_ticks_to_ms_floor32(sys_clock_tick_get() -
+                                 conn->tx_queued_at[seq % CONFIG_BT_CONN_STATS_TX_QUEUE]);
+
+    conn->stats.tx_queue_waits++;
+    conn->stats.tx_queue_wait_total += wait;
+    conn->stats.tx_queue_wait_max = MAX(conn->stats.tx_queue_wait_max, wait);
+}
+
+static void conn_stats_sent(struct bt_conn *conn)
+{
+    struct k_sem *pkts = bt_conn_get_pkts(conn);
+
+    conn->stats.tx_acl++;
+
+    if (pkts && tx_in_flight_total >= pkts->limit)
+    {
+        conn->stats.tx_credit_stalls++;
+    }
+
+    tx_in_flight_total++;
+    conn->tx_in_flight++;
+    conn->stats.tx_in_flight_max = MAX(conn->stats.tx_in_flight_max, conn->tx_in_flight);
+}
+
+void bt_conn_stats_tx_done(struct bt_conn *conn, bool completed)
+{
+    if (!conn->tx_in_flight)
+    {
+        return;
+    }
+
+    conn->tx_in_flight--;
+    tx_in_flight_total--;
+
+    if (completed)
+    {
+        conn->stats.tx_completed++;
+    }
+}
+
+int bt_conn_get_stats(const struct bt_conn *conn, struct bt_conn_stats *stats)
+{
+    if (!conn || !stats)
+    {
+        return -EINVAL;
+    }
+
+    *stats = conn->stats;
+    stats->duration = k_ticks_to_ms_floor32(sys_clock_tick_get() - conn->stats_since);
+
+    return 0;
+}
+
+void bt_conn_reset_stats(struct bt_conn *conn)
+{
+    conn_stats_reset(conn);
+}
+#else
+static inline void conn_stats_reset(struct bt_conn *conn)
+{
+}
+
+static inline void conn_stats_queued(struct bt_conn *conn, struct net_buf *buf)
+{
+}
+
+static inline void conn_stats_dequeued(struct bt_conn *conn)
+{
+}
+
+static inline void conn_stats_sent(struct bt_conn *conn)
+{
+}
+#endif /* CONFIG_BT_CONN_STATS */
+
 static inline const char *state2str(bt_conn_state_t state)
 {
     switch (state)
@@ -363,6 +469,8 @@ static void bt_acl_recv(struct bt_conn *conn, struct net_buf *buf, uint8_t flags
     conn->rx = NULL;
 
     BT_DBG("Successfully parsed %u byte L2CAP packet", buf->len);
+    BT_CONN_STATS_INC(conn, rx_pdus);
+    BT_CONN_STATS_ADD(conn, rx_bytes, buf->len);
     bt_l2cap_recv(conn, buf, true);
 }
 
@@ -383,6 +491,7 @@ void bt_conn_recv(struct bt_conn *conn, struct net_buf *buf, uint8_t flags)
     }
     else if (IS_ENABLED(CONFIG_BT_CONN))
     {
+        BT_CONN_STATS_INC(conn, rx_acl);
         bt_acl_recv(conn, buf, flags);
     }
     else
@@ -457,6 +566,7 @@ int bt_conn_send_cb(struct bt_conn *conn, struct net_buf *buf, bt_conn_tx_cb_t c
         tx_data(buf)->tx = NULL;
     }
 
+    conn_stats_queued(conn, buf);
     net_buf_put(&conn->tx_queue, buf);
     return 0;
 }
@@ -597,9 +707,12 @@ static bool send_frag(struct bt_conn *conn, struct net_buf *buf, uint8_t flags,
             (*pending_no_cb)--;
         }
         // irq_unlock(key);
+        BT_CONN_STATS_INC(conn, tx_errors);
         goto fail;
     }
 
+    conn_stats_sent(conn);
+
     return true;
 
 fail:
@@ -666,6 +779,8 @@ static struct net_buf *create_frag(struct bt_conn *conn, struct net_buf *buf)
     /* Fragments never have a TX completion callback */
     tx_data(frag)->tx = NULL;
 
+    BT_CONN_STATS_INC(conn, tx_frags);
+
     frag_len = MIN(conn_mtu(conn), net_buf_tailroom(frag));
 
     net_buf_add_mem(frag, buf->data, frag_len);
@@ -738,6 +853,10 @@ static void conn_cleanup(struct bt_conn *conn)
         net_buf_unref(buf);
     }
 
+#if defined(CONFIG_BT_CONN_STATS)
+    conn->tx_queue_out = conn->tx_queue_in;
+#endif /* CONFIG_BT_CONN_STATS */
+
     __ASSERT(sys_slist_is_empty(&conn->tx_pending), "Pending TX packets");
     __ASSERT_NO_MSG(conn->pending_no_cb == 0);
 
@@ -831,6 +950,7 @@ void bt_conn_process_tx(struct bt_conn *conn)
     /* Get next ACL packet for connection */
     buf = net_buf_get(&conn->tx_queue, K_NO_WAIT);
     BT_ASSERT(buf);
+    conn_stats_dequeued(conn);
     if (!send_buf(conn, buf))
     {
         net_buf_unref(buf);
@@ -852,6 +972,7 @@ static void process_unack_tx(struct bt_conn *conn)
         {
             conn->pending_no_cb--;
             // irq_unlock(key);
+            bt_conn_stats_tx_done(conn, false);
             k_sem_give(bt_conn_get_pkts(conn));
             continue;
         }
@@ -873,6 +994,7 @@ static void process_unack_tx(struct bt_conn *conn)
 
         conn_tx_destroy(conn, tx);
 
+        bt_conn_stats_tx_done(conn, false);
         k_sem_give(bt_conn_get_pkts(conn));
     }
 }
@@ -958,6 +1080,7 @@ void bt_conn_set_state(struct bt_conn *conn, bt_conn_state_t state)
         }
         k_fifo_init(&conn->tx_queue);
         // k_poll_signal_raise(&conn_change, 0);
+        conn_stats_reset(conn);
 
         if (IS_ENABLED(CONFIG_BT_ISO) && conn->type == BT_CONN_TYPE_ISO)
         {
@@ -266,6 +266,18 @@ struct bt_conn
         uint16_t subversion;
     } rv;
 #endif
+
+#if defined(CONFIG_BT_CONN_STATS)
+    struct bt_conn_stats stats;
+    uint32_t stats_since;
+    /* ACL packets in the controller not yet completed */
+    uint16_t tx_in_flight;
+    /* Enqueue times of the tx_queue entries, indexed by queue sequence */
+    uint32_t tx_queued_at[CONFIG_BT_CONN_STATS_TX_QUEUE];
+    uint32_t tx_queue_in;
+    uint32_t tx_queue_out;
+#endif /* CONFIG_BT_CONN_STATS */
+
     /* Must be at the end so that everything else in the structure can be
      * memset to zero without affecting the ref.
      */
@@ -442,6 +454,21 @@ struct k_sem *bt_conn_get_pkts(struct bt_conn *conn);
 // int bt_conn_prepare_events(struct k_poll_event events[]);
 void bt_conn_process_tx(struct bt_conn *conn);
 
+#if defined(CONFIG_BT_CONN_STATS)
+#define BT_CONN_STATS_INC(_conn, _field)       ((_conn)->stats._field++)
+#define BT_CONN_STATS_ADD(_conn, _field, _val) ((_conn)->stats._field += (_val))
+
+/* An ACL packet left the controller, completed or dropped at disconnect */
+void bt_conn_stats_tx_done(struct bt_conn *conn, bool completed);
+#else
+#define BT_CONN_STATS_INC(_conn, _field)
+#define BT_CONN_STATS_ADD(_conn, _field, _val)
+
+static inline void bt_conn_stats_tx_done(struct bt_conn *conn, bool completed)
+{
+}
+#endif /* CONFIG_BT_CONN_STATS */
+
 uint8_t bt_conn_check_allow_sleep(void);
 void bt_conn_sleep_wake_init(void);
 
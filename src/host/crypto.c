@@ -22,9 +22,436 @@
 
 #include "drivers/hci_driver.h"
 #include "hci_core.h"
-#include "common/aes_soft.h"
+#include "crypto.h"
+#include "common/aes_backend.h"
 
 #if defined(CONFIG_BT_HOST_CRYPTO)
+#if defined(CONFIG_BT_RAND_DRBG)
+#if defined(CONFIG_BT_RAND_OS_ENTROPY) && defined(__linux__)
+#include <stdio.h>
+#elif defined(CONFIG_BT_RAND_OS_ENTROPY) && defined(_WIN32)
+#include <windows.h>
+#include <bcrypt.h>
+#endif
+
+#include "base/common.h"
+#include "common/aes_cmac.h"
+#include "common/ctr_drbg.h"
+#include "common/timer.h"
+
+/* Raw controller bytes conditioned into one seed. Assuming at least 4 bits
+ * of min-entropy per LE_Rand byte this is 256 bits for a 128 bit strength.
+ */
+#define RAND_SEED_RAW_LEN (2 * BT_CTR_DRBG_SEED_LEN)
+
+/* Random bytes returned by one LE_Rand command */
+#define RAND_LE_RAND_LEN sizeof(((struct bt_hci_rp_le_rand *)0)->rand)
+
+/* LE_Rand commands kept outstanding while the pool is filled */
+#define RAND_MAX_INFLIGHT 4
+
+/* Source failures in a row before LE_Rand is no longer asked for */
+#define RAND_MAX_FAILURES 8
+
+/* Continuous health tests, SP 800-90B 4.4, for 4 bits of min-entropy per
+ * byte and a false positive probability of 2^-20 per test.
+ */
+#define RAND_RCT_CUTOFF 6
+#define RAND_APT_WINDOW 512
+#define RAND_APT_CUTOFF 62
+
+#define RAND_BENCH_BYTES (64U * 1024U)
+
+static struct
+{
+    struct bt_ctr_drbg drbg;
+
+    uint8_t pool[CONFIG_BT_RAND_POOL_SIZE];
+    uint16_t pool_len;
+    uint8_t inflight;
+    uint8_t failures;
+
+    /* Repetition count test */
+    uint8_t rct_last;
+    uint8_t rct_count;
+
+    /* Adaptive proportion test */
+    uint8_t apt_ref;
+    uint16_t apt_count;
+    uint16_t apt_seen;
+
+    bool self_test_failed;
+    /* Personalization string used once entropy is available */
+    unsigned int pers;
+    struct bt_rand_stats stats;
+} rand_ctx;
+
+#if defined(CONFIG_BT_RAND_OS_ENTROPY) && defined(__linux__)
+int bt_rand_os_entropy(uint8_t *buf, size_t len)
+{
+    FILE *fp;
+    size_t n;
+
+    fp = fopen("/dev/urandom", "rb");
+    if (!fp)
+    {
+        return -ENOTSUP;
+    }
+
+    n = fread(buf, 1, len, fp);
+    fclose(fp);
+
+    return n == len ? 0 : -EIO;
+}
+#elif defined(CONFIG_BT_RAND_OS_ENTROPY) && defined(_WIN32)
+int bt_rand_os_entropy(uint8_t *buf, size_t len)
+{
+    NTSTATUS status;
+
+    status = BCryptGenRandom(NULL, buf, (ULONG)len, BCRYPT_USE_SYSTEM_PREFERRED_RNG);
+
+    return BCRYPT_SUCCESS(status) ? 0 : -EIO;
+}
+#else
+__weak int bt_rand_os_entropy(uint8_t *buf, size_t len)
+{
+    ARG_UNUSED(buf);
+    ARG_UNUSED(len);
+
+    return -ENOTSUP;
+}
+#endif /* CONFIG_BT_RAND_OS_ENTROPY */
+
+static void rand_source_failed(void)
+{
+    if (rand_ctx.failures < RAND_MAX_FAILURES && ++rand_ctx.failures == RAND_MAX_FAILURES)
+    {
+        BT_ERR("LE_Rand failed %u times, no longer used as entropy source", RAND_MAX_FAILURES);
+    }
+}
+
+/* Returns false when the sample must be discarded */
+static bool rand_health_test(uint8_t sample)
+{
+    bool ok = true;
+
+    if (rand_ctx.rct_count && sample == rand_ctx.rct_last)
+    {
+        if (++rand_ctx.rct_count >= RAND_RCT_CUTOFF)
+        {
+            ok = false;
+        }
+    }
+    else
+    {
+        rand_ctx.rct_last = sample;
+        rand_ctx.rct_count = 1U;
+    }
+
+    if (!rand_ctx.apt_seen)
+    {
+        rand_ctx.apt_ref = sample;
+        rand_ctx.apt_count = 1U;
+    }
+    else if (sample == rand_ctx.apt_ref && ++rand_ctx.apt_count >= RAND_APT_CUTOFF)
+    {
+        ok = false;
+    }
+
+    if (++rand_ctx.apt_seen == RAND_APT_WINDOW)
+    {
+        rand_ctx.apt_seen = 0U;
+    }
+
+    return ok;
+}
+
+static void rand_health_reset(void)
+{
+    rand_ctx.rct_count = 0U;
+    rand_ctx.apt_seen = 0U;
+}
+
+void bt_rand_entropy_done(uint8_t status, const uint8_t *data, size_t len)
+{
+    size_t i;
+    bool ok = true;
+
+    if (rand_ctx.inflight)
+    {
+        rand_ctx.inflight--;
+    }
+
+    if (status)
+    {
+        rand_ctx.stats.le_rand_errors++;
+        rand_source_failed();
+        return;
+    }
+
+    rand_ctx.stats.le_rand_cmds++;
+
+    for (i = 0; i < len; i++)
+    {
+        ok &= rand_health_test(data[i]);
+    }
+
+    if (!ok)
+    {
+        /* Whatever came from the source lately is suspect as well */
+        BT_WARN("LE_Rand health test failed");
+        rand_ctx.stats.health_failures++;
+        rand_ctx.pool_len = 0U;
+        rand_health_reset();
+        rand_source_failed();
+        return;
+    }
+
+    rand_ctx.failures = 0U;
+
+    len = MIN(len, sizeof(rand_ctx.pool) - rand_ctx.pool_len);
+    memcpy(&rand_ctx.pool[rand_ctx.pool_len], data, len);
+    rand_ctx.pool_len += len;
+}
+
+int bt_rand_entropy_fill(void)
+{
+    size_t pending;
+
+    if (!BT_CMD_TEST(bt_dev.supported_commands, 27, 7) || rand_ctx.failures >= RAND_MAX_FAILURES)
+    {
+        return rand_ctx.pool_len >= RAND_SEED_RAW_LEN ? 0 : -EIO;
+    }
+
+    while (rand_ctx.inflight < RAND_MAX_INFLIGHT)
+    {
+        pending = rand_ctx.pool_len + rand_ctx.inflight * RAND_LE_RAND_LEN;
+        if (pending >= sizeof(rand_ctx.pool))
+        {
+            break;
+        }
+
+        if (bt_hci_le_rand_pool_send())
+        {
+            break;
+        }
+
+        rand_ctx.inflight++;
+    }
+
+    if (rand_ctx.pool_len >= RAND_SEED_RAW_LEN)
+    {
+        return 0;
+    }
+
+    return rand_ctx.inflight ? -EINPROGRESS : -EIO;
+}
+
+/* Condition raw pool and OS bytes into a full entropy seed with AES-CMAC,
+ * one of the vetted conditioning components of SP 800-90B 3.1.5.1.
+ */
+static int rand_seed_get(uint8_t seed[BT_CTR_DRBG_SEED_LEN])
+{
+    static const uint8_t cond_key[AES_KEYLEN] = {0};
+    struct bt_aes_cmac_ctx cmac;
+    uint8_t os[BT_CTR_DRBG_SEED_LEN];
+    bool have_pool = rand_ctx.pool_len >= RAND_SEED_RAW_LEN;
+    bool have_os = !bt_rand_os_entropy(os, sizeof(os));
+    uint8_t i;
+
+    if (!have_pool && !have_os)
+    {
+        return -EAGAIN;
+    }
+
+    for (i = 0U; i < BT_CTR_DRBG_SEED_LEN / AES_BLOCKLEN; i++)
+    {
+        bt_aes_cmac_setup_cached(&cmac, cond_key);
+        bt_aes_cmac_update(&cmac, &i, sizeof(i));
+        if (have_pool)
+        {
+            bt_aes_cmac_update(&cmac, &rand_ctx.pool[rand_ctx.pool_len - RAND_SEED_RAW_LEN],
+                               RAND_SEED_RAW_LEN);
+        }
+        if (have_os)
+        {
+            bt_aes_cmac_update(&cmac, os, sizeof(os));
+        }
+        bt_aes_cmac_final(&cmac, &seed[i * AES_BLOCKLEN]);
+    }
+
+    if (have_pool)
+    {
+        rand_ctx.pool_len -= RAND_SEED_RAW_LEN;
+        memset(&rand_ctx.pool[rand_ctx.pool_len], 0, RAND_SEED_RAW_LEN);
+    }
+
+    memset(os, 0, sizeof(os));
+
+    return 0;
+}
+
+/* Never falls back to a guessable seed, bt_rand() fails until LE_Rand or
+ * the OS delivered entropy.
+ */
+static int rand_instantiate(void)
+{
+    uint8_t seed[BT_CTR_DRBG_SEED_LEN];
+    int err;
+
+    err = rand_seed_get(seed);
+    if (err)
+    {
+        return err;
+    }
+
+    err = bt_ctr_drbg_instantiate(&rand_ctx.drbg, seed, (const uint8_t *)&rand_ctx.pers,
+                                  sizeof(rand_ctx.pers));
+    memset(seed, 0, sizeof(seed));
+
+    return err;
+}
+
+static void rand_reseed(void)
+{
+    uint8_t seed[BT_CTR_DRBG_SEED_LEN];
+
+    if (rand_seed_get(seed))
+    {
+        return;
+    }
+
+    bt_ctr_drbg_reseed(&rand_ctx.drbg, seed);
+    memset(seed, 0, sizeof(seed));
+
+    rand_ctx.stats.reseeds++;
+}
+
+void bt_rand_polling_work(void)
+{
+    if (bt_dev.hci_state != HCI_STATE_READY || rand_ctx.self_test_failed)
+    {
+        return;
+    }
+
+    if (!rand_ctx.drbg.seeded)
+    {
+        if (rand_ctx.pool_len >= RAND_SEED_RAW_LEN && !rand_instantiate())
+        {
+            BT_INFO("CTR_DRBG seeded");
+        }
+    }
+    else if (rand_ctx.drbg.reseed_counter > CONFIG_BT_RAND_RESEED_INTERVAL)
+    {
+        rand_reseed();
+    }
+
+    if (rand_ctx.pool_len < RAND_SEED_RAW_LEN)
+    {
+        (void)bt_rand_entropy_fill();
+    }
+}
+
+uint32_t bt_rand_get32(void)
+{
+    uint32_t val = 0U;
+
+    (void)bt_rand(&val, sizeof(val));
+
+    return val;
+}
+
+int bt_rand(void *buf, size_t len)
+{
+    int err;
+
+    if (rand_ctx.self_test_failed)
+    {
+        return -EIO;
+    }
+
+    if (!rand_ctx.drbg.seeded)
+    {
+        err = rand_instantiate();
+        if (err)
+        {
+            return err;
+        }
+    }
+
+    /* Reseeding is normally done from the polling loop, this only catches
+     * callers that run many requests in a row from a single event.
+     */
+    if (rand_ctx.drbg.reseed_counter > 2U * CONFIG_BT_RAND_RESEED_INTERVAL)
+    {
+        rand_reseed();
+    }
+
+    err = bt_ctr_drbg_generate(&rand_ctx.drbg, buf, len);
+    if (!err)
+    {
+        rand_ctx.stats.requests++;
+        rand_ctx.stats.bytes += len;
+    }
+
+    return err;
+}
+
+void bt_rand_init(unsigned int seed)
+{
+    if (bt_ctr_drbg_self_test())
+    {
+        BT_ERR("CTR_DRBG self test failed");
+        rand_ctx.self_test_failed = true;
+        bt_ctr_drbg_uninstantiate(&rand_ctx.drbg);
+        return;
+    }
+
+    rand_ctx.pers = seed;
+
+    if (rand_instantiate())
+    {
+        BT_WARN("No entropy yet, bt_rand() fails until CTR_DRBG is seeded");
+        return;
+    }
+
+    BT_INFO("CTR_DRBG seeded, %u bytes of LE_Rand entropy left", rand_ctx.pool_len);
+}
+
+void bt_rand_stats_get(struct bt_rand_stats *stats)
+{
+    *stats = rand_ctx.stats;
+    stats->pool_len = rand_ctx.pool_len;
+    stats->seeded = rand_ctx.drbg.seeded;
+}
+
+#if defined(CONFIG_BT_RAND_BENCHMARK)
+void bt_rand_benchmark(void)
+{
+    static const uint16_t sizes[] = {4, 16, 64, 256};
+    uint8_t buf[256];
+    uint32_t start;
+    uint32_t elapsed;
+    uint32_t n;
+    uint8_t i;
+
+    for (i = 0U; i < ARRAY_SIZE(sizes); i++)
+    {
+        start = sys_clock_tick_get();
+        for (n = 0U; n < RAND_BENCH_BYTES / sizes[i]; n++)
+        {
+            (void)bt_rand(buf, sizes[i]);
+        }
+        elapsed = MAX(k_ticks_to_us_floor32(sys_clock_tick_get() - start), 1U);
+
+        BT_INFO("bt_rand %u byte requests: %u bytes/s", sizes[i],
+                (uint32_t)(RAND_BENCH_BYTES * 1000000ULL / elapsed));
+    }
+
+    memset(buf, 0, sizeof(buf));
+}
+#endif /* CONFIG_BT_RAND_BENCHMARK */
+#else
 uint32_t rand_get32(void)
 {
     return rand();
@@ -58,6 +485,7 @@ void bt_rand_init(unsigned int seed)
 {
     rand_init(seed);
 }
+#endif /* CONFIG_BT_RAND_DRBG */
 
 void reverse_byte(const uint8_t *in, uint8_t *out)
 {
@@ -66,26 +494,47 @@ void reverse_byte(const uint8_t *in, uint8_t *out)
         out[16 - 1 - i] = in[i];
     }
 }
+
+/* SMP passes TK, STK and LTK derivation keys here, the schedules are never
+ * kept in the AES key cache and are wiped before returning.
+ */
 int bt_encrypt_le(const uint8_t key[16], const uint8_t plaintext[16], uint8_t enc_data[16])
 {
+    struct bt_aes_sched sched;
+    uint8_t key_be[16];
+    uint8_t block[16];
+
     BT_DBG("key %s", bt_hex(key, 16));
     BT_DBG("plaintext %s", bt_hex(plaintext, 16));
 
-    // Our asic is negated
-    // aes_encrypt(AES_BIG_ENDIAN, key, plaintext, 16);
-    // aes_result(enc_data);
-    // aesEncrypt(key, 16, plaintext, enc_data, 16);
-    struct AES_ctx ctx;
+    reverse_byte(key, key_be);
+    reverse_byte(plaintext, block);
+
+    bt_aes_expand(&sched, key_be);
+    bt_aes_encrypt(&sched, block, block);
+
+    reverse_byte(block, enc_data);
+
+    (void)memset(&sched, 0, sizeof(sched));
+    (void)memset(key_be, 0, sizeof(key_be));
+    (void)memset(block, 0, sizeof(block));
 
-    uint8_t key_tmp[16];
-    uint8_t plaintext_tmp[16];
-    reverse_byte(key, key_tmp);
-    reverse_byte(plaintext, plaintext_tmp);
+    BT_DBG("enc_data %s", bt_hex(enc_data, 16));
+
+    return 0;
+}
+
+int bt_encrypt_be(const uint8_t key[16], const uint8_t plaintext[16], uint8_t enc_data[16])
+{
+    struct bt_aes_sched sched;
 
-    AES_init_ctx(&ctx, key_tmp);
-    AES_ECB_encrypt(&ctx, plaintext_tmp);
+    BT_DBG("key %s", bt_hex(key, 16));
+    BT_DBG("plaintext %s", bt_hex(plaintext, 16));
+
+    bt_aes_expand(&sched, key);
+    bt_aes_encrypt(&sched, plaintext, enc_data);
 
-    reverse_byte(plaintext_tmp, enc_data);
+    (void)memset(&sched, 0, sizeof(sched));
 
     BT_DBG("enc_data %s", bt_hex(enc_data, 16));
 
@@ -94,13 +543,20 @@ int bt_encrypt_le(const uint8_t key[16], const uint8_t plaintext[16], uint8_t en
 
 int bt_encrypt_sk(const uint8_t key[16], const uint8_t plaintext[16], uint8_t enc_data[16])
 {
+    struct bt_aes_sched sched;
+    uint8_t block[16];
+
     BT_DBG("sk key %s", bt_hex(key, 16));
     BT_DBG("sk plaintext %s", bt_hex(plaintext, 16));
 
-    // Our asic is negated
-    // aes_encrypt(AES_BIG_ENDIAN, key, plaintext, 16);
-    // aes_encrypt_ctrl(0);        // little out
-    // aes_result(enc_data);
+    /* MS byte first key and plaintext, LS byte first result */
+    bt_aes_expand(&sched, key);
+    bt_aes_encrypt(&sched, plaintext, block);
+
+    reverse_byte(block, enc_data);
+
+    (void)memset(&sched, 0, sizeof(sched));
+    (void)memset(block, 0, sizeof(block));
 
     BT_DBG("sk enc_data %s", bt_hex(enc_data, 16));
 
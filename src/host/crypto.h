@@ -8,9 +8,64 @@
 #ifndef _ZEPHYR_POLLING_HOST_CRYPTO_H_
 #define _ZEPHYR_POLLING_HOST_CRYPTO_H_
 
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
 #include "bt_config.h"
 
 int prng_init(void);
 void bt_rand_init(unsigned int seed);
 
+#if defined(CONFIG_BT_RAND_DRBG)
+struct bt_rand_stats
+{
+    /* Successful bt_rand() requests and bytes handed out */
+    uint32_t requests;
+    uint32_t bytes;
+    /* DRBG reseeds after the initial instantiation */
+    uint32_t reseeds;
+    /* LE_Rand commands completed and failed */
+    uint32_t le_rand_cmds;
+    uint32_t le_rand_errors;
+    /* LE_Rand batches rejected by the health tests */
+    uint32_t health_failures;
+    /* Raw entropy bytes waiting in the pool */
+    uint16_t pool_len;
+    /* Entropy has been mixed in, bt_rand() fails with -EAGAIN until then */
+    bool seeded;
+};
+
+/** @brief Queue LE_Rand commands until the entropy pool is full.
+ *
+ *  @return 0 if the pool holds enough for a seed, -EINPROGRESS if commands
+ *          are outstanding, -EIO if no entropy can be expected.
+ */
+int bt_rand_entropy_fill(void);
+
+/** @brief Hand the result of an LE_Rand command to the entropy pool. */
+void bt_rand_entropy_done(uint8_t status, const uint8_t *data, size_t len);
+
+/** @brief Seed or reseed when due and keep the entropy pool topped up. */
+void bt_rand_polling_work(void);
+
+/** @brief Read entropy from the operating system.
+ *
+ *  Weak, returns -ENOTSUP unless CONFIG_BT_RAND_OS_ENTROPY is enabled on
+ *  Linux or Windows. Ports may provide their own.
+ */
+int bt_rand_os_entropy(uint8_t *buf, size_t len);
+
+void bt_rand_stats_get(struct bt_rand_stats *stats);
+
+#if defined(CONFIG_BT_RAND_BENCHMARK)
+void bt_rand_benchmark(void);
+#endif /* CONFIG_BT_RAND_BENCHMARK */
+#else
+static inline int bt_rand_entropy_fill(void)
+{
+    return 0;
+}
+#endif /* CONFIG_BT_RAND_DRBG */
+
 #endif /* _ZEPHYR_POLLING_HOST_CRYPTO_H_ */
\ No newline at end of file
@@ -37,25 +37,205 @@ bool bt_pub_key_is_debug(uint8_t *pub_key_ptr)
     return memcmp(pub_key_ptr, debug_public_key, BT_PUB_KEY_LEN) == 0;
 }
 
-int bt_pub_key_gen(struct bt_pub_key_cb *new_cb)
+static void pub_key_complete(const uint8_t *key)
 {
     struct bt_pub_key_cb *cb;
-    int err;
 
+    atomic_clear_bit(bt_dev.flags, BT_DEV_PUB_KEY_BUSY);
+
+    if (key)
+    {
+        memcpy(pub_key, key, BT_PUB_KEY_LEN);
+        atomic_set_bit(bt_dev.flags, BT_DEV_HAS_PUB_KEY);
+    }
+
+    SYS_SLIST_FOR_EACH_CONTAINER (&pub_key_cb_slist, cb, node)
+    {
+        if (cb->func)
+        {
+            cb->func(key ? pub_key : NULL);
+        }
+    }
+
+    sys_slist_init(&pub_key_cb_slist);
+}
+
+static void dh_key_complete(const uint8_t *dhkey)
+{
+    if (dh_key_cb)
+    {
+        bt_dh_key_cb_t cb = dh_key_cb;
+
+        dh_key_cb = NULL;
+        cb(dhkey);
+    }
+}
+
+bool bt_ecc_hci_supported(void)
+{
     /*
      * We check for both "LE Read Local P-256 Public Key" and
      * "LE Generate DH Key" support here since both commands are needed for
      * ECC support. If "LE Generate DH Key" is not supported then there
      * is no point in reading local public key.
      */
-    if (!BT_CMD_TEST(bt_dev.supported_commands, 34, 1) ||
-        !BT_CMD_TEST(bt_dev.supported_commands, 34, 2))
+    return BT_CMD_TEST(bt_dev.supported_commands, 34, 1) &&
+           BT_CMD_TEST(bt_dev.supported_commands, 34, 2);
+}
+
+#if defined(CONFIG_BT_HOST_ECC)
+/* Core Spec Vol 3, Part H, 2.3.5.6.1, LS byte first */
+static const uint8_t debug_private_key[BT_PRIV_KEY_LEN] = {
+        0xbd, 0x1a, 0x3c, 0xcd, 0xa6, 0xb8, 0x99, 0x58, 0x99, 0xb7, 0x40, 0xeb, 0x7b, 0x60, 0xff, 0x4a,
+        0x50, 0x3f, 0x10, 0xd2, 0xe3, 0xb3, 0xc9, 0x74, 0x38, 0x5f, 0xc5, 0xa3, 0xd4, 0xf6, 0x49, 0x3f};
+
+static uint8_t priv_key[BT_PRIV_KEY_LEN];
+
+#if defined(CONFIG_BT_SMP_PRECOMPUTE)
+enum
+{
+    SPARE_NONE,
+    SPARE_BUSY,
+    SPARE_READY,
+};
+
+/* Next key pair, computed before the bt_pub_key_gen() that needs it */
+static struct
+{
+    uint8_t state;
+    /* Hand over to the pending bt_pub_key_gen() once computed */
+    bool adopt;
+    uint8_t priv[BT_PRIV_KEY_LEN];
+    uint8_t pub[BT_PUB_KEY_LEN];
+} spare;
+
+static void spare_adopt(void)
+{
+    uint8_t key[BT_PUB_KEY_LEN];
+
+    memcpy(priv_key, spare.priv, sizeof(priv_key));
+    memcpy(key, spare.pub, sizeof(key));
+    memset(&spare, 0, sizeof(spare));
+
+    pub_key_complete(key);
+}
+
+static void spare_ready(const uint8_t *key)
+{
+    if (!key)
+    {
+        bool adopt = spare.adopt;
+
+        memset(&spare, 0, sizeof(spare));
+        if (adopt)
+        {
+            memset(priv_key, 0, sizeof(priv_key));
+            pub_key_complete(NULL);
+        }
+        return;
+    }
+
+    memcpy(spare.pub, key, sizeof(spare.pub));
+    spare.state = SPARE_READY;
+
+    if (spare.adopt)
+    {
+        spare_adopt();
+    }
+}
+
+void bt_pub_key_precompute(void)
+{
+    if (bt_ecc_hci_supported() || spare.state != SPARE_NONE || bt_ecc_p256_busy() || dh_key_cb)
+    {
+        return;
+    }
+
+    do
+    {
+        if (bt_rand(spare.priv, sizeof(spare.priv)))
+        {
+            memset(&spare, 0, sizeof(spare));
+            return;
+        }
+    } while (!bt_ecc_p256_key_valid(spare.priv));
+
+    if (bt_ecc_p256_mul(spare.priv, NULL, spare_ready))
+    {
+        memset(&spare, 0, sizeof(spare));
+        return;
+    }
+
+    spare.state = SPARE_BUSY;
+}
+#endif /* CONFIG_BT_SMP_PRECOMPUTE */
+
+static void host_pub_key_ready(const uint8_t *key)
+{
+    if (!key)
+    {
+        memset(priv_key, 0, sizeof(priv_key));
+    }
+
+    pub_key_complete(key);
+}
+
+static int host_pub_key_gen(void)
+{
+    int err;
+
+    if (IS_ENABLED(CONFIG_BT_USE_DEBUG_KEYS))
+    {
+        memcpy(priv_key, debug_private_key, sizeof(priv_key));
+        pub_key_complete(debug_public_key);
+        return 0;
+    }
+
+#if defined(CONFIG_BT_SMP_PRECOMPUTE)
+    if (spare.state == SPARE_READY)
+    {
+        spare_adopt();
+        return 0;
+    }
+
+    if (spare.state == SPARE_BUSY)
+    {
+        spare.adopt = true;
+        return 0;
+    }
+#endif /* CONFIG_BT_SMP_PRECOMPUTE */
+
+    do
+    {
+        err = bt_rand(priv_key, sizeof(priv_key));
+        if (err)
+        {
+            return err;
+        }
+    } while (!bt_ecc_p256_key_valid(priv_key));
+
+    return bt_ecc_p256_mul(priv_key, NULL, host_pub_key_ready);
+}
+
+static void host_dh_key_ready(const uint8_t *result)
+{
+    /* The DHKey is the X coordinate of the shared point */
+    dh_key_complete(result);
+}
+#endif /* CONFIG_BT_HOST_ECC */
+
+int bt_pub_key_gen(struct bt_pub_key_cb *new_cb)
+{
+    struct bt_pub_key_cb *cb;
+    int err;
+
+    if (!bt_ecc_hci_supported() && !IS_ENABLED(CONFIG_BT_HOST_ECC))
     {
         BT_WARN("ECC HCI commands not available");
         return -ENOTSUP;
     }
 
-    if (IS_ENABLED(CONFIG_BT_USE_DEBUG_KEYS))
+    if (IS_ENABLED(CONFIG_BT_USE_DEBUG_KEYS) && bt_ecc_hci_supported())
     {
         if (!BT_CMD_TEST(bt_dev.supported_commands, 41, 2))
         {
@@ -92,6 +272,20 @@ int bt_pub_key_gen(struct bt_pub_key_cb *new_cb)
 
     atomic_clear_bit(bt_dev.flags, BT_DEV_HAS_PUB_KEY);
 
+#if defined(CONFIG_BT_HOST_ECC)
+    if (!bt_ecc_hci_supported())
+    {
+        err = host_pub_key_gen();
+        if (err)
+        {
+            BT_ERR("Host P-256 key generation failed (err %d)", err);
+            pub_key_complete(NULL);
+        }
+
+        return err;
+    }
+#endif /* CONFIG_BT_HOST_ECC */
+
     err = bt_hci_cmd_send_sync(BT_HCI_OP_LE_P256_PUBLIC_KEY, NULL, NULL);
     if (err)
     {
@@ -185,6 +379,31 @@ int bt_dh_key_gen(const uint8_t remote_pk[BT_PUB_KEY_LEN], bt_dh_key_cb_t cb)
 
     dh_key_cb = cb;
 
+#if defined(CONFIG_BT_HOST_ECC)
+    if (!bt_ecc_hci_supported())
+    {
+#if defined(CONFIG_BT_SMP_PRECOMPUTE)
+        /* The DHKey is on the pairing critical path, the spare is not. No
+         * bt_pub_key_gen() can be waiting for it, that is BT_DEV_PUB_KEY_BUSY.
+         */
+        if (spare.state == SPARE_BUSY)
+        {
+            bt_ecc_p256_cancel();
+            memset(&spare, 0, sizeof(spare));
+        }
+#endif /* CONFIG_BT_SMP_PRECOMPUTE */
+
+        err = bt_ecc_p256_mul(priv_key, remote_pk, host_dh_key_ready);
+        if (err)
+        {
+            dh_key_cb = NULL;
+            BT_WARN("Failed to generate DHKey (err %d)", err);
+        }
+
+        return err;
+    }
+#endif /* CONFIG_BT_HOST_ECC */
+
     if (IS_ENABLED(CONFIG_BT_USE_DEBUG_KEYS) && BT_CMD_TEST(bt_dev.supported_commands, 41, 2))
     {
         err = hci_generate_dhkey_v2(remote_pk, BT_HCI_LE_KEY_TYPE_DEBUG);
@@ -207,27 +426,10 @@ int bt_dh_key_gen(const uint8_t remote_pk[BT_PUB_KEY_LEN], bt_dh_key_cb_t cb)
 void bt_hci_evt_le_pkey_complete(struct net_buf *buf)
 {
     struct bt_hci_evt_le_p256_public_key_complete *evt = (void *)buf->data;
-    struct bt_pub_key_cb *cb;
 
     BT_DBG("status: 0x%02x", evt->status);
 
-    atomic_clear_bit(bt_dev.flags, BT_DEV_PUB_KEY_BUSY);
-
-    if (!evt->status)
-    {
-        memcpy(pub_key, evt->key, BT_PUB_KEY_LEN);
-        atomic_set_bit(bt_dev.flags, BT_DEV_HAS_PUB_KEY);
-    }
-
-    SYS_SLIST_FOR_EACH_CONTAINER (&pub_key_cb_slist, cb, node)
-    {
-        if (cb->func)
-        {
-            cb->func(evt->status ? NULL : pub_key);
-        }
-    }
-
-    sys_slist_init(&pub_key_cb_slist);
+    pub_key_complete(evt->status ? NULL : evt->key);
 }
 
 void bt_hci_evt_le_dhkey_complete(struct net_buf *buf)
@@ -236,11 +438,5 @@ void bt_hci_evt_le_dhkey_complete(struct net_buf *buf)
 
     BT_DBG("status: 0x%02x", evt->status);
 
-    if (dh_key_cb)
-    {
-        bt_dh_key_cb_t cb = dh_key_cb;
-
-        dh_key_cb = NULL;
-        cb(evt->status ? NULL : evt->dhkey);
-    }
+    dh_key_complete(evt->status ? NULL : evt->dhkey);
 }
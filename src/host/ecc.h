@@ -70,6 +70,13 @@ bool bt_pub_key_is_debug(uint8_t *pub_key_ptr);
  */
 int bt_pub_key_gen(struct bt_pub_key_cb *cb);
 
+/*  @brief Check for controller based ECC.
+ *
+ *  @return True if the controller supports both the LE Read Local P-256
+ *          Public Key and the LE Generate DHKey commands.
+ */
+bool bt_ecc_hci_supported(void);
+
 /*  @brief Get the current Public Key.
  *
  *  Get the current ECC Public Key.
@@ -98,4 +105,60 @@ typedef void (*bt_dh_key_cb_t)(const uint8_t key[BT_DH_KEY_LEN]);
  */
 int bt_dh_key_gen(const uint8_t remote_pk[BT_PUB_KEY_LEN], bt_dh_key_cb_t cb);
 
+#if defined(CONFIG_BT_SMP_PRECOMPUTE) && defined(CONFIG_BT_HOST_ECC)
+/*  @brief Prepare the next local key pair while idle.
+ *
+ *  A spare key pair is computed in the background with the host P-256
+ *  implementation, so that the next bt_pub_key_gen() completes at once.
+ *  Does nothing with controller based ECC or if a spare is already there.
+ */
+void bt_pub_key_precompute(void);
+#else
+static inline void bt_pub_key_precompute(void)
+{
+}
+#endif /* CONFIG_BT_SMP_PRECOMPUTE && CONFIG_BT_HOST_ECC */
+
+#if defined(CONFIG_BT_HOST_ECC)
+/*  @typedef bt_ecc_p256_cb_t
+ *  @brief Callback type for a host P-256 scalar multiplication.
+ *
+ *  @param result X and Y of the resulting point, each LS byte first, or NULL
+ *                in case of failure.
+ */
+typedef void (*bt_ecc_p256_cb_t)(const uint8_t result[BT_PUB_KEY_LEN]);
+
+/*  @brief Check a private key is in the range [1, n - 1].
+ *
+ *  @param k Private key, LS byte first.
+ *
+ *  @return True if the key can be used.
+ */
+bool bt_ecc_p256_key_valid(const uint8_t k[BT_PRIV_KEY_LEN]);
+
+/*  @brief Start a host P-256 scalar multiplication.
+ *
+ *  The multiplication runs in bounded slices from bt_polling_work(), the
+ *  callback is called from there once done.
+ *
+ *  @param k     Private key, LS byte first.
+ *  @param point Public key to multiply, or NULL for the generator.
+ *  @param cb    Callback to notify the result.
+ *
+ *  @return Zero on success, -EBUSY if a multiplication is ongoing or -EINVAL
+ *          if the key or the point is invalid.
+ */
+int bt_ecc_p256_mul(const uint8_t k[BT_PRIV_KEY_LEN], const uint8_t point[BT_PUB_KEY_LEN],
+                    bt_ecc_p256_cb_t cb);
+
+/*  @brief Check if a host P-256 multiplication is ongoing. */
+bool bt_ecc_p256_busy(void);
+
+/*  @brief Drop the ongoing host P-256 multiplication without calling back. */
+void bt_ecc_p256_cancel(void);
+
+/*  @brief Run one slice of the ongoing host P-256 multiplication. */
+void bt_ecc_p256_polling_work(void);
+#endif /* CONFIG_BT_HOST_ECC */
+
 #endif /* _ZEPHYR_POLLING_HOST_ECC_H_ */
\ No newline at end of file
@@ -0,0 +1,515 @@
+/* ecc_p256.c - Host P-256 scalar multiplication run in polling slices */
+
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+
+#include "ecc.h"
+
+#include "base/byteorder.h"
+#include "base/sys_clock.h"
+
+#define BT_DBG_ENABLED  IS_ENABLED(CONFIG_BT_DEBUG_HCI_CORE)
+#define LOG_MODULE_NAME bt_ecc_p256
+#include "logging/bt_log.h"
+
+#if defined(CONFIG_BT_HOST_ECC)
+
+#define P256_WORDS 8
+
+/* Square-and-multiply steps are ~1/16 of a ladder bit */
+#define P256_SLICE_BITS     CONFIG_BT_HOST_ECC_SLICE_BITS
+#define P256_SLICE_INV_BITS (CONFIG_BT_HOST_ECC_SLICE_BITS * 16)
+
+/* All field elements are little endian 32-bit words, constants marked _M
+ * are in Montgomery form (x * 2^256 mod p).
+ */
+static const uint32_t curve_p[P256_WORDS] = {0xffffffff, 0xffffffff, 0xffffffff, 0x00000000,
+                                             0x00000000, 0x00000000, 0x00000001, 0xffffffff};
+static const uint32_t curve_n[P256_WORDS] = {0xfc632551, 0xf3b9cac2, 0xa7179e84, 0xbce6faad,
+                                             0xffffffff, 0xffffffff, 0x00000000, 0xffffffff};
+/* p - 2, the exponent for inversion */
+static const uint32_t curve_p_2[P256_WORDS] = {0xfffffffd, 0xffffffff, 0xffffffff, 0x00000000,
+                                               0x00000000, 0x00000000, 0x00000001, 0xffffffff};
+/* 2^512 mod p, converts into Montgomery form */
+static const uint32_t curve_r2[P256_WORDS] = {0x00000003, 0x00000000, 0xffffffff, 0xfffffffb,
+                                              0xfffffffe, 0xffffffff, 0xfffffffd, 0x00000004};
+static const uint32_t curve_one_m[P256_WORDS] = {0x00000001, 0x00000000, 0x00000000, 0xffffffff,
+                                                 0xffffffff, 0xffffffff, 0xfffffffe, 0x00000000};
+static const uint32_t curve_b_m[P256_WORDS] = {0x29c4bddf, 0xd89cdf62, 0x78843090, 0xacf005cd,
+                                               0xf7212ed6, 0xe5a220ab, 0x04874834, 0xdc30061d};
+static const uint32_t curve_gx[P256_WORDS] = {0xd898c296, 0xf4a13945, 0x2deb33a0, 0x77037d81,
+                                              0x63a440f2, 0xf8bce6e5, 0xe12c4247, 0x6b17d1f2};
+static const uint32_t curve_gy[P256_WORDS] = {0x37bf51f5, 0xcbb64068, 0x6b315ece, 0x2bce3357,
+                                              0x7c0f9e16, 0x8ee7eb4a, 0xfe1a7f9b, 0x4fe342e2};
+
+/* Projective (X:Y:Z) point, coordinates in Montgomery form */
+struct p256_point
+{
+    uint32_t x[P256_WORDS];
+    uint32_t y[P256_WORDS];
+    uint32_t z[P256_WORDS];
+};
+
+enum
+{
+    P256_IDLE,
+    P256_LADDER,
+    P256_INVERT,
+};
+
+static struct
+{
+    uint8_t state;
+    /* Scalar and ladder state */
+    uint32_t k[P256_WORDS];
+    struct p256_point r0;
+    struct p256_point r1;
+    int16_t bit;
+    /* Inversion of r0.z */
+    uint32_t inv[P256_WORDS];
+    int16_t inv_bit;
+
+    bt_ecc_p256_cb_t cb;
+
+    uint32_t started;
+    uint32_t slices;
+    uint32_t slice_max;
+} job;
+
+static uint32_t fe_add_raw(uint32_t *r, const uint32_t *a, const uint32_t *b)
+{
+    uint64_t c = 0;
+    uint8_t i;
+
+    for (i = 0U; i < P256_WORDS; i++)
+    {
+        c += (uint64_t)a[i] + b[i];
+        r[i] = (uint32_t)c;
+        c >>= 32;
+    }
+
+    return (uint32_t)c;
+}
+
+static uint32_t fe_sub_raw(uint32_t *r, const uint32_t *a, const uint32_t *b)
+{
+    uint64_t d;
+    uint32_t borrow = 0U;
+    uint8_t i;
+
+    for (i = 0U; i < P256_WORDS; i++)
+    {
+        d = (uint64_t)a[i] - b[i] - borrow;
+        r[i] = (uint32_t)d;
+        borrow = (uint32_t)(d >> 63);
+    }
+
+    return borrow;
+}
+
+/* r = mask ? a : r, mask is all ones or zero */
+static void fe_cmov(uint32_t *r, const uint32_t *a, uint32_t mask)
+{
+    uint8_t i;
+
+    for (i = 0U; i < P256_WORDS; i++)
+    {
+        r[i] ^= mask & (r[i] ^ a[i]);
+    }
+}
+
+static void fe_add(uint32_t *r, const uint32_t *a, const uint32_t *b)
+{
+    uint32_t t[P256_WORDS];
+    uint32_t carry;
+    uint32_t borrow;
+
+    carry = fe_add_raw(r, a, b);
+    borrow = fe_sub_raw(t, r, curve_p);
+
+    fe_cmov(r, t, 0U - (carry | (borrow ^ 1U)));
+}
+
+static void fe_sub(uint32_t *r, const uint32_t *a, const uint32_t *b)
+{
+    uint32_t t[P256_WORDS];
+    uint32_t borrow;
+
+    borrow = fe_sub_raw(r, a, b);
+    (void)fe_add_raw(t, r, curve_p);
+
+    fe_cmov(r, t, 0U - borrow);
+}
+
+/* Montgomery multiplication, r = a * b / 2^256 mod p. As p = -1 mod 2^32
+ * the per word reduction factor is simply the low word.
+ */
+static void fe_mul(uint32_t *r, const uint32_t *a, const uint32_t *b)
+{
+    uint32_t t[P256_WORDS + 2] = {0};
+    uint32_t s[P256_WORDS];
+    uint32_t borrow;
+    uint32_t m;
+    uint64_t c;
+    uint8_t i, j;
+
+    for (i = 0U; i < P256_WORDS; i++)
+    {
+        c = 0U;
+        for (j = 0U; j < P256_WORDS; j++)
+        {
+            c += (uint64_t)a[j] * b[i] + t[j];
+            t[j] = (uint32_t)c;
+            c >>= 32;
+        }
+        c += t[P256_WORDS];
+        t[P256_WORDS] = (uint32_t)c;
+        t[P256_WORDS + 1] = (uint32_t)(c >> 32);
+
+        m = t[0];
+        c = ((uint64_t)m * curve_p[0] + t[0]) >> 32;
+        for (j = 1U; j < P256_WORDS; j++)
+        {
+            c += (uint64_t)m * curve_p[j] + t[j];
+            t[j - 1] = (uint32_t)c;
+            c >>= 32;
+        }
+        c += t[P256_WORDS];
+        t[P256_WORDS - 1] = (uint32_t)c;
+        t[P256_WORDS] = t[P256_WORDS + 1] + (uint32_t)(c >> 32);
+    }
+
+    borrow = fe_sub_raw(s, t, curve_p);
+    memcpy(r, t, sizeof(s));
+    fe_cmov(r, s, 0U - (t[P256_WORDS] | (borrow ^ 1U)));
+}
+
+static uint32_t fe_is_zero(const uint32_t *a)
+{
+    uint32_t acc = 0U;
+    uint8_t i;
+
+    for (i = 0U; i < P256_WORDS; i++)
+    {
+        acc |= a[i];
+    }
+
+    return ((acc | (0U - acc)) >> 31) ^ 1U;
+}
+
+static void fe_from_bytes(uint32_t *r, const uint8_t *buf)
+{
+    uint8_t i;
+
+    for (i = 0U; i < P256_WORDS; i++)
+    {
+        r[i] = sys_get_le32(&buf[i * 4U]);
+    }
+}
+
+static void fe_to_bytes(uint8_t *buf, const uint32_t *a)
+{
+    uint8_t i;
+
+    for (i = 0U; i < P256_WORDS; i++)
+    {
+        sys_put_le32(a[i], &buf[i * 4U]);
+    }
+}
+
+/* a < m, for public range checks */
+static bool fe_less(const uint32_t *a, const uint32_t *m)
+{
+    uint32_t t[P256_WORDS];
+
+    return fe_sub_raw(t, a, m) == 1U;
+}
+
+/* Complete addition for a = -3, Renes-Costello-Batina 2015, Algorithm 4.
+ * Valid for all inputs including doubling and the point at infinity, so the
+ * ladder has no data dependent branches.
+ */
+static void point_add(struct p256_point *r, const struct p256_point *p,
+                      const struct p256_point *q)
+{
+    uint32_t t0[P256_WORDS], t1[P256_WORDS], t2[P256_WORDS], t3[P256_WORDS];
+    uint32_t t4[P256_WORDS], x3[P256_WORDS], y3[P256_WORDS], z3[P256_WORDS];
+
+    fe_mul(t0, p->x, q->x);
+    fe_mul(t1, p->y, q->y);
+    fe_mul(t2, p->z, q->z);
+    fe_add(t3, p->x, p->y);
+    fe_add(t4, q->x, q->y);
+    fe_mul(t3, t3, t4);
+    fe_add(t4, t0, t1);
+    fe_sub(t3, t3, t4);
+    fe_add(t4, p->y, p->z);
+    fe_add(x3, q->y, q->z);
+    fe_mul(t4, t4, x3);
+    fe_add(x3, t1, t2);
+    fe_sub(t4, t4, x3);
+    fe_add(x3, p->x, p->z);
+    fe_add(y3, q->x, q->z);
+    fe_mul(x3, x3, y3);
+    fe_add(y3, t0, t2);
+    fe_sub(y3, x3, y3);
+    fe_mul(z3, curve_b_m, t2);
+    fe_sub(x3, y3, z3);
+    fe_add(z3, x3, x3);
+    fe_add(x3, x3, z3);
+    fe_sub(z3, t1, x3);
+    fe_add(x3, t1, x3);
+    fe_mul(y3, curve_b_m, y3);
+    fe_add(t1, t2, t2);
+    fe_add(t2, t1, t2);
+    fe_sub(y3, y3, t2);
+    fe_sub(y3, y3, t0);
+    fe_add(t1, y3, y3);
+    fe_add(y3, t1, y3);
+    fe_add(t1, t0, t0);
+    fe_add(t0, t1, t0);
+    fe_sub(t0, t0, t2);
+    fe_mul(t1, t4, y3);
+    fe_mul(t2, t0, y3);
+    fe_mul(y3, x3, z3);
+    fe_add(y3, y3, t2);
+    fe_mul(x3, x3, t3);
+    fe_sub(x3, x3, t1);
+    fe_mul(z3, z3, t4);
+    fe_mul(t1, t3, t0);
+    fe_add(z3, z3, t1);
+
+    memcpy(r->x, x3, sizeof(x3));
+    memcpy(r->y, y3, sizeof(y3));
+    memcpy(r->z, z3, sizeof(z3));
+}
+
+static void point_cswap(struct p256_point *a, struct p256_point *b, uint32_t bit)
+{
+    uint32_t *pa = (uint32_t *)a;
+    uint32_t *pb = (uint32_t *)b;
+    uint32_t mask = 0U - bit;
+    uint32_t t;
+    uint8_t i;
+
+    for (i = 0U; i < 3U * P256_WORDS; i++)
+    {
+        t = mask & (pa[i] ^ pb[i]);
+        pa[i] ^= t;
+        pb[i] ^= t;
+    }
+}
+
+/* Affine point in Montgomery form on y^2 = x^3 - 3x + b */
+static bool point_on_curve(const uint32_t *x, const uint32_t *y)
+{
+    uint32_t lhs[P256_WORDS];
+    uint32_t rhs[P256_WORDS];
+    uint32_t t[P256_WORDS];
+
+    fe_mul(lhs, y, y);
+
+    fe_mul(t, x, x);
+    fe_mul(rhs, t, x);
+    fe_sub(rhs, rhs, x);
+    fe_sub(rhs, rhs, x);
+    fe_sub(rhs, rhs, x);
+    fe_add(rhs, rhs, curve_b_m);
+
+    return !memcmp(lhs, rhs, sizeof(lhs));
+}
+
+bool bt_ecc_p256_key_valid(const uint8_t k[32])
+{
+    uint32_t d[P256_WORDS];
+    bool valid;
+
+    fe_from_bytes(d, k);
+    valid = !fe_is_zero(d) && fe_less(d, curve_n);
+    memset(d, 0, sizeof(d));
+
+    return valid;
+}
+
+int bt_ecc_p256_mul(const uint8_t k[32], const uint8_t point[64], bt_ecc_p256_cb_t cb)
+{
+    uint32_t x[P256_WORDS];
+    uint32_t y[P256_WORDS];
+
+    if (job.state != P256_IDLE)
+    {
+        return -EBUSY;
+    }
+
+    if (!bt_ecc_p256_key_valid(k))
+    {
+        return -EINVAL;
+    }
+
+    if (point)
+    {
+        fe_from_bytes(x, point);
+        fe_from_bytes(y, &point[32]);
+
+        if (!fe_less(x, curve_p) || !fe_less(y, curve_p))
+        {
+            return -EINVAL;
+        }
+    }
+    else
+    {
+        memcpy(x, curve_gx, sizeof(x));
+        memcpy(y, curve_gy, sizeof(y));
+    }
+
+    fe_mul(job.r1.x, x, curve_r2);
+    fe_mul(job.r1.y, y, curve_r2);
+    memcpy(job.r1.z, curve_one_m, sizeof(job.r1.z));
+
+    /* Reject invalid curve points before using them with our key */
+    if (!point_on_curve(job.r1.x, job.r1.y))
+    {
+        BT_WARN("Public key not on curve");
+        memset(&job, 0, sizeof(job));
+        return -EINVAL;
+    }
+
+    /* r0 starts at infinity (0:1:0) */
+    memset(job.r0.x, 0, sizeof(job.r0.x));
+    memcpy(job.r0.y, curve_one_m, sizeof(job.r0.y));
+    memset(job.r0.z, 0, sizeof(job.r0.z));
+
+    fe_from_bytes(job.k, k);
+    job.bit = 255;
+    job.cb = cb;
+    job.started = sys_clock_tick_get();
+    job.slices = 0U;
+    job.slice_max = 0U;
+    job.state = P256_LADDER;
+
+    return 0;
+}
+
+bool bt_ecc_p256_busy(void)
+{
+    return job.state != P256_IDLE;
+}
+
+void bt_ecc_p256_cancel(void)
+{
+    memset(&job, 0, sizeof(job));
+}
+
+static void ladder_step(void)
+{
+    uint32_t bit = (job.k[job.bit / 32] >> (job.bit % 32)) & 1U;
+
+    point_cswap(&job.r0, &job.r1, bit);
+    point_add(&job.r1, &job.r0, &job.r1);
+    point_add(&job.r0, &job.r0, &job.r0);
+    point_cswap(&job.r0, &job.r1, bit);
+
+    job.bit--;
+}
+
+static void invert_step(void)
+{
+    fe_mul(job.inv, job.inv, job.inv);
+
+    /* The exponent is public, branching on it leaks nothing */
+    if ((curve_p_2[job.inv_bit / 32] >> (job.inv_bit % 32)) & 1U)
+    {
+        fe_mul(job.inv, job.inv, job.r0.z);
+    }
+
+    job.inv_bit--;
+}
+
+static void job_finish(void)
+{
+    static const uint32_t one[P256_WORDS] = {1};
+    bt_ecc_p256_cb_t cb = job.cb;
+    uint8_t out[64];
+    uint32_t t[P256_WORDS];
+    bool valid;
+
+    /* Infinity only comes out of a small order input */
+    valid = !fe_is_zero(job.r0.z);
+
+    if (valid)
+    {
+        fe_mul(t, job.r0.x, job.inv);
+        fe_mul(t, t, one);
+        fe_to_bytes(out, t);
+
+        fe_mul(t, job.r0.y, job.inv);
+        fe_mul(t, t, one);
+        fe_to_bytes(&out[32], t);
+    }
+
+    /* Times are kept in ticks, a single slice usually takes well under 1 ms */
+    BT_INFO("P-256 done in %u ms, %u slices, longest %u us",
+            k_ticks_to_ms_floor32(sys_clock_tick_get() - job.started), job.slices,
+            k_ticks_to_us_floor32(job.slice_max));
+
+    memset(&job, 0, sizeof(job));
+    memset(t, 0, sizeof(t));
+
+    cb(valid ? out : NULL);
+
+    memset(out, 0, sizeof(out));
+}
+
+void bt_ecc_p256_polling_work(void)
+{
+    uint32_t start;
+    uint32_t elapsed;
+    uint16_t n;
+
+    if (job.state == P256_IDLE)
+    {
+        return;
+    }
+
+    start = sys_clock_tick_get();
+
+    if (job.state == P256_LADDER)
+    {
+        for (n = 0U; n < P256_SLICE_BITS && job.bit >= 0; n++)
+        {
+            ladder_step();
+        }
+
+        if (job.bit < 0)
+        {
+            memset(job.k, 0, sizeof(job.k));
+            memset(&job.r1, 0, sizeof(job.r1));
+            memcpy(job.inv, curve_one_m, sizeof(job.inv));
+            job.inv_bit = 255;
+            job.state = P256_INVERT;
+        }
+    }
+    else
+    {
+        for (n = 0U; n < P256_SLICE_INV_BITS && job.inv_bit >= 0; n++)
+        {
+            invert_step();
+        }
+    }
+
+    elapsed = sys_clock_tick_get() - start;
+    job.slices++;
+    job.slice_max = MAX(job.slice_max, elapsed);
+
+    if (job.state == P256_INVERT && job.inv_bit < 0)
+    {
+        job_finish();
+    }
+}
+
+#endif /* CONFIG_BT_HOST_ECC */
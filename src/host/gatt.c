@@ -18,6 +18,7 @@
 #include "base/byteorder.h"
 #include "base/common.h"
 
+#include "common/aes_cmac.h"
 #include "common/bt_storage_kv.h"
 
 #include <bluetooth/hci.h>
@@ -683,7 +684,7 @@ static ssize_t cf_write(struct bt_conn *conn, const struct bt_gatt_attr *attr, c
 
 struct gen_hash_state
 {
-    struct tc_cmac_struct state;
+    struct bt_aes_cmac_ctx state;
     int err;
 };
 
@@ -750,14 +751,14 @@ static uint8_t gen_hash_m(const struct bt_gatt_attr *attr, uint16_t handle, void
     case BT_UUID_GATT_CHRC_VAL:
     case BT_UUID_GATT_CEP_VAL:
         value = sys_cpu_to_le16(handle);
-        if (tc_cmac_update(&state->state, (uint8_t *)&value, sizeof(handle)) == TC_CRYPTO_FAIL)
+        if (bt_aes_cmac_update(&state->state, (uint8_t *)&value, sizeof(handle)))
         {
             state->err = -EINVAL;
             return BT_GATT_ITER_STOP;
         }
 
         value = sys_cpu_to_le16(u16->val);
-        if (tc_cmac_update(&state->state, (uint8_t *)&value, sizeof(u16->val)) == TC_CRYPTO_FAIL)
+        if (bt_aes_cmac_update(&state->state, (uint8_t *)&value, sizeof(u16->val)))
         {
             state->err = -EINVAL;
             return BT_GATT_ITER_STOP;
@@ -770,7 +771,7 @@ static uint8_t gen_hash_m(const struct bt_gatt_attr *attr, uint16_t handle, void
             return BT_GATT_ITER_STOP;
         }
 
-        if (tc_cmac_update(&state->state, data, len) == TC_CRYPTO_FAIL)
+        if (bt_aes_cmac_update(&state->state, data, len))
         {
             state->err = -EINVAL;
             return BT_GATT_ITER_STOP;
@@ -784,14 +785,14 @@ static uint8_t gen_hash_m(const struct bt_gatt_attr *attr, uint16_t handle, void
     case BT_UUID_GATT_CPF_VAL:
     case BT_UUID_GATT_CAF_VAL:
         value = sys_cpu_to_le16(handle);
-        if (tc_cmac_update(&state->state, (uint8_t *)&value, sizeof(handle)) == TC_CRYPTO_FAIL)
+        if (bt_aes_cmac_update(&state->state, (uint8_t *)&value, sizeof(handle)))
         {
             state->err = -EINVAL;
             return BT_GATT_ITER_STOP;
         }
 
         value = sys_cpu_to_le16(u16->val);
-        if (tc_cmac_update(&state->state, (uint8_t *)&value, sizeof(u16->val)) == TC_CRYPTO_FAIL)
+        if (bt_aes_cmac_update(&state->state, (uint8_t *)&value, sizeof(u16->val)))
         {
             state->err = -EINVAL;
             return BT_GATT_ITER_STOP;
@@ -820,10 +821,11 @@ static void db_hash_store(void)
 static void db_hash_gen(bool store)
 {
     uint8_t key[16] = {};
-    struct tc_aes_key_sched_struct sched;
     struct gen_hash_state state;
 
-    if (tc_cmac_setup(&state.state, key, &sched) == TC_CRYPTO_FAIL)
+    state.err = 0;
+
+    if (bt_aes_cmac_setup_cached(&state.state, key))
     {
         BT_ERR("Unable to setup AES CMAC");
         return;
@@ -831,7 +833,13 @@ static void db_hash_gen(bool store)
 
     bt_gatt_foreach_attr(0x0001, 0xffff, gen_hash_m, &state);
 
-    if (tc_cmac_final(db_hash.hash, &state.state) == TC_CRYPTO_FAIL)
+    if (state.err)
+    {
+        BT_ERR("Unable to hash attributes (err %d)", state.err);
+        return;
+    }
+
+    if (bt_aes_cmac_final(&state.state, db_hash.hash))
     {
         BT_ERR("Unable to calculate hash");
         return;
@@ -1016,6 +1024,85 @@ static int bt_gatt_store_cf(struct bt_conn *conn)
     return 0;
 }
 
+#if defined(CONFIG_BT_GATT_CCC_SPARSE)
+/* CCC configurations of all attributes share one pool, only peers that wrote
+ * a CCC use an entry instead of every CCC reserving one per possible peer.
+ */
+struct ccc_cfg_entry
+{
+    struct _bt_gatt_ccc *ccc;
+    struct bt_gatt_ccc_cfg cfg;
+};
+
+static struct ccc_cfg_entry ccc_cfg_pool[CONFIG_BT_GATT_CCC_SPARSE_POOL];
+
+static struct bt_gatt_ccc_cfg *ccc_cfg_next(struct _bt_gatt_ccc *ccc, struct bt_gatt_ccc_cfg *cfg)
+{
+    struct ccc_cfg_entry *entry;
+
+    entry = cfg ? CONTAINER_OF(cfg, struct ccc_cfg_entry, cfg) + 1 : &ccc_cfg_pool[0];
+
+    for (; entry < &ccc_cfg_pool[ARRAY_SIZE(ccc_cfg_pool)]; entry++)
+    {
+        if (entry->ccc == ccc)
+        {
+            return &entry->cfg;
+        }
+    }
+
+    return NULL;
+}
+
+static struct bt_gatt_ccc_cfg *ccc_cfg_alloc(struct _bt_gatt_ccc *ccc)
+{
+    struct bt_gatt_ccc_cfg *cfg;
+
+    cfg = ccc_cfg_next(NULL, NULL);
+    if (cfg)
+    {
+        CONTAINER_OF(cfg, struct ccc_cfg_entry, cfg)->ccc = ccc;
+    }
+
+    return cfg;
+}
+#else
+static struct bt_gatt_ccc_cfg *ccc_cfg_next(struct _bt_gatt_ccc *ccc, struct bt_gatt_ccc_cfg *cfg)
+{
+    cfg = cfg ? cfg + 1 : &ccc->cfg[0];
+
+    return cfg < &ccc->cfg[ARRAY_SIZE(ccc->cfg)] ? cfg : NULL;
+}
+
+static struct bt_gatt_ccc_cfg *ccc_cfg_alloc(struct _bt_gatt_ccc *ccc)
+{
+    struct bt_gatt_ccc_cfg *cfg;
+
+    for (cfg = ccc_cfg_next(ccc, NULL); cfg; cfg = ccc_cfg_next(ccc, cfg))
+    {
+        if (!bt_addr_le_cmp(&cfg->peer, BT_ADDR_LE_ANY))
+        {
+            return cfg;
+        }
+    }
+
+    return NULL;
+}
+#endif /* CONFIG_BT_GATT_CCC_SPARSE */
+
+#define CCC_CFG_FOREACH(_ccc, _cfg)                                                                \
+    for (_cfg = ccc_cfg_next(_ccc, NULL); _cfg; _cfg = ccc_cfg_next(_ccc, _cfg))
+
+static void clear_ccc_cfg(struct bt_gatt_ccc_cfg *cfg)
+{
+    bt_addr_le_copy(&cfg->peer, BT_ADDR_LE_ANY);
+    cfg->id = 0U;
+    cfg->value = 0U;
+
+#if defined(CONFIG_BT_GATT_CCC_SPARSE)
+    CONTAINER_OF(cfg, struct ccc_cfg_entry, cfg)->ccc = NULL;
+#endif /* CONFIG_BT_GATT_CCC_SPARSE */
+}
+
 #if defined(CONFIG_BT_SETTINGS) && defined(CONFIG_BT_SMP) && defined(CONFIG_BT_GATT_CLIENT)
 /** Struct used to store both the id and the random address of a device when replacing
  * random addresses in the ccc attribute's cfg array with the device's id address after
@@ -1031,6 +1118,7 @@ static uint8_t convert_to_id_on_match(const struct bt_gatt_attr *attr, uint16_t
                                       void *user_data)
 {
     struct _bt_gatt_ccc *ccc;
+    struct bt_gatt_ccc_cfg *cfg;
     struct addr_match *match = user_data;
 
     /* Check if attribute is a CCC */
@@ -1044,11 +1132,11 @@ static uint8_t convert_to_id_on_match(const struct bt_gatt_attr *attr, uint16_t
     /* Copy the device's id address to the config's address if the config's address is the
      * same as the device's private address
      */
-    for (size_t i = 0; i < ARRAY_SIZE(ccc->cfg); i++)
+    CCC_CFG_FOREACH (ccc, cfg)
     {
-        if (bt_addr_le_cmp(&ccc->cfg[i].peer, match->private_addr) == 0)
+        if (bt_addr_le_cmp(&cfg->peer, match->private_addr) == 0)
         {
-            bt_addr_le_copy(&ccc->cfg[i].peer, match->id_addr);
+            bt_addr_le_copy(&cfg->peer, match->id_addr);
         }
     }
 
@@ -1270,13 +1358,6 @@ static void sc_process(struct k_work *work)
 }
 #endif /* defined(CONFIG_BT_GATT_SERVICE_CHANGED) */
 
-static void clear_ccc_cfg(struct bt_gatt_ccc_cfg *cfg)
-{
-    bt_addr_le_copy(&cfg->peer, BT_ADDR_LE_ANY);
-    cfg->id = 0U;
-    cfg->value = 0U;
-}
-
 #if defined(CONFIG_BT_SETTINGS_CCC_STORE_ON_WRITE)
 static struct gatt_ccc_store
 {
@@ -1542,12 +1623,12 @@ static void db_changed(void)
 
 static void gatt_unregister_ccc(struct _bt_gatt_ccc *ccc)
 {
+    struct bt_gatt_ccc_cfg *cfg;
+
     ccc->value = 0;
 
-    for (size_t i = 0; i < ARRAY_SIZE(ccc->cfg); i++)
+    CCC_CFG_FOREACH (ccc, cfg)
     {
-        struct bt_gatt_ccc_cfg *cfg = &ccc->cfg[i];
-
         if (bt_addr_le_cmp(&cfg->peer, BT_ADDR_LE_ANY))
         {
             struct bt_conn *conn;
@@ -2022,18 +2103,16 @@ struct bt_gatt_attr *bt_gatt_attr_next(const struct bt_gatt_attr *attr)
 
 static struct bt_gatt_ccc_cfg *find_ccc_cfg(const struct bt_conn *conn, struct _bt_gatt_ccc *ccc)
 {
-    for (size_t i = 0; i < ARRAY_SIZE(ccc->cfg); i++)
+    struct bt_gatt_ccc_cfg *cfg;
+
+    if (!conn)
     {
-        struct bt_gatt_ccc_cfg *cfg = &ccc->cfg[i];
+        return ccc_cfg_alloc(ccc);
+    }
 
-        if (conn)
-        {
-            if (bt_conn_is_peer_addr_le(conn, cfg->id, &cfg->peer))
-            {
-                return cfg;
-            }
-        }
-        else if (!bt_addr_le_cmp(&cfg->peer, BT_ADDR_LE_ANY))
+    CCC_CFG_FOREACH (ccc, cfg)
+    {
+        if (bt_conn_is_peer_addr_le(conn, cfg->id, &cfg->peer))
         {
             return cfg;
         }
@@ -2065,14 +2144,14 @@ ssize_t bt_gatt_attr_read_ccc(struct bt_conn *conn, const struct bt_gatt_attr *a
 
 static void gatt_ccc_changed(const struct bt_gatt_attr *attr, struct _bt_gatt_ccc *ccc)
 {
-    int i;
+    struct bt_gatt_ccc_cfg *cfg;
     uint16_t value = 0x0000;
 
-    for (i = 0; i < ARRAY_SIZE(ccc->cfg); i++)
+    CCC_CFG_FOREACH (ccc, cfg)
     {
-        if (ccc->cfg[i].value > value)
+        if (cfg->value > value)
         {
-            value = ccc->cfg[i].value;
+            value = cfg->value;
         }
     }
 
@@ -2093,6 +2172,7 @@ ssize_t bt_gatt_attr_write_ccc(struct bt_conn *conn, const struct bt_gatt_attr *
 {
     struct _bt_gatt_ccc *ccc = attr->user_data;
     struct bt_gatt_ccc_cfg *cfg;
+    bool allocated = false;
     bool value_changed;
     uint16_t value;
 
@@ -2136,6 +2216,7 @@ ssize_t bt_gatt_attr_write_ccc(struct bt_conn *conn, const struct bt_gatt_attr *
 
         bt_addr_le_copy(&cfg->peer, &conn->le.dst);
         cfg->id = conn->id;
+        allocated = true;
     }
 
     /* Confirm write if cfg is managed by application */
@@ -2143,15 +2224,23 @@ ssize_t bt_gatt_attr_write_ccc(struct bt_conn *conn, const struct bt_gatt_attr *
     {
         ssize_t write = ccc->cfg_write(conn, attr, value);
 
-        if (write < 0)
+        /* Accept size=1 for backwards compatibility */
+        if (write >= 0 && write != sizeof(value) && write != 1)
         {
-            return write;
+            write = BT_GATT_ERR(BT_ATT_ERR_UNLIKELY);
         }
 
-        /* Accept size=1 for backwards compatibility */
-        if (write != sizeof(value) && write != 1)
+        if (write < 0)
         {
-            return BT_GATT_ERR(BT_ATT_ERR_UNLIKELY);
+            /* A rejected first write must not keep the entry, nothing
+             * else would free it
+             */
+            if (allocated)
+            {
+                clear_ccc_cfg(cfg);
+            }
+
+            return write;
         }
     }
 
@@ -2612,6 +2701,7 @@ static uint8_t notify_cb(const struct bt_gatt_attr *attr, uint16_t handle, void
 {
     struct notify_data *data = user_data;
     struct _bt_gatt_ccc *ccc;
+    struct bt_gatt_ccc_cfg *cfg;
     size_t i;
 
     /* Check attribute user_data must be of type struct _bt_gatt_ccc */
@@ -2650,9 +2740,8 @@ static uint8_t notify_cb(const struct bt_gatt_attr *attr, uint16_t handle, void
     }
 
     /* Notify all peers configured */
-    for (i = 0; i < ARRAY_SIZE(ccc->cfg); i++)
+    CCC_CFG_FOREACH (ccc, cfg)
     {
-        struct bt_gatt_ccc_cfg *cfg = &ccc->cfg[i];
         struct bt_conn *conn;
         int err;
 
@@ -3220,7 +3309,7 @@ static uint8_t update_ccc(const struct bt_gatt_attr *attr, uint16_t handle, void
     struct conn_data *data = user_data;
     struct bt_conn *conn = data->conn;
     struct _bt_gatt_ccc *ccc;
-    size_t i;
+    struct bt_gatt_ccc_cfg *cfg;
     uint8_t err;
 
     /* Check attribute user_data must be of type struct _bt_gatt_ccc */
@@ -3231,10 +3320,8 @@ static uint8_t update_ccc(const struct bt_gatt_attr *attr, uint16_t handle, void
 
     ccc = attr->user_data;
 
-    for (i = 0; i < ARRAY_SIZE(ccc->cfg); i++)
+    CCC_CFG_FOREACH (ccc, cfg)
     {
-        struct bt_gatt_ccc_cfg *cfg = &ccc->cfg[i];
-
         /* Ignore configuration for different peer or not active */
         if (!cfg->value || !bt_conn_is_peer_addr_le(conn, cfg->id, &cfg->peer))
         {
@@ -3288,8 +3375,8 @@ static uint8_t disconnected_cb(const struct bt_gatt_attr *attr, uint16_t handle,
 {
     struct bt_conn *conn = user_data;
     struct _bt_gatt_ccc *ccc;
+    struct bt_gatt_ccc_cfg *cfg;
     bool value_used;
-    size_t i;
 
     /* Check attribute user_data must be of type struct _bt_gatt_ccc */
     if (attr->write != bt_gatt_attr_write_ccc)
@@ -3308,10 +3395,8 @@ static uint8_t disconnected_cb(const struct bt_gatt_attr *attr, uint16_t handle,
     /* Checking if all values are disabled */
     value_used = false;
 
-    for (i = 0; i < ARRAY_SIZE(ccc->cfg); i++)
+    CCC_CFG_FOREACH (ccc, cfg)
     {
-        struct bt_gatt_ccc_cfg *cfg = &ccc->cfg[i];
-
         /* Ignore configurations with disabled value */
         if (!cfg->value)
         {
@@ -3371,7 +3456,8 @@ static uint8_t disconnected_cb(const struct bt_gatt_attr *attr, uint16_t handle,
 
 bool bt_gatt_is_subscribed(struct bt_conn *conn, const struct bt_gatt_attr *attr, uint16_t ccc_type)
 {
-    const struct _bt_gatt_ccc *ccc;
+    struct _bt_gatt_ccc *ccc;
+    struct bt_gatt_ccc_cfg *cfg;
 
     __ASSERT(conn, "invalid parameter\n");
     __ASSERT(attr, "invalid parameter\n");
@@ -3412,11 +3498,9 @@ bool bt_gatt_is_subscribed(struct bt_conn *conn, const struct bt_gatt_attr *attr
     ccc = attr->user_data;
 
     /* Check if the connection is subscribed */
-    for (size_t i = 0; i < BT_GATT_CCC_MAX; i++)
+    CCC_CFG_FOREACH (ccc, cfg)
     {
-        const struct bt_gatt_ccc_cfg *cfg = &ccc->cfg[i];
-
-        if (bt_conn_is_peer_addr_le(conn, cfg->id, &cfg->peer) && (ccc_type & ccc->cfg[i].value))
+        if (bt_conn_is_peer_addr_le(conn, cfg->id, &cfg->peer) && (ccc_type & cfg->value))
         {
             return true;
         }
@@ -3545,6 +3629,10 @@ void bt_gatt_notification(struct bt_conn *conn, uint16_t handle, const void *dat
 
     BT_DBG("handle 0x%04x length %u", handle, length);
 
+#if defined(CONFIG_BT_GATT_CLIENT_CACHE)
+    bt_gatt_cache_notification(conn, handle, data, length);
+#endif /* CONFIG_BT_GATT_CLIENT_CACHE */
+
     sub = gatt_sub_find(conn);
     if (!sub)
     {
@@ -4589,6 +4677,13 @@ int bt_gatt_discover(struct bt_conn *conn, struct bt_gatt_discover_params *param
         return -ENOTCONN;
     }
 
+#if defined(CONFIG_BT_GATT_CLIENT_CACHE)
+    if (!bt_gatt_cache_discover(conn, params))
+    {
+        return 0;
+    }
+#endif /* CONFIG_BT_GATT_CLIENT_CACHE */
+
     switch (params->type)
     {
     case BT_GATT_DISCOVER_PRIMARY:
@@ -4923,6 +5018,13 @@ int bt_gatt_read(struct bt_conn *conn, struct bt_gatt_read_params *params)
         return -ENOTCONN;
     }
 
+#if defined(CONFIG_BT_GATT_READ_COALESCE)
+    if (!bt_gatt_read_coalesce(conn, params))
+    {
+        return 0;
+    }
+#endif /* CONFIG_BT_GATT_READ_COALESCE */
+
     if (params->handle_count == 0)
     {
         return gatt_read_uuid(conn, params);
@@ -5378,6 +5480,13 @@ int bt_gatt_subscribe(struct bt_conn *conn, struct bt_gatt_subscribe_params *par
         int err;
 
 #if defined(CONFIG_BT_GATT_AUTO_DISCOVER_CCC)
+#if defined(CONFIG_BT_GATT_CLIENT_CACHE)
+        if (!params->ccc_handle)
+        {
+            params->ccc_handle =
+                    bt_gatt_cache_find_ccc(conn, params->value_handle, params->end_handle);
+        }
+#endif /* CONFIG_BT_GATT_CLIENT_CACHE */
         if (!params->ccc_handle)
         {
             return gatt_ccc_discover(conn, params);
@@ -5511,6 +5620,20 @@ void bt_gatt_cancel(struct bt_conn *conn, void *params)
     struct bt_att_req *req;
     bt_att_func_t func = NULL;
 
+#if defined(CONFIG_BT_GATT_CLIENT_CACHE)
+    if (bt_gatt_cache_cancel(conn, params))
+    {
+        return;
+    }
+#endif /* CONFIG_BT_GATT_CLIENT_CACHE */
+
+#if defined(CONFIG_BT_GATT_READ_COALESCE)
+    if (bt_gatt_read_coalesce_cancel(conn, params))
+    {
+        return;
+    }
+#endif /* CONFIG_BT_GATT_READ_COALESCE */
+
     // k_sched_lock();
 
     req = bt_att_find_req_by_user_data(conn, params);
@@ -5574,11 +5697,13 @@ static struct bt_gatt_exchange_params gatt_exchange_params = {
 static struct bt_gatt_ccc_cfg *ccc_find_cfg(struct _bt_gatt_ccc *ccc, const bt_addr_le_t *addr,
                                             uint8_t id)
 {
-    for (size_t i = 0; i < ARRAY_SIZE(ccc->cfg); i++)
+    struct bt_gatt_ccc_cfg *cfg;
+
+    CCC_CFG_FOREACH (ccc, cfg)
     {
-        if (id == ccc->cfg[i].id && !bt_addr_le_cmp(&ccc->cfg[i].peer, addr))
+        if (id == cfg->id && !bt_addr_le_cmp(&cfg->peer, addr))
         {
-            return &ccc->cfg[i];
+            return cfg;
         }
     }
 
@@ -5660,7 +5785,7 @@ static uint8_t ccc_load(const struct bt_gatt_attr *attr, uint16_t handle, void *
     cfg = ccc_find_cfg(ccc, load->addr_with_id.addr, load->addr_with_id.id);
     if (!cfg)
     {
-        cfg = ccc_find_cfg(ccc, BT_ADDR_LE_ANY, 0);
+        cfg = ccc_cfg_alloc(ccc);
         if (!cfg)
         {
             BT_DBG("Unable to restore CCC: no cfg left");
@@ -5858,6 +5983,12 @@ void bt_gatt_connected(struct bt_conn *conn)
 
 #if defined(CONFIG_BT_GATT_CLIENT)
     add_subscriptions(conn);
+#if defined(CONFIG_BT_GATT_CLIENT_CACHE)
+    bt_gatt_cache_connected(conn);
+#endif /* CONFIG_BT_GATT_CLIENT_CACHE */
+#if defined(CONFIG_BT_GATT_READ_COALESCE)
+    bt_gatt_read_coalesce_connected(conn);
+#endif /* CONFIG_BT_GATT_READ_COALESCE */
 #if defined(CONFIG_BT_GATT_AUTO_UPDATE_MTU)
     int err;
 
@@ -6308,7 +6439,7 @@ static uint8_t remove_peer_from_attr(const struct bt_gatt_attr *attr, uint16_t h
     cfg = ccc_find_cfg(ccc, addr_with_id->addr, addr_with_id->id);
     if (cfg)
     {
-        memset(cfg, 0, sizeof(*cfg));
+        clear_ccc_cfg(cfg);
     }
 
     return BT_GATT_ITER_CONTINUE;
@@ -6444,6 +6575,10 @@ int bt_gatt_clear(uint8_t id, const bt_addr_le_t *addr)
         bt_gatt_clear_subscriptions(id, addr);
     }
 
+#if defined(CONFIG_BT_GATT_CLIENT_CACHE)
+    bt_gatt_cache_clear(id, addr);
+#endif /* CONFIG_BT_GATT_CLIENT_CACHE */
+
     return 0;
 }
 
@@ -6479,6 +6614,12 @@ void bt_gatt_disconnected(struct bt_conn *conn)
     }
 
 #if defined(CONFIG_BT_GATT_CLIENT)
+#if defined(CONFIG_BT_GATT_CLIENT_CACHE)
+    bt_gatt_cache_disconnected(conn);
+#endif /* CONFIG_BT_GATT_CLIENT_CACHE */
+#if defined(CONFIG_BT_GATT_READ_COALESCE)
+    bt_gatt_read_coalesce_disconnected(conn);
+#endif /* CONFIG_BT_GATT_READ_COALESCE */
     remove_subscriptions(conn);
 #endif /* CONFIG_BT_GATT_CLIENT */
 
@@ -0,0 +1,1185 @@
+/* gatt_cache.c - GATT client attribute cache */
+
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <string.h>
+#include <errno.h>
+#include <stdbool.h>
+
+#include "gatt_internal.h"
+
+#include "base/byteorder.h"
+#include "base/common.h"
+
+#include "common/bt_storage_kv.h"
+#include "common/work.h"
+
+#include <bluetooth/bluetooth.h>
+#include <bluetooth/conn.h>
+#include <bluetooth/uuid.h>
+#include <bluetooth/gatt.h>
+
+#define BT_DBG_ENABLED  IS_ENABLED(CONFIG_BT_DEBUG_GATT)
+#define LOG_MODULE_NAME bt_gatt_cache
+#include "logging/bt_log.h"
+
+#include "hci_core.h"
+#include "conn_internal.h"
+
+#if defined(CONFIG_BT_GATT_CLIENT_CACHE)
+
+#define GATT_CACHE_MAGIC   0x4743
+#define GATT_CACHE_VERSION 1
+
+#define GATT_CACHE_ATTR_MAX CONFIG_BT_GATT_CLIENT_CACHE_ATTR_MAX
+#define GATT_CACHE_PENDING  CONFIG_BT_GATT_CLIENT_CACHE_PENDING
+
+enum
+{
+    CACHE_STATE_IDLE,       /* No usable database, discovery goes over the air */
+    CACHE_STATE_VALIDATING, /* Stored database loaded, reading peer Database Hash */
+    CACHE_STATE_FILLING,    /* Walking the peer database */
+    CACHE_STATE_VALID,      /* Discovery is served from the cache */
+    CACHE_STATE_DISABLED,   /* Peer database could not be cached on this link */
+};
+
+enum
+{
+    CACHE_FILL_HASH,
+    CACHE_FILL_ATTR,
+    CACHE_FILL_PRIMARY,
+    CACHE_FILL_SECONDARY,
+    CACHE_FILL_INCLUDE,
+    CACHE_FILL_CHRC,
+};
+
+enum
+{
+    CACHE_ATTR_OTHER,
+    CACHE_ATTR_PRIMARY,
+    CACHE_ATTR_SECONDARY,
+    CACHE_ATTR_INCLUDE,
+    CACHE_ATTR_CHRC,
+};
+
+/* Cached remote attribute, for declarations uuid holds the declared UUID and
+ * val[] the declaration value (end handle, included range or value handle).
+ */
+struct gatt_cache_attr
+{
+    uint16_t handle;
+    uint16_t val[2];
+    uint8_t kind;
+    uint8_t props;
+    uint8_t uuid_len;
+    uint8_t uuid[BT_UUID_SIZE_128];
+} __packed;
+
+/* Persistent storage format for a peer database */
+struct gatt_cache_store_hdr
+{
+    uint16_t magic;
+    uint8_t version;
+    uint8_t id;
+    bt_addr_le_t addr;
+    uint8_t has_hash;
+    uint8_t hash[16];
+    uint16_t count;
+} __packed;
+
+struct gatt_cache_store
+{
+    struct gatt_cache_store_hdr hdr;
+    struct gatt_cache_attr attrs[GATT_CACHE_ATTR_MAX];
+} __packed;
+
+/* Owner of each storage slot, read from the backend once */
+struct gatt_cache_slot
+{
+    bool used;
+    uint8_t id;
+    bt_addr_le_t addr;
+};
+
+struct gatt_cache
+{
+    struct bt_conn *conn;
+    uint8_t state;
+    uint8_t fill_step;
+    bool stored;
+    bool bypass;
+    uint16_t sc_handle;
+
+    struct gatt_cache_store db;
+
+    union
+    {
+        struct bt_gatt_discover_params disc;
+        struct bt_gatt_read_params read;
+    } fill;
+
+    struct bt_gatt_subscribe_params sc_sub;
+
+    struct bt_gatt_discover_params *pending[GATT_CACHE_PENDING];
+    uint8_t pending_cnt;
+    struct k_work pending_work;
+};
+
+static struct gatt_cache caches[CONFIG_BT_MAX_CONN];
+
+static int cache_fill_next(struct gatt_cache *cache);
+
+static struct gatt_cache *cache_lookup(struct bt_conn *conn)
+{
+    struct gatt_cache *cache;
+
+    if (conn->type != BT_CONN_TYPE_LE)
+    {
+        return NULL;
+    }
+
+    cache = &caches[bt_conn_index(conn)];
+    if (cache->conn != conn)
+    {
+        return NULL;
+    }
+
+    return cache;
+}
+
+static struct gatt_cache_attr *cache_find_attr(struct gatt_cache *cache, uint16_t handle)
+{
+    int lo = 0, hi = (int)cache->db.hdr.count - 1;
+
+    /* Records are stored in ascending handle order */
+    while (lo <= hi)
+    {
+        int mid = (lo + hi) / 2;
+        struct gatt_cache_attr *attr = &cache->db.attrs[mid];
+
+        if (attr->handle == handle)
+        {
+            return attr;
+        }
+
+        if (attr->handle < handle)
+        {
+            lo = mid + 1;
+        }
+        else
+        {
+            hi = mid - 1;
+        }
+    }
+
+    return NULL;
+}
+
+static void cache_attr_set_uuid(struct gatt_cache_attr *attr, const struct bt_uuid *uuid)
+{
+    switch (uuid->type)
+    {
+    case BT_UUID_TYPE_16:
+        attr->uuid_len = BT_UUID_SIZE_16;
+        sys_put_le16(BT_UUID_16(uuid)->val, attr->uuid);
+        break;
+    case BT_UUID_TYPE_128:
+        attr->uuid_len = BT_UUID_SIZE_128;
+        memcpy(attr->uuid, BT_UUID_128(uuid)->val, BT_UUID_SIZE_128);
+        break;
+    default:
+        attr->uuid_len = 0U;
+        break;
+    }
+}
+
+static bool cache_attr_get_uuid(const struct gatt_cache_attr *attr, struct bt_uuid_128 *uuid)
+{
+    return bt_uuid_create(&uuid->uuid, attr->uuid, attr->uuid_len);
+}
+
+/* ------------------------------------------------------------------------- */
+/* Persistent storage                                                        */
+/* ------------------------------------------------------------------------- */
+
+static struct gatt_cache_slot store_slots[CONFIG_BT_MAX_PAIRED];
+static bool store_slots_loaded;
+
+static bool store_hdr_match(const struct gatt_cache_store_hdr *hdr, uint8_t id,
+                            const bt_addr_le_t *addr)
+{
+    return hdr->magic == GATT_CACHE_MAGIC && hdr->version == GATT_CACHE_VERSION &&
+           hdr->id == id && !bt_addr_le_cmp(&hdr->addr, addr);
+}
+
+/* Read only the header of every slot, the attribute records stay in storage */
+static void store_slots_load(void)
+{
+    struct gatt_cache_store_hdr hdr;
+    uint16_t len;
+
+    if (store_slots_loaded)
+    {
+        return;
+    }
+
+    for (uint16_t i = 0U; i < CONFIG_BT_MAX_PAIRED; i++)
+    {
+        struct gatt_cache_slot *slot = &store_slots[i];
+
+        len = sizeof(hdr);
+        (void)memset(&hdr, 0, sizeof(hdr));
+        if (bt_storage_kv_get(KEY_INDEX_LE_GATT_CACHE_ITEM(i), (uint8_t *)&hdr, &len) < 0 ||
+            hdr.magic != GATT_CACHE_MAGIC || hdr.version != GATT_CACHE_VERSION)
+        {
+            slot->used = false;
+            continue;
+        }
+
+        slot->used = true;
+        slot->id = hdr.id;
+        bt_addr_le_copy(&slot->addr, &hdr.addr);
+    }
+
+    store_slots_loaded = true;
+}
+
+/* Find the storage slot holding the database of a peer, or -ENOENT. */
+static int store_find(uint8_t id, const bt_addr_le_t *addr)
+{
+    store_slots_load();
+
+    for (uint16_t i = 0U; i < CONFIG_BT_MAX_PAIRED; i++)
+    {
+        struct gatt_cache_slot *slot = &store_slots[i];
+
+        if (slot->used && slot->id == id && !bt_addr_le_cmp(&slot->addr, addr))
+        {
+            return i;
+        }
+    }
+
+    return -ENOENT;
+}
+
+/* Pick a storage slot for a peer: its own slot, a free one, or one whose
+ * owner is no longer bonded.
+ */
+static int store_alloc(uint8_t id, const bt_addr_le_t *addr)
+{
+    int stale = -ENOMEM;
+    int index;
+
+    index = store_find(id, addr);
+    if (index >= 0)
+    {
+        return index;
+    }
+
+    for (uint16_t i = 0U; i < CONFIG_BT_MAX_PAIRED; i++)
+    {
+        struct gatt_cache_slot *slot = &store_slots[i];
+
+        if (!slot->used)
+        {
+            return i;
+        }
+
+        if (stale < 0 && !bt_addr_le_is_bonded(slot->id, &slot->addr))
+        {
+            stale = i;
+        }
+    }
+
+    return stale;
+}
+
+static void cache_store(struct gatt_cache *cache)
+{
+    struct bt_conn *conn = cache->conn;
+    int index;
+
+    if (!bt_addr_le_is_bonded(conn->id, &conn->le.dst))
+    {
+        return;
+    }
+
+    index = store_alloc(conn->id, &conn->le.dst);
+    if (index < 0)
+    {
+        BT_WARN("No storage slot for %s", bt_addr_le_str(&conn->le.dst));
+        return;
+    }
+
+    cache->db.hdr.magic = GATT_CACHE_MAGIC;
+    cache->db.hdr.version = GATT_CACHE_VERSION;
+    cache->db.hdr.id = conn->id;
+    bt_addr_le_copy(&cache->db.hdr.addr, &conn->le.dst);
+
+    bt_storage_kv_set(KEY_INDEX_LE_GATT_CACHE_ITEM(index), (uint8_t *)&cache->db,
+                      sizeof(cache->db.hdr) + cache->db.hdr.count * sizeof(struct gatt_cache_attr));
+    cache->stored = true;
+
+    store_slots[index].used = true;
+    store_slots[index].id = conn->id;
+    bt_addr_le_copy(&store_slots[index].addr, &conn->le.dst);
+
+    BT_DBG("Stored %u attributes for %s", cache->db.hdr.count, bt_addr_le_str(&conn->le.dst));
+}
+
+static bool cache_load(struct gatt_cache *cache)
+{
+    struct bt_conn *conn = cache->conn;
+    uint16_t len = sizeof(cache->db);
+    int index;
+
+    index = store_find(conn->id, &conn->le.dst);
+    if (index < 0)
+    {
+        return false;
+    }
+
+    (void)memset(&cache->db, 0, sizeof(cache->db));
+    if (bt_storage_kv_get(KEY_INDEX_LE_GATT_CACHE_ITEM(index), (uint8_t *)&cache->db, &len) < 0)
+    {
+        return false;
+    }
+
+    if (!store_hdr_match(&cache->db.hdr, conn->id, &conn->le.dst) ||
+        cache->db.hdr.count > GATT_CACHE_ATTR_MAX)
+    {
+        return false;
+    }
+
+    cache->stored = true;
+
+    return true;
+}
+
+static void cache_store_delete(uint8_t id, const bt_addr_le_t *addr)
+{
+    int index = store_find(id, addr);
+
+    if (index >= 0)
+    {
+        bt_storage_kv_delete(KEY_INDEX_LE_GATT_CACHE_ITEM(index), NULL, 0);
+        store_slots[index].used = false;
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+/* Serving discovery from the cache                                          */
+/* ------------------------------------------------------------------------- */
+
+static uint8_t cache_serve_attr(struct bt_conn *conn, struct bt_gatt_discover_params *params,
+                                const struct gatt_cache_attr *rec, bool *skip)
+{
+    struct bt_uuid_16 decl = BT_UUID_INIT_16(0);
+    struct bt_uuid_128 uuid;
+    struct bt_gatt_attr attr = {
+            .handle = rec->handle,
+    };
+    union
+    {
+        struct bt_gatt_service_val svc;
+        struct bt_gatt_include incl;
+        struct bt_gatt_chrc chrc;
+    } value;
+
+    if (!cache_attr_get_uuid(rec, &uuid))
+    {
+        return BT_GATT_ITER_CONTINUE;
+    }
+
+    switch (rec->kind)
+    {
+    case CACHE_ATTR_PRIMARY:
+        decl.val = BT_UUID_GATT_PRIMARY_VAL;
+        break;
+    case CACHE_ATTR_SECONDARY:
+        decl.val = BT_UUID_GATT_SECONDARY_VAL;
+        break;
+    case CACHE_ATTR_INCLUDE:
+        decl.val = BT_UUID_GATT_INCLUDE_VAL;
+        break;
+    case CACHE_ATTR_CHRC:
+        decl.val = BT_UUID_GATT_CHRC_VAL;
+        break;
+    default:
+        break;
+    }
+
+    switch (params->type)
+    {
+    case BT_GATT_DISCOVER_PRIMARY:
+    case BT_GATT_DISCOVER_SECONDARY:
+        if (rec->kind != (params->type == BT_GATT_DISCOVER_PRIMARY ? CACHE_ATTR_PRIMARY
+                                                                    : CACHE_ATTR_SECONDARY))
+        {
+            return BT_GATT_ITER_CONTINUE;
+        }
+
+        if (params->uuid && bt_uuid_cmp(&uuid.uuid, params->uuid))
+        {
+            return BT_GATT_ITER_CONTINUE;
+        }
+
+        value.svc.uuid = &uuid.uuid;
+        value.svc.end_handle = rec->val[0];
+        attr.uuid = &decl.uuid;
+        attr.user_data = &value.svc;
+        break;
+
+    case BT_GATT_DISCOVER_INCLUDE:
+        if (rec->kind != CACHE_ATTR_INCLUDE)
+        {
+            return BT_GATT_ITER_CONTINUE;
+        }
+
+        if (params->uuid && bt_uuid_cmp(&uuid.uuid, params->uuid))
+        {
+            return BT_GATT_ITER_CONTINUE;
+        }
+
+        value.incl.uuid = &uuid.uuid;
+        value.incl.start_handle = rec->val[0];
+        value.incl.end_handle = rec->val[1];
+        attr.uuid = BT_UUID_GATT_INCLUDE;
+        attr.user_data = &value.incl;
+        break;
+
+    case BT_GATT_DISCOVER_CHARACTERISTIC:
+        if (rec->kind != CACHE_ATTR_CHRC)
+        {
+            return BT_GATT_ITER_CONTINUE;
+        }
+
+        if (params->uuid && bt_uuid_cmp(&uuid.uuid, params->uuid))
+        {
+            return BT_GATT_ITER_CONTINUE;
+        }
+
+        value.chrc = (struct bt_gatt_chrc)BT_GATT_CHRC_INIT(&uuid.uuid, rec->val[0], rec->props);
+        attr.uuid = BT_UUID_GATT_CHRC;
+        attr.user_data = &value.chrc;
+        break;
+
+    case BT_GATT_DISCOVER_DESCRIPTOR:
+        /* Same filtering as the Find Information walk: declarations are
+         * not descriptors and a characteristic declaration is followed by
+         * its value.
+         */
+        if (*skip)
+        {
+            *skip = false;
+            return BT_GATT_ITER_CONTINUE;
+        }
+
+        if (rec->kind == CACHE_ATTR_CHRC)
+        {
+            *skip = true;
+            return BT_GATT_ITER_CONTINUE;
+        }
+
+        if (rec->kind != CACHE_ATTR_OTHER)
+        {
+            return BT_GATT_ITER_CONTINUE;
+        }
+        __fallthrough;
+
+    case BT_GATT_DISCOVER_ATTRIBUTE:
+        attr.uuid = rec->kind == CACHE_ATTR_OTHER ? &uuid.uuid : &decl.uuid;
+        if (params->uuid && bt_uuid_cmp(attr.uuid, params->uuid))
+        {
+            return BT_GATT_ITER_CONTINUE;
+        }
+        break;
+
+    default:
+        return BT_GATT_ITER_CONTINUE;
+    }
+
+    return params->func(conn, &attr, params);
+}
+
+static void cache_serve(struct gatt_cache *cache, struct bt_gatt_discover_params *params)
+{
+    struct bt_conn *conn = cache->conn;
+    bool skip = false;
+
+    BT_DBG("type %u start_handle 0x%04x end_handle 0x%04x", params->type, params->start_handle,
+           params->end_handle);
+
+    for (uint16_t i = 0U; i < cache->db.hdr.count; i++)
+    {
+        const struct gatt_cache_attr *rec = &cache->db.attrs[i];
+
+        if (rec->handle < params->start_handle)
+        {
+            continue;
+        }
+
+        if (rec->handle > params->end_handle)
+        {
+            break;
+        }
+
+        if (cache_serve_attr(conn, params, rec, &skip) == BT_GATT_ITER_STOP)
+        {
+            return;
+        }
+    }
+
+    params->func(conn, NULL, params);
+}
+
+static struct bt_gatt_discover_params *pending_pop(struct gatt_cache *cache)
+{
+    struct bt_gatt_discover_params *params;
+
+    if (!cache->pending_cnt)
+    {
+        return NULL;
+    }
+
+    params = cache->pending[0];
+    cache->pending_cnt--;
+    memmove(&cache->pending[0], &cache->pending[1],
+            cache->pending_cnt * sizeof(cache->pending[0]));
+
+    return params;
+}
+
+static void pending_process(struct k_work *work)
+{
+    struct gatt_cache *cache = CONTAINER_OF(work, struct gatt_cache, pending_work);
+    struct bt_gatt_discover_params *params;
+    int err;
+
+    if (cache->state == CACHE_STATE_VALIDATING || cache->state == CACHE_STATE_FILLING)
+    {
+        return;
+    }
+
+    params = pending_pop(cache);
+    if (!params)
+    {
+        return;
+    }
+
+    if (cache->state == CACHE_STATE_VALID)
+    {
+        cache_serve(cache, params);
+    }
+    else
+    {
+        /* Cache not usable, fall back to the procedure over the air */
+        cache->bypass = true;
+        err = bt_gatt_discover(cache->conn, params);
+        cache->bypass = false;
+        if (err)
+        {
+            params->func(cache->conn, NULL, params);
+        }
+    }
+
+    if (cache->pending_cnt)
+    {
+        k_work_submit(&cache->pending_work);
+    }
+}
+
+static void pending_flush(struct gatt_cache *cache)
+{
+    struct bt_gatt_discover_params *params;
+
+    while ((params = pending_pop(cache)) != NULL)
+    {
+        params->func(cache->conn, NULL, params);
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+/* Validation and fill                                                       */
+/* ------------------------------------------------------------------------- */
+
+static void cache_reset(struct gatt_cache *cache)
+{
+    cache->db.hdr.count = 0U;
+    cache->db.hdr.has_hash = 0U;
+    cache->sc_handle = 0U;
+}
+
+static void cache_invalidate(struct gatt_cache *cache)
+{
+    struct bt_conn *conn = cache->conn;
+
+    BT_DBG("conn %p", conn);
+
+    cache_reset(cache);
+    cache->state = CACHE_STATE_IDLE;
+
+    if (cache->stored)
+    {
+        cache_store_delete(conn->id, &conn->le.dst);
+        cache->stored = false;
+    }
+}
+
+static void cache_lookup_sc(struct gatt_cache *cache)
+{
+    cache->sc_handle = 0U;
+
+    for (uint16_t i = 0U; i < cache->db.hdr.count; i++)
+    {
+        const struct gatt_cache_attr *rec = &cache->db.attrs[i];
+
+        if (rec->kind == CACHE_ATTR_CHRC && rec->uuid_len == BT_UUID_SIZE_16 &&
+            sys_get_le16(rec->uuid) == BT_UUID_GATT_SC_VAL)
+        {
+            cache->sc_handle = rec->val[0];
+            return;
+        }
+    }
+}
+
+static uint8_t cache_sc_notify(struct bt_conn *conn, struct bt_gatt_subscribe_params *params,
+                               const void *data, uint16_t length)
+{
+    /* Service Changed is handled by bt_gatt_cache_notification() */
+    return BT_GATT_ITER_CONTINUE;
+}
+
+static void cache_sc_subscribe(struct gatt_cache *cache)
+{
+    struct bt_gatt_subscribe_params *sub = &cache->sc_sub;
+    uint16_t ccc_handle;
+
+    if (!cache->sc_handle)
+    {
+        return;
+    }
+
+    ccc_handle = bt_gatt_cache_find_ccc(cache->conn, cache->sc_handle, 0xffff);
+    if (!ccc_handle)
+    {
+        return;
+    }
+
+    (void)memset(sub, 0, sizeof(*sub));
+    sub->notify = cache_sc_notify;
+    sub->value_handle = cache->sc_handle;
+    sub->ccc_handle = ccc_handle;
+    sub->value = BT_GATT_CCC_INDICATE;
+    atomic_set_bit(sub->flags, BT_GATT_SUBSCRIBE_FLAG_VOLATILE);
+
+    if (bt_gatt_subscribe(cache->conn, sub))
+    {
+        BT_WARN("Unable to subscribe to Service Changed");
+    }
+}
+
+static void cache_ready(struct gatt_cache *cache)
+{
+    cache_lookup_sc(cache);
+    cache->state = CACHE_STATE_VALID;
+
+    if (cache->pending_cnt)
+    {
+        k_work_submit(&cache->pending_work);
+    }
+}
+
+static void cache_fill_done(struct gatt_cache *cache, bool success)
+{
+    if (!success)
+    {
+        BT_WARN("Unable to cache database of %s", bt_addr_le_str(&cache->conn->le.dst));
+        cache_reset(cache);
+        cache->state = CACHE_STATE_DISABLED;
+        if (cache->pending_cnt)
+        {
+            k_work_submit(&cache->pending_work);
+        }
+        return;
+    }
+
+    BT_DBG("Cached %u attributes", cache->db.hdr.count);
+
+    cache_ready(cache);
+    cache_store(cache);
+    cache_sc_subscribe(cache);
+}
+
+static uint8_t cache_hash_read_cb(struct bt_conn *conn, uint8_t err,
+                                  struct bt_gatt_read_params *params, const void *data,
+                                  uint16_t length)
+{
+    struct gatt_cache *cache = cache_lookup(conn);
+    bool has_hash = !err && data && length == sizeof(cache->db.hdr.hash);
+
+    if (!cache)
+    {
+        return BT_GATT_ITER_STOP;
+    }
+
+    if (cache->state == CACHE_STATE_VALIDATING)
+    {
+        bool valid;
+
+        if (has_hash)
+        {
+            valid = cache->db.hdr.has_hash && !memcmp(cache->db.hdr.hash, data, length);
+        }
+        else
+        {
+            /* Without Database Hash a bonded peer is trusted as long as
+             * it can tell us about changes through Service Changed.
+             */
+            cache_lookup_sc(cache);
+            valid = !cache->db.hdr.has_hash && cache->sc_handle;
+        }
+
+        BT_DBG("Database of %s is %s", bt_addr_le_str(&conn->le.dst),
+               valid ? "unchanged" : "changed");
+
+        if (valid)
+        {
+            cache_ready(cache);
+            /* Changes from now on must still invalidate the reused cache */
+            cache_sc_subscribe(cache);
+        }
+        else
+        {
+            cache_invalidate(cache);
+
+            /* Rebuild right away if discovery is already waiting */
+            if (cache->pending_cnt)
+            {
+                if (has_hash)
+                {
+                    memcpy(cache->db.hdr.hash, data, length);
+                    cache->db.hdr.has_hash = 1U;
+                }
+
+                cache->state = CACHE_STATE_FILLING;
+                cache->fill_step = CACHE_FILL_ATTR;
+                if (cache_fill_next(cache))
+                {
+                    cache_fill_done(cache, false);
+                }
+            }
+        }
+
+        return BT_GATT_ITER_STOP;
+    }
+
+    if (cache->state == CACHE_STATE_FILLING)
+    {
+        if (has_hash)
+        {
+            memcpy(cache->db.hdr.hash, data, length);
+            cache->db.hdr.has_hash = 1U;
+        }
+
+        cache->fill_step = CACHE_FILL_ATTR;
+        if (cache_fill_next(cache))
+        {
+            cache_fill_done(cache, false);
+        }
+    }
+
+    return BT_GATT_ITER_STOP;
+}
+
+static int cache_hash_read(struct gatt_cache *cache)
+{
+    struct bt_gatt_read_params *params = &cache->fill.read;
+
+    (void)memset(params, 0, sizeof(*params));
+    params->func = cache_hash_read_cb;
+    params->handle_count = 0U;
+    params->by_uuid.start_handle = BT_ATT_FIRST_ATTRIBUTE_HANDLE;
+    params->by_uuid.end_handle = BT_ATT_LAST_ATTRIBUTE_HANDLE;
+    params->by_uuid.uuid = BT_UUID_GATT_DB_HASH;
+
+    return bt_gatt_read(cache->conn, params);
+}
+
+static bool cache_fill_record(struct gatt_cache *cache, const struct bt_gatt_attr *attr)
+{
+    struct gatt_cache_attr *rec;
+
+    if (cache->fill_step == CACHE_FILL_ATTR)
+    {
+        if (cache->db.hdr.count >= GATT_CACHE_ATTR_MAX)
+        {
+            BT_WARN("Database exceeds %u attributes", GATT_CACHE_ATTR_MAX);
+            return false;
+        }
+
+        /* Find Information returns handles in ascending order */
+        if (cache->db.hdr.count && cache->db.attrs[cache->db.hdr.count - 1].handle >= attr->handle)
+        {
+            return false;
+        }
+
+        rec = &cache->db.attrs[cache->db.hdr.count++];
+        (void)memset(rec, 0, sizeof(*rec));
+        rec->handle = attr->handle;
+        rec->kind = CACHE_ATTR_OTHER;
+        cache_attr_set_uuid(rec, attr->uuid);
+
+        return true;
+    }
+
+    rec = cache_find_attr(cache, attr->handle);
+    if (!rec)
+    {
+        return false;
+    }
+
+    switch (cache->fill_step)
+    {
+    case CACHE_FILL_PRIMARY:
+    case CACHE_FILL_SECONDARY:
+    {
+        struct bt_gatt_service_val *svc = attr->user_data;
+
+        rec->kind = cache->fill_step == CACHE_FILL_PRIMARY ? CACHE_ATTR_PRIMARY
+                                                           : CACHE_ATTR_SECONDARY;
+        rec->val[0] = svc->end_handle;
+        cache_attr_set_uuid(rec, svc->uuid);
+        break;
+    }
+    case CACHE_FILL_INCLUDE:
+    {
+        struct bt_gatt_include *incl = attr->user_data;
+
+        rec->kind = CACHE_ATTR_INCLUDE;
+        rec->val[0] = incl->start_handle;
+        rec->val[1] = incl->end_handle;
+        cache_attr_set_uuid(rec, incl->uuid);
+        break;
+    }
+    case CACHE_FILL_CHRC:
+    {
+        struct bt_gatt_chrc *chrc = attr->user_data;
+
+        rec->kind = CACHE_ATTR_CHRC;
+        rec->props = chrc->properties;
+        rec->val[0] = chrc->value_handle;
+        cache_attr_set_uuid(rec, chrc->uuid);
+        break;
+    }
+    default:
+        return false;
+    }
+
+    return true;
+}
+
+static uint8_t cache_fill_cb(struct bt_conn *conn, const struct bt_gatt_attr *attr,
+                             struct bt_gatt_discover_params *params)
+{
+    struct gatt_cache *cache = cache_lookup(conn);
+
+    if (!cache || cache->state != CACHE_STATE_FILLING)
+    {
+        return BT_GATT_ITER_STOP;
+    }
+
+    if (!attr)
+    {
+        if (cache->fill_step == CACHE_FILL_CHRC)
+        {
+            cache_fill_done(cache, true);
+            return BT_GATT_ITER_STOP;
+        }
+
+        cache->fill_step++;
+        if (cache_fill_next(cache))
+        {
+            cache_fill_done(cache, false);
+        }
+
+        return BT_GATT_ITER_STOP;
+    }
+
+    if (!cache_fill_record(cache, attr))
+    {
+        cache_fill_done(cache, false);
+        return BT_GATT_ITER_STOP;
+    }
+
+    return BT_GATT_ITER_CONTINUE;
+}
+
+static int cache_fill_next(struct gatt_cache *cache)
+{
+    struct bt_gatt_discover_params *params = &cache->fill.disc;
+
+    BT_DBG("step %u", cache->fill_step);
+
+    if (cache->fill_step == CACHE_FILL_HASH)
+    {
+        return cache_hash_read(cache);
+    }
+
+    if (cache->fill_step == CACHE_FILL_ATTR)
+    {
+        cache->db.hdr.count = 0U;
+    }
+
+    (void)memset(params, 0, sizeof(*params));
+    params->func = cache_fill_cb;
+    params->start_handle = BT_ATT_FIRST_ATTRIBUTE_HANDLE;
+    params->end_handle = BT_ATT_LAST_ATTRIBUTE_HANDLE;
+
+    switch (cache->fill_step)
+    {
+    case CACHE_FILL_ATTR:
+        params->type = BT_GATT_DISCOVER_ATTRIBUTE;
+        break;
+    case CACHE_FILL_PRIMARY:
+        params->type = BT_GATT_DISCOVER_PRIMARY;
+        break;
+    case CACHE_FILL_SECONDARY:
+        params->type = BT_GATT_DISCOVER_SECONDARY;
+        break;
+    case CACHE_FILL_INCLUDE:
+        params->type = BT_GATT_DISCOVER_INCLUDE;
+        break;
+    case CACHE_FILL_CHRC:
+        params->type = BT_GATT_DISCOVER_CHARACTERISTIC;
+        break;
+    default:
+        return -EINVAL;
+    }
+
+    return bt_gatt_discover(cache->conn, params);
+}
+
+static int cache_fill_start(struct gatt_cache *cache)
+{
+    BT_DBG("conn %p", cache->conn);
+
+    cache_reset(cache);
+    cache->state = CACHE_STATE_FILLING;
+    cache->fill_step = CACHE_FILL_HASH;
+
+    return cache_fill_next(cache);
+}
+
+/* ------------------------------------------------------------------------- */
+/* GATT hooks                                                                */
+/* ------------------------------------------------------------------------- */
+
+int bt_gatt_cache_discover(struct bt_conn *conn, struct bt_gatt_discover_params *params)
+{
+    struct gatt_cache *cache = cache_lookup(conn);
+
+    if (!cache)
+    {
+        return -ENOENT;
+    }
+
+    /* Requests issued by the cache itself always go over the air */
+    if (cache->bypass || params == &cache->fill.disc)
+    {
+        return -ENOENT;
+    }
+
+    /* Descriptor values (e.g. CCC flags) are not cached */
+    if (params->type == BT_GATT_DISCOVER_STD_CHAR_DESC)
+    {
+        return -ENOENT;
+    }
+
+    switch (cache->state)
+    {
+    case CACHE_STATE_IDLE:
+        /* Only bonded peers are worth a full database walk */
+        if (!bt_addr_le_is_bonded(conn->id, &conn->le.dst))
+        {
+            return -ENOENT;
+        }
+
+        if (cache_fill_start(cache))
+        {
+            cache_reset(cache);
+            cache->state = CACHE_STATE_DISABLED;
+            return -ENOENT;
+        }
+        break;
+    case CACHE_STATE_VALIDATING:
+    case CACHE_STATE_FILLING:
+    case CACHE_STATE_VALID:
+        break;
+    default:
+        return -ENOENT;
+    }
+
+    if (cache->pending_cnt >= GATT_CACHE_PENDING)
+    {
+        return -ENOENT;
+    }
+
+    cache->pending[cache->pending_cnt++] = params;
+
+    if (cache->state == CACHE_STATE_VALID)
+    {
+        k_work_submit(&cache->pending_work);
+    }
+
+    return 0;
+}
+
+bool bt_gatt_cache_cancel(struct bt_conn *conn, void *params)
+{
+    struct gatt_cache *cache = cache_lookup(conn);
+
+    if (!cache)
+    {
+        return false;
+    }
+
+    for (uint8_t i = 0U; i < cache->pending_cnt; i++)
+    {
+        struct bt_gatt_discover_params *disc = cache->pending[i];
+
+        if (disc != params)
+        {
+            continue;
+        }
+
+        cache->pending_cnt--;
+        memmove(&cache->pending[i], &cache->pending[i + 1],
+                (cache->pending_cnt - i) * sizeof(cache->pending[0]));
+
+        disc->func(conn, NULL, disc);
+
+        return true;
+    }
+
+    return false;
+}
+
+uint16_t bt_gatt_cache_find_ccc(struct bt_conn *conn, uint16_t value_handle, uint16_t end_handle)
+{
+    struct gatt_cache *cache = cache_lookup(conn);
+
+    if (!cache || cache->state != CACHE_STATE_VALID)
+    {
+        return 0U;
+    }
+
+    for (uint16_t i = 0U; i < cache->db.hdr.count; i++)
+    {
+        const struct gatt_cache_attr *rec = &cache->db.attrs[i];
+
+        if (rec->handle <= value_handle)
+        {
+            continue;
+        }
+
+        /* Descriptors end at the next declaration */
+        if (rec->handle > end_handle || rec->kind != CACHE_ATTR_OTHER)
+        {
+            break;
+        }
+
+        if (rec->uuid_len == BT_UUID_SIZE_16 && sys_get_le16(rec->uuid) == BT_UUID_GATT_CCC_VAL)
+        {
+            return rec->handle;
+        }
+    }
+
+    return 0U;
+}
+
+void bt_gatt_cache_notification(struct bt_conn *conn, uint16_t handle, const void *data,
+                                uint16_t length)
+{
+    struct gatt_cache *cache = cache_lookup(conn);
+
+    if (!cache || !cache->sc_handle || handle != cache->sc_handle)
+    {
+        return;
+    }
+
+    BT_DBG("Service Changed 0x%04x-0x%04x", length >= 4 ? sys_get_le16(data) : 0,
+           length >= 4 ? sys_get_le16((const uint8_t *)data + 2) : 0);
+
+    cache_invalidate(cache);
+}
+
+void bt_gatt_cache_connected(struct bt_conn *conn)
+{
+    struct gatt_cache *cache;
+
+    if (conn->type != BT_CONN_TYPE_LE)
+    {
+        return;
+    }
+
+    cache = &caches[bt_conn_index(conn)];
+    (void)memset(cache, 0, sizeof(*cache));
+    cache->conn = conn;
+    cache->state = CACHE_STATE_IDLE;
+    k_work_init(&cache->pending_work, pending_process);
+
+    if (!bt_addr_le_is_bonded(conn->id, &conn->le.dst) || !cache_load(cache))
+    {
+        return;
+    }
+
+    BT_DBG("Validating %u cached attributes of %s", cache->db.hdr.count,
+           bt_addr_le_str(&conn->le.dst));
+
+    cache->state = CACHE_STATE_VALIDATING;
+    if (cache_hash_read(cache))
+    {
+        cache_reset(cache);
+        cache->state = CACHE_STATE_IDLE;
+    }
+}
+
+void bt_gatt_cache_disconnected(struct bt_conn *conn)
+{
+    struct gatt_cache *cache = cache_lookup(conn);
+
+    if (!cache)
+    {
+        return;
+    }
+
+    k_work_cancel(&cache->pending_work);
+    pending_flush(cache);
+
+    cache->conn = NULL;
+    cache->state = CACHE_STATE_IDLE;
+}
+
+void bt_gatt_cache_clear(uint8_t id, const bt_addr_le_t *addr)
+{
+    for (int i = 0; i < ARRAY_SIZE(caches); i++)
+    {
+        struct gatt_cache *cache = &caches[i];
+
+        if (cache->conn && bt_conn_is_peer_addr_le(cache->conn, id, addr))
+        {
+            cache_reset(cache);
+            cache->stored = false;
+            if (cache->state == CACHE_STATE_VALID)
+            {
+                cache->state = CACHE_STATE_IDLE;
+            }
+        }
+    }
+
+    cache_store_delete(id, addr);
+}
+#endif /* CONFIG_BT_GATT_CLIENT_CACHE */
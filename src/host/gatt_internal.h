@@ -59,6 +59,34 @@ static inline void bt_gatt_mult_notification(struct bt_conn *conn, const void *d
 }
 #endif /* CONFIG_BT_GATT_CLIENT */
 
+#if defined(CONFIG_BT_GATT_CLIENT_CACHE)
+void bt_gatt_cache_connected(struct bt_conn *conn);
+void bt_gatt_cache_disconnected(struct bt_conn *conn);
+void bt_gatt_cache_clear(uint8_t id, const bt_addr_le_t *addr);
+
+/* Serve a discovery from the peer database cache, returns -ENOENT when the
+ * procedure has to be run over the air.
+ */
+int bt_gatt_cache_discover(struct bt_conn *conn, struct bt_gatt_discover_params *params);
+bool bt_gatt_cache_cancel(struct bt_conn *conn, void *params);
+
+uint16_t bt_gatt_cache_find_ccc(struct bt_conn *conn, uint16_t value_handle, uint16_t end_handle);
+
+void bt_gatt_cache_notification(struct bt_conn *conn, uint16_t handle, const void *data,
+                                uint16_t length);
+#endif /* CONFIG_BT_GATT_CLIENT_CACHE */
+
+#if defined(CONFIG_BT_GATT_READ_COALESCE)
+void bt_gatt_read_coalesce_connected(struct bt_conn *conn);
+void bt_gatt_read_coalesce_disconnected(struct bt_conn *conn);
+
+/* Queue a single handle read for coalescing, returns -ENOENT when the read
+ * has to be sent on its own.
+ */
+int bt_gatt_read_coalesce(struct bt_conn *conn, struct bt_gatt_read_params *params);
+bool bt_gatt_read_coalesce_cancel(struct bt_conn *conn, void *params);
+#endif /* CONFIG_BT_GATT_READ_COALESCE */
+
 struct bt_gatt_attr;
 
 /* Check attribute permission */
@@ -0,0 +1,404 @@
+/* gatt_read_coalesce.c - GATT client read request coalescing */
+
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <string.h>
+#include <errno.h>
+#include <stdbool.h>
+
+#include "gatt_internal.h"
+
+#include "base/common.h"
+
+#include "common/work.h"
+
+#include <bluetooth/bluetooth.h>
+#include <bluetooth/conn.h>
+#include <bluetooth/att.h>
+#include <bluetooth/gatt.h>
+
+#define BT_DBG_ENABLED  IS_ENABLED(CONFIG_BT_DEBUG_GATT)
+#define LOG_MODULE_NAME bt_gatt_read_coalesce
+#include "logging/bt_log.h"
+
+#include "att_internal.h"
+#include "conn_internal.h"
+
+#if defined(CONFIG_BT_GATT_READ_COALESCE)
+
+#define READ_BATCH_MAX    CONFIG_BT_GATT_READ_COALESCE_MAX
+#define READ_BATCH_WINDOW CONFIG_BT_GATT_READ_COALESCE_WINDOW
+
+/* Per connection read scheduler. Single handle reads are queued for a short
+ * window and sent as one Read Multiple Variable Length request, the response
+ * tuples are then handed back to each caller in queue order.
+ */
+struct read_batch
+{
+    struct bt_conn *conn;
+    /* Set while the scheduler issues reads that must go over the air as is */
+    bool bypass;
+    /* Peer rejected Read Multiple Variable Length, stop coalescing */
+    bool unsupported;
+    /* Batched request outstanding */
+    bool busy;
+
+    struct bt_gatt_read_params *queue[READ_BATCH_MAX];
+    uint8_t queue_cnt;
+
+    struct bt_gatt_read_params *members[READ_BATCH_MAX];
+    uint16_t handles[READ_BATCH_MAX];
+    uint8_t count;
+    uint8_t next;
+    /* Response octets consumed, used to detect a truncated last value */
+    uint16_t rsp_len;
+
+    struct bt_gatt_read_params params;
+    struct k_work_delayable flush_work;
+};
+
+static struct read_batch batches[CONFIG_BT_MAX_CONN];
+
+static struct read_batch *batch_lookup(struct bt_conn *conn)
+{
+    struct read_batch *batch;
+
+    if (conn->type != BT_CONN_TYPE_LE)
+    {
+        return NULL;
+    }
+
+    batch = &batches[bt_conn_index(conn)];
+    if (batch->conn != conn)
+    {
+        return NULL;
+    }
+
+    return batch;
+}
+
+static void batch_read_direct(struct read_batch *batch, struct bt_conn *conn,
+                              struct bt_gatt_read_params *params)
+{
+    int err;
+
+    batch->bypass = true;
+    err = bt_gatt_read(conn, params);
+    batch->bypass = false;
+
+    if (err < 0)
+    {
+        params->func(conn, BT_ATT_ERR_UNLIKELY, params, NULL, 0);
+    }
+}
+
+static void batch_complete(struct read_batch *batch, struct bt_conn *conn)
+{
+    struct bt_gatt_read_params *params;
+    uint8_t i;
+
+    /* Values missing from the response are read one by one, this also
+     * reports per handle errors to the right caller.
+     */
+    for (i = batch->next; i < batch->count; i++)
+    {
+        params = batch->members[i];
+        batch->members[i] = NULL;
+
+        if (params)
+        {
+            batch_read_direct(batch, conn, params);
+        }
+    }
+
+    batch->count = 0U;
+    batch->next = 0U;
+    batch->busy = false;
+
+    if (batch->queue_cnt)
+    {
+        k_work_schedule(&batch->flush_work, K_NO_WAIT);
+    }
+}
+
+static void batch_deliver(struct read_batch *batch, struct bt_conn *conn,
+                          struct bt_gatt_read_params *params, const void *data, uint16_t length,
+                          bool truncated)
+{
+    if (!length)
+    {
+        params->func(conn, 0, params, NULL, 0);
+        return;
+    }
+
+    if (params->func(conn, 0, params, data, length) == BT_GATT_ITER_STOP)
+    {
+        return;
+    }
+
+    if (!truncated)
+    {
+        params->func(conn, 0, params, NULL, 0);
+        return;
+    }
+
+    /* Value did not fit in the response, continue with Read Blob as
+     * bt_gatt_read() would have done for a long value.
+     */
+    params->single.offset += length;
+    batch_read_direct(batch, conn, params);
+}
+
+static uint8_t batch_read_cb(struct bt_conn *conn, uint8_t err, struct bt_gatt_read_params *params,
+                             const void *data, uint16_t length)
+{
+    struct read_batch *batch = CONTAINER_OF(params, struct read_batch, params);
+    struct bt_gatt_read_params *member;
+    bool truncated;
+
+    if (err)
+    {
+        BT_DBG("batch of %u failed err 0x%02x", batch->count, err);
+
+        if (err == BT_ATT_ERR_NOT_SUPPORTED)
+        {
+            batch->unsupported = true;
+        }
+
+        batch_complete(batch, conn);
+        return BT_GATT_ITER_STOP;
+    }
+
+    if (!data)
+    {
+        batch_complete(batch, conn);
+        return BT_GATT_ITER_STOP;
+    }
+
+    batch->rsp_len += sizeof(struct bt_att_read_mult_vl_rsp) + length;
+
+    if (batch->next >= batch->count)
+    {
+        return BT_GATT_ITER_CONTINUE;
+    }
+
+    member = batch->members[batch->next];
+    batch->members[batch->next++] = NULL;
+
+    /* Cancelled while in flight */
+    if (!member)
+    {
+        return BT_GATT_ITER_CONTINUE;
+    }
+
+    truncated = batch->rsp_len >= bt_att_get_mtu(conn);
+
+    batch_deliver(batch, conn, member, data, length, truncated);
+
+    return BT_GATT_ITER_CONTINUE;
+}
+
+static struct bt_gatt_read_params *queue_pop(struct read_batch *batch)
+{
+    struct bt_gatt_read_params *params;
+
+    params = batch->queue[0];
+    batch->queue_cnt--;
+    memmove(&batch->queue[0], &batch->queue[1], batch->queue_cnt * sizeof(batch->queue[0]));
+
+    return params;
+}
+
+static void batch_send(struct read_batch *batch)
+{
+    struct bt_gatt_read_params *params;
+    uint8_t max;
+    uint8_t i;
+    int err;
+
+    if (batch->busy || !batch->queue_cnt)
+    {
+        return;
+    }
+
+    if (batch->queue_cnt == 1U || batch->unsupported)
+    {
+        while (batch->queue_cnt)
+        {
+            params = queue_pop(batch);
+            batch_read_direct(batch, batch->conn, params);
+        }
+        return;
+    }
+
+    /* Request carries 2 octets per handle after the opcode */
+    max = MIN(batch->queue_cnt, (bt_att_get_mtu(batch->conn) - 1) / sizeof(uint16_t));
+
+    for (i = 0U; i < max; i++)
+    {
+        params = queue_pop(batch);
+        batch->members[i] = params;
+        batch->handles[i] = params->single.handle;
+    }
+
+    batch->count = max;
+    batch->next = 0U;
+    batch->rsp_len = 1U;
+    batch->busy = true;
+
+    batch->params.func = batch_read_cb;
+    batch->params.handle_count = max;
+    batch->params.multiple.handles = batch->handles;
+    batch->params.multiple.variable = true;
+
+    BT_DBG("coalesced %u reads", max);
+
+    err = bt_gatt_read(batch->conn, &batch->params);
+    if (err)
+    {
+        BT_DBG("batch not sent err %d", err);
+        batch_complete(batch, batch->conn);
+    }
+}
+
+static void batch_flush(struct k_work *work)
+{
+    struct k_work_delayable *dwork = k_work_delayable_from_work(work);
+    struct read_batch *batch = CONTAINER_OF(dwork, struct read_batch, flush_work);
+
+    if (!batch->conn)
+    {
+        return;
+    }
+
+    batch_send(batch);
+}
+
+int bt_gatt_read_coalesce(struct bt_conn *conn, struct bt_gatt_read_params *params)
+{
+    struct read_batch *batch = batch_lookup(conn);
+
+    if (!batch || batch->bypass || batch->unsupported)
+    {
+        return -ENOENT;
+    }
+
+    /* Only plain single handle reads can be merged */
+    if (params->handle_count != 1U || params->single.offset)
+    {
+        return -ENOENT;
+    }
+
+    if (batch->queue_cnt >= READ_BATCH_MAX)
+    {
+        return -ENOENT;
+    }
+
+    batch->queue[batch->queue_cnt++] = params;
+
+    if (batch->busy)
+    {
+        /* Sent when the outstanding batch completes */
+        return 0;
+    }
+
+    if (batch->queue_cnt == READ_BATCH_MAX)
+    {
+        k_work_cancel_delayable(&batch->flush_work);
+        batch_send(batch);
+    }
+    else if (batch->queue_cnt == 1U)
+    {
+        k_work_schedule(&batch->flush_work, K_MSEC(READ_BATCH_WINDOW));
+    }
+
+    return 0;
+}
+
+bool bt_gatt_read_coalesce_cancel(struct bt_conn *conn, void *params)
+{
+    struct read_batch *batch = batch_lookup(conn);
+    struct bt_gatt_read_params *read;
+    uint8_t i;
+
+    if (!batch)
+    {
+        return false;
+    }
+
+    for (i = 0U; i < batch->queue_cnt; i++)
+    {
+        if (batch->queue[i] != params)
+        {
+            continue;
+        }
+
+        read = batch->queue[i];
+        batch->queue_cnt--;
+        memmove(&batch->queue[i], &batch->queue[i + 1],
+                (batch->queue_cnt - i) * sizeof(batch->queue[0]));
+
+        read->func(conn, BT_ATT_ERR_UNLIKELY, read, NULL, 0);
+        return true;
+    }
+
+    for (i = batch->next; i < batch->count; i++)
+    {
+        if (batch->members[i] != params)
+        {
+            continue;
+        }
+
+        /* The batch stays in flight, the response slot is skipped */
+        read = batch->members[i];
+        batch->members[i] = NULL;
+
+        read->func(conn, BT_ATT_ERR_UNLIKELY, read, NULL, 0);
+        return true;
+    }
+
+    return false;
+}
+
+void bt_gatt_read_coalesce_connected(struct bt_conn *conn)
+{
+    struct read_batch *batch;
+
+    if (conn->type != BT_CONN_TYPE_LE)
+    {
+        return;
+    }
+
+    batch = &batches[bt_conn_index(conn)];
+    (void)memset(batch, 0, sizeof(*batch));
+    batch->conn = conn;
+    k_work_init_delayable(&batch->flush_work, batch_flush);
+}
+
+void bt_gatt_read_coalesce_disconnected(struct bt_conn *conn)
+{
+    struct read_batch *batch = batch_lookup(conn);
+    struct bt_gatt_read_params *params;
+
+    if (!batch)
+    {
+        return;
+    }
+
+    k_work_cancel_delayable(&batch->flush_work);
+
+    while (batch->queue_cnt)
+    {
+        params = queue_pop(batch);
+        params->func(conn, BT_ATT_ERR_UNLIKELY, params, NULL, 0);
+    }
+
+    /* An outstanding batch is failed by ATT, members then fall back to
+     * bt_gatt_read() which reports the disconnection.
+     */
+    batch->conn = NULL;
+}
+
+#endif /* CONFIG_BT_GATT_READ_COALESCE */
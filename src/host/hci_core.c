@@ -29,11 +29,14 @@
 
 #include <common/bt_buf.h>
 #include <common/bt_storage_kv.h>
+#include <common/bt_capture.h>
+#include <common/bt_profile.h>
 
 #define BT_DBG_ENABLED  IS_ENABLED(CONFIG_BT_DEBUG_HCI_CORE)
 #define LOG_MODULE_NAME bt_hci_core
 #include "logging/bt_log.h"
 
+#include "common/aes_backend.h"
 #include "common/rpa.h"
 #include "keys.h"
 #include "hci_ecc.h"
@@ -91,7 +94,7 @@ static inline void handle_event(uint8_t event, struct net_buf *buf,
             return;
         }
 
-        handler->handler(buf);
+        BT_PROFILE_CALL(BT_PROFILE_HCI_EVT, handler->handler, handler->handler(buf));
         return;
     }
 
@@ -196,6 +199,47 @@ int bt_hci_cmd_send_sync(uint16_t opcode, struct net_buf *buf, struct net_buf **
     return 0;
 }
 
+#if defined(CONFIG_BT_RAND_DRBG)
+/* Outstanding LE_Rand commands, which complete in the order they were sent.
+ * Bit n is set if the n-th oldest one was sent for the entropy pool.
+ */
+#define LE_RAND_QUEUE_MAX 32U
+
+static struct
+{
+    uint32_t pool;
+    uint8_t count;
+} le_rand_queue;
+
+static void le_rand_queue_push(bool pool)
+{
+    if (pool)
+    {
+        le_rand_queue.pool |= BIT(le_rand_queue.count);
+    }
+
+    le_rand_queue.count++;
+}
+
+int bt_hci_le_rand_pool_send(void)
+{
+    int err;
+
+    if (le_rand_queue.count == LE_RAND_QUEUE_MAX)
+    {
+        return -ENOBUFS;
+    }
+
+    err = bt_hci_cmd_send(BT_HCI_OP_LE_RAND, NULL);
+    if (!err)
+    {
+        le_rand_queue_push(true);
+    }
+
+    return err;
+}
+#endif /* CONFIG_BT_RAND_DRBG */
+
 int bt_hci_le_rand(void *buffer, size_t len)
 {
     struct bt_hci_rp_le_rand *rp;
@@ -213,12 +257,22 @@ int bt_hci_le_rand(void *buffer, size_t len)
     {
         /* Number of bytes to fill on this iteration */
         count = MIN(len, sizeof(rp->rand));
+#if defined(CONFIG_BT_RAND_DRBG)
+        if (le_rand_queue.count == LE_RAND_QUEUE_MAX)
+        {
+            return -ENOBUFS;
+        }
+#endif /* CONFIG_BT_RAND_DRBG */
         /* Request the next 8 bytes over HCI */
         err = bt_hci_cmd_send_sync(BT_HCI_OP_LE_RAND, NULL, &rsp);
         if (err)
         {
             return err;
         }
+#if defined(CONFIG_BT_RAND_DRBG)
+        /* Keep the completion away from the entropy pool */
+        le_rand_queue_push(false);
+#endif /* CONFIG_BT_RAND_DRBG */
         /* Copy random data into buffer */
         rp = (void *)rsp->data;
         memcpy(buffer, rp->rand, count);
@@ -305,6 +359,7 @@ static void hci_num_completed_packets(struct net_buf *buf)
             {
                 conn->pending_no_cb--;
                 // irq_unlock(key);
+                bt_conn_stats_tx_done(conn, true);
                 k_sem_give(bt_conn_get_pkts(conn));
                 continue;
             }
@@ -327,6 +382,7 @@ static void hci_num_completed_packets(struct net_buf *buf)
             // irq_unlock(key);
 
             k_work_submit(&conn->tx_complete_work);
+            bt_conn_stats_tx_done(conn, true);
             k_sem_give(bt_conn_get_pkts(conn));
         }
 
@@ -2039,6 +2095,8 @@ static void hci_hardware_error(struct net_buf *buf)
     evt = net_buf_pull_mem(buf, sizeof(*evt));
 
     BT_ERR("Hardware error, hardware code: %d", evt->hardware_code);
+
+    bt_capture_trigger();
 }
 
 #if defined(CONFIG_BT_SMP)
@@ -2666,6 +2724,30 @@ static void hci_handle_cmd_cmp_evt_le_rem_dev_to_wl(struct net_buf *buf)
 }
 #endif
 
+#if defined(CONFIG_BT_RAND_DRBG)
+static void le_rand_complete(struct net_buf *buf)
+{
+    struct bt_hci_rp_le_rand *rp = (void *)buf->data;
+    bool pool;
+
+    if (!le_rand_queue.count)
+    {
+        BT_WARN("Unexpected LE_Rand completion");
+        return;
+    }
+
+    pool = le_rand_queue.pool & BIT(0);
+    le_rand_queue.pool >>= 1;
+    le_rand_queue.count--;
+
+    /* bt_hci_le_rand() results are not the pool's to take */
+    if (pool)
+    {
+        bt_rand_entropy_done(rp->status, rp->rand, sizeof(rp->rand));
+    }
+}
+#endif /* CONFIG_BT_RAND_DRBG */
+
 struct hci_command_complete_process_handler
 {
     uint16_t opcode;
@@ -2698,6 +2780,16 @@ static const struct hci_command_complete_process_handler hci_cmd_cmp_handles[] =
         HCI_COMMAND_COMPLETE_HANDLER(BT_HCI_OP_LE_REM_DEV_FROM_WL,
                                      hci_handle_cmd_cmp_evt_le_rem_dev_to_wl),
 #endif
+#if defined(CONFIG_BT_RAND_DRBG)
+        HCI_COMMAND_COMPLETE_HANDLER(BT_HCI_OP_LE_RAND, le_rand_complete),
+#endif
+#if defined(CONFIG_BT_ADV_DATA_CACHE)
+        HCI_COMMAND_COMPLETE_HANDLER(BT_HCI_OP_LE_SET_ADV_DATA, bt_le_adv_data_cmd_complete),
+        HCI_COMMAND_COMPLETE_HANDLER(BT_HCI_OP_LE_SET_SCAN_RSP_DATA, bt_le_adv_data_cmd_complete),
+        HCI_COMMAND_COMPLETE_HANDLER(BT_HCI_OP_LE_SET_EXT_ADV_DATA, bt_le_adv_data_cmd_complete),
+        HCI_COMMAND_COMPLETE_HANDLER(BT_HCI_OP_LE_SET_EXT_SCAN_RSP_DATA,
+                                     bt_le_adv_data_cmd_complete),
+#endif
 };
 
 static inline void
@@ -2716,7 +2808,7 @@ handle_hci_command_complete_work(uint16_t opcode, struct net_buf *buf,
             continue;
         }
 
-        handler->handler(buf);
+        BT_PROFILE_CALL(BT_PROFILE_HCI_CMD_COMPLETE, handler->handler, handler->handler(buf));
         return;
     }
 
@@ -2865,6 +2957,19 @@ static void hci_state_event_process(uint16_t opcode)
             {
                 return;
             }
+            /* Collect the first DRBG seed before anything asks for it */
+            if (bt_rand_entropy_fill() == -EINPROGRESS)
+            {
+                bt_dev.hci_init_state = HCI_INIT_LE_RAND;
+                break;
+            }
+            hci_init_end(0);
+            break;
+        case HCI_INIT_LE_RAND:
+            if (opcode != BT_HCI_OP_LE_RAND || bt_rand_entropy_fill() == -EINPROGRESS)
+            {
+                return;
+            }
             hci_init_end(0);
             break;
         default:
@@ -2893,6 +2998,11 @@ static void hci_cmd_complete(struct net_buf *buf)
 
     hci_cmd_done(opcode, status, buf);
 
+#if defined(CONFIG_BT_ID_LIST_BATCH)
+    /* List opcodes are shared with the table handlers below */
+    bt_id_list_cmd_done(opcode, status, buf);
+#endif /* CONFIG_BT_ID_LIST_BATCH */
+
     handle_hci_command_complete_work(opcode, buf, hci_cmd_cmp_handles,
                                      ARRAY_SIZE(hci_cmd_cmp_handles));
 
@@ -3208,6 +3318,33 @@ static void hci_init_end(int err)
 
     bt_rand_init(0x1234);
 
+#if defined(CONFIG_BT_RAND_BENCHMARK)
+    bt_rand_benchmark();
+#endif /* CONFIG_BT_RAND_BENCHMARK */
+
+#if defined(CONFIG_BT_AES_BENCHMARK)
+    bt_aes_backend_benchmark();
+#endif /* CONFIG_BT_AES_BENCHMARK */
+
+#if defined(CONFIG_BT_KEYS_TABLE_BENCHMARK)
+    bt_keys_table_benchmark();
+#endif /* CONFIG_BT_KEYS_TABLE_BENCHMARK */
+
+#if defined(CONFIG_BT_KEYS_RPA_BENCHMARK)
+    bt_keys_rpa_benchmark();
+#endif /* CONFIG_BT_KEYS_RPA_BENCHMARK */
+
+#if defined(CONFIG_BT_EXT_SCAN_REASSEMBLY_SELFTEST)
+    if (bt_scan_reassembly_selftest())
+    {
+        BT_ERR("Reassembly selftest failed");
+    }
+#endif /* CONFIG_BT_EXT_SCAN_REASSEMBLY_SELFTEST */
+
+#if defined(CONFIG_BT_SCAN_BATCH_BENCHMARK)
+    bt_scan_batch_benchmark();
+#endif /* CONFIG_BT_SCAN_BATCH_BENCHMARK */
+
     bt_id_init();
 
     if (IS_ENABLED(CONFIG_BT_CONN))
@@ -3241,7 +3378,11 @@ int bt_send(struct net_buf *buf)
 {
     BT_DBG("bt_send buf %p len %u type %u", buf, buf->len, bt_buf_get_type(buf));
 
+#if defined(CONFIG_BT_CAPTURE)
+    bt_capture_packet(bt_get_h4_type_by_buffer(bt_buf_get_type(buf)), 0, buf->data, buf->len);
+#else
     BT_PACKET_DUMP(bt_get_h4_type_by_buffer(bt_buf_get_type(buf)), 0, buf->data, buf->len);
+#endif /* CONFIG_BT_CAPTURE */
 
     // if (IS_ENABLED(CONFIG_BT_TINYCRYPT_ECC)) {
     //	return bt_hci_ecc_send(buf);
@@ -3305,7 +3446,11 @@ int bt_recv(struct net_buf *buf)
     {
         return -1;
     }
+#if defined(CONFIG_BT_CAPTURE)
+    bt_capture_packet(bt_get_h4_type_by_buffer(bt_buf_get_type(buf)), 1, buf->data, buf->len);
+#else
     BT_PACKET_DUMP(bt_get_h4_type_by_buffer(bt_buf_get_type(buf)), 1, buf->data, buf->len);
+#endif /* CONFIG_BT_CAPTURE */
 
     BT_DBG("rx: data: %p, len: %p", buf->data, buf->len);
     if (bt_buf_get_type(buf) == BT_BUF_EVT)
@@ -3494,11 +3639,34 @@ void hci_state_polling(void)
 
 void bt_polling_work(void)
 {
-    hci_state_polling();
-    hci_tx_thread();
-    hci_rx_thread();
+    bt_profile_loop();
 
-    timeout_polling_work();
+    BT_PROFILE_CALL(BT_PROFILE_HCI_STATE, hci_state_polling, hci_state_polling());
+    BT_PROFILE_CALL(BT_PROFILE_HCI_TX, hci_tx_thread, hci_tx_thread());
+    BT_PROFILE_CALL(BT_PROFILE_HCI_RX, hci_rx_thread, hci_rx_thread());
+
+#if defined(CONFIG_BT_HOST_ECC)
+    BT_PROFILE_CALL(BT_PROFILE_HOST_WORK, bt_ecc_p256_polling_work, bt_ecc_p256_polling_work());
+#endif /* CONFIG_BT_HOST_ECC */
+
+#if defined(CONFIG_BT_RAND_DRBG)
+    BT_PROFILE_CALL(BT_PROFILE_HOST_WORK, bt_rand_polling_work, bt_rand_polling_work());
+#endif /* CONFIG_BT_RAND_DRBG */
+
+#if defined(CONFIG_BT_SMP_PRECOMPUTE)
+    BT_PROFILE_CALL(BT_PROFILE_HOST_WORK, bt_smp_precompute_work, bt_smp_precompute_work());
+#endif /* CONFIG_BT_SMP_PRECOMPUTE */
+
+#if defined(CONFIG_BT_ID_LIST_BATCH)
+    BT_PROFILE_CALL(BT_PROFILE_HOST_WORK, bt_id_list_polling_work, bt_id_list_polling_work());
+#endif /* CONFIG_BT_ID_LIST_BATCH */
+
+    BT_PROFILE_CALL(BT_PROFILE_TIMEOUT, timeout_polling_work, timeout_polling_work());
+
+#if defined(CONFIG_BT_LOG_DEFERRED)
+    BT_PROFILE_CALL(BT_PROFILE_LOG_DRAIN, bt_log_deferred_drain,
+                    (void)bt_log_deferred_drain(CONFIG_BT_LOG_DEFERRED_DRAIN_MAX));
+#endif /* CONFIG_BT_LOG_DEFERRED */
 }
 
 int bt_enable(bt_ready_cb_t cb)
@@ -3605,6 +3773,17 @@ int bt_enable(bt_ready_cb_t cb)
     return bt_init();
 }
 
+int bt_disable(void)
+{
+#if defined(CONFIG_BT_STORAGE_KV_CACHE)
+    /* Bonds still pending in the write-back cache would be lost */
+    bt_storage_kv_sync();
+#endif /* CONFIG_BT_STORAGE_KV_CACHE */
+
+    /* HCI drivers cannot be closed, the stack keeps running */
+    return -ENOTSUP;
+}
+
 void bt_reset_nsem(void)
 {
     // k_sem_reset(&bt_dev.ncmd_sem);
@@ -3763,15 +3942,18 @@ bool bt_addr_le_is_bonded(uint8_t id, const bt_addr_le_t *addr)
 #if defined(CONFIG_BT_FILTER_ACCEPT_LIST)
 int bt_le_filter_accept_list_add(const bt_addr_le_t *addr)
 {
-    struct bt_hci_cp_le_add_dev_to_fal *cp;
-    struct net_buf *buf;
-    int err;
-
     if (!atomic_test_bit(bt_dev.flags, BT_DEV_READY))
     {
         return -EAGAIN;
     }
 
+#if defined(CONFIG_BT_ID_LIST_BATCH)
+    return bt_id_list_fal_add(addr);
+#else
+    struct bt_hci_cp_le_add_dev_to_fal *cp;
+    struct net_buf *buf;
+    int err;
+
     buf = bt_hci_cmd_create(BT_HCI_OP_LE_ADD_DEV_TO_FAL, sizeof(*cp));
     if (!buf)
     {
@@ -3790,19 +3972,23 @@ int bt_le_filter_accept_list_add(const bt_addr_le_t *addr)
     }
 
     return 0;
+#endif /* CONFIG_BT_ID_LIST_BATCH */
 }
 
 int bt_le_filter_accept_list_remove(const bt_addr_le_t *addr)
 {
-    struct bt_hci_cp_le_rem_dev_from_fal *cp;
-    struct net_buf *buf;
-    int err;
-
     if (!atomic_test_bit(bt_dev.flags, BT_DEV_READY))
     {
         return -EAGAIN;
     }
 
+#if defined(CONFIG_BT_ID_LIST_BATCH)
+    return bt_id_list_fal_remove(addr);
+#else
+    struct bt_hci_cp_le_rem_dev_from_fal *cp;
+    struct net_buf *buf;
+    int err;
+
     buf = bt_hci_cmd_create(BT_HCI_OP_LE_REM_DEV_FROM_FAL, sizeof(*cp));
     if (!buf)
     {
@@ -3820,17 +4006,21 @@ int bt_le_filter_accept_list_remove(const bt_addr_le_t *addr)
     }
 
     return 0;
+#endif /* CONFIG_BT_ID_LIST_BATCH */
 }
 
 int bt_le_filter_accept_list_clear(void)
 {
-    int err;
-
     if (!atomic_test_bit(bt_dev.flags, BT_DEV_READY))
     {
         return -EAGAIN;
     }
 
+#if defined(CONFIG_BT_ID_LIST_BATCH)
+    return bt_id_list_fal_clear();
+#else
+    int err;
+
     err = bt_hci_cmd_send_sync(BT_HCI_OP_LE_CLEAR_FAL, NULL, NULL);
     if (err)
     {
@@ -3839,6 +4029,7 @@ int bt_le_filter_accept_list_clear(void)
     }
 
     return 0;
+#endif /* CONFIG_BT_ID_LIST_BATCH */
 }
 #endif /* defined(CONFIG_BT_FILTER_ACCEPT_LIST) */
 
@@ -4023,6 +4214,9 @@ uint8_t bt_check_allow_sleep(void)
     if (bt_buf_check_allow_sleep()
 #if defined(CONFIG_BT_CONN)
         && bt_conn_check_allow_sleep()
+#endif
+#if defined(CONFIG_BT_STORAGE_KV_CACHE)
+        && bt_storage_kv_check_allow_sleep()
 #endif
         && !bt_monitor_sleep_lock_flag)
     {
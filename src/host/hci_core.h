@@ -142,6 +142,16 @@ enum
     BT_ADV_NUM_FLAGS,
 };
 
+#if defined(CONFIG_BT_ADV_DATA_CACHE)
+/* Data as last given to the controller */
+struct bt_adv_data_cache
+{
+    bool valid;
+    uint16_t len;
+    uint8_t data[CONFIG_BT_ADV_DATA_CACHE_SIZE];
+};
+#endif /* CONFIG_BT_ADV_DATA_CACHE */
+
 struct bt_le_ext_adv
 {
     /* ID Address used for advertising */
@@ -166,6 +176,11 @@ struct bt_le_ext_adv
 #endif /* defined(CONFIG_BT_EXT_ADV) */
 
     struct k_work_delayable lim_adv_timeout_work;
+
+#if defined(CONFIG_BT_ADV_DATA_CACHE)
+    struct bt_adv_data_cache ad_cache;
+    struct bt_adv_data_cache sd_cache;
+#endif /* CONFIG_BT_ADV_DATA_CACHE */
 };
 
 enum
@@ -318,6 +333,7 @@ typedef enum
 
     HCI_INIT_SET_EVENT_MASK = 0xc0,
     HCI_INIT_READ_BD_ADDR,
+    HCI_INIT_LE_RAND,
 
     HCI_INIT_SUCCESS = 0xf0,
 } HCI_INIT_STATE;
@@ -446,6 +462,11 @@ void bt_hci_cmd_state_set_init(struct net_buf *buf, struct bt_hci_cmd_state_set
 
 int bt_hci_disconnect(uint16_t handle, uint8_t reason);
 
+#if defined(CONFIG_BT_RAND_DRBG)
+/* Send LE_Rand on behalf of the entropy pool, see bt_rand_entropy_done() */
+int bt_hci_le_rand_pool_send(void);
+#endif /* CONFIG_BT_RAND_DRBG */
+
 bool bt_le_conn_params_valid(const struct bt_le_conn_param *param);
 int bt_le_set_data_len(struct bt_conn *conn, uint16_t tx_octets, uint16_t tx_time);
 int bt_le_set_phy(struct bt_conn *conn, uint8_t all_phys, uint8_t pref_tx_phy, uint8_t pref_rx_phy,
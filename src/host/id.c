@@ -943,6 +943,13 @@ void bt_id_add(struct bt_keys *keys)
 
     BT_DBG("addr %s", bt_addr_le_str(&keys->addr));
 
+    if (IS_ENABLED(CONFIG_BT_ID_LIST_BATCH))
+    {
+        keys->state |= BT_KEYS_ID_ADDED;
+        bt_id_list_update();
+        return;
+    }
+
     /* Nothing to be done if host-side resolving is used */
     if (!bt_dev.le.rl_size || bt_dev.le.rl_entries > bt_dev.le.rl_size)
     {
@@ -1100,6 +1107,13 @@ void bt_id_del(struct bt_keys *keys)
 
     BT_DBG("addr %s", bt_addr_le_str(&keys->addr));
 
+    if (IS_ENABLED(CONFIG_BT_ID_LIST_BATCH))
+    {
+        keys->state &= ~BT_KEYS_ID_ADDED;
+        bt_id_list_update();
+        return;
+    }
+
     if (!bt_dev.le.rl_size || bt_dev.le.rl_entries > bt_dev.le.rl_size + 1)
     {
         bt_dev.le.rl_entries--;
@@ -1201,6 +1215,584 @@ done:
         bt_le_ext_adv_foreach(adv_unpause_enabled, NULL);
     }
 }
+
+#if defined(CONFIG_BT_ID_LIST_BATCH)
+/* Resolving list entry as programmed into the controller */
+struct id_list_rl
+{
+    bt_addr_le_t addr;
+    uint8_t peer_irk[16];
+    uint8_t local_irk[16];
+};
+
+enum
+{
+    ID_LIST_IDLE,
+    /* Waiting for the list sizes */
+    ID_LIST_SIZE,
+    /* Radio paused, list changes being queued */
+    ID_LIST_APPLY,
+};
+
+static struct
+{
+    uint8_t state;
+    /* Something changed since the last sync */
+    bool dirty;
+    /* Controller content unknown after an error, clear the lists */
+    bool resync;
+    /* List commands sent and not completed */
+    uint8_t inflight;
+    /* Paused by the current window */
+    bool scan_paused;
+    bool res_disabled;
+
+    /* Resolving list as held by the controller, and wanted */
+    struct id_list_rl rl[CONFIG_BT_ID_LIST_RL_MAX];
+    uint8_t rl_count;
+    struct id_list_rl rl_want[CONFIG_BT_ID_LIST_RL_MAX];
+    uint8_t rl_want_count;
+
+#if defined(CONFIG_BT_FILTER_ACCEPT_LIST)
+    /* Filter accept list as held by the controller, and wanted */
+    uint8_t fal_size;
+    bt_addr_le_t fal[CONFIG_BT_ID_LIST_FAL_MAX];
+    uint8_t fal_count;
+    bt_addr_le_t fal_want[CONFIG_BT_ID_LIST_FAL_MAX];
+    uint8_t fal_want_count;
+#endif /* CONFIG_BT_FILTER_ACCEPT_LIST */
+} id_list;
+
+static int id_list_cmd(uint16_t opcode, const void *data, uint8_t len)
+{
+    struct net_buf *buf;
+
+    buf = bt_hci_cmd_create(opcode, len);
+    if (!buf)
+    {
+        return -ENOBUFS;
+    }
+
+    if (len)
+    {
+        net_buf_add_mem(buf, data, len);
+    }
+
+    bt_hci_cmd_send(opcode, buf);
+    id_list.inflight++;
+
+    return 0;
+}
+
+static uint8_t id_list_rl_limit(void)
+{
+    return MIN(bt_dev.le.rl_size, CONFIG_BT_ID_LIST_RL_MAX);
+}
+
+static void id_list_rl_collect(struct bt_keys *keys, void *data)
+{
+    struct id_list_rl *entry;
+
+    if (!(keys->state & BT_KEYS_ID_ADDED))
+    {
+        return;
+    }
+
+    /* Counted even past the limit to detect host side resolving */
+    if (bt_dev.le.rl_entries++ >= id_list_rl_limit())
+    {
+        return;
+    }
+
+    entry = &id_list.rl_want[id_list.rl_want_count++];
+    bt_addr_le_copy(&entry->addr, &keys->addr);
+    memcpy(entry->peer_irk, keys->irk.val, 16);
+#if defined(CONFIG_BT_PRIVACY)
+    memcpy(entry->local_irk, &bt_dev.irk[keys->id], 16);
+#else
+    memset(entry->local_irk, 0, 16);
+#endif
+}
+
+static void id_list_rl_want(void)
+{
+    bt_dev.le.rl_entries = 0U;
+    id_list.rl_want_count = 0U;
+
+    if (IS_ENABLED(CONFIG_BT_CENTRAL) && IS_ENABLED(CONFIG_BT_PRIVACY))
+    {
+        bt_keys_foreach(BT_KEYS_ALL, id_list_rl_collect, NULL);
+    }
+    else
+    {
+        bt_keys_foreach(BT_KEYS_IRK, id_list_rl_collect, NULL);
+    }
+
+    /* Too many for the controller, the host resolves all of them */
+    if (bt_dev.le.rl_entries > id_list_rl_limit())
+    {
+        BT_DBG("%u IRKs, resolving in the host", bt_dev.le.rl_entries);
+        bt_dev.le.rl_entries = MAX(bt_dev.le.rl_entries, bt_dev.le.rl_size + 1);
+        id_list.rl_want_count = 0U;
+    }
+}
+
+static int id_list_rl_find(const struct id_list_rl *list, uint8_t count,
+                           const struct id_list_rl *entry)
+{
+    uint8_t i;
+
+    for (i = 0U; i < count; i++)
+    {
+        if (!memcmp(&list[i], entry, sizeof(*entry)))
+        {
+            return i;
+        }
+    }
+
+    return -ENOENT;
+}
+
+/* Queue the next resolving list change, -EALREADY once in sync */
+static int id_list_rl_step(void)
+{
+    struct bt_hci_cp_le_add_dev_to_rl add;
+    struct bt_hci_cp_le_rem_dev_from_rl rem;
+    struct bt_hci_cp_le_set_privacy_mode mode;
+    struct id_list_rl *entry;
+    uint8_t i;
+    int err;
+
+    for (i = 0U; i < id_list.rl_count; i++)
+    {
+        entry = &id_list.rl[i];
+
+        if (id_list_rl_find(id_list.rl_want, id_list.rl_want_count, entry) >= 0)
+        {
+            continue;
+        }
+
+        bt_addr_le_copy(&rem.peer_id_addr, &entry->addr);
+        err = id_list_cmd(BT_HCI_OP_LE_REM_DEV_FROM_RL, &rem, sizeof(rem));
+        if (err)
+        {
+            return err;
+        }
+
+        id_list.rl[i] = id_list.rl[--id_list.rl_count];
+        return 0;
+    }
+
+    for (i = 0U; i < id_list.rl_want_count; i++)
+    {
+        entry = &id_list.rl_want[i];
+
+        if (id_list_rl_find(id_list.rl, id_list.rl_count, entry) >= 0)
+        {
+            continue;
+        }
+
+        bt_addr_le_copy(&add.peer_id_addr, &entry->addr);
+        memcpy(add.peer_irk, entry->peer_irk, 16);
+        memcpy(add.local_irk, entry->local_irk, 16);
+        err = id_list_cmd(BT_HCI_OP_LE_ADD_DEV_TO_RL, &add, sizeof(add));
+        if (err)
+        {
+            return err;
+        }
+
+        id_list.rl[id_list.rl_count++] = *entry;
+
+        /* Device privacy mode, see bt_id_add() */
+        if (BT_CMD_TEST(bt_dev.supported_commands, 39, 2))
+        {
+            bt_addr_le_copy(&mode.id_addr, &entry->addr);
+            mode.mode = BT_HCI_LE_PRIVACY_MODE_DEVICE;
+            (void)id_list_cmd(BT_HCI_OP_LE_SET_PRIVACY_MODE, &mode, sizeof(mode));
+        }
+
+        return 0;
+    }
+
+    return -EALREADY;
+}
+
+#if defined(CONFIG_BT_FILTER_ACCEPT_LIST)
+static int id_list_addr_find(const bt_addr_le_t *list, uint8_t count, const bt_addr_le_t *addr)
+{
+    uint8_t i;
+
+    for (i = 0U; i < count; i++)
+    {
+        if (!bt_addr_le_cmp(&list[i], addr))
+        {
+            return i;
+        }
+    }
+
+    return -ENOENT;
+}
+
+/* Queue the next filter accept list change, -EALREADY once in sync */
+static int id_list_fal_step(void)
+{
+    struct bt_hci_cp_le_add_dev_to_fal add;
+    struct bt_hci_cp_le_rem_dev_from_fal rem;
+    uint8_t i;
+    int err;
+
+    for (i = 0U; i < id_list.fal_count; i++)
+    {
+        if (id_list_addr_find(id_list.fal_want, id_list.fal_want_count, &id_list.fal[i]) >= 0)
+        {
+            continue;
+        }
+
+        bt_addr_le_copy(&rem.addr, &id_list.fal[i]);
+        err = id_list_cmd(BT_HCI_OP_LE_REM_DEV_FROM_FAL, &rem, sizeof(rem));
+        if (err)
+        {
+            return err;
+        }
+
+        id_list.fal[i] = id_list.fal[--id_list.fal_count];
+        return 0;
+    }
+
+    for (i = 0U; i < id_list.fal_want_count; i++)
+    {
+        if (id_list_addr_find(id_list.fal, id_list.fal_count, &id_list.fal_want[i]) >= 0)
+        {
+            continue;
+        }
+
+        bt_addr_le_copy(&add.addr, &id_list.fal_want[i]);
+        err = id_list_cmd(BT_HCI_OP_LE_ADD_DEV_TO_FAL, &add, sizeof(add));
+        if (err)
+        {
+            return err;
+        }
+
+        bt_addr_le_copy(&id_list.fal[id_list.fal_count++], &id_list.fal_want[i]);
+        return 0;
+    }
+
+    return -EALREADY;
+}
+
+int bt_id_list_fal_add(const bt_addr_le_t *addr)
+{
+    if (id_list_addr_find(id_list.fal_want, id_list.fal_want_count, addr) >= 0)
+    {
+        return 0;
+    }
+
+    if (id_list.fal_want_count == ARRAY_SIZE(id_list.fal_want) ||
+        (id_list.fal_size && id_list.fal_want_count == id_list.fal_size))
+    {
+        return -ENOMEM;
+    }
+
+    bt_addr_le_copy(&id_list.fal_want[id_list.fal_want_count++], addr);
+    bt_id_list_update();
+
+    return 0;
+}
+
+int bt_id_list_fal_remove(const bt_addr_le_t *addr)
+{
+    int i;
+
+    i = id_list_addr_find(id_list.fal_want, id_list.fal_want_count, addr);
+    if (i < 0)
+    {
+        return -ENOENT;
+    }
+
+    id_list.fal_want[i] = id_list.fal_want[--id_list.fal_want_count];
+    bt_id_list_update();
+
+    return 0;
+}
+
+int bt_id_list_fal_clear(void)
+{
+    id_list.fal_want_count = 0U;
+    bt_id_list_update();
+
+    return 0;
+}
+#else
+static inline int id_list_fal_step(void)
+{
+    return -EALREADY;
+}
+#endif /* CONFIG_BT_FILTER_ACCEPT_LIST */
+
+/* The lists cannot change while an initiator or limited advertising or
+ * scanning, which must not be paused, is using them.
+ */
+static bool id_list_busy(void)
+{
+    struct bt_conn *conn;
+
+    conn = bt_conn_lookup_state_le(BT_ID_DEFAULT, NULL, BT_CONN_CONNECTING);
+    if (conn)
+    {
+        bt_conn_unref(conn);
+        return true;
+    }
+
+    if (IS_ENABLED(CONFIG_BT_BROADCASTER) && IS_ENABLED(CONFIG_BT_EXT_ADV))
+    {
+        bool adv_enabled = false;
+
+        bt_le_ext_adv_foreach(adv_is_limited_enabled, &adv_enabled);
+        if (adv_enabled)
+        {
+            return true;
+        }
+    }
+
+#if defined(CONFIG_BT_OBSERVER)
+    if (IS_ENABLED(CONFIG_BT_EXT_ADV) && atomic_test_bit(bt_dev.flags, BT_DEV_SCANNING) &&
+        atomic_test_bit(bt_dev.flags, BT_DEV_SCAN_LIMITED))
+    {
+        return true;
+    }
+#endif /* CONFIG_BT_OBSERVER */
+
+    return false;
+}
+
+static void id_list_pause(void)
+{
+    if (IS_ENABLED(CONFIG_BT_BROADCASTER))
+    {
+        bt_le_ext_adv_foreach(adv_pause_enabled, NULL);
+    }
+
+#if defined(CONFIG_BT_OBSERVER)
+    id_list.scan_paused = atomic_test_bit(bt_dev.flags, BT_DEV_SCANNING);
+    if (id_list.scan_paused)
+    {
+        bt_le_scan_set_enable(BT_HCI_LE_SCAN_DISABLE);
+    }
+#endif /* CONFIG_BT_OBSERVER */
+
+    id_list.res_disabled = false;
+}
+
+static void id_list_resume(void)
+{
+    if (id_list.res_disabled && id_list.rl_count)
+    {
+        addr_res_enable(BT_HCI_ADDR_RES_ENABLE);
+    }
+
+#if defined(CONFIG_BT_OBSERVER)
+    if (id_list.scan_paused)
+    {
+        bt_le_scan_set_enable(BT_HCI_LE_SCAN_ENABLE);
+    }
+#endif /* CONFIG_BT_OBSERVER */
+
+    if (IS_ENABLED(CONFIG_BT_BROADCASTER))
+    {
+        bt_le_ext_adv_foreach(adv_unpause_enabled, NULL);
+    }
+}
+
+/* Queue as many changes as command buffers allow, true once all are done */
+static bool id_list_apply(void)
+{
+    int err;
+
+    if (id_list.resync)
+    {
+        id_list.resync = false;
+        id_list.rl_count = 0U;
+        if (bt_dev.le.rl_size)
+        {
+            (void)id_list_cmd(BT_HCI_OP_LE_CLEAR_RL, NULL, 0);
+        }
+#if defined(CONFIG_BT_FILTER_ACCEPT_LIST)
+        id_list.fal_count = 0U;
+        (void)id_list_cmd(BT_HCI_OP_LE_CLEAR_FAL, NULL, 0);
+#endif /* CONFIG_BT_FILTER_ACCEPT_LIST */
+    }
+
+    do
+    {
+        err = id_list_rl_step();
+        if (err == -EALREADY)
+        {
+            err = id_list_fal_step();
+        }
+    } while (!err);
+
+    return err == -EALREADY && !id_list.inflight && !id_list.resync;
+}
+
+static bool id_list_changed(void)
+{
+    uint8_t i;
+
+    if (id_list.rl_want_count != id_list.rl_count)
+    {
+        return true;
+    }
+
+    for (i = 0U; i < id_list.rl_count; i++)
+    {
+        if (id_list_rl_find(id_list.rl_want, id_list.rl_want_count, &id_list.rl[i]) < 0)
+        {
+            return true;
+        }
+    }
+
+#if defined(CONFIG_BT_FILTER_ACCEPT_LIST)
+    if (id_list.fal_want_count != id_list.fal_count)
+    {
+        return true;
+    }
+
+    for (i = 0U; i < id_list.fal_count; i++)
+    {
+        if (id_list_addr_find(id_list.fal_want, id_list.fal_want_count, &id_list.fal[i]) < 0)
+        {
+            return true;
+        }
+    }
+#endif /* CONFIG_BT_FILTER_ACCEPT_LIST */
+
+    return false;
+}
+
+void bt_id_list_update(void)
+{
+    id_list.dirty = true;
+}
+
+void bt_id_list_polling_work(void)
+{
+    bool rl_changed;
+
+    if (bt_dev.hci_state != HCI_STATE_READY)
+    {
+        return;
+    }
+
+    switch (id_list.state)
+    {
+    case ID_LIST_IDLE:
+        if (!id_list.dirty)
+        {
+            return;
+        }
+
+        if (BT_FEAT_LE_PRIVACY(bt_dev.le.features))
+        {
+            (void)id_list_cmd(BT_HCI_OP_LE_READ_RL_SIZE, NULL, 0);
+        }
+#if defined(CONFIG_BT_FILTER_ACCEPT_LIST)
+        (void)id_list_cmd(BT_HCI_OP_LE_READ_FAL_SIZE, NULL, 0);
+#endif /* CONFIG_BT_FILTER_ACCEPT_LIST */
+
+        /* Both lists may hold anything after a controller reset */
+        id_list.resync = true;
+        id_list.state = ID_LIST_SIZE;
+        /* fall through */
+    case ID_LIST_SIZE:
+        if (id_list.inflight)
+        {
+            return;
+        }
+
+        if (!id_list.dirty || id_list_busy())
+        {
+            return;
+        }
+
+        id_list.dirty = false;
+        id_list_rl_want();
+
+        if (!id_list.resync && !id_list_changed())
+        {
+            return;
+        }
+
+        rl_changed = id_list.resync || id_list.rl_want_count != id_list.rl_count ||
+                     memcmp(id_list.rl_want, id_list.rl, id_list.rl_count * sizeof(id_list.rl[0]));
+
+        id_list_pause();
+
+        /* Resolution must be off while the resolving list changes */
+        if (rl_changed && bt_dev.le.rl_size)
+        {
+            addr_res_enable(BT_HCI_ADDR_RES_DISABLE);
+            id_list.res_disabled = true;
+        }
+
+        id_list.state = ID_LIST_APPLY;
+        /* fall through */
+    case ID_LIST_APPLY:
+        if (!id_list_apply())
+        {
+            return;
+        }
+
+        id_list_resume();
+        id_list.state = ID_LIST_SIZE;
+        break;
+    default:
+        break;
+    }
+}
+
+void bt_id_list_cmd_done(uint16_t opcode, uint8_t status, struct net_buf *buf)
+{
+    switch (opcode)
+    {
+    case BT_HCI_OP_LE_READ_RL_SIZE:
+        if (!status)
+        {
+            bt_dev.le.rl_size = ((struct bt_hci_rp_le_read_rl_size *)buf->data)->rl_size;
+        }
+        break;
+#if defined(CONFIG_BT_FILTER_ACCEPT_LIST)
+    case BT_HCI_OP_LE_READ_FAL_SIZE:
+        if (!status)
+        {
+            id_list.fal_size = ((struct bt_hci_rp_le_read_fal_size *)buf->data)->fal_size;
+        }
+        break;
+    case BT_HCI_OP_LE_ADD_DEV_TO_FAL:
+    case BT_HCI_OP_LE_REM_DEV_FROM_FAL:
+    case BT_HCI_OP_LE_CLEAR_FAL:
+#endif /* CONFIG_BT_FILTER_ACCEPT_LIST */
+    case BT_HCI_OP_LE_ADD_DEV_TO_RL:
+    case BT_HCI_OP_LE_REM_DEV_FROM_RL:
+    case BT_HCI_OP_LE_CLEAR_RL:
+        if (status)
+        {
+            BT_WARN("List command 0x%04x failed (0x%02x), resyncing", opcode, status);
+            id_list.resync = true;
+            id_list.dirty = true;
+        }
+        break;
+    case BT_HCI_OP_LE_SET_PRIVACY_MODE:
+        break;
+    default:
+        return;
+    }
+
+    if (id_list.inflight)
+    {
+        id_list.inflight--;
+    }
+}
+#endif /* CONFIG_BT_ID_LIST_BATCH */
 #endif /* defined(CONFIG_BT_SMP) */
 
 void bt_id_get(bt_addr_le_t *addrs, size_t *count)
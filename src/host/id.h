@@ -50,6 +50,21 @@ int bt_id_set_private_addr(uint8_t id);
 
 void bt_id_pending_keys_update(void);
 
+#if defined(CONFIG_BT_ID_LIST_BATCH)
+/* Resync the controller lists with the bonded keys from the polling loop */
+void bt_id_list_update(void);
+void bt_id_list_polling_work(void);
+void bt_id_list_cmd_done(uint16_t opcode, uint8_t status, struct net_buf *buf);
+
+int bt_id_list_fal_add(const bt_addr_le_t *addr);
+int bt_id_list_fal_remove(const bt_addr_le_t *addr);
+int bt_id_list_fal_clear(void);
+#else
+static inline void bt_id_list_update(void)
+{
+}
+#endif /* CONFIG_BT_ID_LIST_BATCH */
+
 int bt_id_set_public_id_addr(bt_addr_le_t *addr);
 
 void bt_id_loading(void);
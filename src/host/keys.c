@@ -22,9 +22,15 @@
 #define LOG_MODULE_NAME bt_keys
 #include "logging/bt_log.h"
 
+#include "base/byteorder.h"
+#include "base/sys_clock.h"
+
+#include "common/aes_backend.h"
+#include "common/aes_cmac.h"
 #include "common/rpa.h"
 #include "gatt_internal.h"
 #include "hci_core.h"
+#include "id.h"
 #include "smp.h"
 
 #include "common/bt_storage_kv.h"
@@ -39,9 +45,13 @@ static uint32_t aging_counter_val;
 static struct bt_keys *last_keys_updated;
 #endif /* CONFIG_BT_KEYS_OVERWRITE_OLDEST */
 
+#if defined(CONFIG_BT_SETTINGS)
 #define BT_SETTINGS_KEY_MAX          (0x10)
 #define BT_KEYS_LIST_INFO_MAGIC_INFO (0xaabb)
 
+/* Legacy layout, a list of all bonds rewritten on every change plus one item
+ * per bond. Only read to move old bonds to per slot records.
+ */
 struct bt_storage_kv_key_list_item
 {
     uint8_t id;
@@ -56,164 +66,144 @@ struct bt_storage_kv_key_list_header
     struct bt_storage_kv_key_list_item items[BT_SETTINGS_KEY_MAX];
 };
 
-void bt_storage_kv_init_key_list_info(struct bt_storage_kv_key_list_header *list_info)
-{
-    list_info->magic = BT_KEYS_LIST_INFO_MAGIC_INFO;
-    list_info->cnt = 0;
-}
-
-void bt_storage_kv_get_key_list_info(struct bt_storage_kv_key_list_header *list_info)
+/* Every key pool slot is stored as a record of its own, so adding, updating
+ * or removing a bond only writes the record of that slot.
+ */
+struct bt_storage_kv_key_record
 {
-    uint16_t len = sizeof(struct bt_storage_kv_key_list_header);
-    int ret = bt_storage_kv_get(KEY_INDEX_LE_KEY_INFO_LIST, (uint8_t *)list_info, &len);
-    if ((ret < 0) || (len != sizeof(struct bt_storage_kv_key_list_header)) ||
-        (list_info->magic != BT_KEYS_LIST_INFO_MAGIC_INFO))
-    {
-        bt_storage_kv_init_key_list_info(list_info);
-    }
-}
+    uint8_t id;
+    bt_addr_le_t addr;
+    uint8_t data[BT_KEYS_STORAGE_LEN];
+};
 
-int bt_storage_kv_get_key_list_info_pos(struct bt_storage_kv_key_list_header *list_info, uint8_t id,
-                                        const bt_addr_le_t *addr)
+static void bt_storage_kv_key_store(struct bt_keys *keys)
 {
-    int pos = -1;
-    for (int i = 0; i < list_info->cnt; i++)
-    {
-        struct bt_storage_kv_key_list_item *item = &list_info->items[i];
-        if (id == item->id && !bt_addr_le_cmp(&item->addr, addr))
-        {
-            pos = i;
-            break;
-        }
-    }
+    struct bt_storage_kv_key_record record;
 
-    return pos;
-}
+    record.id = keys->id;
+    bt_addr_le_copy(&record.addr, &keys->addr);
+    memcpy(record.data, keys->storage_start, BT_KEYS_STORAGE_LEN);
 
-int bt_storage_kv_get_key_list_info_index(struct bt_storage_kv_key_list_header *list_info,
-                                          uint8_t id, const bt_addr_le_t *addr)
-{
-    int select_index = -1;
-    int pos = bt_storage_kv_get_key_list_info_pos(list_info, id, addr);
-    if (pos >= 0)
-    {
-        select_index = list_info->items[pos].index;
-    }
+    bt_storage_kv_set(KEY_INDEX_LE_KEY_RECORD(keys - key_pool), (uint8_t *)&record,
+                      sizeof(record));
 
-    return select_index;
+    (void)memset(&record, 0, sizeof(record));
 }
 
-void bt_storage_kv_set_key_list_info_append(struct bt_storage_kv_key_list_header *list_info,
-                                            uint8_t id, const bt_addr_le_t *addr, uint8_t index)
+static int bt_storage_kv_key_load(uint16_t index, struct bt_keys *keys)
 {
-    // TODO: check the old one?
-    uint8_t store_index = list_info->cnt;
-    if (store_index >= BT_SETTINGS_KEY_MAX)
+    struct bt_storage_kv_key_record record;
+    uint16_t len = sizeof(record);
+    int err = 0;
+
+    if (bt_storage_kv_get(KEY_INDEX_LE_KEY_RECORD(index), (uint8_t *)&record, &len) < 0 ||
+        len != sizeof(record) || !bt_addr_le_cmp(&record.addr, BT_ADDR_LE_ANY))
     {
-        store_index = 0;
+        err = -ENOENT;
     }
     else
     {
-        list_info->cnt++;
+        keys->id = record.id;
+        bt_addr_le_copy(&keys->addr, &record.addr);
+        memcpy(keys->storage_start, record.data, BT_KEYS_STORAGE_LEN);
     }
 
-    struct bt_storage_kv_key_list_item *item = &list_info->items[store_index];
-    item->id = id;
-    item->index = index;
-    bt_addr_le_copy(&item->addr, addr);
+    (void)memset(&record, 0, sizeof(record));
 
-    bt_storage_kv_set(KEY_INDEX_LE_KEY_INFO_LIST, (uint8_t *)list_info,
-                      sizeof(struct bt_storage_kv_key_list_header));
+    return err;
 }
 
-void bt_storage_kv_set_key_list_info_delete(struct bt_storage_kv_key_list_header *list_info,
-                                            uint8_t id, const bt_addr_le_t *addr)
+static void bt_storage_kv_key_delete(struct bt_keys *keys)
 {
-    // TODO: check the old one?
-    int pos = bt_storage_kv_get_key_list_info_pos(list_info, id, addr);
-    if (pos > 0)
-    {
-        list_info->cnt--;
-        if (list_info->cnt > 0)
-        {
-            for (int i = pos; i < list_info->cnt; i++)
-            {
-                memcpy(&list_info->items[i], &list_info->items[i + 1],
-                       sizeof(struct bt_storage_kv_key_list_item));
-            }
-        }
-
-        bt_storage_kv_set(KEY_INDEX_LE_KEY_INFO_LIST, (uint8_t *)list_info,
-                          sizeof(struct bt_storage_kv_key_list_header));
-    }
+    bt_storage_kv_delete(KEY_INDEX_LE_KEY_RECORD(keys - key_pool), NULL, 0);
 }
 
-void bt_storage_kv_set_key_item(uint8_t index, struct bt_keys *keys)
+/* The old list based layout wrote every bond to KEY_INFO_ITEM(0), whatever
+ * index its list entry claims, and appended a list entry on every store.
+ * A record thus only holds the keys of the last entry that refers to it,
+ * the other bonds sharing it lost their keys long ago and must pair again.
+ */
+static bool bt_storage_kv_key_item_owner(const struct bt_storage_kv_key_list_header *list_info,
+                                         int pos)
 {
-    // TODO: check the old one?
-    BT_ASSERT(index < BT_SETTINGS_KEY_MAX);
-
-    bt_storage_kv_set(KEY_INDEX_LE_KEY_INFO_ITEM(index), keys->storage_start, BT_KEYS_STORAGE_LEN);
-}
+    int i;
 
-int bt_storage_kv_get_key_item(uint8_t index, struct bt_keys *keys)
-{
-    // TODO: check the old one?
-    BT_ASSERT(index < BT_SETTINGS_KEY_MAX);
-    uint16_t len = BT_KEYS_STORAGE_LEN;
+    for (i = pos + 1; i < list_info->cnt; i++)
+    {
+        if (list_info->items[i].index == list_info->items[pos].index)
+        {
+            return false;
+        }
+    }
 
-    // TODO: length judge?
-    return bt_storage_kv_get(KEY_INDEX_LE_KEY_INFO_ITEM(index), keys->storage_start, &len);
+    return true;
 }
 
-#if defined(CONFIG_BT_SETTINGS)
-static void bt_storage_kv_key_store(struct bt_keys *keys)
+static void bt_storage_kv_key_migrate(void)
 {
-    uint8_t id = keys->id;
-    bt_addr_le_t *addr = &keys->addr;
-    int select_index = -1;
     struct bt_storage_kv_key_list_header list_info;
-    bt_storage_kv_get_key_list_info(&list_info);
-    select_index = bt_storage_kv_get_key_list_info_index(&list_info, id, addr);
+    struct bt_storage_kv_key_list_item *item;
+    uint16_t len = sizeof(list_info);
+    struct bt_keys *keys;
+    int i;
 
-    if (select_index < 0)
+    if (bt_storage_kv_get(KEY_INDEX_LE_KEY_INFO_LIST, (uint8_t *)&list_info, &len) < 0 ||
+        len != sizeof(list_info) || list_info.magic != BT_KEYS_LIST_INFO_MAGIC_INFO)
     {
-        select_index = 0;
+        return;
     }
 
-    bt_storage_kv_set_key_list_info_append(&list_info, id, addr, select_index);
-    bt_storage_kv_set_key_item(select_index, keys);
-}
-#endif
+    BT_INFO("Migrate %d keys to per slot records", list_info.cnt);
 
-__unused
-static int bt_storage_kv_key_get(struct bt_keys *keys)
-{
-    uint8_t id = keys->id;
-    bt_addr_le_t *addr = &keys->addr;
-    struct bt_storage_kv_key_list_header list_info;
-    bt_storage_kv_get_key_list_info(&list_info);
-    int select_index = bt_storage_kv_get_key_list_info_index(&list_info, id, addr);
+    /* A full list wrapped around to its first entry, the order in which
+     * the entries were written is lost.
+     */
+    if (list_info.cnt >= BT_SETTINGS_KEY_MAX)
+    {
+        BT_WARN("Legacy key list wrapped, no bond can be migrated");
+        list_info.cnt = 0U;
+    }
 
-    if (select_index < 0)
+    for (i = 0; i < list_info.cnt; i++)
     {
-        return -1;
+        item = &list_info.items[i];
+        if (item->index >= BT_SETTINGS_KEY_MAX)
+        {
+            continue;
+        }
+
+        if (!bt_storage_kv_key_item_owner(&list_info, i))
+        {
+            BT_WARN("Dropped bond %s, its keys were overwritten", bt_addr_le_str(&item->addr));
+            continue;
+        }
+
+        keys = bt_keys_get_addr(item->id, &item->addr);
+        if (!keys)
+        {
+            BT_ERR("Failed to allocate keys for %s", bt_addr_le_str(&item->addr));
+            break;
+        }
+
+        len = BT_KEYS_STORAGE_LEN;
+        if (bt_storage_kv_get(KEY_INDEX_LE_KEY_INFO_ITEM(item->index), keys->storage_start,
+                              &len) < 0)
+        {
+            bt_keys_clear(keys);
+            continue;
+        }
+
+        bt_storage_kv_key_store(keys);
     }
 
-    bt_storage_kv_get_key_item(select_index, keys);
-    return 0;
-}
+    for (i = 0; i < BT_SETTINGS_KEY_MAX; i++)
+    {
+        bt_storage_kv_delete(KEY_INDEX_LE_KEY_INFO_ITEM(i), NULL, 0);
+    }
 
-#if defined(CONFIG_BT_SETTINGS)
-static void bt_storage_kv_key_delete(struct bt_keys *keys)
-{
-    uint8_t id = keys->id;
-    bt_addr_le_t *addr = &keys->addr;
-    struct bt_storage_kv_key_list_header list_info;
-    bt_storage_kv_get_key_list_info(&list_info);
-    bt_storage_kv_set_key_list_info_delete(&list_info, id, addr);
+    bt_storage_kv_delete(KEY_INDEX_LE_KEY_INFO_LIST, NULL, 0);
 }
-#endif
+#endif /* CONFIG_BT_SETTINGS */
 
 #if IS_ENABLED(CONFIG_BT_KEYS_OVERWRITE_OLDEST)
 static uint32_t aging_counter_val;
@@ -222,7 +212,7 @@ static struct bt_keys *last_keys_updated;
 struct key_data
 {
     bool in_use;
-    uint8_t id;
+    uint16_t id;
 };
 
 static void find_key_in_use(struct bt_conn *conn, void *data)
@@ -246,7 +236,7 @@ static void find_key_in_use(struct bt_conn *conn, void *data)
     }
 }
 
-static bool key_is_in_use(uint8_t id)
+static bool key_is_in_use(uint16_t id)
 {
     struct key_data kdata = {false, id};
 
@@ -256,245 +246,1069 @@ static bool key_is_in_use(uint8_t id)
 }
 #endif /* CONFIG_BT_KEYS_OVERWRITE_OLDEST */
 
-struct bt_keys *bt_keys_get_addr(uint8_t id, const bt_addr_le_t *addr)
-{
-    struct bt_keys *keys;
-    int i;
-    size_t first_free_slot = ARRAY_SIZE(key_pool);
-
-    BT_DBG("%s", bt_addr_le_str(addr));
-
-    for (i = 0; i < ARRAY_SIZE(key_pool); i++)
-    {
-        keys = &key_pool[i];
-
-        if (keys->id == id && !bt_addr_le_cmp(&keys->addr, addr))
-        {
-            return keys;
-        }
-        if (first_free_slot == ARRAY_SIZE(key_pool) && !bt_addr_le_cmp(&keys->addr, BT_ADDR_LE_ANY))
-        {
-            first_free_slot = i;
-        }
-    }
+#if defined(CONFIG_BT_KEYS_INDEX)
+#define KEYS_NONE 0xFFFF
 
+/* Hash chains over the slots in use, keyed by identity and address */
+static uint16_t keys_bucket[CONFIG_BT_MAX_PAIRED];
+static uint16_t keys_hash_next[CONFIG_BT_MAX_PAIRED];
+/* Stack of free slots */
+static uint16_t keys_free[CONFIG_BT_MAX_PAIRED];
+static uint16_t keys_free_cnt;
 #if IS_ENABLED(CONFIG_BT_KEYS_OVERWRITE_OLDEST)
-    if (first_free_slot == ARRAY_SIZE(key_pool))
-    {
-        struct bt_keys *oldest = NULL;
-        bt_addr_le_t oldest_addr;
-
-        for (i = 0; i < ARRAY_SIZE(key_pool); i++)
-        {
-            struct bt_keys *current = &key_pool[i];
-            bool key_in_use = (CONFIG_BT_MAX_CONN > 1) && key_is_in_use(i);
-
-            if (key_in_use)
-            {
-                continue;
-            }
+/* Slots in use ordered by aging counter, head is the most recently used */
+static uint16_t keys_lru_prev[CONFIG_BT_MAX_PAIRED];
+static uint16_t keys_lru_next[CONFIG_BT_MAX_PAIRED];
+static uint16_t keys_lru_head;
+static uint16_t keys_lru_tail;
+#endif /* CONFIG_BT_KEYS_OVERWRITE_OLDEST */
+static bool keys_index_ready;
 
-            if ((oldest == NULL) || (current->aging_counter < oldest->aging_counter))
-            {
-                oldest = current;
-            }
-        }
+static void keys_index_rebuild(void);
 
-        if (oldest == NULL)
-        {
-            BT_DBG("unable to create keys for %s", bt_addr_le_str(addr));
-            return NULL;
-        }
+static uint16_t keys_hash(uint8_t id, const bt_addr_le_t *addr)
+{
+    /* FNV-1a, public addresses share their upper bytes */
+    uint32_t hash = 2166136261U;
+    uint8_t i;
 
-        /* Use a copy as bt_unpair will clear the oldest key. */
-        bt_addr_le_copy(&oldest_addr, &oldest->addr);
-        bt_unpair(oldest->id, &oldest_addr);
-        if (!bt_addr_le_cmp(&oldest->addr, BT_ADDR_LE_ANY))
-        {
-            first_free_slot = oldest - &key_pool[0];
-        }
-    }
+    hash = (hash ^ id) * 16777619U;
+    hash = (hash ^ addr->type) * 16777619U;
 
-#endif /* CONFIG_BT_KEYS_OVERWRITE_OLDEST */
-    if (first_free_slot < ARRAY_SIZE(key_pool))
+    for (i = 0U; i < sizeof(addr->a.val); i++)
     {
-        keys = &key_pool[first_free_slot];
-        keys->id = id;
-        bt_addr_le_copy(&keys->addr, addr);
-#if IS_ENABLED(CONFIG_BT_KEYS_OVERWRITE_OLDEST)
-        keys->aging_counter = ++aging_counter_val;
-        last_keys_updated = keys;
-#endif /* CONFIG_BT_KEYS_OVERWRITE_OLDEST */
-        BT_DBG("created %p for %s", keys, bt_addr_le_str(addr));
-        return keys;
+        hash = (hash ^ addr->a.val[i]) * 16777619U;
     }
 
-    BT_DBG("unable to create keys for %s", bt_addr_le_str(addr));
-
-    return NULL;
+    return hash % ARRAY_SIZE(keys_bucket);
 }
 
-void bt_foreach_bond(uint8_t id, void (*func)(const struct bt_bond_info *info, void *user_data),
-                     void *user_data)
+static void keys_hash_add(uint16_t index)
 {
-    int i;
-
-    for (i = 0; i < ARRAY_SIZE(key_pool); i++)
-    {
-        struct bt_keys *keys = &key_pool[i];
-
-        if (keys->keys && keys->id == id)
-        {
-            struct bt_bond_info info;
+    uint16_t bucket = keys_hash(key_pool[index].id, &key_pool[index].addr);
 
-            bt_addr_le_copy(&info.addr, &keys->addr);
-            func(&info, user_data);
-        }
-    }
+    keys_hash_next[index] = keys_bucket[bucket];
+    keys_bucket[bucket] = index;
 }
 
-void bt_keys_foreach(int type, void (*func)(struct bt_keys *keys, void *data), void *data)
+/* Returns false if the slot was not hashed */
+static bool keys_hash_del(uint16_t index)
 {
-    int i;
+    uint16_t *link = &keys_bucket[keys_hash(key_pool[index].id, &key_pool[index].addr)];
 
-    for (i = 0; i < ARRAY_SIZE(key_pool); i++)
+    while (*link != KEYS_NONE)
     {
-        if ((key_pool[i].keys & type))
+        if (*link == index)
         {
-            func(&key_pool[i], data);
+            *link = keys_hash_next[index];
+            keys_hash_next[index] = KEYS_NONE;
+            return true;
         }
+
+        link = &keys_hash_next[*link];
     }
+
+    return false;
 }
 
-struct bt_keys *bt_keys_find(int type, uint8_t id, const bt_addr_le_t *addr)
+#if IS_ENABLED(CONFIG_BT_KEYS_OVERWRITE_OLDEST)
+static void keys_lru_unlink(uint16_t index)
 {
-    int i;
-
-    BT_DBG("type %d %s", type, bt_addr_le_str(addr));
+    if (keys_lru_prev[index] != KEYS_NONE)
+    {
+        keys_lru_next[keys_lru_prev[index]] = keys_lru_next[index];
+    }
+    else
+    {
+        keys_lru_head = keys_lru_next[index];
+    }
 
-    for (i = 0; i < ARRAY_SIZE(key_pool); i++)
+    if (keys_lru_next[index] != KEYS_NONE)
     {
-        if ((key_pool[i].keys & type) && key_pool[i].id == id &&
-            !bt_addr_le_cmp(&key_pool[i].addr, addr))
-        {
-            return &key_pool[i];
-        }
+        keys_lru_prev[keys_lru_next[index]] = keys_lru_prev[index];
+    }
+    else
+    {
+        keys_lru_tail = keys_lru_prev[index];
     }
 
-    return NULL;
+    keys_lru_prev[index] = KEYS_NONE;
+    keys_lru_next[index] = KEYS_NONE;
 }
 
-struct bt_keys *bt_keys_get_type(int type, uint8_t id, const bt_addr_le_t *addr)
+static void keys_lru_push(uint16_t index)
 {
-    struct bt_keys *keys;
+    keys_lru_prev[index] = KEYS_NONE;
+    keys_lru_next[index] = keys_lru_head;
 
-    BT_DBG("type %d %s", type, bt_addr_le_str(addr));
-
-    keys = bt_keys_find(type, id, addr);
-    if (keys)
+    if (keys_lru_head != KEYS_NONE)
     {
-        return keys;
+        keys_lru_prev[keys_lru_head] = index;
     }
-
-    keys = bt_keys_get_addr(id, addr);
-    if (!keys)
+    else
     {
-        return NULL;
+        keys_lru_tail = index;
     }
 
-    bt_keys_add_type(keys, type);
-
-    return keys;
+    keys_lru_head = index;
 }
 
-struct bt_keys *bt_keys_find_irk(uint8_t id, const bt_addr_le_t *addr)
+static void keys_index_touch(struct bt_keys *keys)
 {
-    int i;
+    uint16_t index = keys - key_pool;
 
-    BT_DBG("%s", bt_addr_le_str(addr));
+    if (!keys_index_ready)
+    {
+        keys_index_rebuild();
+    }
 
-    if (!bt_addr_le_is_rpa(addr))
+    if (keys_lru_head != index)
     {
-        return NULL;
+        keys_lru_unlink(index);
+        keys_lru_push(index);
     }
+}
 
-    for (i = 0; i < ARRAY_SIZE(key_pool); i++)
+static struct bt_keys *keys_oldest_unused(void)
+{
+    uint16_t index;
+
+    for (index = keys_lru_tail; index != KEYS_NONE; index = keys_lru_prev[index])
     {
-        // BT_DBG("i: 0x%x, keys: 0x%x", i, key_pool[i].keys);
-        if (!(key_pool[i].keys & BT_KEYS_IRK))
+        if ((CONFIG_BT_MAX_CONN > 1) && key_is_in_use(index))
         {
             continue;
         }
 
-        // BT_DBG("id: %d, id1: %d, rpa: %s", id
-        //     , key_pool[i].id, bt_addr_str(&key_pool[i].irk.rpa));
-
-        if (key_pool[i].id == id && !bt_addr_cmp(&addr->a, &key_pool[i].irk.rpa))
-        {
-            BT_DBG("cached RPA %s for %s", bt_addr_str(&key_pool[i].irk.rpa),
-                   bt_addr_le_str(&key_pool[i].addr));
-            return &key_pool[i];
-        }
+        return &key_pool[index];
     }
 
-    for (i = 0; i < ARRAY_SIZE(key_pool); i++)
+    return NULL;
+}
+#endif /* CONFIG_BT_KEYS_OVERWRITE_OLDEST */
+
+static void keys_index_rebuild(void)
+{
+    uint16_t i;
+
+    (void)memset(keys_bucket, 0xFF, sizeof(keys_bucket));
+    (void)memset(keys_hash_next, 0xFF, sizeof(keys_hash_next));
+    keys_free_cnt = 0U;
+
+#if IS_ENABLED(CONFIG_BT_KEYS_OVERWRITE_OLDEST)
+    (void)memset(keys_lru_prev, 0xFF, sizeof(keys_lru_prev));
+    (void)memset(keys_lru_next, 0xFF, sizeof(keys_lru_next));
+    keys_lru_head = KEYS_NONE;
+    keys_lru_tail = KEYS_NONE;
+#endif /* CONFIG_BT_KEYS_OVERWRITE_OLDEST */
+
+    /* Push free slots from the top so the lowest one is used first */
+    for (i = ARRAY_SIZE(key_pool); i > 0; i--)
     {
-        // BT_DBG("i: 0x%x, keys: 0x%x", i, key_pool[i].keys);
-        if (!(key_pool[i].keys & BT_KEYS_IRK))
-        {
-            continue;
-        }
+        uint16_t index = i - 1;
 
-        if (key_pool[i].id != id)
+        if (!bt_addr_le_cmp(&key_pool[index].addr, BT_ADDR_LE_ANY))
         {
+            keys_free[keys_free_cnt++] = index;
             continue;
         }
 
-        if (bt_rpa_irk_matches(key_pool[i].irk.val, &addr->a))
+        keys_hash_add(index);
+
+#if IS_ENABLED(CONFIG_BT_KEYS_OVERWRITE_OLDEST)
         {
-            BT_DBG("RPA %s matches %s", bt_addr_str(&key_pool[i].irk.rpa),
-                   bt_addr_le_str(&key_pool[i].addr));
+            uint16_t pos = keys_lru_head;
 
-            bt_addr_copy(&key_pool[i].irk.rpa, &addr->a);
+            /* Only done once after loading, keep it simple */
+            while (pos != KEYS_NONE &&
+                   key_pool[pos].aging_counter > key_pool[index].aging_counter)
+            {
+                pos = keys_lru_next[pos];
+            }
 
-            return &key_pool[i];
+            if (pos == keys_lru_head)
+            {
+                keys_lru_push(index);
+            }
+            else
+            {
+                uint16_t prev = (pos == KEYS_NONE) ? keys_lru_tail : keys_lru_prev[pos];
+
+                keys_lru_prev[index] = prev;
+                keys_lru_next[index] = pos;
+                keys_lru_next[prev] = index;
+
+                if (pos == KEYS_NONE)
+                {
+                    keys_lru_tail = index;
+                }
+                else
+                {
+                    keys_lru_prev[pos] = index;
+                }
+            }
         }
+#endif /* CONFIG_BT_KEYS_OVERWRITE_OLDEST */
     }
 
-    BT_DBG("No IRK for %s", bt_addr_le_str(addr));
-
-    return NULL;
+    keys_index_ready = true;
 }
 
-struct bt_keys *bt_keys_find_addr(uint8_t id, const bt_addr_le_t *addr)
+static struct bt_keys *keys_lookup(uint8_t id, const bt_addr_le_t *addr)
 {
-    int i;
+    uint16_t index;
 
-    BT_DBG("%s", bt_addr_le_str(addr));
+    if (!keys_index_ready)
+    {
+        keys_index_rebuild();
+    }
 
-    for (i = 0; i < ARRAY_SIZE(key_pool); i++)
+    for (index = keys_bucket[keys_hash(id, addr)]; index != KEYS_NONE;
+         index = keys_hash_next[index])
     {
-        if (key_pool[i].id == id && !bt_addr_le_cmp(&key_pool[i].addr, addr))
+        if (key_pool[index].id == id && !bt_addr_le_cmp(&key_pool[index].addr, addr))
         {
-            return &key_pool[i];
+            return &key_pool[index];
         }
     }
 
     return NULL;
 }
 
-void bt_keys_add_type(struct bt_keys *keys, int type)
+static struct bt_keys *keys_free_slot(void)
 {
-    keys->keys |= type;
-}
+    if (!keys_index_ready)
+    {
+        keys_index_rebuild();
+    }
 
-void bt_keys_clear(struct bt_keys *keys)
+    if (!keys_free_cnt)
+    {
+        return NULL;
+    }
+
+    return &key_pool[keys_free[--keys_free_cnt]];
+}
+
+/* Called once the slot got its identity and address */
+static void keys_index_add(struct bt_keys *keys)
+{
+    uint16_t index = keys - key_pool;
+
+    keys_hash_add(index);
+#if IS_ENABLED(CONFIG_BT_KEYS_OVERWRITE_OLDEST)
+    keys_lru_push(index);
+#endif /* CONFIG_BT_KEYS_OVERWRITE_OLDEST */
+}
+
+/* Called before the slot is cleared */
+static void keys_index_del(struct bt_keys *keys)
+{
+    uint16_t index = keys - key_pool;
+
+    if (!keys_index_ready)
+    {
+        keys_index_rebuild();
+    }
+
+    if (!keys_hash_del(index))
+    {
+        return;
+    }
+
+#if IS_ENABLED(CONFIG_BT_KEYS_OVERWRITE_OLDEST)
+    keys_lru_unlink(index);
+#endif /* CONFIG_BT_KEYS_OVERWRITE_OLDEST */
+
+    keys_free[keys_free_cnt++] = index;
+}
+#else
+static struct bt_keys *keys_lookup(uint8_t id, const bt_addr_le_t *addr)
+{
+    int i;
+
+    for (i = 0; i < ARRAY_SIZE(key_pool); i++)
+    {
+        if (key_pool[i].id == id && !bt_addr_le_cmp(&key_pool[i].addr, addr))
+        {
+            return &key_pool[i];
+        }
+    }
+
+    return NULL;
+}
+
+static struct bt_keys *keys_free_slot(void)
+{
+    int i;
+
+    for (i = 0; i < ARRAY_SIZE(key_pool); i++)
+    {
+        if (!bt_addr_le_cmp(&key_pool[i].addr, BT_ADDR_LE_ANY))
+        {
+            return &key_pool[i];
+        }
+    }
+
+    return NULL;
+}
+
+#if IS_ENABLED(CONFIG_BT_KEYS_OVERWRITE_OLDEST)
+static struct bt_keys *keys_oldest_unused(void)
+{
+    struct bt_keys *oldest = NULL;
+    int i;
+
+    for (i = 0; i < ARRAY_SIZE(key_pool); i++)
+    {
+        struct bt_keys *current = &key_pool[i];
+        bool key_in_use = (CONFIG_BT_MAX_CONN > 1) && key_is_in_use(i);
+
+        if (key_in_use)
+        {
+            continue;
+        }
+
+        if ((oldest == NULL) || (current->aging_counter < oldest->aging_counter))
+        {
+            oldest = current;
+        }
+    }
+
+    return oldest;
+}
+
+static inline void keys_index_touch(struct bt_keys *keys)
+{
+}
+#endif /* CONFIG_BT_KEYS_OVERWRITE_OLDEST */
+
+static inline void keys_index_add(struct bt_keys *keys)
+{
+}
+
+static inline void keys_index_del(struct bt_keys *keys)
+{
+}
+#endif /* CONFIG_BT_KEYS_INDEX */
+
+struct bt_keys *bt_keys_get_addr(uint8_t id, const bt_addr_le_t *addr)
+{
+    struct bt_keys *keys;
+
+    BT_DBG("%s", bt_addr_le_str(addr));
+
+    keys = keys_lookup(id, addr);
+    if (keys)
+    {
+        return keys;
+    }
+
+    keys = keys_free_slot();
+
+#if IS_ENABLED(CONFIG_BT_KEYS_OVERWRITE_OLDEST)
+    if (!keys)
+    {
+        struct bt_keys *oldest = keys_oldest_unused();
+        bt_addr_le_t oldest_addr;
+
+        if (oldest == NULL)
+        {
+            BT_DBG("unable to create keys for %s", bt_addr_le_str(addr));
+            return NULL;
+        }
+
+        /* Use a copy as bt_unpair will clear the oldest key. */
+        bt_addr_le_copy(&oldest_addr, &oldest->addr);
+        bt_unpair(oldest->id, &oldest_addr);
+        if (!bt_addr_le_cmp(&oldest->addr, BT_ADDR_LE_ANY))
+        {
+            keys = keys_free_slot();
+        }
+    }
+
+#endif /* CONFIG_BT_KEYS_OVERWRITE_OLDEST */
+    if (keys)
+    {
+        keys->id = id;
+        bt_addr_le_copy(&keys->addr, addr);
+#if IS_ENABLED(CONFIG_BT_KEYS_OVERWRITE_OLDEST)
+        keys->aging_counter = ++aging_counter_val;
+        last_keys_updated = keys;
+#endif /* CONFIG_BT_KEYS_OVERWRITE_OLDEST */
+        keys_index_add(keys);
+        BT_DBG("created %p for %s", keys, bt_addr_le_str(addr));
+        return keys;
+    }
+
+    BT_DBG("unable to create keys for %s", bt_addr_le_str(addr));
+
+    return NULL;
+}
+
+void bt_keys_set_addr(struct bt_keys *keys, const bt_addr_le_t *addr)
+{
+#if defined(CONFIG_BT_KEYS_INDEX)
+    bool hashed;
+
+    if (!keys_index_ready)
+    {
+        keys_index_rebuild();
+    }
+
+    hashed = keys_hash_del(keys - key_pool);
+#endif /* CONFIG_BT_KEYS_INDEX */
+
+    bt_addr_le_copy(&keys->addr, addr);
+
+#if defined(CONFIG_BT_KEYS_INDEX)
+    if (hashed)
+    {
+        keys_hash_add(keys - key_pool);
+    }
+#endif /* CONFIG_BT_KEYS_INDEX */
+}
+
+void bt_foreach_bond(uint8_t id, void (*func)(const struct bt_bond_info *info, void *user_data),
+                     void *user_data)
+{
+    int i;
+
+    for (i = 0; i < ARRAY_SIZE(key_pool); i++)
+    {
+        struct bt_keys *keys = &key_pool[i];
+
+        if (keys->keys && keys->id == id)
+        {
+            struct bt_bond_info info;
+
+            bt_addr_le_copy(&info.addr, &keys->addr);
+            func(&info, user_data);
+        }
+    }
+}
+
+void bt_keys_foreach(int type, void (*func)(struct bt_keys *keys, void *data), void *data)
+{
+    int i;
+
+    for (i = 0; i < ARRAY_SIZE(key_pool); i++)
+    {
+        if ((key_pool[i].keys & type))
+        {
+            func(&key_pool[i], data);
+        }
+    }
+}
+
+struct bt_keys *bt_keys_find(int type, uint8_t id, const bt_addr_le_t *addr)
+{
+    struct bt_keys *keys;
+
+    BT_DBG("type %d %s", type, bt_addr_le_str(addr));
+
+    keys = keys_lookup(id, addr);
+    if (keys && (keys->keys & type))
+    {
+        return keys;
+    }
+
+    return NULL;
+}
+
+struct bt_keys *bt_keys_get_type(int type, uint8_t id, const bt_addr_le_t *addr)
+{
+    struct bt_keys *keys;
+
+    BT_DBG("type %d %s", type, bt_addr_le_str(addr));
+
+    keys = bt_keys_find(type, id, addr);
+    if (keys)
+    {
+        return keys;
+    }
+
+    keys = bt_keys_get_addr(id, addr);
+    if (!keys)
+    {
+        return NULL;
+    }
+
+    bt_keys_add_type(keys, type);
+
+    return keys;
+}
+
+#if defined(CONFIG_BT_KEYS_RPA_CACHE)
+#define RPA_CACHE_NONE    0xFF
+/* In ms, entry stamps are in ticks */
+#define RPA_CACHE_TIMEOUT (CONFIG_BT_KEYS_RPA_CACHE_TIMEOUT * 1000U)
+
+struct rpa_cache_entry
+{
+    bt_addr_t rpa;
+    uint8_t id;
+    bool in_use;
+    /* Next entry in the same hash bucket */
+    uint8_t hash_next;
+    /* Neighbours in the LRU list, head is the most recently used */
+    uint8_t lru_prev;
+    uint8_t lru_next;
+    /* NULL if no bonded IRK resolves the RPA */
+    struct bt_keys *keys;
+    uint32_t stamp;
+};
+
+static struct rpa_cache_entry rpa_cache[CONFIG_BT_KEYS_RPA_CACHE_SIZE];
+static uint8_t rpa_cache_bucket[CONFIG_BT_KEYS_RPA_CACHE_SIZE];
+static uint8_t rpa_cache_head;
+static uint8_t rpa_cache_tail;
+static bool rpa_cache_ready;
+
+static uint8_t rpa_cache_hash(uint8_t id, const bt_addr_t *rpa)
+{
+    /* The hash part of an RPA is the output of AES, it needs no mixing */
+    return (uint8_t)(((rpa->val[0] | (rpa->val[1] << 8)) ^ id) % ARRAY_SIZE(rpa_cache_bucket));
+}
+
+static void rpa_cache_flush(void)
+{
+    uint8_t i;
+
+    (void)memset(rpa_cache, 0, sizeof(rpa_cache));
+    (void)memset(rpa_cache_bucket, RPA_CACHE_NONE, sizeof(rpa_cache_bucket));
+
+    for (i = 0U; i < ARRAY_SIZE(rpa_cache); i++)
+    {
+        rpa_cache[i].hash_next = RPA_CACHE_NONE;
+        rpa_cache[i].lru_prev = i ? i - 1 : RPA_CACHE_NONE;
+        rpa_cache[i].lru_next = (i + 1 < ARRAY_SIZE(rpa_cache)) ? i + 1 : RPA_CACHE_NONE;
+    }
+
+    rpa_cache_head = 0U;
+    rpa_cache_tail = ARRAY_SIZE(rpa_cache) - 1;
+    rpa_cache_ready = true;
+}
+
+static void rpa_cache_touch(uint8_t index)
+{
+    struct rpa_cache_entry *entry = &rpa_cache[index];
+
+    if (index == rpa_cache_head)
+    {
+        return;
+    }
+
+    /* Unlink, the entry is not the head so it has a previous one */
+    rpa_cache[entry->lru_prev].lru_next = entry->lru_next;
+    if (entry->lru_next != RPA_CACHE_NONE)
+    {
+        rpa_cache[entry->lru_next].lru_prev = entry->lru_prev;
+    }
+    else
+    {
+        rpa_cache_tail = entry->lru_prev;
+    }
+
+    entry->lru_prev = RPA_CACHE_NONE;
+    entry->lru_next = rpa_cache_head;
+    rpa_cache[rpa_cache_head].lru_prev = index;
+    rpa_cache_head = index;
+}
+
+static void rpa_cache_unhash(uint8_t index)
+{
+    struct rpa_cache_entry *entry = &rpa_cache[index];
+    uint8_t *link = &rpa_cache_bucket[rpa_cache_hash(entry->id, &entry->rpa)];
+
+    while (*link != RPA_CACHE_NONE)
+    {
+        if (*link == index)
+        {
+            *link = entry->hash_next;
+            break;
+        }
+
+        link = &rpa_cache[*link].hash_next;
+    }
+
+    entry->hash_next = RPA_CACHE_NONE;
+    entry->in_use = false;
+}
+
+/* Returns the entry for the RPA, expired or not, or NULL */
+static struct rpa_cache_entry *rpa_cache_find(uint8_t id, const bt_addr_t *rpa)
+{
+    uint8_t index;
+
+    if (!rpa_cache_ready)
+    {
+        rpa_cache_flush();
+    }
+
+    for (index = rpa_cache_bucket[rpa_cache_hash(id, rpa)]; index != RPA_CACHE_NONE;
+         index = rpa_cache[index].hash_next)
+    {
+        if (rpa_cache[index].id == id && !bt_addr_cmp(&rpa_cache[index].rpa, rpa))
+        {
+            return &rpa_cache[index];
+        }
+    }
+
+    return NULL;
+}
+
+static bool rpa_cache_valid(const struct rpa_cache_entry *entry)
+{
+    return k_ticks_to_ms_floor32(sys_clock_tick_get() - entry->stamp) < RPA_CACHE_TIMEOUT;
+}
+
+static void rpa_cache_store(struct rpa_cache_entry *entry, uint8_t id, const bt_addr_t *rpa,
+                            struct bt_keys *keys)
+{
+    uint8_t index;
+    uint8_t bucket;
+
+    if (!entry)
+    {
+        /* Replace the least recently used entry */
+        index = rpa_cache_tail;
+        entry = &rpa_cache[index];
+
+        if (entry->in_use)
+        {
+            rpa_cache_unhash(index);
+        }
+
+        entry->id = id;
+        bt_addr_copy(&entry->rpa, rpa);
+        entry->in_use = true;
+
+        bucket = rpa_cache_hash(id, rpa);
+        entry->hash_next = rpa_cache_bucket[bucket];
+        rpa_cache_bucket[bucket] = index;
+    }
+    else
+    {
+        index = entry - rpa_cache;
+    }
+
+    entry->keys = keys;
+    entry->stamp = sys_clock_tick_get();
+
+    rpa_cache_touch(index);
+}
+
+static void rpa_cache_keys_changed(void)
+{
+    rpa_cache_ready = false;
+}
+#else
+static inline void rpa_cache_keys_changed(void)
+{
+}
+#endif /* CONFIG_BT_KEYS_RPA_CACHE */
+
+#if defined(CONFIG_BT_KEYS_IRK_SCHED)
+struct irk_sched
+{
+    /* IRK the schedule was expanded from */
+    uint8_t irk[16];
+    struct bt_aes_sched sched;
+};
+
+static struct irk_sched irk_sched[CONFIG_BT_MAX_PAIRED];
+
+static const struct bt_aes_sched *irk_sched_get(int index)
+{
+    struct irk_sched *entry = &irk_sched[index];
+    uint8_t irk_be[16];
+
+    /* The IRK is written right after the key type is added, the copy
+     * catches that as well as a change of the AES backend.
+     */
+    if (entry->sched.backend != bt_aes_backend_get() ||
+        memcmp(entry->irk, key_pool[index].irk.val, sizeof(entry->irk)))
+    {
+        memcpy(entry->irk, key_pool[index].irk.val, sizeof(entry->irk));
+        sys_memcpy_swap(irk_be, entry->irk, sizeof(irk_be));
+        bt_aes_expand(&entry->sched, irk_be);
+        (void)memset(irk_be, 0, sizeof(irk_be));
+    }
+
+    return &entry->sched;
+}
+
+static struct bt_keys *irk_resolve(uint8_t id, const bt_addr_t *rpa)
+{
+    const struct bt_aes_sched *irks[ARRAY_SIZE(key_pool)];
+    int i;
+
+    for (i = 0; i < ARRAY_SIZE(key_pool); i++)
+    {
+        if ((key_pool[i].keys & BT_KEYS_IRK) && key_pool[i].id == id)
+        {
+            irks[i] = irk_sched_get(i);
+        }
+        else
+        {
+            irks[i] = NULL;
+        }
+    }
+
+    i = bt_rpa_resolve(irks, ARRAY_SIZE(irks), rpa);
+    if (i < 0)
+    {
+        return NULL;
+    }
+
+    return &key_pool[i];
+}
+#else
+static struct bt_keys *irk_resolve(uint8_t id, const bt_addr_t *rpa)
+{
+    int i;
+
+    for (i = 0; i < ARRAY_SIZE(key_pool); i++)
+    {
+        if (!(key_pool[i].keys & BT_KEYS_IRK))
+        {
+            continue;
+        }
+
+        if (key_pool[i].id != id)
+        {
+            continue;
+        }
+
+        if (bt_rpa_irk_matches(key_pool[i].irk.val, rpa))
+        {
+            return &key_pool[i];
+        }
+    }
+
+    return NULL;
+}
+#endif /* CONFIG_BT_KEYS_IRK_SCHED */
+
+static void irk_sched_clear(struct bt_keys *keys)
+{
+#if defined(CONFIG_BT_KEYS_IRK_SCHED)
+    (void)memset(&irk_sched[keys - key_pool], 0, sizeof(irk_sched[0]));
+#endif /* CONFIG_BT_KEYS_IRK_SCHED */
+}
+
+static struct bt_keys *find_irk(uint8_t id, const bt_addr_le_t *addr)
+{
+    struct bt_keys *keys;
+    int i;
+
+    for (i = 0; i < ARRAY_SIZE(key_pool); i++)
+    {
+        // BT_DBG("i: 0x%x, keys: 0x%x", i, key_pool[i].keys);
+        if (!(key_pool[i].keys & BT_KEYS_IRK))
+        {
+            continue;
+        }
+
+        // BT_DBG("id: %d, id1: %d, rpa: %s", id
+        //     , key_pool[i].id, bt_addr_str(&key_pool[i].irk.rpa));
+
+        if (key_pool[i].id == id && !bt_addr_cmp(&addr->a, &key_pool[i].irk.rpa))
+        {
+            BT_DBG("cached RPA %s for %s", bt_addr_str(&key_pool[i].irk.rpa),
+                   bt_addr_le_str(&key_pool[i].addr));
+            return &key_pool[i];
+        }
+    }
+
+    keys = irk_resolve(id, &addr->a);
+    if (keys)
+    {
+        BT_DBG("RPA %s matches %s", bt_addr_le_str(addr), bt_addr_le_str(&keys->addr));
+
+        bt_addr_copy(&keys->irk.rpa, &addr->a);
+
+        return keys;
+    }
+
+    BT_DBG("No IRK for %s", bt_addr_le_str(addr));
+
+    return NULL;
+}
+
+struct bt_keys *bt_keys_find_irk(uint8_t id, const bt_addr_le_t *addr)
+{
+#if defined(CONFIG_BT_KEYS_RPA_CACHE)
+    struct rpa_cache_entry *entry;
+    struct bt_keys *keys;
+#endif /* CONFIG_BT_KEYS_RPA_CACHE */
+
+    BT_DBG("%s", bt_addr_le_str(addr));
+
+    if (!bt_addr_le_is_rpa(addr))
+    {
+        return NULL;
+    }
+
+#if defined(CONFIG_BT_KEYS_RPA_CACHE)
+    entry = rpa_cache_find(id, &addr->a);
+    if (entry && rpa_cache_valid(entry))
+    {
+        rpa_cache_touch(entry - rpa_cache);
+        return entry->keys;
+    }
+
+    keys = find_irk(id, addr);
+    rpa_cache_store(entry, id, &addr->a, keys);
+
+    return keys;
+#else
+    return find_irk(id, addr);
+#endif /* CONFIG_BT_KEYS_RPA_CACHE */
+}
+
+#if defined(CONFIG_BT_KEYS_RPA_BENCHMARK)
+#define RPA_BENCH_IRKS    50
+#define RPA_BENCH_RPAS    500
+/* Advertisers are reported repeatedly while in range, RPAs are replayed in
+ * groups so every report of a group but the first can hit the cache.
+ */
+#define RPA_BENCH_GROUP   16
+#define RPA_BENCH_REPORTS 10
+
+void bt_keys_rpa_benchmark(void)
+{
+    static uint8_t irks[RPA_BENCH_IRKS][16];
+    static struct bt_aes_sched scheds[RPA_BENCH_IRKS];
+    static const struct bt_aes_sched *sched_list[RPA_BENCH_IRKS];
+    static bt_addr_t rpas[RPA_BENCH_RPAS];
+    uint32_t lookups = 0U;
+    uint32_t matches = 0U;
+    uint32_t start;
+    uint32_t elapsed;
+    uint8_t irk_be[16];
+    int group, rep, i, j;
+
+    for (i = 0; i < RPA_BENCH_IRKS; i++)
+    {
+        (void)bt_rand(irks[i], sizeof(irks[i]));
+    }
+
+    for (i = 0; i < RPA_BENCH_RPAS; i++)
+    {
+        (void)bt_rand(rpas[i].val, sizeof(rpas[i].val));
+        BT_ADDR_SET_RPA(&rpas[i]);
+    }
+
+    /* Per IRK path, as without CONFIG_BT_KEYS_IRK_SCHED */
+    start = sys_clock_tick_get();
+    for (group = 0; group < RPA_BENCH_RPAS; group += RPA_BENCH_GROUP)
+    {
+        for (rep = 0; rep < RPA_BENCH_REPORTS; rep++)
+        {
+            for (i = group; i < MIN(group + RPA_BENCH_GROUP, RPA_BENCH_RPAS); i++)
+            {
+                for (j = 0; j < RPA_BENCH_IRKS; j++)
+                {
+                    matches += bt_rpa_irk_matches(irks[j], &rpas[i]);
+                }
+                lookups++;
+            }
+        }
+    }
+    elapsed = sys_clock_tick_get() - start;
+    BT_INFO("RPA per IRK: %u lookups in %u ms, %u us each", lookups,
+            k_ticks_to_ms_floor32(elapsed), k_ticks_to_us_floor32(elapsed) / lookups);
+
+    /* Batched path with kept schedules */
+    start = sys_clock_tick_get();
+    for (j = 0; j < RPA_BENCH_IRKS; j++)
+    {
+        sys_memcpy_swap(irk_be, irks[j], sizeof(irk_be));
+        bt_aes_expand(&scheds[j], irk_be);
+        sched_list[j] = &scheds[j];
+    }
+
+    for (group = 0; group < RPA_BENCH_RPAS; group += RPA_BENCH_GROUP)
+    {
+        for (rep = 0; rep < RPA_BENCH_REPORTS; rep++)
+        {
+            for (i = group; i < MIN(group + RPA_BENCH_GROUP, RPA_BENCH_RPAS); i++)
+            {
+                matches += (bt_rpa_resolve(sched_list, RPA_BENCH_IRKS, &rpas[i]) >= 0);
+            }
+        }
+    }
+    elapsed = sys_clock_tick_get() - start;
+    BT_INFO("RPA batched: %u lookups in %u ms, %u us each", lookups,
+            k_ticks_to_ms_floor32(elapsed), k_ticks_to_us_floor32(elapsed) / lookups);
+
+#if defined(CONFIG_BT_KEYS_RPA_CACHE)
+    {
+        struct rpa_cache_entry *entry;
+        uint32_t misses = 0U;
+
+        start = sys_clock_tick_get();
+        for (group = 0; group < RPA_BENCH_RPAS; group += RPA_BENCH_GROUP)
+        {
+            for (rep = 0; rep < RPA_BENCH_REPORTS; rep++)
+            {
+                for (i = group; i < MIN(group + RPA_BENCH_GROUP, RPA_BENCH_RPAS); i++)
+                {
+                    entry = rpa_cache_find(BT_ID_DEFAULT, &rpas[i]);
+                    if (entry && rpa_cache_valid(entry))
+                    {
+                        rpa_cache_touch(entry - rpa_cache);
+                        continue;
+                    }
+
+                    misses++;
+                    matches += (bt_rpa_resolve(sched_list, RPA_BENCH_IRKS, &rpas[i]) >= 0);
+                    rpa_cache_store(entry, BT_ID_DEFAULT, &rpas[i], NULL);
+                }
+            }
+        }
+        elapsed = sys_clock_tick_get() - start;
+        BT_INFO("RPA cached: %u lookups in %u ms, %u us each, %u misses", lookups,
+                k_ticks_to_ms_floor32(elapsed), k_ticks_to_us_floor32(elapsed) / lookups,
+                misses);
+
+        /* Do not leave the benchmark RPAs behind */
+        rpa_cache_keys_changed();
+    }
+#endif /* CONFIG_BT_KEYS_RPA_CACHE */
+
+    if (matches)
+    {
+        BT_WARN("%u unexpected RPA matches", matches);
+    }
+
+    (void)memset(irks, 0, sizeof(irks));
+    (void)memset(scheds, 0, sizeof(scheds));
+    (void)memset(irk_be, 0, sizeof(irk_be));
+}
+#endif /* CONFIG_BT_KEYS_RPA_BENCHMARK */
+
+struct bt_keys *bt_keys_find_addr(uint8_t id, const bt_addr_le_t *addr)
+{
+    BT_DBG("%s", bt_addr_le_str(addr));
+
+    return keys_lookup(id, addr);
+}
+
+#if defined(CONFIG_BT_KEYS_TABLE_BENCHMARK)
+#define KEYS_BENCH_LOOKUPS 100000
+#define KEYS_BENCH_EVICTS  1000
+
+static void keys_bench_addr(bt_addr_le_t *addr, uint32_t n)
+{
+    /* A fleet of devices from one vendor, only the low bytes differ */
+    addr->type = BT_ADDR_LE_PUBLIC;
+    sys_put_le32(n, addr->a.val);
+    addr->a.val[4] = 0x5a;
+    addr->a.val[5] = 0xc0;
+}
+
+void bt_keys_table_benchmark(void)
+{
+    static const uint16_t sizes[] = {16, 64, 128, 256, 512};
+    uint32_t hit, miss, evict, found, start, i;
+    bt_addr_le_t addr;
+    uint16_t n;
+    int s;
+
+    for (i = 0; i < ARRAY_SIZE(key_pool); i++)
+    {
+        if (bt_addr_le_cmp(&key_pool[i].addr, BT_ADDR_LE_ANY))
+        {
+            BT_WARN("Keys table benchmark needs an empty key pool");
+            return;
+        }
+    }
+
+    for (s = 0; s < ARRAY_SIZE(sizes) && sizes[s] <= ARRAY_SIZE(key_pool); s++)
+    {
+        n = sizes[s];
+        found = 0U;
+
+        for (i = 0; i < n; i++)
+        {
+            keys_bench_addr(&addr, i);
+            (void)bt_keys_get_addr(BT_ID_DEFAULT, &addr);
+        }
+
+        start = sys_clock_tick_get();
+        for (i = 0; i < KEYS_BENCH_LOOKUPS; i++)
+        {
+            keys_bench_addr(&addr, i % n);
+            found += (bt_keys_find_addr(BT_ID_DEFAULT, &addr) != NULL);
+        }
+        hit = sys_clock_tick_get() - start;
+
+        start = sys_clock_tick_get();
+        for (i = 0; i < KEYS_BENCH_LOOKUPS; i++)
+        {
+            keys_bench_addr(&addr, n + i);
+            found += (bt_keys_find_addr(BT_ID_DEFAULT, &addr) != NULL);
+        }
+        miss = sys_clock_tick_get() - start;
+
+        evict = 0U;
+#if IS_ENABLED(CONFIG_BT_KEYS_OVERWRITE_OLDEST)
+        start = sys_clock_tick_get();
+        for (i = 0; i < KEYS_BENCH_EVICTS; i++)
+        {
+            found += (keys_oldest_unused() == NULL);
+        }
+        evict = sys_clock_tick_get() - start;
+#endif /* CONFIG_BT_KEYS_OVERWRITE_OLDEST */
+
+        BT_INFO("%u bonds: hit %u ns, miss %u ns, oldest %u ns", n,
+                (uint32_t)(k_ticks_to_ns_floor64(hit) / KEYS_BENCH_LOOKUPS),
+                (uint32_t)(k_ticks_to_ns_floor64(miss) / KEYS_BENCH_LOOKUPS),
+                (uint32_t)(k_ticks_to_ns_floor64(evict) / KEYS_BENCH_EVICTS));
+
+        if (found != KEYS_BENCH_LOOKUPS)
+        {
+            BT_WARN("Unexpected lookup results %u", found);
+        }
+
+        /* Drop the slots without touching the persisted keys */
+        for (i = 0; i < ARRAY_SIZE(key_pool); i++)
+        {
+            if (bt_addr_le_cmp(&key_pool[i].addr, BT_ADDR_LE_ANY))
+            {
+                keys_index_del(&key_pool[i]);
+                (void)memset(&key_pool[i], 0, sizeof(key_pool[i]));
+            }
+        }
+    }
+
+    rpa_cache_keys_changed();
+}
+#endif /* CONFIG_BT_KEYS_TABLE_BENCHMARK */
+
+void bt_keys_add_type(struct bt_keys *keys, int type)
+{
+    keys->keys |= type;
+
+    if (type & BT_KEYS_IRK)
+    {
+        /* RPAs that did not resolve before may resolve now */
+        rpa_cache_keys_changed();
+    }
+}
+
+void bt_keys_clear(struct bt_keys *keys)
 {
     BT_DBG("%s (keys 0x%04x)", bt_addr_le_str(&keys->addr), keys->keys);
 
     if (keys->state & BT_KEYS_ID_ADDED)
     {
         // bt_id_del(keys);
+        /* Dropped from the resolving list on the next sync */
+        bt_id_list_update();
     }
 
 #if defined(CONFIG_BT_SETTINGS)
@@ -502,7 +1316,15 @@ void bt_keys_clear(struct bt_keys *keys)
     bt_storage_kv_key_delete(keys);
 #endif
 
+    keys_index_del(keys);
+
     (void)memset(keys, 0, sizeof(*keys));
+
+    irk_sched_clear(keys);
+    rpa_cache_keys_changed();
+    bt_aes_key_cache_clear();
+    /* The CSRK may have been cached for signing */
+    bt_aes_cmac_cache_clear();
 }
 
 #if defined(CONFIG_BT_SETTINGS)
@@ -519,34 +1341,56 @@ __unused
 static void id_add(struct bt_keys *keys, void *user_data)
 {
     // bt_id_add(keys);
+#if defined(CONFIG_BT_ID_LIST_BATCH)
+    /* Only marked, the lists are programmed once from the polling loop */
+    bt_id_add(keys);
+#endif /* CONFIG_BT_ID_LIST_BATCH */
 }
 
 int bt_keys_loading(void)
 {
-    char addr_str[BT_ADDR_LE_STR_LEN];
-    uint8_t id;
-    bt_addr_le_t *addr;
-    int index;
     struct bt_keys *keys;
-    struct bt_storage_kv_key_list_header list_info;
-    bt_storage_kv_get_key_list_info(&list_info);
-    BT_INFO("Load key info, total cnt: %d", list_info.cnt);
-    for (int i = 0; i < list_info.cnt; i++)
-    {
-        id = list_info.items[i].id;
-        addr = &list_info.items[i].addr;
-        index = list_info.items[i].index;
-        bt_addr_le_to_str(addr, addr_str, sizeof(addr_str));
-        BT_INFO("Load list key info, id: %d, addr: %s, index: %d", id, addr_str, index);
-        keys = bt_keys_get_addr(id, addr);
-        if (!keys)
+    int count = 0;
+    int i;
+
+    bt_storage_kv_key_migrate();
+
+    for (i = 0; i < ARRAY_SIZE(key_pool); i++)
+    {
+        keys = &key_pool[i];
+
+        /* Slots of migrated keys are already filled */
+        if (!bt_addr_le_cmp(&keys->addr, BT_ADDR_LE_ANY) && bt_storage_kv_key_load(i, keys))
+        {
+            continue;
+        }
+
+        BT_DBG("Loaded keys for %s id %d in slot %d", bt_addr_le_str(&keys->addr), keys->id, i);
+
+#if IS_ENABLED(CONFIG_BT_KEYS_OVERWRITE_OLDEST)
+        if (keys->aging_counter > aging_counter_val)
         {
-            BT_ERR("Failed to allocate keys for %s", bt_addr_le_str(addr));
-            return -ENOMEM;
+            aging_counter_val = keys->aging_counter;
         }
-        bt_storage_kv_get_key_item(index, keys);
+#endif /* CONFIG_BT_KEYS_OVERWRITE_OLDEST */
+
+        count++;
+    }
+
+    BT_INFO("Loaded keys of %d devices", count);
+
+#if defined(CONFIG_BT_KEYS_INDEX)
+    /* Slots were filled directly */
+    keys_index_rebuild();
+#endif /* CONFIG_BT_KEYS_INDEX */
+
+    if (IS_ENABLED(CONFIG_BT_ID_LIST_BATCH))
+    {
+        bt_keys_foreach(BT_KEYS_IRK, id_add, NULL);
     }
 
+    rpa_cache_keys_changed();
+
     return 0;
 }
 
@@ -569,6 +1413,7 @@ void bt_keys_update_usage(uint8_t id, const bt_addr_le_t *addr)
 
     keys->aging_counter = ++aging_counter_val;
     last_keys_updated = keys;
+    keys_index_touch(keys);
 
     BT_DBG("Aging counter for %s is set to %u", bt_addr_le_str(addr), keys->aging_counter);
 
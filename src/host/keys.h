@@ -93,6 +93,9 @@ struct bt_keys *bt_keys_find(int type, uint8_t id, const bt_addr_le_t *addr);
 struct bt_keys *bt_keys_find_irk(uint8_t id, const bt_addr_le_t *addr);
 struct bt_keys *bt_keys_find_addr(uint8_t id, const bt_addr_le_t *addr);
 
+/* Change the identity address of the keys, keeps the key index up to date */
+void bt_keys_set_addr(struct bt_keys *keys, const bt_addr_le_t *addr);
+
 void bt_keys_add_type(struct bt_keys *keys, int type);
 void bt_keys_clear(struct bt_keys *keys);
 
@@ -141,4 +144,14 @@ void bt_keys_show_sniffer_info(struct bt_keys *keys, void *data);
 
 int bt_keys_loading(void);
 
+#if defined(CONFIG_BT_KEYS_TABLE_BENCHMARK)
+/** @brief Measure and log key lookup and eviction cost up to 512 bonds. */
+void bt_keys_table_benchmark(void);
+#endif /* CONFIG_BT_KEYS_TABLE_BENCHMARK */
+
+#if defined(CONFIG_BT_KEYS_RPA_BENCHMARK)
+/** @brief Measure and log the cost of resolving unrelated RPAs. */
+void bt_keys_rpa_benchmark(void);
+#endif /* CONFIG_BT_KEYS_RPA_BENCHMARK */
+
 #endif /* _ZEPHYR_POLLING_HOST_KEYS_H_ */
\ No newline at end of file
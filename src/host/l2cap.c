@@ -2126,11 +2126,14 @@ static int l2cap_chan_le_send(struct bt_l2cap_le_chan *ch, struct net_buf *buf,
         return err;
     }
 
+    BT_CONN_STATS_INC(ch->chan.conn, coc_tx_segs);
+
     /* Check if there is no credits left clear output status and notify its
      * change.
      */
     if (!atomic_get(&ch->tx.credits))
     {
+        BT_CONN_STATS_INC(ch->chan.conn, coc_tx_credit_stalls);
         atomic_clear_bit(ch->chan.status, BT_L2CAP_STATUS_OUT);
         if (ch->chan.ops->status)
         {
@@ -2436,6 +2439,7 @@ static void l2cap_chan_send_credits(struct bt_l2cap_le_chan *chan, struct net_bu
     }
 
     l2cap_chan_rx_give_credits(chan, credits);
+    BT_CONN_STATS_ADD(chan->chan.conn, coc_rx_credits, credits);
 
     ev = net_buf_add(buf, sizeof(*ev));
     ev->cid = sys_cpu_to_le16(chan->rx.cid);
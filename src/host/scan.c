@@ -22,6 +22,8 @@
 #include "conn_internal.h"
 // #include "direction_internal.h"
 #include "id.h"
+#include "scan.h"
+#include "common/bt_profile.h"
 
 #define BT_DBG_ENABLED  IS_ENABLED(CONFIG_BT_DEBUG_HCI_CORE)
 #define LOG_MODULE_NAME bt_scan
@@ -31,7 +33,76 @@
 static bt_le_scan_cb_t *scan_dev_found_cb;
 static sys_slist_t scan_cbs = SYS_SLIST_STATIC_INIT(&scan_cbs);
 
+#if defined(CONFIG_BT_SCAN_BATCH_BENCHMARK)
+/* Benchmark reports bypass the filters and the duplicate tracking */
+static bool scan_bench_active;
+#endif /* CONFIG_BT_SCAN_BATCH_BENCHMARK */
+
+#if defined(CONFIG_BT_SCAN_BATCH)
+static sys_slist_t scan_batch_cbs = SYS_SLIST_STATIC_INIT(&scan_batch_cbs);
+/* Reports of the HCI event being processed, pointing into its buffer */
+static struct bt_le_scan_report scan_batch[CONFIG_BT_SCAN_BATCH_MAX];
+static uint8_t scan_batch_count;
+
+static void scan_batch_flush(void)
+{
+    struct bt_le_scan_batch_cb *listener, *next;
+
+    if (!scan_batch_count)
+    {
+        return;
+    }
+
+    SYS_SLIST_FOR_EACH_CONTAINER_SAFE (&scan_batch_cbs, listener, next, node)
+    {
+        listener->recv(scan_batch, scan_batch_count);
+    }
+
+    scan_batch_count = 0U;
+}
+
+static void scan_batch_add(const bt_addr_le_t *addr, const struct bt_le_scan_recv_info *info,
+                           const uint8_t *data, uint16_t len)
+{
+    struct bt_le_scan_report *report;
+
+    if (sys_slist_is_empty(&scan_batch_cbs))
+    {
+        return;
+    }
+
+    report = &scan_batch[scan_batch_count];
+    report->addr = addr;
+    report->rssi = info->rssi;
+    report->tx_power = info->tx_power;
+    report->adv_type = info->adv_type;
+    report->adv_props = info->adv_props;
+    report->sid = info->sid;
+    report->primary_phy = info->primary_phy;
+    report->secondary_phy = info->secondary_phy;
+    report->interval = info->interval;
+    report->data = data;
+    report->data_len = len;
+
+    if (++scan_batch_count == ARRAY_SIZE(scan_batch))
+    {
+        scan_batch_flush();
+    }
+}
+#else
+static inline void scan_batch_flush(void)
+{
+}
+
+static inline void scan_batch_add(const bt_addr_le_t *addr,
+                                  const struct bt_le_scan_recv_info *info, const uint8_t *data,
+                                  uint16_t len)
+{
+}
+#endif /* CONFIG_BT_SCAN_BATCH */
+
 #if defined(CONFIG_BT_EXT_ADV)
+#if !defined(CONFIG_BT_EXT_SCAN_REASSEMBLY)
 /* A buffer used to reassemble advertisement data from the controller. */
 NET_BUF_SIMPLE_DEFINE(ext_scan_buf, CONFIG_BT_EXT_SCAN_BUF_SIZE);
 
@@ -69,6 +140,7 @@ static void reset_reassembling_advertiser(void)
     net_buf_simple_reset(&ext_scan_buf);
     reassembling_advertiser.state = FRAG_ADV_INACTIVE;
 }
+#endif /* !CONFIG_BT_EXT_SCAN_REASSEMBLY */
 
 #if defined(CONFIG_BT_PER_ADV_SYNC)
 static struct bt_le_per_adv_sync *get_pending_per_adv_sync(void);
@@ -80,7 +152,10 @@ static sys_slist_t pa_sync_cbs = SYS_SLIST_STATIC_INIT(&pa_sync_cbs);
 void bt_scan_reset(void)
 {
     scan_dev_found_cb = NULL;
-#if defined(CONFIG_BT_EXT_ADV)
+    bt_scan_dedup_stop();
+#if defined(CONFIG_BT_EXT_SCAN_REASSEMBLY)
+    bt_scan_reassembly_reset();
+#elif defined(CONFIG_BT_EXT_ADV)
     reset_reassembling_advertiser();
 #endif
 }
@@ -478,12 +553,42 @@ static uint8_t get_adv_props_legacy(uint8_t evt_type)
     }
 }
 
-static void le_adv_recv(bt_addr_le_t *addr, struct bt_le_scan_recv_info *info,
-                        struct net_buf_simple *buf, uint16_t len)
+static void le_adv_deliver(const bt_addr_le_t *id_addr, struct bt_le_scan_recv_info *info,
+                           struct net_buf_simple *buf, uint16_t len)
 {
     struct bt_le_scan_cb *listener, *next;
     struct net_buf_simple_state state;
+
+    if (scan_dev_found_cb)
+    {
+        net_buf_simple_save(buf, &state);
+
+        buf->len = len;
+        scan_dev_found_cb(id_addr, info->rssi, info->adv_type, buf);
+
+        net_buf_simple_restore(buf, &state);
+    }
+
+    SYS_SLIST_FOR_EACH_CONTAINER_SAFE (&scan_cbs, listener, next, node)
+    {
+        if (listener->recv)
+        {
+            net_buf_simple_save(buf, &state);
+
+            buf->len = len;
+            listener->recv(info, buf);
+
+            net_buf_simple_restore(buf, &state);
+        }
+    }
+}
+
+static void le_adv_recv(bt_addr_le_t *addr, struct bt_le_scan_recv_info *info,
+                        struct net_buf_simple *buf, uint16_t len)
+{
     bt_addr_le_t id_addr;
+    bool deliver;
+    bool per_report;
 
     BT_DBG("%s event %u, len %u, rssi %d dBm", bt_addr_le_str(addr), info->adv_type, len,
            info->rssi);
@@ -496,6 +601,35 @@ static void le_adv_recv(bt_addr_le_t *addr, struct bt_le_scan_recv_info *info,
         return;
     }
 
+#if defined(CONFIG_BT_SCAN_BATCH_BENCHMARK)
+    if (scan_bench_active)
+    {
+        deliver = true;
+    }
+    else
+#endif /* CONFIG_BT_SCAN_BATCH_BENCHMARK */
+    {
+        deliver = bt_scan_filter_match(addr, info->rssi, buf->data, len) &&
+                  bt_scan_dedup_check(addr, info->sid, info->adv_type, info->rssi, buf->data,
+                                      len);
+    }
+
+    if (deliver)
+    {
+        scan_batch_add(addr, info, buf->data, len);
+    }
+
+    per_report = deliver && (scan_dev_found_cb || !sys_slist_is_empty(&scan_cbs));
+
+    /* Without callbacks to call the address only matters to a pending
+     * connection, and there is none while scanning explicitly.
+     */
+    if (!per_report && (!IS_ENABLED(CONFIG_BT_CENTRAL) ||
+                        atomic_test_bit(bt_dev.flags, BT_DEV_EXPLICIT_SCAN)))
+    {
+        return;
+    }
+
     if (addr->type == BT_ADDR_LE_PUBLIC_ID || addr->type == BT_ADDR_LE_RANDOM_ID)
     {
         bt_addr_le_copy(&id_addr, addr);
@@ -512,27 +646,9 @@ static void le_adv_recv(bt_addr_le_t *addr, struct bt_le_scan_recv_info *info,
 
     info->addr = &id_addr;
 
-    if (scan_dev_found_cb)
-    {
-        net_buf_simple_save(buf, &state);
-
-        buf->len = len;
-        scan_dev_found_cb(&id_addr, info->rssi, info->adv_type, buf);
-
-        net_buf_simple_restore(buf, &state);
-    }
-
-    SYS_SLIST_FOR_EACH_CONTAINER_SAFE (&scan_cbs, listener, next, node)
+    if (per_report)
     {
-        if (listener->recv)
-        {
-            net_buf_simple_save(buf, &state);
-
-            buf->len = len;
-            listener->recv(info, buf);
-
-            net_buf_simple_restore(buf, &state);
-        }
+        le_adv_deliver(&id_addr, info, buf, len);
     }
 
 #if defined(CONFIG_BT_CENTRAL)
@@ -547,6 +663,7 @@ void bt_hci_le_scan_timeout(struct net_buf *buf)
 
     atomic_clear_bit(bt_dev.flags, BT_DEV_SCANNING);
     atomic_clear_bit(bt_dev.flags, BT_DEV_EXPLICIT_SCAN);
+    bt_scan_dedup_stop();
 
     atomic_clear_bit(bt_dev.flags, BT_DEV_SCAN_LIMITED);
     atomic_clear_bit(bt_dev.flags, BT_DEV_RPA_VALID);
@@ -631,9 +748,13 @@ void bt_hci_le_adv_ext_report(struct net_buf *buf)
         struct bt_hci_evt_le_ext_advertising_info *evt;
         struct bt_le_scan_recv_info scan_info;
         uint16_t data_status;
+#if defined(CONFIG_BT_EXT_SCAN_REASSEMBLY)
+        struct net_buf_simple *reassembled;
+#else
         bool is_report_complete;
         bool more_to_come;
         bool is_new_advertiser;
+#endif /* CONFIG_BT_EXT_SCAN_REASSEMBLY */
 
         if (buf->len < sizeof(*evt))
         {
@@ -643,8 +764,6 @@ void bt_hci_le_adv_ext_report(struct net_buf *buf)
 
         evt = net_buf_pull_mem(buf, sizeof(*evt));
         data_status = BT_HCI_LE_ADV_EVT_TYPE_DATA_STATUS(evt->evt_type);
-        is_report_complete = data_status == BT_HCI_LE_ADV_EVT_TYPE_DATA_STATUS_COMPLETE;
-        more_to_come = data_status == BT_HCI_LE_ADV_EVT_TYPE_DATA_STATUS_PARTIAL;
 
         if (evt->evt_type & BT_HCI_LE_ADV_EVT_TYPE_LEGACY)
         {
@@ -653,9 +772,38 @@ void bt_hci_le_adv_ext_report(struct net_buf *buf)
              */
             create_ext_adv_info(evt, &scan_info);
             le_adv_recv(&evt->addr, &scan_info, &buf->b, evt->length);
+            net_buf_pull(buf, evt->length);
             continue;
         }
 
+#if defined(CONFIG_BT_EXT_SCAN_REASSEMBLY)
+        if (buf->len < evt->length)
+        {
+            BT_ERR("Unexpected end of buffer");
+            break;
+        }
+
+        switch (bt_scan_reassembly_feed(&evt->addr, evt->sid, data_status, buf->data,
+                                        evt->length, &reassembled))
+        {
+        case BT_SCAN_REASSEMBLY_DIRECT:
+            create_ext_adv_info(evt, &scan_info);
+            le_adv_recv(&evt->addr, &scan_info, &buf->b, evt->length);
+            break;
+        case BT_SCAN_REASSEMBLY_DONE:
+            create_ext_adv_info(evt, &scan_info);
+            le_adv_recv(&evt->addr, &scan_info, reassembled, reassembled->len);
+            /* The data is only kept until the next report is fed */
+            scan_batch_flush();
+            break;
+        default:
+            break;
+        }
+
+        net_buf_pull(buf, evt->length);
+#else
+        is_report_complete = data_status == BT_HCI_LE_ADV_EVT_TYPE_DATA_STATUS_COMPLETE;
+        more_to_come = data_status == BT_HCI_LE_ADV_EVT_TYPE_DATA_STATUS_PARTIAL;
         is_new_advertiser =
                 reassembling_advertiser.state == FRAG_ADV_INACTIVE ||
                 !fragmented_advertisers_equal(&reassembling_advertiser, &evt->addr, evt->sid);
@@ -667,6 +815,7 @@ void bt_hci_le_adv_ext_report(struct net_buf *buf)
              */
             create_ext_adv_info(evt, &scan_info);
             le_adv_recv(&evt->addr, &scan_info, &buf->b, evt->length);
+            net_buf_pull(buf, evt->length);
             continue;
         }
 
@@ -736,12 +885,16 @@ void bt_hci_le_adv_ext_report(struct net_buf *buf)
         __ASSERT_NO_MSG(is_report_complete);
         create_ext_adv_info(evt, &scan_info);
         le_adv_recv(&evt->addr, &scan_info, &ext_scan_buf, ext_scan_buf.len);
+        scan_batch_flush();
 
         /* We do no longer need to keep track of this advertiser. */
         reset_reassembling_advertiser();
 
         net_buf_pull(buf, evt->length);
+#endif /* CONFIG_BT_EXT_SCAN_REASSEMBLY */
     }
+
+    scan_batch_flush();
 }
 
 #if defined(CONFIG_BT_PER_ADV_SYNC)
@@ -1254,6 +1407,8 @@ void bt_hci_le_adv_report(struct net_buf *buf)
 
         net_buf_pull(buf, evt->length + sizeof(adv_info.rssi));
     }
+
+    scan_batch_flush();
 }
 
 static bool valid_le_scan_param(const struct bt_le_scan_param *param)
@@ -1264,7 +1419,14 @@ static bool valid_le_scan_param(const struct bt_le_scan_param *param)
     }
 
     if (param->options & ~(BT_LE_SCAN_OPT_FILTER_DUPLICATE | BT_LE_SCAN_OPT_FILTER_ACCEPT_LIST |
-                           BT_LE_SCAN_OPT_CODED | BT_LE_SCAN_OPT_NO_1M))
+                           BT_LE_SCAN_OPT_CODED | BT_LE_SCAN_OPT_NO_1M |
+                           BT_LE_SCAN_OPT_HOST_FILTER_DUPLICATE))
+    {
+        return false;
+    }
+
+    if (!IS_ENABLED(CONFIG_BT_SCAN_DEDUP) &&
+        (param->options & BT_LE_SCAN_OPT_HOST_FILTER_DUPLICATE))
     {
         return false;
     }
@@ -1379,6 +1541,7 @@ int bt_le_scan_start(const struct bt_le_scan_param *param, bt_le_scan_cb_t cb)
     }
 
     scan_dev_found_cb = cb;
+    bt_scan_dedup_start(param);
 
     return 0;
 }
@@ -1416,6 +1579,127 @@ void bt_le_scan_cb_unregister(struct bt_le_scan_cb *cb)
     sys_slist_find_and_remove(&scan_cbs, &cb->node);
 }
 
+#if defined(CONFIG_BT_SCAN_BATCH)
+void bt_le_scan_batch_cb_register(struct bt_le_scan_batch_cb *cb)
+{
+    sys_slist_append(&scan_batch_cbs, &cb->node);
+}
+
+void bt_le_scan_batch_cb_unregister(struct bt_le_scan_batch_cb *cb)
+{
+    sys_slist_find_and_remove(&scan_batch_cbs, &cb->node);
+}
+
+#if defined(CONFIG_BT_SCAN_BATCH_BENCHMARK)
+#define SCAN_BENCH_REPORTS 8
+#define SCAN_BENCH_DATA    31
+#define SCAN_BENCH_EVENTS  2000
+
+#if defined(CONFIG_BT_PROFILE)
+#define SCAN_BENCH_NOW() bt_profile_now()
+#else
+#define SCAN_BENCH_NOW() k_ticks_to_us_floor32(sys_clock_tick_get())
+#endif /* CONFIG_BT_PROFILE */
+
+static uint32_t scan_bench_seen;
+
+static void scan_bench_recv(const struct bt_le_scan_recv_info *info, struct net_buf_simple *buf)
+{
+    scan_bench_seen += buf->len;
+}
+
+static void scan_bench_batch_recv(const struct bt_le_scan_report *reports, size_t count)
+{
+    size_t i;
+
+    for (i = 0; i < count; i++)
+    {
+        scan_bench_seen += reports[i].data_len;
+    }
+}
+
+/* Replay the same LE Advertising Report event through the per report
+ * and the batched listener, returns the time taken in microseconds.
+ */
+static uint32_t scan_bench_replay(const uint8_t *evt, uint16_t len)
+{
+    static uint8_t storage[1 + SCAN_BENCH_REPORTS * (9 + SCAN_BENCH_DATA + 1)];
+    struct net_buf buf;
+    uint32_t start;
+    int i;
+
+    (void)memset(&buf, 0, sizeof(buf));
+    buf.__buf = storage;
+    buf.size = sizeof(storage);
+
+    start = SCAN_BENCH_NOW();
+    for (i = 0; i < SCAN_BENCH_EVENTS; i++)
+    {
+        memcpy(storage, evt, len);
+        buf.data = storage;
+        buf.len = len;
+        bt_hci_le_adv_report(&buf);
+    }
+
+    return MAX(SCAN_BENCH_NOW() - start, 1U);
+}
+
+void bt_scan_batch_benchmark(void)
+{
+    static uint8_t evt[1 + SCAN_BENCH_REPORTS * (9 + SCAN_BENCH_DATA + 1)];
+    struct bt_le_scan_batch_cb batch_cb = {.recv = scan_bench_batch_recv};
+    struct bt_le_scan_cb cb = {.recv = scan_bench_recv};
+    bt_le_scan_cb_t *saved_found_cb = scan_dev_found_cb;
+    sys_slist_t saved_cbs = scan_cbs;
+    sys_slist_t saved_batch_cbs = scan_batch_cbs;
+    bool explicit = atomic_test_and_set_bit(bt_dev.flags, BT_DEV_EXPLICIT_SCAN);
+    uint32_t reports = SCAN_BENCH_EVENTS * SCAN_BENCH_REPORTS;
+    uint32_t elapsed;
+    uint16_t len = 0U;
+    int i;
+
+    evt[len++] = SCAN_BENCH_REPORTS;
+    for (i = 0; i < SCAN_BENCH_REPORTS; i++)
+    {
+        evt[len++] = BT_HCI_ADV_IND;
+        evt[len++] = BT_ADDR_LE_RANDOM;
+        (void)bt_rand(&evt[len], sizeof(bt_addr_t));
+        len += sizeof(bt_addr_t);
+        evt[len++] = SCAN_BENCH_DATA;
+        (void)bt_rand(&evt[len], SCAN_BENCH_DATA);
+        len += SCAN_BENCH_DATA;
+        evt[len++] = (uint8_t)-60;
+    }
+
+    /* Only the benchmark listeners, an observer scan in progress, and
+     * leave the filter and duplicate state and statistics untouched.
+     */
+    scan_dev_found_cb = NULL;
+    sys_slist_init(&scan_cbs);
+    sys_slist_init(&scan_batch_cbs);
+    scan_bench_active = true;
+
+    bt_le_scan_cb_register(&cb);
+    elapsed = scan_bench_replay(evt, len);
+    BT_INFO("Scan per report: %u reports in %u us, %u reports/s", reports, elapsed,
+            (uint32_t)(reports * 1000000ULL / elapsed));
+    bt_le_scan_cb_unregister(&cb);
+
+    bt_le_scan_batch_cb_register(&batch_cb);
+    elapsed = scan_bench_replay(evt, len);
+    BT_INFO("Scan batched: %u reports in %u us, %u reports/s", reports, elapsed,
+            (uint32_t)(reports * 1000000ULL / elapsed));
+    bt_le_scan_batch_cb_unregister(&batch_cb);
+
+    scan_bench_active = false;
+    scan_dev_found_cb = saved_found_cb;
+    scan_cbs = saved_cbs;
+    scan_batch_cbs = saved_batch_cbs;
+    atomic_set_bit_to(bt_dev.flags, BT_DEV_EXPLICIT_SCAN, explicit);
+}
+#endif /* CONFIG_BT_SCAN_BATCH_BENCHMARK */
+#endif /* CONFIG_BT_SCAN_BATCH */
+
 #if defined(CONFIG_BT_PER_ADV_SYNC)
 uint8_t bt_le_per_adv_sync_get_index(struct bt_le_per_adv_sync *per_adv_sync)
 {
@@ -22,4 +22,67 @@ struct bt_le_per_adv_sync *bt_hci_get_per_adv_sync(uint16_t handle);
 
 void bt_periodic_sync_disable(void);
 
+#if defined(CONFIG_BT_EXT_SCAN_REASSEMBLY)
+enum
+{
+    /* More reports of the chain expected */
+    BT_SCAN_REASSEMBLY_PENDING,
+    /* Chain complete in the returned buffer */
+    BT_SCAN_REASSEMBLY_DONE,
+    /* Complete in a single report, use the report data */
+    BT_SCAN_REASSEMBLY_DIRECT,
+    /* Report dropped, truncated chain */
+    BT_SCAN_REASSEMBLY_DROPPED,
+};
+
+/* Add the data of one extended advertising report to the chain of its
+ * (address, SID). The buffer returned with BT_SCAN_REASSEMBLY_DONE is
+ * valid until the next call.
+ */
+int bt_scan_reassembly_feed(const bt_addr_le_t *addr, uint8_t sid, uint8_t data_status,
+                            const uint8_t *data, uint8_t len, struct net_buf_simple **out);
+void bt_scan_reassembly_reset(void);
+
+#if defined(CONFIG_BT_EXT_SCAN_REASSEMBLY_SELFTEST)
+int bt_scan_reassembly_selftest(void);
+#endif /* CONFIG_BT_EXT_SCAN_REASSEMBLY_SELFTEST */
+#endif /* CONFIG_BT_EXT_SCAN_REASSEMBLY */
+
+#if defined(CONFIG_BT_SCAN_FILTER)
+/* Whether the report passes the filter set, on the raw report data */
+bool bt_scan_filter_match(const bt_addr_le_t *addr, int8_t rssi, const uint8_t *data,
+                          uint16_t len);
+#else
+static inline bool bt_scan_filter_match(const bt_addr_le_t *addr, int8_t rssi,
+                                        const uint8_t *data, uint16_t len)
+{
+    return true;
+}
+#endif /* CONFIG_BT_SCAN_FILTER */
+
+#if defined(CONFIG_BT_SCAN_DEDUP)
+/* Start tracking devices if the scan asks for it, stop otherwise */
+void bt_scan_dedup_start(const struct bt_le_scan_param *param);
+void bt_scan_dedup_stop(void);
+/* Whether the report is to be delivered or suppressed as a duplicate */
+bool bt_scan_dedup_check(const bt_addr_le_t *addr, uint8_t sid, uint8_t adv_type, int8_t rssi,
+                         const uint8_t *data, uint16_t len);
+#else
+static inline void bt_scan_dedup_start(const struct bt_le_scan_param *param)
+{
+}
+static inline void bt_scan_dedup_stop(void)
+{
+}
+static inline bool bt_scan_dedup_check(const bt_addr_le_t *addr, uint8_t sid, uint8_t adv_type,
+                                       int8_t rssi, const uint8_t *data, uint16_t len)
+{
+    return true;
+}
+#endif /* CONFIG_BT_SCAN_DEDUP */
+
+#if defined(CONFIG_BT_SCAN_BATCH_BENCHMARK)
+void bt_scan_batch_benchmark(void);
+#endif /* CONFIG_BT_SCAN_BATCH_BENCHMARK */
+
 #endif /* _ZEPHYR_POLLING_HOST_SCAN_H_ */
\ No newline at end of file
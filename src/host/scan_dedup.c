@@ -0,0 +1,191 @@
+/* scan_dedup.c - Host duplicate advertising report filter */
+
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <string.h>
+
+#include "bt_config.h"
+
+#include "base/types.h"
+#include "base/common.h"
+#include "base/sys_clock.h"
+
+#include <bluetooth/bluetooth.h>
+#include <bluetooth/hci.h>
+
+#include "scan.h"
+
+#define BT_DBG_ENABLED  IS_ENABLED(CONFIG_BT_DEBUG_HCI_CORE)
+#define LOG_MODULE_NAME bt_scan_dedup
+#include "logging/bt_log.h"
+
+#if defined(CONFIG_BT_SCAN_DEDUP)
+
+#define DEDUP_SIZE  CONFIG_BT_SCAN_DEDUP_SIZE
+/* Entries looked at from the home slot of a device before one is replaced */
+#define DEDUP_PROBE MIN(8, DEDUP_SIZE)
+#define FNV1A_INIT  2166136261U
+
+/* A device as it was last delivered. Advertising data and scan response
+ * data of the same set are tracked as two devices.
+ */
+struct dedup_entry
+{
+    bt_addr_le_t addr;
+    uint8_t sid;
+    uint8_t adv_type;
+    int8_t rssi;
+    bool used;
+    uint32_t fingerprint;
+    uint32_t delivered;
+    uint32_t seen;
+};
+
+static struct
+{
+    bool active;
+    uint8_t rssi_delta;
+    uint32_t refresh_ms;
+    struct bt_le_scan_dedup_stats stats;
+    struct dedup_entry table[DEDUP_SIZE];
+} dedup;
+
+/* FNV-1a, over the key for the slot and over the data for the fingerprint */
+static uint32_t fnv1a(uint32_t hash, const uint8_t *data, uint16_t len)
+{
+    while (len--)
+    {
+        hash ^= *data++;
+        hash *= 16777619U;
+    }
+
+    return hash;
+}
+
+void bt_scan_dedup_start(const struct bt_le_scan_param *param)
+{
+    if (!(param->options & BT_LE_SCAN_OPT_HOST_FILTER_DUPLICATE))
+    {
+        dedup.active = false;
+        return;
+    }
+
+    (void)memset(dedup.table, 0, sizeof(dedup.table));
+
+    if (param->dedup)
+    {
+        dedup.rssi_delta = param->dedup->rssi_delta;
+        dedup.refresh_ms = param->dedup->refresh_ms;
+    }
+    else
+    {
+        dedup.rssi_delta = CONFIG_BT_SCAN_DEDUP_RSSI_DELTA;
+        dedup.refresh_ms = CONFIG_BT_SCAN_DEDUP_REFRESH;
+    }
+
+    dedup.active = true;
+}
+
+void bt_scan_dedup_stop(void)
+{
+    dedup.active = false;
+}
+
+static struct dedup_entry *dedup_lookup(const bt_addr_le_t *addr, uint8_t sid, uint8_t adv_type,
+                                        bool *found)
+{
+    struct dedup_entry *oldest = NULL;
+    struct dedup_entry *entry;
+    uint32_t slot;
+    uint8_t i;
+
+    slot = fnv1a(FNV1A_INIT, (const uint8_t *)addr, sizeof(*addr));
+    slot = fnv1a(slot, &sid, sizeof(sid));
+    slot = fnv1a(slot, &adv_type, sizeof(adv_type)) % DEDUP_SIZE;
+
+    for (i = 0U; i < DEDUP_PROBE; i++)
+    {
+        entry = &dedup.table[(slot + i) % DEDUP_SIZE];
+
+        if (!entry->used)
+        {
+            *found = false;
+            return entry;
+        }
+
+        if (entry->sid == sid && entry->adv_type == adv_type && !bt_addr_le_cmp(&entry->addr, addr))
+        {
+            *found = true;
+            return entry;
+        }
+
+        if (!oldest || (int32_t)(oldest->seen - entry->seen) > 0)
+        {
+            oldest = entry;
+        }
+    }
+
+    dedup.stats.evicted++;
+    *found = false;
+
+    return oldest;
+}
+
+bool bt_scan_dedup_check(const bt_addr_le_t *addr, uint8_t sid, uint8_t adv_type, int8_t rssi,
+                         const uint8_t *data, uint16_t len)
+{
+    uint32_t now = k_ticks_to_ms_floor32(sys_clock_tick_get());
+    uint32_t fingerprint;
+    struct dedup_entry *entry;
+    bool found;
+
+    if (!dedup.active)
+    {
+        return true;
+    }
+
+    fingerprint = fnv1a(FNV1A_INIT, data, len);
+    entry = dedup_lookup(addr, sid, adv_type, &found);
+    entry->seen = now;
+
+    if (!found)
+    {
+        dedup.stats.new_device++;
+    }
+    else if (entry->fingerprint != fingerprint)
+    {
+        dedup.stats.changed++;
+    }
+    else if (dedup.rssi_delta && rssi != (int8_t)BT_HCI_LE_RSSI_NOT_AVAILABLE &&
+             (rssi > entry->rssi ? rssi - entry->rssi : entry->rssi - rssi) >= dedup.rssi_delta)
+    {
+        dedup.stats.rssi++;
+    }
+    else if (dedup.refresh_ms && now - entry->delivered >= dedup.refresh_ms)
+    {
+        dedup.stats.refresh++;
+    }
+    else
+    {
+        dedup.stats.suppressed++;
+        return false;
+    }
+
+    bt_addr_le_copy(&entry->addr, addr);
+    entry->sid = sid;
+    entry->adv_type = adv_type;
+    entry->rssi = rssi;
+    entry->used = true;
+    entry->fingerprint = fingerprint;
+    entry->delivered = now;
+
+    return true;
+}
+
+void bt_le_scan_dedup_stats_get(struct bt_le_scan_dedup_stats *stats)
+{
+    *stats = dedup.stats;
+}
+#endif /* CONFIG_BT_SCAN_DEDUP */
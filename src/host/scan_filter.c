@@ -0,0 +1,476 @@
+/* scan_filter.c - Advertising report filters evaluated before delivery */
+
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <errno.h>
+#include <string.h>
+
+#include "bt_config.h"
+
+#include "base/types.h"
+#include "base/byteorder.h"
+#include "base/common.h"
+
+#include <bluetooth/bluetooth.h>
+#include <bluetooth/hci.h>
+
+#include "scan.h"
+
+#define BT_DBG_ENABLED  IS_ENABLED(CONFIG_BT_DEBUG_HCI_CORE)
+#define LOG_MODULE_NAME bt_scan_filter
+#include "logging/bt_log.h"
+
+#if defined(CONFIG_BT_SCAN_FILTER)
+
+#define FILTER_MAX         CONFIG_BT_SCAN_FILTER_MAX
+#define FILTER_PATTERN_LEN CONFIG_BT_SCAN_FILTER_PATTERN_LEN
+/* AD structures of a wanted type recorded per report */
+#define FILTER_AD_REFS     16
+
+/* A filter as given, with the pattern copied and everything the report
+ * is compared against in over the air format.
+ */
+struct filter_rule
+{
+    uint8_t conditions;
+    bt_addr_le_t addr;
+    uint8_t addr_len;
+    int8_t rssi_min;
+    uint8_t ad_type;
+    uint16_t company_id;
+    uint8_t uuid16[2];
+    uint8_t uuid128[16];
+    uint8_t pattern_ad_type;
+    uint8_t pattern_offset;
+    uint8_t pattern_len;
+    uint8_t pattern_data[FILTER_PATTERN_LEN];
+    uint8_t pattern_mask[FILTER_PATTERN_LEN];
+    struct bt_le_scan_filter_stats stats;
+};
+
+/* What the filters need to know about the AD structures of a report,
+ * collected in a single walk over the data.
+ */
+struct ad_summary
+{
+    const uint8_t *data;
+    uint32_t present[8];
+    uint8_t count;
+    struct
+    {
+        uint8_t type;
+        uint8_t len;
+        uint16_t offset;
+    } refs[FILTER_AD_REFS];
+};
+
+static struct
+{
+    uint8_t count;
+    /* Any filter looks into the AD structures */
+    bool needs_ad;
+    /* Lowest RSSI any filter accepts, INT8_MIN when one has no floor */
+    int8_t rssi_floor;
+    /* AD types whose structures are recorded in the summary */
+    uint32_t ad_wanted[8];
+    uint32_t passed;
+    uint32_t dropped;
+    struct filter_rule rules[FILTER_MAX];
+} filter_set;
+
+static void type_set(uint32_t *map, uint8_t type)
+{
+    map[type / 32U] |= BIT(type % 32U);
+}
+
+static bool type_test(const uint32_t *map, uint8_t type)
+{
+    return map[type / 32U] & BIT(type % 32U);
+}
+
+static int rule_compile(struct filter_rule *rule, const struct bt_le_scan_filter *filter)
+{
+    uint8_t i;
+
+    (void)memset(rule, 0, sizeof(*rule));
+    rule->conditions = filter->conditions;
+
+    if (filter->conditions & BT_LE_SCAN_FILTER_ADDR)
+    {
+        if (filter->addr_prefix_len > sizeof(filter->addr.a.val))
+        {
+            return -EINVAL;
+        }
+
+        bt_addr_le_copy(&rule->addr, &filter->addr);
+        rule->addr_len =
+                filter->addr_prefix_len ? filter->addr_prefix_len : sizeof(filter->addr.a.val);
+    }
+
+    rule->rssi_min = filter->rssi_min;
+
+    if (filter->conditions & BT_LE_SCAN_FILTER_AD_TYPE)
+    {
+        rule->ad_type = filter->ad_type;
+    }
+
+    if (filter->conditions & BT_LE_SCAN_FILTER_COMPANY_ID)
+    {
+        rule->company_id = filter->company_id;
+        type_set(filter_set.ad_wanted, BT_DATA_MANUFACTURER_DATA);
+    }
+
+    if (filter->conditions & BT_LE_SCAN_FILTER_UUID16)
+    {
+        sys_put_le16(filter->uuid16, rule->uuid16);
+        type_set(filter_set.ad_wanted, BT_DATA_UUID16_SOME);
+        type_set(filter_set.ad_wanted, BT_DATA_UUID16_ALL);
+        type_set(filter_set.ad_wanted, BT_DATA_SVC_DATA16);
+    }
+
+    if (filter->conditions & BT_LE_SCAN_FILTER_UUID128)
+    {
+        memcpy(rule->uuid128, filter->uuid128, sizeof(rule->uuid128));
+        type_set(filter_set.ad_wanted, BT_DATA_UUID128_SOME);
+        type_set(filter_set.ad_wanted, BT_DATA_UUID128_ALL);
+        type_set(filter_set.ad_wanted, BT_DATA_SVC_DATA128);
+    }
+
+    if (filter->conditions & BT_LE_SCAN_FILTER_PATTERN)
+    {
+        if (!filter->pattern.data || !filter->pattern.len ||
+            filter->pattern.len > FILTER_PATTERN_LEN)
+        {
+            return -EINVAL;
+        }
+
+        rule->pattern_ad_type = filter->pattern.ad_type;
+        rule->pattern_offset = filter->pattern.offset;
+        rule->pattern_len = filter->pattern.len;
+
+        /* Masked out bits are cleared once here instead of per report */
+        for (i = 0U; i < rule->pattern_len; i++)
+        {
+            rule->pattern_mask[i] = filter->pattern.mask ? filter->pattern.mask[i] : 0xff;
+            rule->pattern_data[i] = filter->pattern.data[i] & rule->pattern_mask[i];
+        }
+
+        if (rule->pattern_ad_type)
+        {
+            type_set(filter_set.ad_wanted, rule->pattern_ad_type);
+        }
+    }
+
+    return 0;
+}
+
+int bt_le_scan_filter_set(const struct bt_le_scan_filter *filters, size_t count)
+{
+    uint8_t i;
+    int err;
+
+    if (count && !filters)
+    {
+        return -EINVAL;
+    }
+
+    if (count > FILTER_MAX)
+    {
+        return -ENOMEM;
+    }
+
+    (void)memset(&filter_set, 0, sizeof(filter_set));
+    filter_set.rssi_floor = count ? INT8_MAX : INT8_MIN;
+
+    for (i = 0U; i < count; i++)
+    {
+        err = rule_compile(&filter_set.rules[i], &filters[i]);
+        if (err)
+        {
+            (void)memset(&filter_set, 0, sizeof(filter_set));
+            return err;
+        }
+
+        if (filters[i].conditions & BT_LE_SCAN_FILTER_RSSI)
+        {
+            filter_set.rssi_floor = MIN(filter_set.rssi_floor, filters[i].rssi_min);
+        }
+        else
+        {
+            filter_set.rssi_floor = INT8_MIN;
+        }
+
+        if (filters[i].conditions &
+            (BT_LE_SCAN_FILTER_AD_TYPE | BT_LE_SCAN_FILTER_COMPANY_ID | BT_LE_SCAN_FILTER_UUID16 |
+             BT_LE_SCAN_FILTER_UUID128 | BT_LE_SCAN_FILTER_PATTERN))
+        {
+            filter_set.needs_ad = true;
+        }
+    }
+
+    filter_set.count = count;
+
+    return 0;
+}
+
+int bt_le_scan_filter_stats_get(size_t index, struct bt_le_scan_filter_stats *stats)
+{
+    if (index >= filter_set.count || !stats)
+    {
+        return -EINVAL;
+    }
+
+    *stats = filter_set.rules[index].stats;
+
+    return 0;
+}
+
+void bt_le_scan_filter_totals_get(uint32_t *passed, uint32_t *dropped)
+{
+    *passed = filter_set.passed;
+    *dropped = filter_set.dropped;
+}
+
+static void ad_summarize(struct ad_summary *ad, const uint8_t *data, uint16_t len)
+{
+    uint16_t offset = 0U;
+    uint8_t ad_len;
+    uint8_t type;
+
+    (void)memset(ad->present, 0, sizeof(ad->present));
+    ad->data = data;
+    ad->count = 0U;
+
+    while (offset + 1U < len)
+    {
+        ad_len = data[offset];
+        /* Zero length is the significant part ending early */
+        if (!ad_len || offset + 1U + ad_len > len)
+        {
+            break;
+        }
+
+        type = data[offset + 1U];
+        type_set(ad->present, type);
+
+        if (type_test(filter_set.ad_wanted, type) && ad->count < FILTER_AD_REFS)
+        {
+            ad->refs[ad->count].type = type;
+            ad->refs[ad->count].len = ad_len - 1U;
+            ad->refs[ad->count].offset = offset + 2U;
+            ad->count++;
+        }
+
+        offset += 1U + ad_len;
+    }
+}
+
+static bool ad_company_match(const struct ad_summary *ad, uint16_t company_id)
+{
+    uint8_t i;
+
+    for (i = 0U; i < ad->count; i++)
+    {
+        if (ad->refs[i].type == BT_DATA_MANUFACTURER_DATA && ad->refs[i].len >= 2U &&
+            sys_get_le16(&ad->data[ad->refs[i].offset]) == company_id)
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/* UUID in one of the lists, or at the start of service data */
+static bool ad_uuid_match(const struct ad_summary *ad, const uint8_t *uuid, uint8_t uuid_len,
+                          uint8_t some, uint8_t all, uint8_t svc_data)
+{
+    const uint8_t *data;
+    uint8_t i, j;
+
+    for (i = 0U; i < ad->count; i++)
+    {
+        data = &ad->data[ad->refs[i].offset];
+
+        if (ad->refs[i].type == svc_data)
+        {
+            if (ad->refs[i].len >= uuid_len && !memcmp(data, uuid, uuid_len))
+            {
+                return true;
+            }
+        }
+        else if (ad->refs[i].type == some || ad->refs[i].type == all)
+        {
+            for (j = 0U; j + uuid_len <= ad->refs[i].len; j += uuid_len)
+            {
+                if (!memcmp(&data[j], uuid, uuid_len))
+                {
+                    return true;
+                }
+            }
+        }
+    }
+
+    return false;
+}
+
+static bool bytes_match(const struct filter_rule *rule, const uint8_t *data, uint16_t len)
+{
+    uint8_t i;
+
+    if (rule->pattern_offset + rule->pattern_len > len)
+    {
+        return false;
+    }
+
+    data += rule->pattern_offset;
+
+    for (i = 0U; i < rule->pattern_len; i++)
+    {
+        if ((data[i] & rule->pattern_mask[i]) != rule->pattern_data[i])
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static bool ad_pattern_match(const struct ad_summary *ad, const struct filter_rule *rule,
+                             uint16_t len)
+{
+    uint8_t i;
+
+    if (!rule->pattern_ad_type)
+    {
+        return bytes_match(rule, ad->data, len);
+    }
+
+    for (i = 0U; i < ad->count; i++)
+    {
+        if (ad->refs[i].type == rule->pattern_ad_type &&
+            bytes_match(rule, &ad->data[ad->refs[i].offset], ad->refs[i].len))
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static bool addr_match(const struct filter_rule *rule, const bt_addr_le_t *addr)
+{
+    uint8_t type = addr->type;
+
+    /* Resolved by the controller, compare as the identity it is */
+    if (type == BT_ADDR_LE_PUBLIC_ID || type == BT_ADDR_LE_RANDOM_ID)
+    {
+        type -= BT_ADDR_LE_PUBLIC_ID;
+    }
+
+    /* Most significant bytes come last */
+    return type == rule->addr.type &&
+           !memcmp(&addr->a.val[sizeof(addr->a.val) - rule->addr_len],
+                   &rule->addr.a.val[sizeof(addr->a.val) - rule->addr_len], rule->addr_len);
+}
+
+/* Cheapest conditions first, the AD ones work off the summary */
+static bool rule_match(const struct filter_rule *rule, const bt_addr_le_t *addr, int8_t rssi,
+                       const struct ad_summary *ad, uint16_t len)
+{
+    if ((rule->conditions & BT_LE_SCAN_FILTER_RSSI) &&
+        (rssi == (int8_t)BT_HCI_LE_RSSI_NOT_AVAILABLE || rssi < rule->rssi_min))
+    {
+        return false;
+    }
+
+    if ((rule->conditions & BT_LE_SCAN_FILTER_ADDR) && !addr_match(rule, addr))
+    {
+        return false;
+    }
+
+    if ((rule->conditions & BT_LE_SCAN_FILTER_AD_TYPE) && !type_test(ad->present, rule->ad_type))
+    {
+        return false;
+    }
+
+    if ((rule->conditions & BT_LE_SCAN_FILTER_COMPANY_ID) &&
+        !ad_company_match(ad, rule->company_id))
+    {
+        return false;
+    }
+
+    if ((rule->conditions & BT_LE_SCAN_FILTER_UUID16) &&
+        !ad_uuid_match(ad, rule->uuid16, sizeof(rule->uuid16), BT_DATA_UUID16_SOME,
+                       BT_DATA_UUID16_ALL, BT_DATA_SVC_DATA16))
+    {
+        return false;
+    }
+
+    if ((rule->conditions & BT_LE_SCAN_FILTER_UUID128) &&
+        !ad_uuid_match(ad, rule->uuid128, sizeof(rule->uuid128), BT_DATA_UUID128_SOME,
+                       BT_DATA_UUID128_ALL, BT_DATA_SVC_DATA128))
+    {
+        return false;
+    }
+
+    if ((rule->conditions & BT_LE_SCAN_FILTER_PATTERN) && !ad_pattern_match(ad, rule, len))
+    {
+        return false;
+    }
+
+    return true;
+}
+
+bool bt_scan_filter_match(const bt_addr_le_t *addr, int8_t rssi, const uint8_t *data,
+                          uint16_t len)
+{
+    struct ad_summary ad;
+    uint8_t i;
+
+    if (!filter_set.count)
+    {
+        return true;
+    }
+
+    /* Below every floor, no filter can accept it */
+    if (rssi < filter_set.rssi_floor || (filter_set.rssi_floor != INT8_MIN &&
+                                      rssi == (int8_t)BT_HCI_LE_RSSI_NOT_AVAILABLE))
+    {
+        for (i = 0U; i < filter_set.count; i++)
+        {
+            filter_set.rules[i].stats.rejected++;
+        }
+
+        filter_set.dropped++;
+        return false;
+    }
+
+    if (filter_set.needs_ad)
+    {
+        ad_summarize(&ad, data, len);
+    }
+    else
+    {
+        ad.data = data;
+    }
+
+    for (i = 0U; i < filter_set.count; i++)
+    {
+        if (rule_match(&filter_set.rules[i], addr, rssi, &ad, len))
+        {
+            filter_set.rules[i].stats.matched++;
+            filter_set.passed++;
+            return true;
+        }
+
+        filter_set.rules[i].stats.rejected++;
+    }
+
+    filter_set.dropped++;
+
+    return false;
+}
+#endif /* CONFIG_BT_SCAN_FILTER */
@@ -0,0 +1,471 @@
+/* scan_reassembly.c - Extended advertising report reassembly per advertiser */
+
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <errno.h>
+#include <string.h>
+
+#include "bt_config.h"
+
+#include "base/types.h"
+#include "base/common.h"
+#include "base/sys_clock.h"
+
+#include <bluetooth/bluetooth.h>
+#include <bluetooth/hci.h>
+
+#include "scan.h"
+
+#define BT_DBG_ENABLED  IS_ENABLED(CONFIG_BT_DEBUG_HCI_CORE)
+#define LOG_MODULE_NAME bt_scan_reassembly
+#include "logging/bt_log.h"
+
+#if defined(CONFIG_BT_EXT_SCAN_REASSEMBLY)
+
+#define REASM_MAX     CONFIG_BT_EXT_SCAN_REASSEMBLY_MAX
+#define REASM_TIMEOUT CONFIG_BT_EXT_SCAN_REASSEMBLY_TIMEOUT
+#define DISCARD_MAX   CONFIG_BT_EXT_SCAN_REASSEMBLY_DISCARD_MAX
+
+/* Chain of reports from one advertising set of one advertiser. Entries are
+ * matched on (address, SID), a new chain takes a free entry, else one that
+ * timed out, else the least recently used one.
+ */
+struct reasm_entry
+{
+    bt_addr_le_t addr;
+    uint8_t sid;
+    enum
+    {
+        REASM_FREE,
+        REASM_ACTIVE,
+    } state;
+    uint32_t last_used;
+    struct net_buf_simple buf;
+};
+
+/* Chain that lost its entry, evicted, timed out or too long. The rest of
+ * it is dropped up to its last report, which has no way to tell it from
+ * the first report of a new chain otherwise.
+ */
+struct reasm_discard
+{
+    bt_addr_le_t addr;
+    uint8_t sid;
+    bool used;
+    uint32_t last_used;
+};
+
+static struct reasm_entry reasm_table[REASM_MAX];
+static struct reasm_discard reasm_discards[DISCARD_MAX];
+static uint8_t reasm_pool[REASM_MAX][CONFIG_BT_EXT_SCAN_BUF_SIZE];
+static struct bt_le_scan_reassembly_stats reasm_stats;
+
+static uint32_t reasm_now(void)
+{
+    return k_ticks_to_ms_floor32(sys_clock_tick_get());
+}
+
+static bool reasm_expired(uint32_t last_used, uint32_t now)
+{
+    return (uint32_t)(now - last_used) > REASM_TIMEOUT;
+}
+
+static void reasm_free(struct reasm_entry *entry)
+{
+    net_buf_simple_reset(&entry->buf);
+    entry->state = REASM_FREE;
+}
+
+static struct reasm_discard *reasm_discard_find(const bt_addr_le_t *addr, uint8_t sid)
+{
+    struct reasm_discard *discard;
+    uint8_t i;
+
+    for (i = 0U; i < DISCARD_MAX; i++)
+    {
+        discard = &reasm_discards[i];
+
+        if (discard->used && discard->sid == sid && !bt_addr_le_cmp(&discard->addr, addr))
+        {
+            return discard;
+        }
+    }
+
+    return NULL;
+}
+
+/* Free the entry, and drop what is left of its chain */
+static void reasm_discard(struct reasm_entry *entry, uint32_t now)
+{
+    struct reasm_discard *lru = NULL;
+    struct reasm_discard *discard;
+    uint8_t i;
+
+    for (i = 0U; i < DISCARD_MAX; i++)
+    {
+        discard = &reasm_discards[i];
+
+        if (!discard->used)
+        {
+            lru = discard;
+            break;
+        }
+
+        if (!lru || (int32_t)(lru->last_used - discard->last_used) > 0)
+        {
+            lru = discard;
+        }
+    }
+
+    /* One heard from within the timeout may still send reports, they
+     * would be taken for a new chain
+     */
+    if (lru->used && !reasm_expired(lru->last_used, now))
+    {
+        BT_WARN("Dropped chain of %s sid %u no longer tracked", bt_addr_le_str(&lru->addr),
+                lru->sid);
+        reasm_stats.lost++;
+    }
+
+    bt_addr_le_copy(&lru->addr, &entry->addr);
+    lru->sid = entry->sid;
+    lru->used = true;
+    lru->last_used = now;
+
+    reasm_free(entry);
+}
+
+static struct reasm_entry *reasm_find(const bt_addr_le_t *addr, uint8_t sid, uint32_t now)
+{
+    struct reasm_entry *entry;
+    uint8_t i;
+
+    for (i = 0U; i < REASM_MAX; i++)
+    {
+        entry = &reasm_table[i];
+
+        if (entry->state == REASM_FREE || entry->sid != sid || bt_addr_le_cmp(&entry->addr, addr))
+        {
+            continue;
+        }
+
+        if (reasm_expired(entry->last_used, now))
+        {
+            /* Late, but maybe still the same chain */
+            reasm_stats.timed_out++;
+            reasm_discard(entry, now);
+            return NULL;
+        }
+
+        return entry;
+    }
+
+    return NULL;
+}
+
+static struct reasm_entry *reasm_alloc(const bt_addr_le_t *addr, uint8_t sid, uint32_t now)
+{
+    struct reasm_entry *lru = NULL;
+    struct reasm_entry *entry;
+    uint8_t i;
+
+    for (i = 0U; i < REASM_MAX; i++)
+    {
+        entry = &reasm_table[i];
+
+        if (entry->state != REASM_FREE && reasm_expired(entry->last_used, now))
+        {
+            reasm_stats.timed_out++;
+            reasm_discard(entry, now);
+        }
+
+        if (entry->state == REASM_FREE)
+        {
+            lru = entry;
+            break;
+        }
+
+        if (!lru || (int32_t)(lru->last_used - entry->last_used) > 0)
+        {
+            lru = entry;
+        }
+    }
+
+    if (lru->state != REASM_FREE)
+    {
+        BT_DBG("Evicting %s sid %u", bt_addr_le_str(&lru->addr), lru->sid);
+        reasm_stats.evicted++;
+        reasm_discard(lru, now);
+    }
+
+    /* Also drops data of a chain completed before */
+    reasm_free(lru);
+
+    bt_addr_le_copy(&lru->addr, addr);
+    lru->sid = sid;
+    lru->state = REASM_ACTIVE;
+
+    return lru;
+}
+
+int bt_scan_reassembly_feed(const bt_addr_le_t *addr, uint8_t sid, uint8_t data_status,
+                            const uint8_t *data, uint8_t len, struct net_buf_simple **out)
+{
+    uint32_t now = reasm_now();
+    struct reasm_discard *discard = NULL;
+    struct reasm_entry *entry;
+
+    entry = reasm_find(addr, sid, now);
+    if (!entry)
+    {
+        discard = reasm_discard_find(addr, sid);
+    }
+
+    if (discard)
+    {
+        /* Already counted when its entry was lost */
+        discard->last_used = now;
+        if (data_status != BT_HCI_LE_ADV_EVT_TYPE_DATA_STATUS_PARTIAL)
+        {
+            discard->used = false;
+        }
+
+        return BT_SCAN_REASSEMBLY_DROPPED;
+    }
+
+    if (data_status == BT_HCI_LE_ADV_EVT_TYPE_DATA_STATUS_INCOMPLETE)
+    {
+        /* Controller truncated, no more data will come */
+        reasm_stats.truncated++;
+        if (entry)
+        {
+            reasm_free(entry);
+        }
+
+        return BT_SCAN_REASSEMBLY_DROPPED;
+    }
+
+    if (!entry && data_status == BT_HCI_LE_ADV_EVT_TYPE_DATA_STATUS_COMPLETE)
+    {
+        /* Single report, nothing to reassemble */
+        reasm_stats.direct++;
+        return BT_SCAN_REASSEMBLY_DIRECT;
+    }
+
+    if (!entry)
+    {
+        entry = reasm_alloc(addr, sid, now);
+    }
+
+    entry->last_used = now;
+
+    if (len > net_buf_simple_tailroom(&entry->buf))
+    {
+        reasm_stats.truncated++;
+        if (data_status == BT_HCI_LE_ADV_EVT_TYPE_DATA_STATUS_PARTIAL)
+        {
+            reasm_discard(entry, now);
+        }
+        else
+        {
+            reasm_free(entry);
+        }
+
+        return BT_SCAN_REASSEMBLY_DROPPED;
+    }
+
+    net_buf_simple_add_mem(&entry->buf, data, len);
+
+    if (data_status == BT_HCI_LE_ADV_EVT_TYPE_DATA_STATUS_PARTIAL)
+    {
+        return BT_SCAN_REASSEMBLY_PENDING;
+    }
+
+    /* Freed, but the data stays until the next report is fed */
+    reasm_stats.completed++;
+    entry->state = REASM_FREE;
+    *out = &entry->buf;
+
+    return BT_SCAN_REASSEMBLY_DONE;
+}
+
+void bt_scan_reassembly_reset(void)
+{
+    uint8_t i;
+
+    for (i = 0U; i < REASM_MAX; i++)
+    {
+        reasm_table[i].buf.__buf = reasm_pool[i];
+        reasm_table[i].buf.size = sizeof(reasm_pool[i]);
+        reasm_free(&reasm_table[i]);
+    }
+
+    (void)memset(reasm_discards, 0, sizeof(reasm_discards));
+}
+
+void bt_le_scan_reassembly_stats_get(struct bt_le_scan_reassembly_stats *stats)
+{
+    *stats = reasm_stats;
+}
+
+#if defined(CONFIG_BT_EXT_SCAN_REASSEMBLY_SELFTEST)
+/* More chains than table entries interleave, with lengths up to twice
+ * the buffer so that every path is taken. No more than can be followed
+ * once dropped, or the tail of one may be delivered.
+ */
+#define SELFTEST_CHAINS  MIN(REASM_MAX + 2, DISCARD_MAX)
+#define SELFTEST_USUAL   MIN(REASM_MAX, SELFTEST_CHAINS)
+#define SELFTEST_ROUNDS  200
+#define SELFTEST_FRAG    60
+
+static uint32_t selftest_seed = 0x2545f491;
+
+static uint32_t selftest_rand(void)
+{
+    /* xorshift32 */
+    selftest_seed ^= selftest_seed << 13;
+    selftest_seed ^= selftest_seed >> 17;
+    selftest_seed ^= selftest_seed << 5;
+
+    return selftest_seed;
+}
+
+static uint8_t selftest_byte(uint8_t chain, uint16_t round, uint16_t offset)
+{
+    return (uint8_t)(chain * 31U + round * 7U + offset);
+}
+
+struct selftest_chain
+{
+    bt_addr_le_t addr;
+    uint8_t sid;
+    uint16_t round;
+    uint16_t len;
+    uint16_t sent;
+    bool active;
+    bool delivered;
+};
+
+int bt_scan_reassembly_selftest(void)
+{
+    struct bt_le_scan_reassembly_stats before = reasm_stats;
+    struct selftest_chain chains[SELFTEST_CHAINS];
+    uint8_t frag[SELFTEST_FRAG];
+    struct net_buf_simple *out;
+    struct selftest_chain *c;
+    uint32_t done = 0U, undelivered = 0U, bad = 0U;
+    uint32_t counted;
+    uint16_t round = 0U;
+    uint8_t in_flight = 0U;
+    uint16_t i, n;
+    uint8_t status;
+    int ret;
+
+    bt_scan_reassembly_reset();
+    (void)memset(chains, 0, sizeof(chains));
+
+    for (i = 0U; i < SELFTEST_CHAINS; i++)
+    {
+        chains[i].addr.type = BT_ADDR_LE_RANDOM;
+        /* Pairs are two sets of the same advertiser */
+        chains[i].addr.a.val[0] = i / 2U;
+        chains[i].addr.a.val[5] = 0xc0;
+        chains[i].sid = i % 2U;
+    }
+
+    /* Chains still in flight at the end are run to completion */
+    while (round < SELFTEST_ROUNDS || in_flight)
+    {
+        /* Only as many chains in flight as the table holds, except now
+         * and then to have entries evicted.
+         */
+        c = &chains[selftest_rand() % ((selftest_rand() & 7U) ? SELFTEST_USUAL : SELFTEST_CHAINS)];
+
+        if (!c->active)
+        {
+            if (round == SELFTEST_ROUNDS)
+            {
+                continue;
+            }
+
+            in_flight++;
+            c->active = true;
+            c->round = round++;
+            c->len = 1U + selftest_rand() % (CONFIG_BT_EXT_SCAN_BUF_SIZE * 2U);
+            c->sent = 0U;
+            c->delivered = false;
+        }
+
+        /* MIN() evaluates its arguments twice */
+        n = 1U + selftest_rand() % SELFTEST_FRAG;
+        n = MIN(c->len - c->sent, n);
+        for (i = 0U; i < n; i++)
+        {
+            frag[i] = selftest_byte(c - chains, c->round, c->sent + i);
+        }
+
+        c->sent += n;
+        status = c->sent < c->len ? BT_HCI_LE_ADV_EVT_TYPE_DATA_STATUS_PARTIAL
+                                  : BT_HCI_LE_ADV_EVT_TYPE_DATA_STATUS_COMPLETE;
+
+        ret = bt_scan_reassembly_feed(&c->addr, c->sid, status, frag, n, &out);
+        if (ret == BT_SCAN_REASSEMBLY_DONE || ret == BT_SCAN_REASSEMBLY_DIRECT)
+        {
+            /* A direct report carries all of its data in this fragment */
+            const uint8_t *data = ret == BT_SCAN_REASSEMBLY_DONE ? out->data : frag;
+            uint16_t len = ret == BT_SCAN_REASSEMBLY_DONE ? out->len : n;
+
+            done++;
+            c->delivered = true;
+
+            /* Only ever the whole chain, never the tail of one that lost
+             * its entry on the way
+             */
+            if (len != c->len)
+            {
+                bad++;
+                len = 0U;
+            }
+
+            for (i = 0U; i < len; i++)
+            {
+                if (data[i] != selftest_byte(c - chains, c->round, i))
+                {
+                    bad++;
+                    break;
+                }
+            }
+        }
+
+        if (status != BT_HCI_LE_ADV_EVT_TYPE_DATA_STATUS_PARTIAL)
+        {
+            in_flight--;
+            c->active = false;
+            if (!c->delivered)
+            {
+                undelivered++;
+            }
+        }
+    }
+
+    /* Every chain not delivered must show up in the counters */
+    counted = (reasm_stats.evicted - before.evicted) + (reasm_stats.truncated - before.truncated) +
+              (reasm_stats.timed_out - before.timed_out);
+    if (counted != undelivered || reasm_stats.lost != before.lost)
+    {
+        bad++;
+    }
+
+    BT_INFO("Reassembly selftest: %u done, %u dropped, %u evicted, %u truncated, %u lost, %u bad",
+            done, undelivered, reasm_stats.evicted - before.evicted,
+            reasm_stats.truncated - before.truncated, reasm_stats.lost - before.lost, bad);
+
+    bt_scan_reassembly_reset();
+    reasm_stats = before;
+
+    return bad ? -EIO : 0;
+}
+#endif /* CONFIG_BT_EXT_SCAN_REASSEMBLY_SELFTEST */
+#endif /* CONFIG_BT_EXT_SCAN_REASSEMBLY */
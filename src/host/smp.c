@@ -32,6 +32,8 @@
 
 #include "hci_core.h"
 
+#include "common/aes_cmac.h"
+
 #if defined(CONFIG_BT_CONN)
 #if defined(CONFIG_BT_SMP)
 #define SMP_TIMEOUT K_SECONDS(30)
@@ -130,6 +132,18 @@ enum
     SMP_NUM_FLAGS,
 };
 
+/* Pairing phases timed by the benchmark */
+enum
+{
+    SMP_BENCH_PKEY_TX, /* local Public Key sent */
+    SMP_BENCH_PKEY_RX, /* remote Public Key received */
+    SMP_BENCH_CONFIRM, /* first local Pairing Confirm sent */
+    SMP_BENCH_DHKEY,   /* DHKey available */
+    SMP_BENCH_DHCHECK, /* local DHKey Check sent */
+
+    SMP_BENCH_PHASES,
+};
+
 /* SMP channel specific context */
 struct bt_smp
 {
@@ -190,6 +204,21 @@ struct bt_smp
     /* Remote key distribution */
     uint8_t remote_dist;
 
+#if defined(CONFIG_BT_SMP_PRECOMPUTE)
+    /* f4 keyed with prnd with PKx of local key f4_pre_gen absorbed */
+    struct bt_aes_cmac_ctx f4_pre;
+    uint32_t f4_pre_gen;
+    bool f4_pre_valid;
+#endif /* CONFIG_BT_SMP_PRECOMPUTE */
+
+#if defined(CONFIG_BT_SMP_BENCHMARK)
+    /* Pairing start time and AES-CMAC operations done before it */
+    uint32_t bench_start;
+    uint32_t bench_cmac;
+    /* Ticks from the start at which each phase was first reached */
+    uint32_t bench_phase[SMP_BENCH_PHASES];
+#endif /* CONFIG_BT_SMP_BENCHMARK */
+
     /* The channel this context is associated with.
      * This marks the beginning of the part of the structure that will not
      * be memset to zero in init.
@@ -265,6 +294,28 @@ static bool bondable = IS_ENABLED(CONFIG_BT_BONDABLE);
 static bool oobd_present;
 static bool sc_supported;
 static const uint8_t *sc_public_key;
+
+#if defined(CONFIG_BT_SMP_PRECOMPUTE)
+/* Pairing random values drawn while idle */
+struct smp_nonce
+{
+    uint8_t prnd[16];
+    /* f4 keyed with prnd with PKx of local key f4_key_gen absorbed */
+    struct bt_aes_cmac_ctx f4;
+    uint32_t f4_key_gen;
+    bool f4_valid;
+};
+
+static struct smp_nonce nonce_pool[CONFIG_BT_SMP_NONCE_POOL_SIZE];
+static uint8_t nonce_count;
+
+/* Bumped whenever sc_public_key changes */
+static uint32_t sc_key_gen;
+/* LE SC pairings the current local key pair was used for */
+static uint8_t sc_key_uses;
+/* Key generation failed, not retried until the next pairing */
+static bool sc_key_failed;
+#endif /* CONFIG_BT_SMP_PRECOMPUTE */
 // static K_SEM_DEFINE(sc_local_pkey_ready, 0, 1);
 
 static bool le_sc_supported(void)
@@ -279,6 +330,12 @@ static bool le_sc_supported(void)
         return false;
     }
 
+    /* Host computes the keys when the controller cannot */
+    if (IS_ENABLED(CONFIG_BT_HOST_ECC))
+    {
+        return true;
+    }
+
     return BT_CMD_TEST(bt_dev.supported_commands, 34, 1) &&
            BT_CMD_TEST(bt_dev.supported_commands, 34, 2);
 }
@@ -515,22 +572,20 @@ static struct net_buf *smp_create_pdu(struct bt_smp *smp, uint8_t op, size_t len
  *          : len    ( length of the message in octets )
  * Output   : out    ( message authentication code )
  */
+#if defined(CONFIG_BT_SMP_BENCHMARK)
+static uint32_t smp_cmac_count;
+#endif /* CONFIG_BT_SMP_BENCHMARK */
+
 static int bt_smp_aes_cmac(const uint8_t *key, const uint8_t *in, size_t len, uint8_t *out)
 {
-    // struct tc_aes_key_sched_struct sched;
-    // struct tc_cmac_struct state;
+#if defined(CONFIG_BT_SMP_BENCHMARK)
+    smp_cmac_count++;
+#endif /* CONFIG_BT_SMP_BENCHMARK */
 
-    // if (tc_cmac_setup(&state, key, &sched) == TC_CRYPTO_FAIL) {
-    // 	return -EIO;
-    // }
-
-    // if (tc_cmac_update(&state, in, len) == TC_CRYPTO_FAIL) {
-    // 	return -EIO;
-    // }
-
-    // if (tc_cmac_final(out, &state) == TC_CRYPTO_FAIL) {
-    // 	return -EIO;
-    // }
+    if (bt_aes_cmac(key, in, len, out))
+    {
+        return -EIO;
+    }
 
     return 0;
 }
@@ -593,6 +648,120 @@ static int smp_f4(const uint8_t *u, const uint8_t *v, const uint8_t *x, uint8_t
     return err;
 }
 
+#if defined(CONFIG_BT_SMP_PRECOMPUTE)
+/* Absorb the local PKx into an f4 keyed with the nonce, the first 32 of the
+ * 65 octets of every local confirm value.
+ */
+static void smp_nonce_prepare(struct smp_nonce *n)
+{
+    uint8_t key[16];
+    uint8_t u[32];
+
+    n->f4_valid = false;
+
+    if (!sc_public_key)
+    {
+        return;
+    }
+
+    sys_memcpy_swap(key, n->prnd, sizeof(key));
+    sys_memcpy_swap(u, sc_public_key, sizeof(u));
+
+    if (!bt_aes_cmac_setup(&n->f4, key) && !bt_aes_cmac_update(&n->f4, u, sizeof(u)))
+    {
+        n->f4_key_gen = sc_key_gen;
+        n->f4_valid = true;
+    }
+
+    memset(key, 0, sizeof(key));
+}
+
+static void smp_nonce_fill(void)
+{
+    uint8_t i;
+
+    for (i = 0U; i < nonce_count; i++)
+    {
+        if (!nonce_pool[i].f4_valid || nonce_pool[i].f4_key_gen != sc_key_gen)
+        {
+            smp_nonce_prepare(&nonce_pool[i]);
+        }
+    }
+
+    while (nonce_count < ARRAY_SIZE(nonce_pool))
+    {
+        if (bt_rand(nonce_pool[nonce_count].prnd, 16))
+        {
+            return;
+        }
+
+        smp_nonce_prepare(&nonce_pool[nonce_count]);
+        nonce_count++;
+    }
+}
+#endif /* CONFIG_BT_SMP_PRECOMPUTE */
+
+/* Draw a new local random number, from the pool when there is one */
+static int smp_prnd_get(struct bt_smp *smp)
+{
+#if defined(CONFIG_BT_SMP_PRECOMPUTE)
+    struct smp_nonce *n;
+
+    smp->f4_pre_valid = false;
+
+    if (nonce_count)
+    {
+        n = &nonce_pool[--nonce_count];
+
+        memcpy(smp->prnd, n->prnd, sizeof(smp->prnd));
+        if (n->f4_valid && n->f4_key_gen == sc_key_gen)
+        {
+            smp->f4_pre = n->f4;
+            smp->f4_pre_gen = n->f4_key_gen;
+            smp->f4_pre_valid = true;
+        }
+
+        memset(n, 0, sizeof(*n));
+        return 0;
+    }
+#endif /* CONFIG_BT_SMP_PRECOMPUTE */
+
+    return bt_rand(smp->prnd, 16);
+}
+
+/* Local confirm value f4(PKax, PKbx, prnd, z) */
+static int smp_f4_local(struct bt_smp *smp, uint8_t z, uint8_t res[16])
+{
+#if defined(CONFIG_BT_SMP_PRECOMPUTE)
+    uint8_t m[33];
+
+    /* The local key may have been replaced since the nonce was drawn */
+    if (smp->f4_pre_valid && smp->f4_pre_gen == sc_key_gen)
+    {
+        smp->f4_pre_valid = false;
+
+#if defined(CONFIG_BT_SMP_BENCHMARK)
+        smp_cmac_count++;
+#endif /* CONFIG_BT_SMP_BENCHMARK */
+
+        sys_memcpy_swap(m, smp->pkey, 32);
+        m[32] = z;
+
+        if (bt_aes_cmac_update(&smp->f4_pre, m, sizeof(m)) ||
+            bt_aes_cmac_final(&smp->f4_pre, res))
+        {
+            return -EIO;
+        }
+
+        sys_mem_swap(res, 16);
+
+        return 0;
+    }
+#endif /* CONFIG_BT_SMP_PRECOMPUTE */
+
+    return smp_f4(sc_public_key, smp->pkey, smp->prnd, z, res);
+}
+
 static int smp_f5(const uint8_t *w, const uint8_t *n1, const uint8_t *n2, const bt_addr_le_t *a1,
                   const bt_addr_le_t *a2, uint8_t *mackey, uint8_t *ltk)
 {
@@ -887,7 +1056,7 @@ static void smp_sign_info_sent(struct bt_conn *conn, void *user_data, int err)
 }
 #endif /* CONFIG_BT_SIGNING */
 
-#if defined(CONFIG_BT_BREDR)
+#if defined(CONFIG_BT_BREDR) || defined(CONFIG_BT_SMP_SELFTEST)
 static int smp_h6(const uint8_t w[16], const uint8_t key_id[4], uint8_t res[16])
 {
     uint8_t ws[16];
@@ -937,7 +1106,9 @@ static int smp_h7(const uint8_t salt[16], const uint8_t w[16], uint8_t res[16])
 
     return 0;
 }
+#endif /* CONFIG_BT_BREDR || CONFIG_BT_SMP_SELFTEST */
 
+#if defined(CONFIG_BT_BREDR)
 static void sc_derive_link_key(struct bt_smp *smp)
 {
     /* constants as specified in Core Spec Vol.3 Part H 2.4.2.4 */
@@ -1937,6 +2108,55 @@ static void smp_reset(struct bt_smp *smp)
     }
 }
 
+#if defined(CONFIG_BT_SMP_BENCHMARK)
+static void smp_bench_start(struct bt_smp *smp)
+{
+    smp->bench_start = sys_clock_tick_get();
+    smp->bench_cmac = smp_cmac_count;
+    memset(smp->bench_phase, 0xff, sizeof(smp->bench_phase));
+}
+
+static void smp_bench_mark(struct bt_smp *smp, uint8_t phase)
+{
+    if (smp->bench_phase[phase] == UINT32_MAX)
+    {
+        smp->bench_phase[phase] = sys_clock_tick_get() - smp->bench_start;
+    }
+}
+
+static void smp_bench_report(struct bt_smp *smp, uint8_t status)
+{
+    static const char *const phase_name[SMP_BENCH_PHASES] = {
+            "public key sent", "public key received", "confirm sent", "DHKey ready",
+            "DHKey check sent"};
+    uint8_t i;
+
+    BT_INFO("pairing %s in %u ms, %u AES-CMAC ops", status ? "failed" : "completed",
+            k_ticks_to_ms_floor32(sys_clock_tick_get() - smp->bench_start),
+            smp_cmac_count - smp->bench_cmac);
+
+    for (i = 0U; i < SMP_BENCH_PHASES; i++)
+    {
+        if (smp->bench_phase[i] != UINT32_MAX)
+        {
+            BT_INFO("  %s at %u ms", phase_name[i], k_ticks_to_ms_floor32(smp->bench_phase[i]));
+        }
+    }
+}
+#else
+static inline void smp_bench_start(struct bt_smp *smp)
+{
+}
+
+static inline void smp_bench_mark(struct bt_smp *smp, uint8_t phase)
+{
+}
+
+static inline void smp_bench_report(struct bt_smp *smp, uint8_t status)
+{
+}
+#endif /* CONFIG_BT_SMP_BENCHMARK */
+
 static uint8_t hci_err_get(enum bt_security_err err)
 {
     switch (err)
@@ -1967,6 +2187,20 @@ static void smp_pairing_complete(struct bt_smp *smp, uint8_t status)
 
     BT_DBG("status 0x%x", status);
 
+    smp_bench_report(smp, status);
+
+#if defined(CONFIG_BT_SMP_PRECOMPUTE)
+    if (atomic_test_bit(smp->flags, SMP_FLAG_SC) && sc_key_uses < UINT8_MAX)
+    {
+        sc_key_uses++;
+    }
+
+    sc_key_failed = false;
+#endif /* CONFIG_BT_SMP_PRECOMPUTE */
+
+    /* Drop cached IRK schedules, the peer may have a new one */
+    bt_aes_key_cache_clear();
+
     if (!status)
     {
 #if defined(CONFIG_BT_BREDR)
@@ -2216,7 +2450,7 @@ static uint8_t smp_send_pairing_confirm(struct bt_smp *smp)
 
     req = net_buf_add(buf, sizeof(*req));
 
-    if (smp_f4(sc_public_key, smp->pkey, smp->prnd, r, req->val))
+    if (smp_f4_local(smp, r, req->val))
     {
         net_buf_unref(buf);
         return BT_SMP_ERR_UNSPECIFIED;
@@ -2224,6 +2458,8 @@ static uint8_t smp_send_pairing_confirm(struct bt_smp *smp)
 
     smp_send(smp, buf, NULL, NULL);
 
+    smp_bench_mark(smp, SMP_BENCH_CONFIRM);
+
     atomic_clear_bit(smp->flags, SMP_FLAG_CFM_DELAYED);
 
     return 0;
@@ -2902,13 +3138,15 @@ static int smp_init(struct bt_smp *smp)
     (void)memset(smp, 0, offsetof(struct bt_smp, chan));
 
     /* Generate local random number */
-    if (bt_rand(smp->prnd, 16))
+    if (smp_prnd_get(smp))
     {
         return BT_SMP_ERR_UNSPECIFIED;
     }
 
     BT_DBG("prnd %s", bt_hex(smp->prnd, 16));
 
+    smp_bench_start(smp);
+
     atomic_set_bit(smp->allowed_cmds, BT_SMP_CMD_PAIRING_FAIL);
 
 #if !defined(CONFIG_BT_SMP_OOB_LEGACY_PAIR_ONLY)
@@ -3356,6 +3594,8 @@ static uint8_t sc_send_public_key(struct bt_smp *smp)
 
     smp_send(smp, req_buf, NULL, NULL);
 
+    smp_bench_mark(smp, SMP_BENCH_PKEY_TX);
+
     if (IS_ENABLED(CONFIG_BT_USE_DEBUG_KEYS))
     {
         atomic_set_bit(smp->flags, SMP_FLAG_SC_DEBUG_KEY);
@@ -3636,6 +3876,8 @@ static uint8_t sc_smp_send_dhkey_check(struct bt_smp *smp, const uint8_t *e)
 
     smp_send(smp, buf, NULL, NULL);
 
+    smp_bench_mark(smp, SMP_BENCH_DHCHECK);
+
     return 0;
 }
 
@@ -3796,6 +4038,8 @@ static uint8_t smp_dhkey_ready(struct bt_smp *smp, const uint8_t *dhkey)
     atomic_clear_bit(smp->flags, SMP_FLAG_DHKEY_PENDING);
     memcpy(smp->dhkey, dhkey, BT_DH_KEY_LEN);
 
+    smp_bench_mark(smp, SMP_BENCH_DHKEY);
+
     /* wait for user passkey confirmation */
     if (atomic_test_bit(smp->flags, SMP_FLAG_USER))
     {
@@ -4014,7 +4258,7 @@ static uint8_t smp_pairing_random(struct bt_smp *smp, struct net_buf *buf)
                 break;
             }
 
-            if (bt_rand(smp->prnd, 16))
+            if (smp_prnd_get(smp))
             {
                 return BT_SMP_ERR_UNSPECIFIED;
             }
@@ -4074,7 +4318,7 @@ static uint8_t smp_pairing_random(struct bt_smp *smp, struct net_buf *buf)
             return 0;
         }
 
-        if (bt_rand(smp->prnd, 16))
+        if (smp_prnd_get(smp))
         {
             return BT_SMP_ERR_UNSPECIFIED;
         }
@@ -4238,7 +4482,7 @@ static uint8_t smp_ident_addr_info(struct bt_smp *smp, struct net_buf *buf)
              */
             if (!bt_addr_le_is_identity(&conn->le.dst))
             {
-                bt_addr_le_copy(&keys->addr, &req->addr);
+                bt_keys_set_addr(keys, &req->addr);
                 bt_addr_le_copy(&conn->le.dst, &req->addr);
 
                 bt_conn_identity_resolved(conn);
@@ -4557,6 +4801,8 @@ static uint8_t smp_public_key(struct bt_smp *smp, struct net_buf *buf)
     memcpy(smp->pkey, req->x, BT_PUB_KEY_COORD_LEN);
     memcpy(&smp->pkey[BT_PUB_KEY_COORD_LEN], req->y, BT_PUB_KEY_COORD_LEN);
 
+    smp_bench_mark(smp, SMP_BENCH_PKEY_RX);
+
     /* mark key as debug if remote is using it */
     if (bt_pub_key_is_debug(smp->pkey))
     {
@@ -4880,6 +5126,11 @@ static void bt_smp_pkey_ready(const uint8_t *pkey)
 
     sc_public_key = pkey;
 
+#if defined(CONFIG_BT_SMP_PRECOMPUTE)
+    sc_key_gen++;
+    sc_key_failed = !pkey;
+#endif /* CONFIG_BT_SMP_PRECOMPUTE */
+
     if (!pkey)
     {
         BT_WARN("Public key not available");
@@ -5095,18 +5346,17 @@ static int smp_sign_buf(const uint8_t *key, uint8_t *msg, uint16_t len)
     uint32_t cnt = UNALIGNED_GET((uint32_t *)&msg[len]);
     uint8_t *sig = msg + len;
     uint8_t key_s[16], tmp[16];
-    int err;
 
     BT_DBG("Signing msg %s len %u key %s", bt_hex(msg, len), len, bt_hex(key, 16));
 
     sys_mem_swap(m, len + sizeof(cnt));
     sys_memcpy_swap(key_s, key, 16);
 
-    err = bt_smp_aes_cmac(key_s, m, len + sizeof(cnt), tmp);
-    if (err)
+    /* The CSRK lives as long as the bond, keep its key schedule */
+    if (bt_aes_cmac_cached(key_s, m, len + sizeof(cnt), tmp))
     {
         BT_ERR("Data signing failed");
-        return err;
+        return -EIO;
     }
 
     sys_mem_swap(tmp, sizeof(tmp));
@@ -5224,6 +5474,69 @@ int bt_smp_irk_get(uint8_t *ir, uint8_t *irk)
     return smp_d1(ir, 1, 0, irk);
 }
 
+static int smp_s1_test(void)
+{
+    uint8_t k[16] = {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+                     0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00};
+    // uint8_t k_be[16] = {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    //                     0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00};
+    // 0x000F0E0D0C0B0A091122334455667788
+    uint8_t r1[16] = {0x88, 0x77, 0x66, 0x55, 0x44, 0x33, 0x22, 0x11,
+                      0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f, 0x00};
+    // uint8_t r1_be[16] = {0x00, 0x0f, 0x0e, 0x0d, 0x0c, 0x0b, 0x0a, 0x09,
+    //                      0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x88};
+    // 0x010203040506070899AABBCCDDEEFF00
+    uint8_t r2[16] = {0x00, 0xff, 0xee, 0xdd, 0xcc, 0xbb, 0xaa, 0x99,
+                      0x08, 0x07, 0x06, 0x05, 0x04, 0x03, 0x02, 0x01};
+    // uint8_t r2_be[16] = {0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08,
+    //                      0x99, 0xaa, 0xbb, 0xcc, 0xdd, 0xee, 0xff, 0x00};
+    // 0x9a1fe1f0e8b0f49b5b4216ae796da062.
+    uint8_t exp[16] = {0x62, 0xa0, 0x6d, 0x79, 0xae, 0x16, 0x42, 0x5b,
+                       0x9b, 0xf4, 0xb0, 0xe8, 0xf0, 0xe1, 0x1f, 0x9a};
+    uint8_t res[16];
+    int err;
+
+    err = smp_s1(k, r1, r2, res);
+    if (err)
+        return err;
+
+    if (memcmp(res, exp, 16))
+        return -EINVAL;
+
+    return 0;
+}
+
+static int smp_c1_test(void)
+{
+    uint8_t k[16] = {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+                     0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00};
+    // 0x5783D52156AD6F0E6388274EC6702EE0,
+    uint8_t r[16] = {0xe0, 0x2e, 0x70, 0xc6, 0x4e, 0x27, 0x88, 0x63,
+                     0x0e, 0x6f, 0xad, 0x56, 0x21, 0xd5, 0x83, 0x57};
+    // 0x07071000000101
+    uint8_t preq[7] = {0x01, 0x01, 0x00, 0x00, 0x10, 0x07, 0x07};
+    // 0x05000800000302
+    uint8_t pres[7] = {0x02, 0x03, 0x00, 0x00, 0x08, 0x00, 0x05};
+    // 8-bit iat is 0x01, 48-bit ia is 0xA1A2A3A4A5A6
+    bt_addr_le_t ia = {0x01, {{0xa6, 0xa5, 0xa4, 0xa3, 0xa2, 0xa1}}};
+    // 8-bit rat is 0x00, 48-bit ra is 0xB1B2B3B4B5B6
+    bt_addr_le_t ra = {0x00, {{0xb6, 0xb5, 0xb4, 0xb3, 0xb2, 0xb1}}};
+    // 0x1e1e3fef878988ea d2a74dc5bef13b86..
+    uint8_t exp[16] = {0x86, 0x3b, 0xf1, 0xbe, 0xc5, 0x4d, 0xa7, 0xd2,
+                       0xea, 0x88, 0x89, 0x87, 0xef, 0x3f, 0x1e, 0x1e};
+    uint8_t res[16];
+    int err;
+
+    err = smp_c1(k, r, preq, pres, &ia, &ra, res);
+    if (err)
+        return err;
+
+    if (memcmp(res, exp, 16))
+        return -EINVAL;
+
+    return 0;
+}
+
 #if defined(CONFIG_BT_SMP_SELFTEST)
 /* Test vectors are taken from RFC 4493
  * https://tools.ietf.org/html/rfc4493
@@ -5506,7 +5819,7 @@ static int smp_g2_test(void)
     return 0;
 }
 
-#if defined(CONFIG_BT_BREDR)
+/* h6 and h7 are tested even without BR/EDR, they are plain AES-CMAC */
 static int smp_h6_test(void)
 {
     uint8_t w[16] = {0x9b, 0x7d, 0x39, 0x0a, 0xa6, 0x10, 0x10, 0x34,
@@ -5555,7 +5868,6 @@ static int smp_h7_test(void)
 
     return 0;
 }
-#endif /* CONFIG_BT_BREDR */
 
 static int smp_self_test(void)
 {
@@ -5603,7 +5915,6 @@ static int smp_self_test(void)
         return err;
     }
 
-#if defined(CONFIG_BT_BREDR)
     err = smp_h6_test();
     if (err)
     {
@@ -5617,77 +5928,28 @@ static int smp_self_test(void)
         BT_ERR("SMP h7 self test failed");
         return err;
     }
-#endif /* CONFIG_BT_BREDR */
 
-    return 0;
-}
-#else
-// static inline int smp_self_test(void)
-//{
-//	return 0;
-// }
-
-static int smp_s1_test(void)
-{
-    uint8_t k[16] = {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-                     0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00};
-    // uint8_t k_be[16] = {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-    //                     0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00};
-    // 0x000F0E0D0C0B0A091122334455667788
-    uint8_t r1[16] = {0x88, 0x77, 0x66, 0x55, 0x44, 0x33, 0x22, 0x11,
-                      0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f, 0x00};
-    // uint8_t r1_be[16] = {0x00, 0x0f, 0x0e, 0x0d, 0x0c, 0x0b, 0x0a, 0x09,
-    //                      0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x88};
-    // 0x010203040506070899AABBCCDDEEFF00
-    uint8_t r2[16] = {0x00, 0xff, 0xee, 0xdd, 0xcc, 0xbb, 0xaa, 0x99,
-                      0x08, 0x07, 0x06, 0x05, 0x04, 0x03, 0x02, 0x01};
-    // uint8_t r2_be[16] = {0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08,
-    //                      0x99, 0xaa, 0xbb, 0xcc, 0xdd, 0xee, 0xff, 0x00};
-    // 0x9a1fe1f0e8b0f49b5b4216ae796da062.
-    uint8_t exp[16] = {0x62, 0xa0, 0x6d, 0x79, 0xae, 0x16, 0x42, 0x5b,
-                       0x9b, 0xf4, 0xb0, 0xe8, 0xf0, 0xe1, 0x1f, 0x9a};
-    uint8_t res[16];
-    int err;
-
-    err = smp_s1(k, r1, r2, res);
+    err = smp_s1_test();
     if (err)
+    {
+        BT_ERR("SMP s1 self test failed");
         return err;
+    }
 
-    if (memcmp(res, exp, 16))
-        return -EINVAL;
-
-    return 0;
-}
-static int smp_c1_test(void)
-{
-    uint8_t k[16] = {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-                     0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00};
-    // 0x5783D52156AD6F0E6388274EC6702EE0,
-    uint8_t r[16] = {0xe0, 0x2e, 0x70, 0xc6, 0x4e, 0x27, 0x88, 0x63,
-                     0x0e, 0x6f, 0xad, 0x56, 0x21, 0xd5, 0x83, 0x57};
-    // 0x07071000000101
-    uint8_t preq[7] = {0x01, 0x01, 0x00, 0x00, 0x10, 0x07, 0x07};
-    // 0x05000800000302
-    uint8_t pres[7] = {0x02, 0x03, 0x00, 0x00, 0x08, 0x00, 0x05};
-    // 8-bit iat is 0x01, 48-bit ia is 0xA1A2A3A4A5A6
-    bt_addr_le_t ia = {0x01, {{0xa6, 0xa5, 0xa4, 0xa3, 0xa2, 0xa1}}};
-    // 8-bit rat is 0x00, 48-bit ra is 0xB1B2B3B4B5B6
-    bt_addr_le_t ra = {0x00, {{0xb6, 0xb5, 0xb4, 0xb3, 0xb2, 0xb1}}};
-    // 0x1e1e3fef878988ea d2a74dc5bef13b86..
-    uint8_t exp[16] = {0x86, 0x3b, 0xf1, 0xbe, 0xc5, 0x4d, 0xa7, 0xd2,
-                       0xea, 0x88, 0x89, 0x87, 0xef, 0x3f, 0x1e, 0x1e};
-    uint8_t res[16];
-    int err;
-
-    err = smp_c1(k, r, preq, pres, &ia, &ra, res);
+    err = smp_c1_test();
     if (err)
+    {
+        BT_ERR("SMP c1 self test failed");
         return err;
-
-    if (memcmp(res, exp, 16))
-        return -EINVAL;
+    }
 
     return 0;
 }
+#else
+// static inline int smp_self_test(void)
+//{
+//	return 0;
+// }
 
 static inline int smp_self_test(void)
 {
@@ -5714,6 +5976,53 @@ static inline int smp_self_test(void)
 }
 #endif
 
+#if defined(CONFIG_BT_SMP_BENCHMARK)
+#define SMP_BENCH_ROUNDS 32
+
+static void smp_bench_run(void)
+{
+    static const bt_addr_le_t a1 = {0x00, {{0x01, 0x02, 0x03, 0x04, 0x05, 0x06}}};
+    static const bt_addr_le_t a2 = {0x01, {{0x11, 0x12, 0x13, 0x14, 0x15, 0x16}}};
+    uint8_t u[32] = {0x01};
+    uint8_t v[32] = {0x02};
+    uint8_t x[16] = {0x03};
+    uint8_t y[16] = {0x04};
+    uint8_t iocap[3] = {0x00};
+    uint8_t mackey[16], ltk[16], res[16];
+    uint32_t passkey;
+    uint32_t start;
+    uint16_t i;
+
+    start = sys_clock_tick_get();
+    for (i = 0U; i < SMP_BENCH_ROUNDS; i++)
+    {
+        (void)smp_f4(u, v, x, 0, res);
+    }
+    BT_INFO("f4: %u us", k_ticks_to_us_floor32(sys_clock_tick_get() - start) / SMP_BENCH_ROUNDS);
+
+    start = sys_clock_tick_get();
+    for (i = 0U; i < SMP_BENCH_ROUNDS; i++)
+    {
+        (void)smp_f5(u, x, y, &a1, &a2, mackey, ltk);
+    }
+    BT_INFO("f5: %u us", k_ticks_to_us_floor32(sys_clock_tick_get() - start) / SMP_BENCH_ROUNDS);
+
+    start = sys_clock_tick_get();
+    for (i = 0U; i < SMP_BENCH_ROUNDS; i++)
+    {
+        (void)smp_f6(mackey, x, y, res, iocap, &a1, &a2, res);
+    }
+    BT_INFO("f6: %u us", k_ticks_to_us_floor32(sys_clock_tick_get() - start) / SMP_BENCH_ROUNDS);
+
+    start = sys_clock_tick_get();
+    for (i = 0U; i < SMP_BENCH_ROUNDS; i++)
+    {
+        (void)smp_g2(u, v, x, y, &passkey);
+    }
+    BT_INFO("g2: %u us", k_ticks_to_us_floor32(sys_clock_tick_get() - start) / SMP_BENCH_ROUNDS);
+}
+#endif /* CONFIG_BT_SMP_BENCHMARK */
+
 int bt_smp_auth_passkey_entry(struct bt_conn *conn, unsigned int passkey)
 {
     struct bt_smp *smp;
@@ -6308,11 +6617,66 @@ BT_L2CAP_CHANNEL_DEFINE_NEW(smp_fixed_chan, BT_L2CAP_CID_SMP, bt_smp_accept, NUL
 BT_L2CAP_CHANNEL_DEFINE(smp_br_fixed_chan, BT_L2CAP_CID_BR_SMP, bt_smp_br_accept, NULL);
 #endif /* CONFIG_BT_BREDR */
 
+#if defined(CONFIG_BT_SMP_PRECOMPUTE)
+static bool smp_pairing_active(void)
+{
+    uint8_t i;
+
+    for (i = 0U; i < ARRAY_SIZE(bt_smp_pool); i++)
+    {
+        if (atomic_test_bit(bt_smp_pool[i].flags, SMP_FLAG_PAIRING))
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void bt_smp_precompute_work(void)
+{
+    static struct bt_pub_key_cb pub_key_cb = {
+            .func = bt_smp_pkey_ready,
+    };
+
+    /* Never touch the key or the nonces a pairing is using */
+    if (bt_dev.hci_state != HCI_STATE_READY || !sc_supported || smp_pairing_active())
+    {
+        return;
+    }
+
+    if (!atomic_test_bit(bt_dev.flags, BT_DEV_PUB_KEY_BUSY) && !sc_key_failed)
+    {
+        if (!sc_public_key ||
+            (CONFIG_BT_SMP_SC_KEY_REUSE && sc_key_uses >= CONFIG_BT_SMP_SC_KEY_REUSE))
+        {
+            sc_key_uses = 0U;
+            sc_public_key = NULL;
+            /* Do not retry on every poll, a pairing clears the failure */
+            if (bt_pub_key_gen(&pub_key_cb))
+            {
+                sc_key_failed = true;
+            }
+            return;
+        }
+
+        bt_pub_key_precompute();
+    }
+
+    smp_nonce_fill();
+}
+#endif /* CONFIG_BT_SMP_PRECOMPUTE */
+
 int bt_smp_init(void)
 {
     // static struct bt_pub_key_cb pub_key_cb = {
     //         .func = bt_smp_pkey_ready,
     // };
+#if defined(CONFIG_BT_HOST_ECC)
+    static struct bt_pub_key_cb host_pub_key_cb = {
+            .func = bt_smp_pkey_ready,
+    };
+#endif /* CONFIG_BT_HOST_ECC */
 
     sc_supported = le_sc_supported();
     if (IS_ENABLED(CONFIG_BT_SMP_SC_PAIR_ONLY) && !sc_supported)
@@ -6332,8 +6696,21 @@ int bt_smp_init(void)
     if (!IS_ENABLED(CONFIG_BT_SMP_OOB_LEGACY_PAIR_ONLY))
     {
         // bt_pub_key_gen(&pub_key_cb);
+#if defined(CONFIG_BT_HOST_ECC)
+        /* Started now as the host key takes a while to compute, controller
+         * based ECC keeps generating the key on demand.
+         */
+        if (!bt_ecc_hci_supported())
+        {
+            (void)bt_pub_key_gen(&host_pub_key_cb);
+        }
+#endif /* CONFIG_BT_HOST_ECC */
     }
 
+#if defined(CONFIG_BT_SMP_BENCHMARK)
+    smp_bench_run();
+#endif /* CONFIG_BT_SMP_BENCHMARK */
+
     return smp_self_test();
 }
 
@@ -165,6 +165,11 @@ int bt_smp_br_send_pairing_req(struct bt_conn *conn);
 
 int bt_smp_init(void);
 
+#if defined(CONFIG_BT_SMP_PRECOMPUTE)
+/* Refresh the local key pair and the nonce pool while no pairing runs */
+void bt_smp_precompute_work(void);
+#endif /* CONFIG_BT_SMP_PRECOMPUTE */
+
 int bt_smp_auth_passkey_entry(struct bt_conn *conn, unsigned int passkey);
 int bt_smp_auth_passkey_confirm(struct bt_conn *conn);
 int bt_smp_auth_pairing_confirm(struct bt_conn *conn);
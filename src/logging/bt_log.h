@@ -38,6 +38,23 @@ extern "C" {
 
 // LOG_MODULE_REGISTER(LOG_MODULE_NAME, LOG_LEVEL);
 
+#if defined(CONFIG_BT_LOG_RUNTIME_LEVEL)
+/* The sentinel level lets the first message that passes LOG_LEVEL through
+ * to bt_log_module_enabled(), which registers the module. Filtering out a
+ * message is a single compare after that.
+ */
+static struct bt_log_module bt_log_module_local __unused = {
+    .name = STRINGIFY(LOG_MODULE_NAME),
+    .level = BT_LOG_MODULE_UNREGISTERED,
+};
+
+#undef LOG_IMPL_RUNTIME_ENABLED
+#define LOG_IMPL_RUNTIME_ENABLED(_level)                                                           \
+    ((_level) <= bt_log_module_local.level &&                                                      \
+     (bt_log_module_local.level < BT_LOG_MODULE_REGISTERING ||                                     \
+      bt_log_module_enabled(&bt_log_module_local, _level)))
+#endif /* CONFIG_BT_LOG_RUNTIME_LEVEL */
+
 #define BT_DBG(fmt, ...)  LOG_IMPL_DBG(LOG_MODULE_NAME, LOG_LEVEL, fmt, ##__VA_ARGS__)
 #define BT_ERR(fmt, ...)  LOG_IMPL_ERR(LOG_MODULE_NAME, LOG_LEVEL, fmt, ##__VA_ARGS__)
 #define BT_WARN(fmt, ...) LOG_IMPL_WRN(LOG_MODULE_NAME, LOG_LEVEL, fmt, ##__VA_ARGS__)
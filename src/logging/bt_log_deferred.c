@@ -0,0 +1,564 @@
+/* bt_log_deferred.c - Deferred formatting of log messages */
+
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "bt_config.h"
+
+#include "base/types.h"
+#include "base/common.h"
+#include "base/sys_clock.h"
+
+#include "bt_log_impl.h"
+
+#if defined(CONFIG_BT_LOG_DEFERRED)
+
+#define LOG_SLOTS     CONFIG_BT_LOG_DEFERRED_SLOTS
+#define LOG_SLOT_MASK (LOG_SLOTS - 1U)
+#define LOG_ARGS_SIZE CONFIG_BT_LOG_DEFERRED_ARGS_SIZE
+#define LOG_LINE_SIZE 256
+
+BUILD_ASSERT((LOG_SLOTS & LOG_SLOT_MASK) == 0U, "BT_LOG_DEFERRED_SLOTS not a power of two");
+
+/* A message as recorded by the call site. The format, module and function
+ * names are literals and only referenced, the arguments are copied the way
+ * the format says they were passed.
+ */
+struct log_slot
+{
+    /* Lap of the ring the slot is free in, one more once committed */
+    uint32_t seq;
+    uint32_t timestamp;
+    const char *format;
+    const char *name;
+    const char *func;
+    uint16_t line;
+    uint8_t level;
+    uint8_t len;
+    /* Arguments after len did not fit */
+    bool truncated;
+    uint8_t args[LOG_ARGS_SIZE];
+};
+
+enum log_arg
+{
+    LOG_ARG_NONE,
+    LOG_ARG_PERCENT,
+    LOG_ARG_INT,
+    LOG_ARG_LONG,
+    LOG_ARG_LLONG,
+    LOG_ARG_SIZE,
+    LOG_ARG_PTR,
+    LOG_ARG_DOUBLE,
+    LOG_ARG_STR,
+};
+
+struct log_spec
+{
+    uint8_t arg;
+    bool star_width;
+    bool star_prec;
+    /* From the '%' up to and including the conversion */
+    uint8_t len;
+};
+
+/* Any number of producers, e.g. the polling loop and driver threads, claim
+ * slots with a compare-and-set on head, the polling loop is the only
+ * consumer. base/atomic.h is not atomic on every port, the compiler
+ * builtins are used instead: a slot's contents are published by the
+ * release store of its seq and picked up by an acquire load of it.
+ */
+static struct
+{
+    uint32_t head;
+    uint32_t tail;
+    uint32_t dropped;
+    struct log_slot slots[LOG_SLOTS];
+} ring;
+
+static char log_line[LOG_LINE_SIZE];
+
+static const char *spec_parse(const char *format, struct log_spec *spec)
+{
+    const char *p = format + 1;
+    uint8_t longs = 0U;
+    bool size = false;
+
+    (void)memset(spec, 0, sizeof(*spec));
+
+    while (*p == '-' || *p == '+' || *p == ' ' || *p == '#' || *p == '0')
+    {
+        p++;
+    }
+
+    if (*p == '*')
+    {
+        spec->star_width = true;
+        p++;
+    }
+
+    while (*p >= '0' && *p <= '9')
+    {
+        p++;
+    }
+
+    if (*p == '.')
+    {
+        p++;
+        if (*p == '*')
+        {
+            spec->star_prec = true;
+            p++;
+        }
+
+        while (*p >= '0' && *p <= '9')
+        {
+            p++;
+        }
+    }
+
+    for (;; p++)
+    {
+        if (*p == 'l')
+        {
+            longs++;
+        }
+        else if (*p == 'j')
+        {
+            longs = 2U;
+        }
+        else if (*p == 'z' || *p == 't')
+        {
+            size = true;
+        }
+        else if (*p != 'h')
+        {
+            break;
+        }
+    }
+
+    switch (*p)
+    {
+    case 'd':
+    case 'i':
+    case 'u':
+    case 'x':
+    case 'X':
+    case 'o':
+    case 'c':
+        spec->arg = size ? LOG_ARG_SIZE
+                         : (longs >= 2U ? LOG_ARG_LLONG : (longs ? LOG_ARG_LONG : LOG_ARG_INT));
+        break;
+    case 'p':
+        spec->arg = LOG_ARG_PTR;
+        break;
+    case 's':
+        spec->arg = LOG_ARG_STR;
+        break;
+    case 'f':
+    case 'F':
+    case 'e':
+    case 'E':
+    case 'g':
+    case 'G':
+        spec->arg = LOG_ARG_DOUBLE;
+        break;
+    case '%':
+        spec->arg = LOG_ARG_PERCENT;
+        break;
+    default:
+        /* Unknown, the rest of the arguments cannot be told apart */
+        spec->arg = LOG_ARG_NONE;
+        break;
+    }
+
+    if (*p)
+    {
+        p++;
+    }
+
+    spec->len = (uint8_t)MIN(p - format, UINT8_MAX);
+
+    return p;
+}
+
+static void args_put(struct log_slot *slot, const void *val, size_t size)
+{
+    if (slot->truncated || slot->len + size > LOG_ARGS_SIZE)
+    {
+        slot->truncated = true;
+        return;
+    }
+
+    (void)memcpy(&slot->args[slot->len], val, size);
+    slot->len += size;
+}
+
+static void args_put_str(struct log_slot *slot, const char *str)
+{
+    size_t n = 0U;
+
+    if (slot->truncated || slot->len == LOG_ARGS_SIZE)
+    {
+        slot->truncated = true;
+        return;
+    }
+
+    if (!str)
+    {
+        str = "(null)";
+    }
+
+    /* Cut short to what is left, the terminator always fits */
+    while (str[n] && slot->len + n + 1U < LOG_ARGS_SIZE)
+    {
+        n++;
+    }
+
+    (void)memcpy(&slot->args[slot->len], str, n);
+    slot->args[slot->len + n] = '\0';
+    slot->len += n + 1U;
+}
+
+static void args_record(struct log_slot *slot, const char *format, va_list ap)
+{
+    struct log_spec spec;
+    int i;
+    long l;
+    long long ll;
+    size_t z;
+    void *ptr;
+    double d;
+
+    while (*format && !slot->truncated)
+    {
+        if (*format != '%')
+        {
+            format++;
+            continue;
+        }
+
+        format = spec_parse(format, &spec);
+
+        if (spec.star_width)
+        {
+            i = va_arg(ap, int);
+            args_put(slot, &i, sizeof(i));
+        }
+
+        if (spec.star_prec)
+        {
+            i = va_arg(ap, int);
+            args_put(slot, &i, sizeof(i));
+        }
+
+        switch (spec.arg)
+        {
+        case LOG_ARG_INT:
+            i = va_arg(ap, int);
+            args_put(slot, &i, sizeof(i));
+            break;
+        case LOG_ARG_LONG:
+            l = va_arg(ap, long);
+            args_put(slot, &l, sizeof(l));
+            break;
+        case LOG_ARG_LLONG:
+            ll = va_arg(ap, long long);
+            args_put(slot, &ll, sizeof(ll));
+            break;
+        case LOG_ARG_SIZE:
+            z = va_arg(ap, size_t);
+            args_put(slot, &z, sizeof(z));
+            break;
+        case LOG_ARG_PTR:
+            ptr = va_arg(ap, void *);
+            args_put(slot, &ptr, sizeof(ptr));
+            break;
+        case LOG_ARG_DOUBLE:
+            d = va_arg(ap, double);
+            args_put(slot, &d, sizeof(d));
+            break;
+        case LOG_ARG_STR:
+            args_put_str(slot, va_arg(ap, const char *));
+            break;
+        case LOG_ARG_PERCENT:
+            break;
+        default:
+            return;
+        }
+    }
+}
+
+void bt_log_deferred(uint8_t level, const char *name, const char *func, uint16_t line,
+                     const char *format, ...)
+{
+    struct log_slot *slot;
+    uint32_t ticket;
+    uint32_t lap;
+    uint32_t seq;
+    va_list ap;
+
+    for (;;)
+    {
+        ticket = __atomic_load_n(&ring.head, __ATOMIC_RELAXED);
+        lap = ticket & ~LOG_SLOT_MASK;
+        slot = &ring.slots[ticket & LOG_SLOT_MASK];
+        seq = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+
+        if (seq == lap)
+        {
+            if (__atomic_compare_exchange_n(&ring.head, &ticket, ticket + 1U, false,
+                                            __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+            {
+                break;
+            }
+        }
+        else if ((int32_t)(seq - lap) < 0)
+        {
+            /* Still holds a message of the previous lap */
+            (void)__atomic_fetch_add(&ring.dropped, 1U, __ATOMIC_RELAXED);
+            return;
+        }
+    }
+
+    slot->timestamp = k_ticks_to_ms_floor32(sys_clock_tick_get());
+    slot->format = format;
+    slot->name = name;
+    slot->func = func;
+    slot->line = line;
+    slot->level = level;
+    slot->len = 0U;
+    slot->truncated = false;
+
+    va_start(ap, format);
+    args_record(slot, format, ap);
+    va_end(ap);
+
+    __atomic_store_n(&slot->seq, lap + 1U, __ATOMIC_RELEASE);
+}
+
+static bool args_get(const struct log_slot *slot, uint8_t *offset, void *val, size_t size)
+{
+    if (*offset + size > slot->len)
+    {
+        return false;
+    }
+
+    (void)memcpy(val, &slot->args[*offset], size);
+    *offset += size;
+
+    return true;
+}
+
+static size_t line_add(size_t pos, int ret)
+{
+    /* snprintf() tells how much it wanted to write */
+    if (ret < 0)
+    {
+        return pos;
+    }
+
+    return MIN(pos + (size_t)ret, sizeof(log_line) - 2U);
+}
+
+/* The spec with every '*' replaced by the recorded value */
+static bool spec_build(const struct log_slot *slot, uint8_t *offset, const char *format,
+                       const struct log_spec *spec, char *buf, size_t size)
+{
+    size_t pos = 0U;
+    int star;
+    int ret;
+    uint8_t i;
+
+    for (i = 0U; i < spec->len && pos + 1U < size; i++)
+    {
+        if (format[i] != '*')
+        {
+            buf[pos++] = format[i];
+            continue;
+        }
+
+        if (!args_get(slot, offset, &star, sizeof(star)))
+        {
+            return false;
+        }
+
+        ret = snprintf(&buf[pos], size - pos, "%d", star);
+        if (ret < 0 || (size_t)ret >= size - pos)
+        {
+            return false;
+        }
+
+        pos += ret;
+    }
+
+    if (i < spec->len)
+    {
+        return false;
+    }
+
+    buf[pos] = '\0';
+
+    return true;
+}
+
+static size_t spec_format(const struct log_slot *slot, uint8_t *offset, const char *format,
+                          const struct log_spec *spec, size_t pos)
+{
+    char *out = &log_line[pos];
+    size_t room = sizeof(log_line) - 1U - pos;
+    char buf[24];
+    long long ll;
+    size_t z;
+    void *ptr;
+    double d;
+    long l;
+    int i;
+    int ret = -1;
+
+    if (!spec_build(slot, offset, format, spec, buf, sizeof(buf)))
+    {
+        return SIZE_MAX;
+    }
+
+    switch (spec->arg)
+    {
+    case LOG_ARG_INT:
+        if (args_get(slot, offset, &i, sizeof(i)))
+        {
+            ret = snprintf(out, room, buf, i);
+        }
+        break;
+    case LOG_ARG_LONG:
+        if (args_get(slot, offset, &l, sizeof(l)))
+        {
+            ret = snprintf(out, room, buf, l);
+        }
+        break;
+    case LOG_ARG_LLONG:
+        if (args_get(slot, offset, &ll, sizeof(ll)))
+        {
+            ret = snprintf(out, room, buf, ll);
+        }
+        break;
+    case LOG_ARG_SIZE:
+        if (args_get(slot, offset, &z, sizeof(z)))
+        {
+            ret = snprintf(out, room, buf, z);
+        }
+        break;
+    case LOG_ARG_PTR:
+        if (args_get(slot, offset, &ptr, sizeof(ptr)))
+        {
+            ret = snprintf(out, room, buf, ptr);
+        }
+        break;
+    case LOG_ARG_DOUBLE:
+        if (args_get(slot, offset, &d, sizeof(d)))
+        {
+            ret = snprintf(out, room, buf, d);
+        }
+        break;
+    case LOG_ARG_STR:
+        if (*offset < slot->len)
+        {
+            ret = snprintf(out, room, buf, (const char *)&slot->args[*offset]);
+            *offset += strlen((const char *)&slot->args[*offset]) + 1U;
+        }
+        break;
+    case LOG_ARG_PERCENT:
+        ret = snprintf(out, room, "%%");
+        break;
+    default:
+        break;
+    }
+
+    if (ret < 0)
+    {
+        return SIZE_MAX;
+    }
+
+    return line_add(pos, ret);
+}
+
+static void slot_format(const struct log_slot *slot)
+{
+    const char *format = slot->format;
+    const char *start;
+    struct log_spec spec;
+    uint8_t offset = 0U;
+    size_t next;
+    size_t pos;
+
+    pos = line_add(0U, snprintf(log_line, sizeof(log_line) - 1U, "[%08u] %c: (%s)%s():%u: ",
+                                (unsigned int)slot->timestamp,
+                                z_log_minimal_level_to_char(slot->level), slot->name,
+                                slot->func, slot->line));
+
+    while (*format && pos < sizeof(log_line) - 2U)
+    {
+        if (*format != '%')
+        {
+            log_line[pos++] = *format++;
+            continue;
+        }
+
+        start = format;
+        format = spec_parse(format, &spec);
+
+        next = spec_format(slot, &offset, start, &spec, pos);
+        if (next == SIZE_MAX)
+        {
+            /* Cut short when recorded, or a conversion we do not know */
+            pos = line_add(pos, snprintf(&log_line[pos], sizeof(log_line) - 1U - pos, "<...>"));
+            break;
+        }
+
+        pos = next;
+    }
+
+    log_line[pos++] = '\n';
+    log_line[pos] = '\0';
+}
+
+uint32_t bt_log_deferred_drain(uint32_t max)
+{
+    struct log_slot *slot;
+    uint32_t count = 0U;
+    uint32_t dropped;
+    uint32_t lap;
+
+    while (count < max)
+    {
+        slot = &ring.slots[ring.tail & LOG_SLOT_MASK];
+        lap = ring.tail & ~LOG_SLOT_MASK;
+
+        if (__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) != lap + 1U)
+        {
+            /* Empty, or the next message is still being recorded */
+            break;
+        }
+
+        slot_format(slot);
+        bt_log_impl_printf(slot->level, "%s", log_line);
+
+        __atomic_store_n(&slot->seq, lap + LOG_SLOTS, __ATOMIC_RELEASE);
+        ring.tail++;
+        count++;
+    }
+
+    if (__atomic_load_n(&ring.dropped, __ATOMIC_RELAXED))
+    {
+        dropped = __atomic_exchange_n(&ring.dropped, 0U, __ATOMIC_RELAXED);
+        bt_log_impl_printf(LOG_IMPL_LEVEL_WRN, "W: %u log messages dropped\n",
+                           (unsigned int)dropped);
+    }
+
+    return count;
+}
+#endif /* CONFIG_BT_LOG_DEFERRED */
@@ -27,3 +27,122 @@ void bt_log_impl_register(const bt_log_impl_t *log_impl)
     bt_log_implementation = log_impl;
     bt_log_impl_init();
 }
+
+#if defined(CONFIG_BT_LOG_RUNTIME_LEVEL)
+#include <errno.h>
+#include <string.h>
+
+/* Levels set before the module registered, matched on its name */
+static struct
+{
+    char name[32];
+    uint8_t level;
+} bt_log_overrides[CONFIG_BT_LOG_RUNTIME_LEVEL_OVERRIDES];
+static uint8_t bt_log_override_count;
+static struct bt_log_module *bt_log_modules;
+static bool bt_log_all_set;
+static uint8_t bt_log_all_level;
+
+/* Logging can happen from driver and timer threads as well as from the
+ * polling loop, a module is claimed and linked with compare-and-set so
+ * that racing first messages cannot link it twice.
+ */
+bool bt_log_module_enabled(struct bt_log_module *module, uint8_t level)
+{
+    uint8_t state = BT_LOG_MODULE_UNREGISTERED;
+    uint8_t new_level = LOG_IMPL_LEVEL_DBG;
+    uint8_t i;
+
+    if (!__atomic_compare_exchange_n(&module->level, &state, BT_LOG_MODULE_REGISTERING, false,
+                                     __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE))
+    {
+        /* Being registered by another thread, or done already */
+        return level <= state;
+    }
+
+    module->next = __atomic_load_n(&bt_log_modules, __ATOMIC_RELAXED);
+    while (!__atomic_compare_exchange_n(&bt_log_modules, &module->next, module, true,
+                                        __ATOMIC_RELEASE, __ATOMIC_RELAXED))
+    {
+    }
+
+    if (bt_log_all_set)
+    {
+        new_level = bt_log_all_level;
+    }
+
+    for (i = 0U; i < bt_log_override_count; i++)
+    {
+        if (!strcmp(bt_log_overrides[i].name, module->name))
+        {
+            new_level = bt_log_overrides[i].level;
+            break;
+        }
+    }
+
+    /* bt_log_level_set() may have reached the module since it was linked */
+    state = BT_LOG_MODULE_REGISTERING;
+    if (!__atomic_compare_exchange_n(&module->level, &state, new_level, false, __ATOMIC_RELEASE,
+                                     __ATOMIC_RELAXED))
+    {
+        new_level = state;
+    }
+
+    return level <= new_level;
+}
+
+static int bt_log_override_set(const char *name, uint8_t level)
+{
+    uint8_t i;
+
+    if (!name)
+    {
+        /* Replaces every level set before */
+        bt_log_all_set = true;
+        bt_log_all_level = level;
+        bt_log_override_count = 0U;
+        return 0;
+    }
+
+    for (i = 0U; i < bt_log_override_count; i++)
+    {
+        if (!strcmp(bt_log_overrides[i].name, name))
+        {
+            bt_log_overrides[i].level = level;
+            return 0;
+        }
+    }
+
+    if (bt_log_override_count == ARRAY_SIZE(bt_log_overrides) ||
+        strlen(name) >= sizeof(bt_log_overrides[0].name))
+    {
+        return -ENOMEM;
+    }
+
+    (void)strcpy(bt_log_overrides[bt_log_override_count].name, name);
+    bt_log_overrides[bt_log_override_count].level = level;
+    bt_log_override_count++;
+
+    return 0;
+}
+
+int bt_log_level_set(const char *name, uint8_t level)
+{
+    struct bt_log_module *module;
+    int err;
+
+    /* Before walking the list, a module linked meanwhile reads the override */
+    err = bt_log_override_set(name, level);
+
+    for (module = __atomic_load_n(&bt_log_modules, __ATOMIC_ACQUIRE); module;
+         module = module->next)
+    {
+        if (!name || !strcmp(module->name, name))
+        {
+            __atomic_store_n(&module->level, level, __ATOMIC_RELAXED);
+        }
+    }
+
+    return err;
+}
+#endif /* CONFIG_BT_LOG_RUNTIME_LEVEL */
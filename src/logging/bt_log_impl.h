@@ -37,6 +37,18 @@ extern void bt_log_impl_printf(uint8_t _level, const char *format, ...);
 extern void bt_log_impl_packet(uint8_t packet_type, uint8_t in, uint8_t *packet, uint16_t len);
 extern void bt_log_impl_init(void);
 
+#if defined(CONFIG_BT_LOG_DEFERRED)
+extern void bt_log_deferred(uint8_t level, const char *name, const char *func, uint16_t line,
+                            const char *format, ...);
+extern uint32_t bt_log_deferred_drain(uint32_t max);
+
+/* Formatted later, the format and the names must be string literals */
+#define LOG_IMPL_TO_PRINTK(_fun, _line, _level, _name, fmt, ...)                                   \
+    do                                                                                             \
+    {                                                                                              \
+        bt_log_deferred(_level, #_name, _fun, _line, fmt, ##__VA_ARGS__);                          \
+    } while (false);
+#else
 #define LOG_IMPL_TO_PRINTK(_fun, _line, _level, _name, fmt, ...)                                   \
     do                                                                                             \
     {                                                                                              \
@@ -47,10 +59,47 @@ extern void bt_log_impl_init(void);
                            z_log_minimal_level_to_char(_level), #_name, _fun, _line,               \
                            ##__VA_ARGS__);                                                         \
     } while (false);
+#endif /* CONFIG_BT_LOG_DEFERRED */
+
+#if defined(CONFIG_BT_LOG_RUNTIME_LEVEL)
+/* Levels of a module that has not been linked into the module list yet,
+ * above every real level so that its messages reach the slow path.
+ */
+#define BT_LOG_MODULE_REGISTERING  0xFEU
+#define BT_LOG_MODULE_UNREGISTERED 0xFFU
+
+/* Runtime level of one logging module, one per file including bt_log.h */
+struct bt_log_module
+{
+    const char *name;
+    uint8_t level;
+    struct bt_log_module *next;
+};
+
+extern bool bt_log_module_enabled(struct bt_log_module *module, uint8_t level);
+
+/**
+ * @brief Set the runtime level of a logging module
+ *
+ * Messages above the level the module was built with stay compiled out.
+ * Must not be called from more than one thread at a time, modules may
+ * register from any thread meanwhile.
+ *
+ * @param name Module name as given by LOG_MODULE_NAME, NULL for all modules.
+ * @param level LOG_IMPL_LEVEL_NONE to LOG_IMPL_LEVEL_DBG.
+ *
+ * @return 0 on success, -ENOMEM if no override is left for a module that has
+ * not logged yet.
+ */
+int bt_log_level_set(const char *name, uint8_t level);
+#endif /* CONFIG_BT_LOG_RUNTIME_LEVEL */
+
+/* Redefined by bt_log.h to the level of the module */
+#define LOG_IMPL_RUNTIME_ENABLED(_level) (true)
 
 #ifdef FUNCTION_CONTROL_DEBUG_ENABLE
 #define __LOG_IMPL(_level, _name, _level_thod, ...)                                                \
-    if (_level <= _level_thod)                                                                     \
+    if (_level <= _level_thod && LOG_IMPL_RUNTIME_ENABLED(_level))                                 \
     {                                                                                              \
         LOG_IMPL_TO_PRINTK(__func__, __LINE__, _level, _name, __VA_ARGS__);                        \
     }